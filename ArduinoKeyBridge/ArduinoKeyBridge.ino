@@ -1,72 +1,157 @@
 // Required libraries and headers
 #include <Arduino.h>
 #include <memory>
+#include <usbhub.h>
 #include "TCPConnection.h"
 #include "ArduinoKeyBridgeNeoPixel.h"
 #include "MinimalKeyboard.h"
-
-// USB Host Controller and HID Keyboard interface
+#include "BridgeClock.h"
+#include "KeyStages.h"
+#include "SnippetStore.h"
+#include "CalibrationStore.h"
+#include "ConfigStore.h"
+#include "LatencyTracer.h"
+#include "LoopWatchdog.h"
+#include "TaskScheduler.h"
+#include "SerialTransport.h"
+#include "BleTransport.h"
+
+// USB Host Controller, a hub and up to four HID keyboards behind it
 USB Usb;
-HIDBoot<USB_HID_PROTOCOL_KEYBOARD> HidKeyboard(&Usb);
-
-// Keyboard instance for handling input
+USBHub Hub(&Usb);
+HIDBoot<USB_HID_PROTOCOL_KEYBOARD> HidKeyboard0(&Usb);
+HIDBoot<USB_HID_PROTOCOL_KEYBOARD> HidKeyboard1(&Usb);
+HIDBoot<USB_HID_PROTOCOL_KEYBOARD> HidKeyboard2(&Usb);
+HIDBoot<USB_HID_PROTOCOL_KEYBOARD> HidKeyboard3(&Usb);
+HIDBoot<USB_HID_PROTOCOL_KEYBOARD>* hidKeyboards[KeyboardMerger::MAX_DEVICES] = {
+    &HidKeyboard0, &HidKeyboard1, &HidKeyboard2, &HidKeyboard3
+};
+bool hidKeyboardReady[KeyboardMerger::MAX_DEVICES] = {};
+
+// Keyboard instance for handling input, one parser per USB keyboard
 MinimalKeyboard& keyboard = MinimalKeyboard::getInstance();
-MinimalKeyboardParser parser(keyboard);
-
-// Timer for test key report
-static unsigned long lastTestKeyTime = 0;
-static constexpr unsigned long TEST_KEY_INTERVAL = 20000; // 20 seconds
-
-static unsigned long lastStatusTime = 0;
-static constexpr unsigned long STATUS_INTERVAL = 10000; // 10 seconds
-
-bool isCharterMode = false;
-String charterBuffer = "";
-unsigned long lastCharTime = 0;
-const unsigned long charterDelay = 100; // ms
+MinimalKeyboardParser parsers[KeyboardMerger::MAX_DEVICES] = {
+    MinimalKeyboardParser(keyboard, 0), MinimalKeyboardParser(keyboard, 1),
+    MinimalKeyboardParser(keyboard, 2), MinimalKeyboardParser(keyboard, 3)
+};
+
+// Stages every key report from the USB keyboard runs through, in order
+using KeyProcessing = KeyPipeline::Pipeline<
+    DeviceRouteStage,    // Macro pads to the server, if configured
+    ChordStage,          // Mode switch chords and sequences (F19, both shifts, ...)
+    CharterStage,        // Charter mode: keys type from the charter buffer
+    RemapStage,          // Layered key remapping (RemapStore)
+    ServerForwardStage,  // Command mode: forward to the server
+    HostStage            // Otherwise pass through to the host
+>;
+KeyProcessing keyProcessing;
+
+// Link to the server: WiFi TCP unless built with -DKEYBRIDGE_BLE or
+// -DKEYBRIDGE_SERIAL (Serial1, Serial carries the log)
+#if defined(KEYBRIDGE_BLE)
+BleTransport bleTransport;
+#elif defined(KEYBRIDGE_SERIAL)
+SerialTransport serialTransport(Serial1);
+#endif
+
+// FlightRecorder HALT reasons
+static constexpr uint8_t HALT_USB_INIT = 1;
+
+// Log messages per second and source below ERROR, changeable with LOG_RATE
+static constexpr uint16_t LOG_RATE = 20;
+static constexpr uint16_t LOG_BURST = 40;
+
+// Scheduler periods, deadlines and budgets in microseconds. USB polling and
+// HID output come first; network, LEDs and status only get what is left.
+static constexpr unsigned long USB_PERIOD = 1000;
+static constexpr unsigned long NETWORK_PERIOD = 2000;
+static constexpr unsigned long LED_PERIOD = LedCompositor::FRAME_INTERVAL_MS * 1000;
+void usbTask();
+void networkTask();
+void ledTask();
+void statusTask();
 
 void setup() {
     // Initialize logger first
     ArduinoKeyBridgeLogger::getInstance().begin(115200);
-    ArduinoKeyBridgeLogger::getInstance().setLogLevel(LogLevel::DEBUG);
+    // What the last run did before a hang, before the configured log level
+    // can hide it or the rate limit cut it short
+    LoopWatchdog::getInstance().begin();
+    // Tunables from data flash (BridgeConfig), everything below reads them
+    ConfigStore::getInstance().begin();
+    const BridgeConfig& config = ConfigStore::config();
+    ArduinoKeyBridgeLogger::getInstance().setLogLevel(LogLevel(config.logLevel));
+    // Keep DEBUG on without typing bursts flooding the serial link
+    ArduinoKeyBridgeLogger::getInstance().setRateLimit(LOG_RATE, LOG_BURST);
     ArduinoKeyBridgeLogger::getInstance().info("Setup", "Starting ArduinoKeyBridge...");
     
     // Initialize NeoPixel
-    ArduinoKeyBridgeNeoPixel::getInstance().begin(6, 8);
+    ArduinoKeyBridgeNeoPixel::getInstance().begin(config.ledPin, config.ledCount);
     ArduinoKeyBridgeNeoPixel::getInstance().setBrightness(0);
     ArduinoKeyBridgeNeoPixel::getInstance().showSetupProgress(0.0f);
 
     // Setup 25% complete
     ArduinoKeyBridgeNeoPixel::getInstance().showSetupProgress(0.25f);
+    LoopWatchdog::getInstance().setupStep(25);
     ArduinoKeyBridgeLogger::getInstance().info("Setup", "25% complete");
 
-    // Initialize TCP server
+    // Initialize TCP server (or the BLE/serial link)
+#if defined(KEYBRIDGE_BLE)
+    bleTransport.begin("ArduinoKeyBridge");
+    TCPConnection::getInstance().useTransport(bleTransport);
+#elif defined(KEYBRIDGE_SERIAL)
+    Serial1.begin(115200);
+    TCPConnection::getInstance().useTransport(serialTransport);
+#else
     TCPConnection::getInstance().startAP();
+#endif
+    // Only now: the access point can take longer to come up than the timeout
+    LoopWatchdog::getInstance().arm();
 
     // Setup 50% complete
     ArduinoKeyBridgeNeoPixel::getInstance().showSetupProgress(0.50f);
+    LoopWatchdog::getInstance().setupStep(50);
     ArduinoKeyBridgeLogger::getInstance().info("Setup", "50% complete");
 
     // Initialize USB Host Shield
     if (Usb.Init() == -1) {
         ArduinoKeyBridgeLogger::getInstance().error("Setup", "USB initialization failed");
         ArduinoKeyBridgeNeoPixel::getInstance().setStatusError();
-        while (1); // Halt if USB init fails
+        // Halt; the watchdog resets the board and the next boot dumps the record
+        LoopWatchdog::getInstance().halt(HALT_USB_INIT);
     }
     ArduinoKeyBridgeLogger::getInstance().info("Setup", "USB initialized");
 
-    // Register the keyboard parser
-    HidKeyboard.SetReportParser(0, &parser);
+    // Register the keyboard parsers. Keyboards take the slots in the order
+    // they enumerate; the first one is the main keyboard, the others are
+    // tagged as macro pads so routing can tell them apart.
+    for (uint8_t i = 0; i < KeyboardMerger::MAX_DEVICES; ++i) {
+        hidKeyboards[i]->SetReportParser(0, &parsers[i]);
+        keyboard.merger().setTag(i, i == 0 ? KeyboardMerger::KEYBOARD : KeyboardMerger::MACRO_PAD);
+    }
 
     // Setup 75% complete
     ArduinoKeyBridgeNeoPixel::getInstance().showSetupProgress(0.75f);
+    LoopWatchdog::getInstance().setupStep(75);
     ArduinoKeyBridgeLogger::getInstance().info("Setup", "75% complete");
 
     // Initialize keyboard
     keyboard.begin();
+    // Typing rate calibrated for the last host profile
+    CalibrationStore::getInstance().begin();
+
+    // Key remap tables from flash, replaceable over TCP
+    RemapStore::getInstance().begin();
+    TCPConnection::getInstance().registerBlobSink(BridgeProtocol::Control::REMAP_BLOB, &RemapStore::getInstance());
+    // Snippet library, typed from flash by key binding
+    SnippetStore::getInstance().begin();
+    TCPConnection::getInstance().registerBlobSink(BridgeProtocol::Control::SNIPPET_BLOB, &SnippetStore::getInstance());
+    TCPConnection::getInstance().registerBlobSink(BridgeProtocol::Control::CONFIG_BLOB, &ConfigStore::getInstance());
     
     // Setup 100% complete
     ArduinoKeyBridgeNeoPixel::getInstance().showSetupProgress(1.0f);
+    LoopWatchdog::getInstance().setupStep(100);
+    ArduinoKeyBridgeNeoPixel::getInstance().clearSetupProgress();
 
     ArduinoKeyBridgeLogger::getInstance().info("Setup", "Setup completed successfully");
     ArduinoKeyBridgeNeoPixel::getInstance().setStatusIdle();
@@ -74,87 +159,85 @@ void setup() {
 
     // Mem after setup
     ArduinoKeyBridgeLogger::getInstance().logMemory("Setup");
+
+    // Tasks run from loop(): name, function, priority, period, deadline, budget
+    TaskScheduler& scheduler = TaskScheduler::getInstance();
+    scheduler.addTask("usb", usbTask, 0, USB_PERIOD, USB_PERIOD, 1000);
+    scheduler.addTask("network", networkTask, 1, NETWORK_PERIOD, 5000, 5000);
+    scheduler.addTask("leds", ledTask, 2, LED_PERIOD, LED_PERIOD, 2000);
+    scheduler.addTask("status", statusTask, 3, config.statusIntervalMs * 1000, 1000000, 20000);
 }
 
 
-void handle_new_key_report() {
-
-    if (keyboard.currentReport.keys[0] == 0x6E) { // F19 keycode
-        // Manual charter mode toggle (F19)
-        TCPConnection::getInstance().toggleCharterMode();
-        ArduinoKeyBridgeLogger::getInstance().debug("Loop", "Manual charter mode toggled - Now " + String(TCPConnection::getInstance().is_charter_mode() ? "ON" : "OFF"));
-        keyboard.hasNewReport = false;
-        return;
-
-    } else if (TCPConnection::getInstance().is_charter_mode()) {
-        // Handle charter mode key reports
-        ArduinoKeyBridgeLogger::getInstance().debug("Loop", "Charter mode is on, handling key report");
-        TCPConnection::getInstance().handleCharterKeyReport(keyboard.currentReport);
-        keyboard.hasNewReport = false;
-        return;
-
-    } else if (keyboard.currentReport.modifiers == 0x22) {
-        // Always process command mode toggle reports locally first
-
-        ArduinoKeyBridgeLogger::getInstance().debug("Loop", "Command mode detected");
-        TCPConnection::getInstance().set_command_mode(!TCPConnection::getInstance().is_command_mode());
-        ArduinoKeyBridgeNeoPixel::getInstance().setColor(TCPConnection::getInstance().is_command_mode() ? NeoPixelColors::BLUE : NeoPixelColors::WHITE);
-        //TCPConnection::getInstance().sendKeyReport(&keyboard.currentReport); // Optionally notify server
-        ArduinoKeyBridgeLogger::getInstance().debug("Loop", "Command mode toggled");
-        if (TCPConnection::getInstance().is_command_mode()) {
-            ArduinoKeyBridgeLogger::getInstance().debug("Loop", "Command mode ON");
-            TCPConnection::getInstance().sendKeyReport(KeyReport{0x22, 0x00, {0x10, 0x10, 0x10, 0x10, 0x10, 0x10}});
-            ArduinoKeyBridgeNeoPixel::getInstance().setBrightness(15);
-        } else {
-            ArduinoKeyBridgeLogger::getInstance().debug("Loop", "Command mode OFF");
-            TCPConnection::getInstance().sendKeyReport(KeyReport{0x22, 0x00, {0x11, 0x11, 0x11, 0x11, 0x11, 0x11}});
-            ArduinoKeyBridgeNeoPixel::getInstance().setBrightness(1);
-        }
-        // The is_keyreport_command_mode function should toggle the mode internally
-    } else if (TCPConnection::getInstance().is_command_mode()) {
-        // In command mode: send all other key reports to the server
-        TCPConnection::getInstance().sendKeyReport(keyboard.currentReport);
-        ArduinoKeyBridgeLogger::getInstance().debug("Loop", "Sending key report to TCP connection");
-    
-    } else {
-        // Otherwise, send to the host computer
-        keyboard.sendReport(&keyboard.currentReport);
-    }
-    keyboard.hasNewReport = false;
+void handle_new_key_report(KeyReport& report, unsigned long arrivalUs) {
+    FlightRecorder::record(FlightRecorder::KEY_REPORT, report.modifiers, uint16_t(report.keys[0] | (report.keys[1] << 8)));
+    // Sampled reports are timed from their USB arrival to the host or server
+    LatencyTracer::getInstance().arrival(arrivalUs);
+    keyProcessing.process(report);
 }
 
 
-void loop() {
-    // Roll the currently active color
-    ArduinoKeyBridgeNeoPixel::getInstance().rollColor(0);
-
+void usbTask() {
     // Process USB tasks
     Usb.Task();
 
+    // Keys held on a keyboard that was unplugged must not stay pressed
+    for (uint8_t i = 0; i < KeyboardMerger::MAX_DEVICES; ++i) {
+        bool ready = hidKeyboards[i]->isReady();
+        if (hidKeyboardReady[i] && !ready) keyboard.onDeviceGone(i);
+        hidKeyboardReady[i] = ready;
+    }
+
+    // Send new key reports on right away, each a copy so stages can modify it
+    KeyReport report;
+    unsigned long arrivalUs;
+    while (keyboard.nextReport(report, arrivalUs)) {
+        handle_new_key_report(report, arrivalUs);
+    }
+    // Sequences that complete by timing out (ChordStage)
+    keyProcessing.stage<1>().poll();
+    // One queued report per host polling interval
+    keyboard.pump();
+}
+
+void networkTask() {
     // Check for TCP connection client/new message
     TCPConnection::getInstance().poll();
+    keyboard.pump();
+}
 
-    // Check for new key report and send to TCP connection
-    if (keyboard.hasNewReport) {
-        handle_new_key_report();
-    }
+void ledTask() {
+    // Compose the LED layers, the strip is only sent when the frame changed
+    ArduinoKeyBridgeNeoPixel::getInstance().update();
+}
 
-    // Call TCPConnection::status() every 10 seconds
-    if (millis() - lastStatusTime >= STATUS_INTERVAL) {
-        lastStatusTime = millis();
-        TCPConnection::getInstance().status();
-
-        // send a key report to the TCP connection
-        /*
-        KeyReport report = {0};
-        report.modifiers = 0x00; // No modifiers
-        report.reserved = 0x00;
-        report.keys[0] = 0x37; // '.' key
-        for (int i = 1; i < 6; ++i) report.keys[i] = 0x00;
-        TCPConnection::getInstance().sendKeyReport(report);
-        TCPConnection::getInstance().sendEmptyKeyReport();
-        */
-    }
+void statusTask() {
+    TCPConnection::getInstance().status();
+    // Scheduler latencies for the last status interval
+    TaskScheduler::getInstance().logStats();
+    TaskScheduler::getInstance().resetStats();
+    // HID queue depth and losses
+    keyboard.logStats();
+    // Longest loop iteration and stalls
+    LoopWatchdog::getInstance().logStats();
+    // Sources that went quiet while over their limit
+    ArduinoKeyBridgeLogger::getInstance().reportSuppressed();
+
+    // send a key report to the TCP connection
+    /*
+    KeyReport report = {0};
+    report.modifiers = 0x00; // No modifiers
+    report.reserved = 0x00;
+    report.keys[0] = 0x37; // '.' key
+    for (int i = 1; i < 6; ++i) report.keys[i] = 0x00;
+    TCPConnection::getInstance().sendKeyReport(report);
+    TCPConnection::getInstance().sendEmptyKeyReport();
+    */
 }
 
 
+void loop() {
+    LoopWatchdog::getInstance().iterationStarted();
+    TaskScheduler::getInstance().runOnce();
+    LoopWatchdog::getInstance().iterationEnded();
+}
@@ -1,6 +1,8 @@
 #include "ArduinoKeyBridgeLogger.h"
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include <string.h>
+#include "BridgeClock.h"
 
 ArduinoKeyBridgeLogger& ArduinoKeyBridgeLogger::getInstance() {
     static ArduinoKeyBridgeLogger instance;
@@ -12,7 +14,7 @@ void ArduinoKeyBridgeLogger::begin(unsigned long baudRate) {
         SerialUSB.begin(baudRate);
         // No blocking wait for SerialUSB
         initialized = true;
-        startTime = millis();
+        startTime = BridgeClock::millis();
         info("Logger", "ArduinoKeyBridgeLogger initialized");
     }
 }
@@ -24,6 +26,59 @@ void ArduinoKeyBridgeLogger::setLogLevel(LogLevel level) {
     info("Logger", levelMsg);
 }
 
+void ArduinoKeyBridgeLogger::setRateLimit(uint16_t perSecond, uint16_t burst, uint16_t sampleEvery) {
+    LogRateLimiter::Limit limit;
+    limit.perSecond = perSecond;
+    limit.burst = burst;
+    limit.sampleEvery = sampleEvery;
+    limiter.setDefault(limit);
+    info("Logger", String("Rate limit: ") + perSecond + "/s, burst " + burst + ", 1 in " + sampleEvery);
+}
+
+bool ArduinoKeyBridgeLogger::setRateLimit(const char* source, uint16_t perSecond, uint16_t burst, uint16_t sampleEvery) {
+    LogRateLimiter::Limit limit;
+    limit.perSecond = perSecond;
+    limit.burst = burst;
+    limit.sampleEvery = sampleEvery;
+    return limiter.setLimit(source, limit);
+}
+
+void ArduinoKeyBridgeLogger::reportSuppressed() {
+    if (!initialized || !SerialUSB) return;
+    uint32_t count = 0;
+    while (const char* source = limiter.takeSuppressed(count)) {
+        printSuppressed(source, count);
+    }
+}
+
+bool ArduinoKeyBridgeLogger::allow(LogLevel level, const char* source) {
+    if (!initialized || !SerialUSB || level < currentLevel) return false;
+    if (!admit(level, source)) return false;
+    admitted = source;
+    return true;
+}
+
+bool ArduinoKeyBridgeLogger::admit(LogLevel level, const char* source) {
+    if (admitted && (admitted == source || strcmp(admitted, source) == 0)) {
+        admitted = nullptr;
+        return true;
+    }
+    admitted = nullptr;
+    if (level >= LogLevel::ERROR) return true;
+    uint32_t suppressed = 0;
+    if (!limiter.allow(source, BridgeClock::millis(), suppressed)) return false;
+    if (suppressed > 0) printSuppressed(source, suppressed);
+    return true;
+}
+
+void ArduinoKeyBridgeLogger::printSuppressed(const char* source, uint32_t count) {
+    timestamp();
+    SerialUSB.print("INFO [Logger] suppressed ");
+    SerialUSB.print(count);
+    SerialUSB.print(" messages from ");
+    SerialUSB.println(source);
+}
+
 void ArduinoKeyBridgeLogger::debug(const char* source, const char* message) {
     if (!initialized || !SerialUSB) return;
     log(LogLevel::DEBUG, source, message);
@@ -78,7 +133,7 @@ void ArduinoKeyBridgeLogger::mem(const char* source, const String& message) {
 
 void ArduinoKeyBridgeLogger::log(LogLevel level, const char* source, const char* message) {
     if (!initialized || !SerialUSB) return;
-    if (level >= currentLevel) {
+    if (level >= currentLevel && admit(level, source)) {
         timestamp();
         SerialUSB.print(getLevelString(level));
         SerialUSB.print(" [");
@@ -95,6 +150,7 @@ void ArduinoKeyBridgeLogger::log(LogLevel level, const char* source, const Strin
 
 void ArduinoKeyBridgeLogger::hexDump(const char* source, const uint8_t* data, size_t length) {
     if (!initialized || !SerialUSB || currentLevel > LogLevel::DEBUG) return;
+    if (!admit(LogLevel::DEBUG, source)) return;
     timestamp();
     SerialUSB.print("DEBUG [");
     SerialUSB.print(source);
@@ -112,7 +168,7 @@ void ArduinoKeyBridgeLogger::hexDump(const char* source, const uint8_t* data, si
 
 void ArduinoKeyBridgeLogger::timestamp() {
     if (!initialized || !SerialUSB) return;
-    unsigned long currentTime = millis() - startTime;
+    unsigned long currentTime = BridgeClock::millis() - startTime;
     unsigned long seconds = currentTime / 1000;
     unsigned long milliseconds = currentTime % 1000;
     
@@ -2,6 +2,7 @@
 #define ARDUINO_KEY_BRIDGE_LOGGER_H
 
 #include <Arduino.h>
+#include "LogRateLimiter.h"
 
 // Log levels
 enum class LogLevel {
@@ -23,6 +24,21 @@ public:
     
     void begin(unsigned long baudRate = 115200);
     void setLogLevel(LogLevel level);
+
+    // Token bucket and 1-in-N sampling per source for everything below
+    // ERROR (LogRateLimiter.h). perSecond 0 turns the limit off. Messages
+    // held back are reported as "suppressed N messages from X" once the
+    // source gets through again or reportSuppressed() runs.
+    void setRateLimit(uint16_t perSecond, uint16_t burst, uint16_t sampleEvery = 1);
+    bool setRateLimit(const char* source, uint16_t perSecond, uint16_t burst, uint16_t sampleEvery = 1);
+    void reportSuppressed();
+    const LogRateLimiter::Limit& rateLimit() const { return limiter.defaultLimit(); }
+
+    // For per-report paths, before building the message: false if level is
+    // filtered out or source is over its rate limit (counted as suppressed).
+    // After true the next message from source is printed without being
+    // charged again.
+    bool allow(LogLevel level, const char* source);
     
     // Logging methods with source tracking
     void debug(const char* source, const char* message);
@@ -59,9 +75,13 @@ private:
     LogLevel currentLevel = LogLevel::INFO;
     bool initialized = false;
     unsigned long startTime = 0;
+    LogRateLimiter limiter;
+    const char* admitted = nullptr; // Source that allow() already charged
 
     void log(LogLevel level, const char* source, const char* message);
     void log(LogLevel level, const char* source, const String& message);
+    bool admit(LogLevel level, const char* source);
+    void printSuppressed(const char* source, uint32_t count);
     const char* getLevelString(LogLevel level);
 };
 
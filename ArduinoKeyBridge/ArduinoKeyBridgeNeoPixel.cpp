@@ -1,4 +1,5 @@
 #include "ArduinoKeyBridgeNeoPixel.h"
+#include "BridgeClock.h"
 
 ArduinoKeyBridgeNeoPixel& ArduinoKeyBridgeNeoPixel::getInstance() {
     static ArduinoKeyBridgeNeoPixel instance;
@@ -9,14 +10,26 @@ void ArduinoKeyBridgeNeoPixel::begin(uint8_t pin, uint16_t numPixels) {
     if (!initialized) {
         pixels = new Adafruit_NeoPixel(numPixels, pin, NEO_GRB + NEO_KHZ800);
         pixels->begin();
+        // Levels are applied per layer by the compositor
         pixels->setBrightness(255);  
         pixels->show();
+        compositor_.begin(numPixels);
         initialized = true;
+        applyMode();
     } else {
         ArduinoKeyBridgeLogger::getInstance().warning("NeoPixel", "Attempt to initialize already initialized NeoPixel");
     }
 }
 
+void ArduinoKeyBridgeNeoPixel::applyMode() {
+    compositor_.setSolid(LedCompositor::MODE, modeColor_, brightness_ / 4);
+    if (ambient_) {
+        compositor_.setRolling(LedCompositor::AMBIENT, modeColor_, brightness_);
+    } else {
+        compositor_.clearLayer(LedCompositor::AMBIENT);
+    }
+}
+
 void ArduinoKeyBridgeNeoPixel::setColor(const NeoPixelColor& color) {
     setColor(color.r, color.g, color.b);
 }
@@ -26,64 +39,26 @@ void ArduinoKeyBridgeNeoPixel::setColor(uint8_t r, uint8_t g, uint8_t b) {
         ArduinoKeyBridgeLogger::getInstance().error("NeoPixel", "Attempt to set color before initialization");
         return;
     }
-    activeColor = Color(r, g, b);
-    for(int i = 0; i < pixels->numPixels(); i++) {
-        pixels->setPixelColor(i, pixels->Color(r, g, b));
-    }
-    pixels->show();
+    modeColor_ = NeoPixelColor(r, g, b);
+    applyMode();
 }
 
-void ArduinoKeyBridgeNeoPixel::setAlternatingColors(uint8_t r1, uint8_t g1, uint8_t b1, 
-                                                   uint8_t r2, uint8_t g2, uint8_t b2) {
+void ArduinoKeyBridgeNeoPixel::setBrightness(uint8_t brightness) {
     if (!initialized) {
-        ArduinoKeyBridgeLogger::getInstance().error("NeoPixel", "Attempt to set alternating colors before initialization");
+        ArduinoKeyBridgeLogger::getInstance().error("NeoPixel", "Attempt to set brightness before initialization");
         return;
     }
-    
-    // Store the colors for animation
-    color1 = Color(r1, g1, b1);
-    color2 = Color(r2, g2, b2);
-    
-    // Initial pattern
-    currentPattern = false;
-    for(int i = 0; i < pixels->numPixels(); i++) {
-        if (i % 2 == 0) {
-            pixels->setPixelColor(i, pixels->Color(r1, g1, b1));
-        } else {
-            pixels->setPixelColor(i, pixels->Color(r2, g2, b2));
-        }
-    }
-    pixels->show();
+    brightness_ = brightness;
+    applyMode();
 }
 
-void ArduinoKeyBridgeNeoPixel::update() {
-    if (!initialized) return;
-    
-    unsigned long currentTime = millis();
-    if (currentTime - lastUpdate >= UPDATE_INTERVAL) {
-        lastUpdate = currentTime;
-        currentPattern = !currentPattern;
-        
-        for(int i = 0; i < pixels->numPixels(); i++) {
-            if (i % 2 == currentPattern) {
-                pixels->setPixelColor(i, pixels->Color(color1.r, color1.g, color1.b));
-            } else {
-                pixels->setPixelColor(i, pixels->Color(color2.r, color2.g, color2.b));
-            }
-        }
-        pixels->show();
-    }
+void ArduinoKeyBridgeNeoPixel::setAmbient(bool enabled) {
+    ambient_ = enabled;
+    if (initialized) applyMode();
 }
 
-void ArduinoKeyBridgeNeoPixel::setBrightness(uint8_t brightness) {
-    if (!initialized) {
-        ArduinoKeyBridgeLogger::getInstance().error("NeoPixel", "Attempt to set brightness before initialization");
-        return;
-    }
-    String brightnessMsg = "Setting brightness to " + String(brightness);
-    pixels->setBrightness(brightness);
-    //pixels->setBrightness(10);
-    pixels->show();
+void ArduinoKeyBridgeNeoPixel::flash(const NeoPixelColor& color, unsigned long durationMs) {
+    compositor_.setSolid(LedCompositor::ACTIVITY, color, brightness_, durationMs);
 }
 
 void ArduinoKeyBridgeNeoPixel::clear() {
@@ -91,8 +66,7 @@ void ArduinoKeyBridgeNeoPixel::clear() {
         ArduinoKeyBridgeLogger::getInstance().error("NeoPixel", "Attempt to clear before initialization");
         return;
     }
-    pixels->clear();
-    pixels->show();
+    compositor_.clearAll();
 }
 
 void ArduinoKeyBridgeNeoPixel::show() {
@@ -100,103 +74,57 @@ void ArduinoKeyBridgeNeoPixel::show() {
         ArduinoKeyBridgeLogger::getInstance().error("NeoPixel", "Attempt to show before initialization");
         return;
     }
+    render(true);
+}
+
+void ArduinoKeyBridgeNeoPixel::update() {
+    if (!initialized) return;
+    render(false);
+}
+
+void ArduinoKeyBridgeNeoPixel::render(bool force) {
+    if (!compositor_.render(BridgeClock::millis(), force)) return;
+    for (uint16_t i = 0; i < compositor_.pixelCount(); i++) {
+        const NeoPixelColor& color = compositor_.pixel(i);
+        pixels->setPixelColor(i, pixels->Color(color.r, color.g, color.b));
+    }
     pixels->show();
+    shows_++;
 }
 
 void ArduinoKeyBridgeNeoPixel::setStatusIdle() {
-    setColor(0, 0, 255);  // Solid bright blue
+    setColor(NeoPixelColors::BLUE);  // Solid bright blue
 }
 
 void ArduinoKeyBridgeNeoPixel::setStatusBusy() {
-    setColor(255, 165, 0);  // Solid bright orange
+    setColor(NeoPixelColors::ORANGE);  // Solid bright orange
 }
 
 void ArduinoKeyBridgeNeoPixel::setStatusError() {
-    setColor(255, 0, 0);  // Solid bright red
+    if (!initialized) return;
+    compositor_.setSolid(LedCompositor::ERROR, NeoPixelColors::RED, STATUS_LEVEL);
+    // Shown right away, the caller may halt
+    render(true);
 }
 
-void ArduinoKeyBridgeNeoPixel::setPixelColors(const NeoPixelColor& pixel0, const NeoPixelColor& pixel1,
-                                             const NeoPixelColor& pixel2, const NeoPixelColor& pixel3,
-                                             const NeoPixelColor& pixel4, const NeoPixelColor& pixel5,
-                                             const NeoPixelColor& pixel6, const NeoPixelColor& pixel7) {
-    if (!initialized) {
-        ArduinoKeyBridgeLogger::getInstance().error("NeoPixel", "Attempt to set pixel colors before initialization");
-        return;
-    }
-    
-    // Array of pixel colors for easier iteration
-    const NeoPixelColor* pixelColors[] = {
-        &pixel0, &pixel1, &pixel2, &pixel3,
-        &pixel4, &pixel5, &pixel6, &pixel7
-    };
-
-    // Set each pixel's color
-    for (int i = 0; i < 8 && i < pixels->numPixels(); i++) {
-        const NeoPixelColor* color = pixelColors[i];
-        pixels->setPixelColor(i, pixels->Color(color->r, color->g, color->b));
-    }
-
-    // If there are more pixels, set them to off/black
-    for (int i = 8; i < pixels->numPixels(); i++) {
-        pixels->setPixelColor(i, pixels->Color(0, 0, 0));
-    }
-
-    pixels->show();
+void ArduinoKeyBridgeNeoPixel::clearStatusError() {
+    compositor_.clearLayer(LedCompositor::ERROR);
 }
 
+void ArduinoKeyBridgeNeoPixel::setStatusSuccess() {
+    setColor(NeoPixelColors::GREEN);  // Solid bright green
+} 
+
 void ArduinoKeyBridgeNeoPixel::showSetupProgress(float progress) {
     if (!initialized) {
         ArduinoKeyBridgeLogger::getInstance().error("NeoPixel", "Attempt to show setup progress before initialization");
         return;
     }
-
-    // Clamp progress between 0 and 1
-    progress = progress < 0.0f ? 0.0f : (progress > 1.0f ? 1.0f : progress);
-    
-    // Calculate how many pixels should be blue
-    int numPixels = pixels->numPixels() / 3; // 3 LEDs per pixel
-    int bluePixels = round(progress * numPixels);
-    
-    // Set all pixels to red first
-    for (int i = 0; i < numPixels; i++) {
-        if (i < bluePixels) {
-            // Progress pixels are white
-            pixels->setPixelColor(i, pixels->Color(255, 255, 255));
-        } else {
-            // Remaining pixels are ded
-            pixels->setPixelColor(i, pixels->Color(0, 0, 0));
-        }
-    }
-    
-    pixels->show();
+    // Progress pixels are white, the rest off; setup blocks, so show it now
+    compositor_.setProgress(LedCompositor::BOOT, NeoPixelColors::WHITE, progress, STATUS_LEVEL);
+    render(true);
 }
 
-void ArduinoKeyBridgeNeoPixel::setStatusSuccess() {
-    setColor(0, 255, 0);  // Solid bright green
-} 
-
-void ArduinoKeyBridgeNeoPixel::rollColor(int delayMs) {
-    // Use activeColor for rolling
-    if (!initialized) {
-        ArduinoKeyBridgeLogger::getInstance().error("NeoPixel", "Attempt to roll color before initialization");
-        return;
-    }
-    uint32_t color = pixels->Color(activeColor.r, activeColor.g, activeColor.b);
-    // Roll from bottom to top
-    for(int i=0; i<pixels->numPixels(); i++) {
-        for(int j=0; j<pixels->numPixels(); j++) pixels->setPixelColor(j,0);
-        pixels->setPixelColor(i,color);
-        pixels->show();
-        delay(delayMs);
-    }
-    // Roll from top to bottom
-    for(int i=pixels->numPixels()-1; i>=0; i--) {
-        for(int j=0; j<pixels->numPixels(); j++) pixels->setPixelColor(j,0);
-        pixels->setPixelColor(i,color);
-        pixels->show();
-        delay(delayMs);
-    }
-    // Clear all pixels at end
-    for(int j=0; j<pixels->numPixels(); j++) pixels->setPixelColor(j,0);
-    pixels->show();
-}
\ No newline at end of file
+void ArduinoKeyBridgeNeoPixel::clearSetupProgress() {
+    compositor_.clearLayer(LedCompositor::BOOT);
+}
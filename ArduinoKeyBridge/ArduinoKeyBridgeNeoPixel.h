@@ -3,85 +3,71 @@
 
 #include <Adafruit_NeoPixel.h>
 #include "ArduinoKeyBridgeLogger.h"
+#include "LedCompositor.h"
 
-// Color constants for easy reference
-struct NeoPixelColor {
-    uint8_t r, g, b;
-    constexpr NeoPixelColor(uint8_t r_ = 0, uint8_t g_ = 0, uint8_t b_ = 0) : r(r_), g(g_), b(b_) {}
-};
-
-namespace NeoPixelColors {
-    static constexpr NeoPixelColor RED(255, 0, 0);
-    static constexpr NeoPixelColor GREEN(0, 255, 0);
-    static constexpr NeoPixelColor BLUE(0, 0, 255);
-    static constexpr NeoPixelColor YELLOW(255, 255, 0);
-    static constexpr NeoPixelColor MAGENTA(255, 0, 255);
-    static constexpr NeoPixelColor CYAN(0, 255, 255);
-    static constexpr NeoPixelColor WHITE(255, 255, 255);
-    static constexpr NeoPixelColor BLACK(0, 0, 0);
-}
-
+// Status LEDs. Setters only change a layer of the LedCompositor; update()
+// (the LED task) composes the layers at a capped frame rate and sends the
+// strip only when the frame changed. Setup progress and errors are shown at
+// once, since setup blocks and an error may halt the sketch.
 class ArduinoKeyBridgeNeoPixel {
 public:
     static ArduinoKeyBridgeNeoPixel& getInstance();
     
     void begin(uint8_t pin = 6, uint16_t numPixels = 24);
+
+    // Mode layer color, also used by the rolling ambient dot
     void setColor(const NeoPixelColor& color);
+    void setColor(uint8_t r, uint8_t g, uint8_t b);
+    // Mode brightness: the ambient dot at this level, the fill at a quarter of it
     void setBrightness(uint8_t brightness);
+    void setAmbient(bool enabled);
+    // Short flash over the mode color (server feedback, charter buffer state)
+    void flash(const NeoPixelColor& color, unsigned long durationMs = FLASH_MS);
+
+    // Clears every layer
     void clear();
+    // Composes and sends a frame now
     void show();
     
     // Status indicator methods
     void setStatusIdle();
     void setStatusBusy();
     void setStatusError();
+    void clearStatusError();
     void setStatusSuccess();
 
-    // Setup progress indicator (0.0 to 1.0)
+    // Setup progress indicator (0.0 to 1.0), shown immediately
     void showSetupProgress(float progress);
+    void clearSetupProgress();
 
-    // Non-blocking animation update - call this in loop()
+    // Non-blocking frame update - call this from the LED task
     void update();
 
-    // New method to set individual pixel colors using NeoPixelColor constants
-    void setPixelColors(const NeoPixelColor& pixel0, const NeoPixelColor& pixel1,
-                       const NeoPixelColor& pixel2, const NeoPixelColor& pixel3,
-                       const NeoPixelColor& pixel4, const NeoPixelColor& pixel5,
-                       const NeoPixelColor& pixel6, const NeoPixelColor& pixel7);
-
-    // Roll a color through all pixels
-    void rollColor(int delayMs);
-
-    // Overload setColor to take NeoPixelColor
-    void setColor(uint8_t r, uint8_t g, uint8_t b);
+    LedCompositor& compositor() { return compositor_; }
+    // Strip updates actually sent
+    uint32_t showCount() const { return shows_; }
 
 private:
+    static constexpr unsigned long FLASH_MS = 500;
+    // Boot progress and errors don't follow the mode brightness
+    static constexpr uint8_t STATUS_LEVEL = 32;
+
     ArduinoKeyBridgeNeoPixel() = default;
     ~ArduinoKeyBridgeNeoPixel() = default;
     ArduinoKeyBridgeNeoPixel(const ArduinoKeyBridgeNeoPixel&) = delete;
     ArduinoKeyBridgeNeoPixel& operator=(const ArduinoKeyBridgeNeoPixel&) = delete;
 
-    // Helper method for alternating colors
-    void setAlternatingColors(uint8_t r1, uint8_t g1, uint8_t b1, 
-                            uint8_t r2, uint8_t g2, uint8_t b2);
-
     Adafruit_NeoPixel* pixels = nullptr;
     bool initialized = false;
 
-    // Animation state
-    unsigned long lastUpdate = 0;
-    static const unsigned long UPDATE_INTERVAL = 1000; // Update every 1 second
-    bool currentPattern = false; // false = first color, true = second color
-    
-    // Current colors
-    struct Color {
-        uint8_t r, g, b;
-        Color(uint8_t r_ = 0, uint8_t g_ = 0, uint8_t b_ = 0) : r(r_), g(g_), b(b_) {}
-    };
-    Color color1, color2;
+    LedCompositor compositor_;
+    NeoPixelColor modeColor_ = NeoPixelColors::WHITE;
+    uint8_t brightness_ = 255;
+    bool ambient_ = true;
+    uint32_t shows_ = 0;
 
-    // Store the currently active color for rollColor
-    Color activeColor;
+    void applyMode();
+    void render(bool force);
 };
 
-#endif 
\ No newline at end of file
+#endif
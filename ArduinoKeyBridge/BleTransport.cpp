@@ -0,0 +1,85 @@
+#include "BleTransport.h"
+#include "ArduinoKeyBridgeLogger.h"
+
+#ifdef KEYBRIDGE_BLE
+
+BleTransport::BleTransport()
+    : service_(SERVICE_UUID),
+      tx_(TX_CHAR_UUID, BLERead | BLENotify, VALUE_SIZE),
+      rx_(RX_CHAR_UUID, BLEWrite | BLEWriteWithoutResponse, VALUE_SIZE) {}
+
+bool BleTransport::begin(const char* localName) {
+    if (!BLE.begin()) {
+        ArduinoKeyBridgeLogger::getInstance().error("BleTransport", "Starting BLE failed");
+        return false;
+    }
+    BLE.setLocalName(localName);
+    BLE.setAdvertisedService(service_);
+    service_.addCharacteristic(tx_);
+    service_.addCharacteristic(rx_);
+    BLE.addService(service_);
+    BLE.advertise();
+    ArduinoKeyBridgeLogger::getInstance().info("BleTransport", "Advertising, waiting for a central");
+    return true;
+}
+
+bool BleTransport::accept() {
+    BLE.poll();
+    if (connected()) return false;
+    central_ = BLE.central();
+    if (!central_ || !central_.connected()) return false;
+    rxHead_ = rxCount_ = 0;
+    ArduinoKeyBridgeLogger::getInstance().info("BleTransport", String("Central connected: ") + central_.address());
+    return true;
+}
+
+bool BleTransport::connected() {
+    return central_ && central_.connected();
+}
+
+void BleTransport::pull() {
+    if (!rx_.written()) return;
+    const uint8_t* data = rx_.value();
+    size_t length = size_t(rx_.valueLength());
+    if (length > RX_BUFFER_SIZE - rxCount_) {
+        // No room, the central is writing faster than frames are parsed
+        rxOverruns_++;
+        return;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        rxBuffer_[(rxHead_ + rxCount_) % RX_BUFFER_SIZE] = data[i];
+        rxCount_++;
+    }
+}
+
+int BleTransport::available() {
+    pull();
+    return int(rxCount_);
+}
+
+int BleTransport::read() {
+    if (rxCount_ == 0) pull();
+    if (rxCount_ == 0) return -1;
+    uint8_t byte = rxBuffer_[rxHead_];
+    rxHead_ = (rxHead_ + 1) % RX_BUFFER_SIZE;
+    rxCount_--;
+    return byte;
+}
+
+int BleTransport::read(uint8_t* buf, size_t length) {
+    size_t n = 0;
+    while (n < length) {
+        int byte = read();
+        if (byte < 0) break;
+        buf[n++] = uint8_t(byte);
+    }
+    return int(n);
+}
+
+size_t BleTransport::write(const uint8_t* data, size_t length) {
+    if (!connected()) return 0;
+    if (length > maxPayload_) length = maxPayload_;
+    return tx_.writeValue(data, int(length)) ? length : 0;
+}
+
+#endif // KEYBRIDGE_BLE
@@ -0,0 +1,65 @@
+#ifndef BLE_TRANSPORT_H
+#define BLE_TRANSPORT_H
+
+// Only built with -DKEYBRIDGE_BLE, so the WiFi build doesn't link ArduinoBLE:
+//   arduino-cli compile --build-property "compiler.cpp.extra_flags=-DKEYBRIDGE_BLE" ...
+#ifdef KEYBRIDGE_BLE
+
+#include <Arduino.h>
+#include <ArduinoBLE.h>
+#include "Transport.h"
+
+// Bridge protocol over two GATT characteristics, same service and UUIDs as
+// BluetoothKeyBridge: the central writes frames to RX, the device notifies
+// on TX. Frames are packed into notifications of maxPayload() bytes, so a
+// burst of events costs one connection event instead of one per frame.
+//
+// The payload defaults to 20 bytes (default ATT MTU of 23); raise it with
+// setMaxPayload() for centrals that negotiate a larger MTU. The UNO R4 WiFi
+// radio runs either WiFi or BLE, so use this instead of WiFiTcpTransport.
+class BleTransport : public Transport {
+public:
+    static constexpr const char* SERVICE_UUID = "4fafc201-1fb5-459e-8fcc-c5c9c331914b";
+    static constexpr const char* TX_CHAR_UUID = "beb5483e-36e1-4688-b7f5-ea07361b26a8"; // Device -> central
+    static constexpr const char* RX_CHAR_UUID = "beb5483e-36e1-4688-b7f5-ea07361b26a9"; // Central -> device
+    static constexpr size_t VALUE_SIZE = 244;
+    static constexpr size_t DEFAULT_PAYLOAD = 20;
+
+    BleTransport();
+
+    // Starts advertising; false if the radio didn't come up
+    bool begin(const char* localName);
+    void setMaxPayload(size_t bytes) { maxPayload_ = bytes < VALUE_SIZE ? bytes : VALUE_SIZE; }
+
+    bool accept() override;
+    bool connected() override;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buf, size_t length) override;
+    size_t write(const uint8_t* data, size_t length) override;
+    size_t maxPayload() const override { return maxPayload_; }
+    bool batchWrites() const override { return true; }
+    const char* name() const override { return "ble"; }
+
+    // RX writes lost because the previous one hadn't been read yet
+    uint32_t rxOverruns() const { return rxOverruns_; }
+
+private:
+    static constexpr size_t RX_BUFFER_SIZE = 256;
+
+    BLEService service_;
+    BLECharacteristic tx_;
+    BLECharacteristic rx_;
+    BLEDevice central_;
+    size_t maxPayload_ = DEFAULT_PAYLOAD;
+
+    uint8_t rxBuffer_[RX_BUFFER_SIZE];
+    size_t rxHead_ = 0;
+    size_t rxCount_ = 0;
+    uint32_t rxOverruns_ = 0;
+
+    void pull();
+};
+
+#endif // KEYBRIDGE_BLE
+#endif
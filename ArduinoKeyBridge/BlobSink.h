@@ -0,0 +1,21 @@
+#ifndef BLOB_SINK_H
+#define BLOB_SINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Receiver for a binary upload over TCP. The server sends a value report
+// with the blob's code and length (see BridgeProtocol.h) followed by the raw
+// bytes; TCPConnection hands them to the sink registered for that code and
+// answers BLOB_OK or BLOB_ERROR once all bytes have arrived.
+class BlobSink {
+public:
+    virtual ~BlobSink() = default;
+    // Returns false to reject the upload; its bytes are then read and dropped
+    virtual bool beginBlob(size_t length) = 0;
+    virtual bool writeBlob(const uint8_t* data, size_t length, size_t offset) = 0;
+    // All bytes received: validate and apply. Not called after a failure.
+    virtual bool endBlob() = 0;
+};
+
+#endif
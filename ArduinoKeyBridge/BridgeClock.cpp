@@ -0,0 +1,37 @@
+#include "BridgeClock.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+namespace {
+    class ArduinoClock : public Clock {
+    public:
+        unsigned long millis() override { return ::millis(); }
+        unsigned long micros() override { return ::micros(); }
+        void delay(unsigned long ms) override { ::delay(ms); }
+        void delayMicroseconds(unsigned long us) override { ::delayMicroseconds(us); }
+    };
+
+    ArduinoClock defaultClock;
+}
+#else
+namespace {
+    VirtualClock defaultClock;
+}
+#endif
+
+namespace {
+    Clock* activeClock = &defaultClock;
+}
+
+namespace BridgeClock {
+
+Clock& get() {
+    return *activeClock;
+}
+
+void set(Clock* clock) {
+    activeClock = clock ? clock : &defaultClock;
+}
+
+}
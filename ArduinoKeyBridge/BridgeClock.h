@@ -0,0 +1,50 @@
+#ifndef BRIDGE_CLOCK_H
+#define BRIDGE_CLOCK_H
+
+#include <stdint.h>
+
+// Time source for everything in the sketch that waits or measures time.
+// Code calls BridgeClock::millis()/micros()/delay() instead of the Arduino
+// functions so a different Clock can be injected with BridgeClock::set().
+//
+// On the board the default clock maps straight to millis/micros/delay. In a
+// host build (no ARDUINO define) the default is a VirtualClock, where delays
+// advance time instantly, so long timed scenarios run in milliseconds with
+// exact, reproducible timestamps.
+class Clock {
+public:
+    virtual ~Clock() = default;
+    virtual unsigned long millis() = 0;
+    virtual unsigned long micros() = 0;
+    virtual void delay(unsigned long ms) = 0;
+    virtual void delayMicroseconds(unsigned long us) = 0;
+};
+
+// Deterministic time that only moves when somebody waits or calls advance()
+class VirtualClock : public Clock {
+public:
+    unsigned long millis() override { return (unsigned long)(now_us_ / 1000); }
+    unsigned long micros() override { return (unsigned long)now_us_; }
+    void delay(unsigned long ms) override { now_us_ += uint64_t(ms) * 1000; }
+    void delayMicroseconds(unsigned long us) override { now_us_ += us; }
+
+    void advance(uint64_t us) { now_us_ += us; }
+    void set(uint64_t us) { now_us_ = us; }
+    uint64_t now() const { return now_us_; }
+
+private:
+    uint64_t now_us_ = 0;
+};
+
+namespace BridgeClock {
+    Clock& get();
+    // Pass nullptr to go back to the default clock
+    void set(Clock* clock);
+
+    inline unsigned long millis() { return get().millis(); }
+    inline unsigned long micros() { return get().micros(); }
+    inline void delay(unsigned long ms) { get().delay(ms); }
+    inline void delayMicroseconds(unsigned long us) { get().delayMicroseconds(us); }
+}
+
+#endif
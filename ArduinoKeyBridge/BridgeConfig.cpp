@@ -0,0 +1,50 @@
+#include "BridgeConfig.h"
+#include <string.h>
+#include "Crc16.h"
+#include "LedCompositor.h"
+
+BridgeConfig BridgeConfig::defaults() {
+    BridgeConfig config;
+    memset(&config, 0, sizeof(config));
+    config.port = 8080;
+    strcpy(config.apSsid, "ArduinoKeyBridge");
+    strcpy(config.apPassword, "12345678");
+    config.logLevel = 1;
+    config.ledPin = 6;
+    config.ledCount = 8;
+    config.ledIdleBrightness = 1;
+    config.ledModeBrightness = 15;
+    config.hidIntervalUs = 1000;
+    config.statusIntervalMs = 10000;
+    config.charterChunk = MAX_CHARTER_CHUNK;
+    config.macroPadRoute = ROUTE_HOST;
+    config.seal();
+    return config;
+}
+
+void BridgeConfig::seal() {
+    magic = MAGIC;
+    version = VERSION;
+    size = sizeof(BridgeConfig);
+    crc = crc16(reinterpret_cast<const uint8_t*>(this), offsetof(BridgeConfig, crc));
+}
+
+bool BridgeConfig::valid() const {
+    if (magic != MAGIC || version != VERSION || size != sizeof(BridgeConfig)) return false;
+    if (crc != crc16(reinterpret_cast<const uint8_t*>(this), offsetof(BridgeConfig, crc))) return false;
+    size_t ssid = strnlen(apSsid, SSID_SIZE);
+    size_t password = strnlen(apPassword, PASSWORD_SIZE);
+    return ssid > 0 && ssid <= 32 && password >= 8 && password < PASSWORD_SIZE && port != 0 &&
+           logLevel <= 5 && ledCount > 0 && ledCount <= LedCompositor::MAX_PIXELS && hidIntervalUs >= 125 &&
+           statusIntervalMs >= MIN_STATUS_INTERVAL_MS &&
+           statusIntervalMs <= MAX_STATUS_INTERVAL_MS && charterChunk > 0 && charterChunk <= MAX_CHARTER_CHUNK &&
+           macroPadRoute <= ROUTE_SERVER;
+}
+
+const BridgeConfig* BridgeConfig::newest(const BridgeConfig& a, const BridgeConfig& b) {
+    bool aValid = a.valid(), bValid = b.valid();
+    if (aValid && bValid) return b.newerThan(a) ? &b : &a;
+    if (aValid) return &a;
+    if (bValid) return &b;
+    return nullptr;
+}
@@ -0,0 +1,71 @@
+#ifndef BRIDGE_CONFIG_H
+#define BRIDGE_CONFIG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Tunables that used to be compile-time constants, as one fixed-layout
+// struct. ConfigStore keeps it in data flash and copies it to RAM at boot
+// byte for byte: there is nothing to parse, subsystems read the fields of
+// ConfigStore::config() directly. It is checked by magic, version, size and
+// CRC instead; a struct that fails any check is replaced by defaults().
+//
+// Every field sits at its natural alignment with no padding, and both the
+// board and the hosts that build config blobs (keybridge_cli config-build)
+// are little endian, so the bytes in flash, on the wire and in memory are
+// the same. New fields need a new VERSION.
+struct BridgeConfig {
+    static constexpr uint32_t MAGIC = 0x4643424B; // "KBCF"
+    static constexpr uint16_t VERSION = 1;
+    static constexpr size_t SSID_SIZE = 34;     // Up to 32 characters and the NUL, padded
+    static constexpr size_t PASSWORD_SIZE = 64; // 8 to 63 characters (WPA2) and the NUL
+    static constexpr uint8_t MAX_CHARTER_CHUNK = 16;
+    // Up to an hour, so the period in microseconds (TaskScheduler) fits in 32 bits
+    static constexpr uint32_t MIN_STATUS_INTERVAL_MS = 1000;
+    static constexpr uint32_t MAX_STATUS_INTERVAL_MS = 3600000;
+
+    // Where the keys of MACRO_PAD keyboards go (KeyboardMerger.h)
+    enum MacroPadRoute : uint8_t {
+        ROUTE_HOST = 0,   // Merged with the main keyboard, through the whole pipeline
+        ROUTE_SERVER = 1  // Always to the server, never to the host
+    };
+
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;              // sizeof(BridgeConfig)
+    uint32_t sequence;          // Bumped on every write; the newer flash slot wins
+
+    uint16_t port;              // TCP server
+    char apSsid[SSID_SIZE];
+    char apPassword[PASSWORD_SIZE];
+
+    uint8_t logLevel;           // LogLevel (ArduinoKeyBridgeLogger.h), 1 = DEBUG
+    uint8_t ledPin;
+    uint16_t ledCount;
+    uint8_t ledIdleBrightness;  // Mode level outside command and charter mode
+    uint8_t ledModeBrightness;  // In command or charter mode
+    uint16_t hidIntervalUs;     // HID report interval for hosts without a calibration
+    uint32_t statusIntervalMs;  // Status task period
+    uint8_t charterChunk;       // Characters typed per network poll while dumping
+    uint8_t macroPadRoute;      // MacroPadRoute
+
+    uint16_t crc;               // CRC-16/CCITT-FALSE of everything before it
+
+    // The values the firmware was built with
+    static BridgeConfig defaults();
+
+    // Fills in magic, version, size and crc
+    void seal();
+    // Header, CRC and every field in range
+    bool valid() const;
+    // Sequence comparison that survives wrap-around
+    bool newerThan(const BridgeConfig& other) const { return int32_t(sequence - other.sequence) > 0; }
+
+    // The valid one of two slots, the newer if both are; nullptr if neither
+    static const BridgeConfig* newest(const BridgeConfig& a, const BridgeConfig& b);
+};
+
+static_assert(sizeof(BridgeConfig) == 128, "BridgeConfig layout changed");
+static_assert(offsetof(BridgeConfig, crc) == sizeof(BridgeConfig) - 2, "the CRC must be the last field");
+
+#endif
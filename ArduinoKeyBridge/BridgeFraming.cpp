@@ -0,0 +1,112 @@
+#include "BridgeFraming.h"
+#include <string.h>
+
+namespace BridgeFraming {
+
+void FrameParser::reset() {
+    setEventEncoding(false);
+}
+
+void FrameParser::setEventEncoding(bool enabled) {
+    // Both framings start from an empty report
+    eventEncoding_ = enabled;
+    decoder_.reset();
+    frameLength_ = 0;
+    memset(&report_, 0, sizeof(report_));
+    memset(&control_, 0, sizeof(control_));
+}
+
+FrameParser::Result FrameParser::feed(uint8_t byte) {
+    if (eventEncoding_) {
+        switch (decoder_.feed(byte)) {
+            case KeyEventCodec::Decoder::REPORT:
+                report_ = decoder_.report();
+                frames_++;
+                return REPORT;
+            case KeyEventCodec::Decoder::CONTROL: {
+                uint8_t code = decoder_.control();
+                control_ = (code & BridgeProtocol::VALUE_FLAG)
+                    ? BridgeProtocol::makeValueReport(code, decoder_.value())
+                    : BridgeProtocol::makeControlReport(code);
+                frames_++;
+                return CONTROL;
+            }
+            default:
+                return NEED_MORE;
+        }
+    }
+
+    frame_[frameLength_++] = byte;
+    if (frameLength_ < BridgeProtocol::REPORT_SIZE) return NEED_MORE;
+    frameLength_ = 0;
+    frames_++;
+
+    KeyReport frame;
+    memcpy(&frame, frame_, sizeof(frame));
+    uint16_t value = 0;
+    if (BridgeProtocol::valueCode(frame, value) != BridgeProtocol::Control::NONE ||
+        BridgeProtocol::controlCode(frame) != BridgeProtocol::Control::NONE) {
+        control_ = frame;
+        return CONTROL;
+    }
+    report_ = frame;
+    return REPORT;
+}
+
+void FrameWriter::reset() {
+    pendingLength_ = 0;
+    eventEncoding_ = false;
+    encoder_.reset();
+}
+
+void FrameWriter::setEventEncoding(bool enabled) {
+    eventEncoding_ = enabled;
+    encoder_.reset();
+}
+
+bool FrameWriter::write(const KeyReport& report) {
+    if (!transport_ || !transport_->connected()) return false;
+
+    if (!eventEncoding_) {
+        append((const uint8_t*)&report, sizeof(KeyReport));
+    } else {
+        uint8_t buf[KeyEventCodec::MAX_REPORT_BYTES];
+        uint16_t value = 0;
+        uint8_t code = BridgeProtocol::valueCode(report, value);
+        if (code == BridgeProtocol::Control::NONE) code = BridgeProtocol::controlCode(report);
+        size_t length = (code != BridgeProtocol::Control::NONE)
+            ? KeyEventCodec::Encoder::encodeControl(code, buf, value)
+            : encoder_.encode(report, buf);
+        if (length == 0) return true;
+        append(buf, length);
+    }
+    frames_++;
+    if (!transport_->batchWrites()) flush();
+    return true;
+}
+
+void FrameWriter::append(const uint8_t* data, size_t length) {
+    size_t limit = transport_->maxPayload();
+    if (limit > MAX_BATCH) limit = MAX_BATCH;
+    // Frames may straddle two payloads, the parser reads a byte stream
+    while (length > 0) {
+        if (pendingLength_ >= limit) flush();
+        size_t chunk = limit - pendingLength_;
+        if (chunk > length) chunk = length;
+        memcpy(pending_ + pendingLength_, data, chunk);
+        pendingLength_ += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+void FrameWriter::flush() {
+    if (pendingLength_ == 0 || !transport_) return;
+    transport_->write(pending_, pendingLength_);
+    transport_->flush();
+    bytes_ += pendingLength_;
+    packets_++;
+    pendingLength_ = 0;
+}
+
+}
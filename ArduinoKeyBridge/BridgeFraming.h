@@ -0,0 +1,86 @@
+#ifndef BRIDGE_FRAMING_H
+#define BRIDGE_FRAMING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "BridgeProtocol.h"
+#include "KeyEventCodec.h"
+#include "Transport.h"
+
+// Framing shared by every Transport: raw 8-byte reports or, after
+// EVENTS_ON, KeyEventCodec events (see BridgeProtocol.h).
+//
+// Charter text and blobs are not framed; TCPConnection stops feeding the
+// parser when a control frame starts one and reads them from the transport
+// directly.
+namespace BridgeFraming {
+    class FrameParser {
+    public:
+        enum Result : uint8_t {
+            NEED_MORE, // Byte consumed, frame not complete yet
+            REPORT,    // report() holds the key state
+            CONTROL    // controlReport() holds a control or value report
+        };
+
+        FrameParser() { reset(); }
+        // Back to raw framing with nothing buffered
+        void reset();
+        void setEventEncoding(bool enabled);
+        bool eventEncoding() const { return eventEncoding_; }
+
+        Result feed(uint8_t byte);
+
+        const KeyReport& report() const { return report_; }
+        // Raw framing: the frame as received. Event framing: the equivalent
+        // control or value report.
+        const KeyReport& controlReport() const { return control_; }
+        uint32_t frames() const { return frames_; }
+
+    private:
+        bool eventEncoding_;
+        KeyEventCodec::Decoder decoder_;
+        uint8_t frame_[BridgeProtocol::REPORT_SIZE];
+        size_t frameLength_;
+        KeyReport report_;
+        KeyReport control_;
+        uint32_t frames_ = 0;
+    };
+
+    class FrameWriter {
+    public:
+        // Largest batch, the payload of a BLE notification at a 247 byte MTU
+        static constexpr size_t MAX_BATCH = 244;
+
+        FrameWriter() { reset(); }
+        void setTransport(Transport* transport) { transport_ = transport; }
+        // Back to raw framing, drops anything not flushed
+        void reset();
+        void setEventEncoding(bool enabled);
+        bool eventEncoding() const { return eventEncoding_; }
+
+        // Encodes report (control and value reports as CONTROL events when
+        // event encoding is on). Written at once unless the transport batches,
+        // then packed until a payload is full or flush() is called.
+        bool write(const KeyReport& report);
+        void flush();
+
+        uint32_t frames() const { return frames_; }
+        uint32_t bytes() const { return bytes_; }
+        uint32_t packets() const { return packets_; }
+        void resetStats() { frames_ = bytes_ = packets_ = 0; }
+
+    private:
+        Transport* transport_ = nullptr;
+        bool eventEncoding_;
+        KeyEventCodec::Encoder encoder_;
+        uint8_t pending_[MAX_BATCH];
+        size_t pendingLength_;
+        uint32_t frames_ = 0;
+        uint32_t bytes_ = 0;
+        uint32_t packets_ = 0;
+
+        void append(const uint8_t* data, size_t length);
+    };
+}
+
+#endif
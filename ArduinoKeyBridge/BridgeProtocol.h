@@ -0,0 +1,115 @@
+#ifndef BRIDGE_PROTOCOL_H
+#define BRIDGE_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "KeyReport.h"
+
+// Wire protocol spoken by TCPConnection, shared with the host-side tools in
+// tools/cpp.
+namespace BridgeProtocol {
+    // Every frame on the wire is a raw 8-byte KeyReport
+    static constexpr size_t REPORT_SIZE = sizeof(KeyReport);
+
+    // Control reports carry this modifier byte and the same code in all six key slots
+    static constexpr uint8_t CONTROL_MODIFIERS = 0x22;
+
+    // Charter text is sent raw after a CHARTER control report and ends with NUL,
+    // or as a CharterCodec stream (which ends with the same byte) after CHARTER_COMPRESSED
+    static constexpr char TEXT_TERMINATOR = '\0';
+
+    // Server -> device control codes
+    namespace Control {
+        static constexpr uint8_t NONE = 0x00;
+        static constexpr uint8_t CHARTER = 0x02;
+        static constexpr uint8_t EVENTS_ON = 0x03;  // Switch this connection to KeyEventCodec framing
+        static constexpr uint8_t EVENTS_OFF = 0x04; // Back to raw 8-byte reports
+        static constexpr uint8_t TYPING_CLASSIC = 0x05;  // Charter text: press + release per character
+        static constexpr uint8_t TYPING_ROLLOVER = 0x06; // Charter text: overlapping presses (RolloverTyper)
+        static constexpr uint8_t CHARTER_COMPRESSED = 0x07; // Like CHARTER, text follows as a CharterCodec stream
+        static constexpr uint8_t MIRROR_ON = 0x08;  // Command mode types locally, reports are mirrored to the server
+        static constexpr uint8_t MIRROR_OFF = 0x09; // Command mode forwards reports to the server only
+        static constexpr uint8_t COMMAND_ON = 10;
+        static constexpr uint8_t COMMAND_OFF = 11;
+        static constexpr uint8_t GOOD = 12;
+        static constexpr uint8_t BAD = 13;
+        static constexpr uint8_t WARN = 14;
+        static constexpr uint8_t CALIBRATE = 15; // Find the fastest typing rate the host takes (TypingCalibrator)
+        static constexpr uint8_t TRACE_QUERY = 16; // Export the latency histograms (LatencyTracer)
+        static constexpr uint8_t TRACE_RESET = 17; // Clear the latency histograms
+
+        // Value reports announcing a binary upload; the value is its length
+        // in bytes and exactly that many raw bytes follow (see BlobSink.h)
+        static constexpr uint8_t REMAP_BLOB = 0x41; // KeyRemap tables
+        static constexpr uint8_t SNIPPET_BLOB = 0x42; // SnippetLibrary image
+        static constexpr uint8_t CONFIG_BLOB = 0x43;  // BridgeConfig, empty for the defaults
+
+        // Value reports that change a setting
+        static constexpr uint8_t LOG_RATE = 0x44;   // Debug log messages per second and source, 0 = unlimited
+        static constexpr uint8_t LOG_SAMPLE = 0x45; // Log 1 in N messages per source
+        static constexpr uint8_t SNIPPET_TYPE = 0x46; // Type the stored snippet with this id
+        static constexpr uint8_t HOST_PROFILE = 0x47;     // Id of the host the server runs on, selects its typing calibration
+        static constexpr uint8_t CALIBRATE_RESULT = 0x48; // CRC-16 of the probe text the host received
+        static constexpr uint8_t TRACE_SAMPLE = 0x49; // Trace 1 in N USB key reports, 0 = off
+        static constexpr uint8_t TRACE_HOLD = 0x4A;   // Before TRACE_ID: us the server held the report
+        static constexpr uint8_t TRACE_ID = 0x4B;     // The next key report belongs to this trace
+        static constexpr uint8_t STALL_BUDGET = 0x4C; // Loop iterations longer than this many ms are stalls (LoopWatchdog), 0 = off
+    }
+
+    // Device -> server notifications (same control report shape)
+    namespace Notify {
+        static constexpr uint8_t COMMAND_ON = 0x10;
+        static constexpr uint8_t COMMAND_OFF = 0x11;
+        static constexpr uint8_t EVENTS_ON = 0x13;  // Ack, device frames are delta encoded from now on
+        static constexpr uint8_t CREDIT = 0x52;     // Value report: charter bytes (compressed bytes for CHARTER_COMPRESSED) the sender may add
+        static constexpr uint8_t CREDIT_START = 0x5B; // Value report: first CREDIT of a new charter stream, credit left from the last one is void
+        static constexpr uint8_t BLOB_OK = 0x14;    // Upload received and applied
+        static constexpr uint8_t BLOB_ERROR = 0x15; // Upload rejected (unknown code, too large, invalid)
+        static constexpr uint8_t MIRROR_ON = 0x16;  // Ack, reports that follow were already typed locally
+        static constexpr uint8_t MIRROR_OFF = 0x17; // Ack, reports that follow are for the server to handle
+        static constexpr uint8_t CALIBRATE_END = 0x18;   // Probe typed, answer with CALIBRATE_RESULT
+        static constexpr uint8_t CALIBRATE_PROBE = 0x53; // Value report: a probe follows at this many us per HID report
+        static constexpr uint8_t CALIBRATE_DONE = 0x54;  // Value report: calibrated us per HID report, 0 if even the slowest lost keys
+        static constexpr uint8_t TRACE_ID = 0x55;        // Value report: the next key report is traced with this id
+        static constexpr uint8_t TRACE_DONE = 0x56;      // Value report: the server report with this trace id reached the host
+        // TRACE_QUERY answer: per histogram with samples TRACE_HISTOGRAM, then
+        // TRACE_BUCKET + TRACE_COUNT per non-empty bucket; TRACE_END last
+        static constexpr uint8_t TRACE_HISTOGRAM = 0x57; // Value report: histogram index (LatencyTracer::NAMES)
+        static constexpr uint8_t TRACE_BUCKET = 0x58;    // Value report: bucket index (LatencyHistogram)
+        static constexpr uint8_t TRACE_COUNT = 0x59;     // Value report: samples in that bucket
+        static constexpr uint8_t TRACE_END = 0x5A;       // Value report: traces lost, saturated at 65535
+    }
+
+    // Codes with this bit set are value reports: {0x22, 0, {code, code, lo, hi, 0, 0}}.
+    // With event encoding they are a CONTROL event followed by the two value bytes.
+    static constexpr uint8_t VALUE_FLAG = 0x40;
+
+    inline KeyReport makeControlReport(uint8_t code) {
+        KeyReport report = {CONTROL_MODIFIERS, 0x00, {code, code, code, code, code, code}};
+        return report;
+    }
+
+    // Returns the control code carried by report, or Control::NONE for ordinary key reports
+    inline uint8_t controlCode(const KeyReport& report) {
+        if (report.modifiers != CONTROL_MODIFIERS) return Control::NONE;
+        for (int i = 1; i < 6; ++i) {
+            if (report.keys[i] != report.keys[0]) return Control::NONE;
+        }
+        return report.keys[0];
+    }
+
+    inline KeyReport makeValueReport(uint8_t code, uint16_t value) {
+        KeyReport report = {CONTROL_MODIFIERS, 0x00, {code, code, uint8_t(value & 0xFF), uint8_t(value >> 8), 0, 0}};
+        return report;
+    }
+
+    // Returns the code of a value report and stores its value, or Control::NONE
+    inline uint8_t valueCode(const KeyReport& report, uint16_t& value) {
+        if (report.modifiers != CONTROL_MODIFIERS || !(report.keys[0] & VALUE_FLAG)) return Control::NONE;
+        if (report.keys[1] != report.keys[0] || report.keys[4] != 0 || report.keys[5] != 0) return Control::NONE;
+        value = uint16_t(report.keys[2]) | (uint16_t(report.keys[3]) << 8);
+        return report.keys[0];
+    }
+}
+
+#endif
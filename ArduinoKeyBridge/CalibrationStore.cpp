@@ -0,0 +1,113 @@
+#include "CalibrationStore.h"
+#include "MinimalKeyboard.h"
+#include "ArduinoKeyBridgeLogger.h"
+#include "ConfigStore.h"
+#include "Crc16.h"
+#include <EEPROM.h>
+
+CalibrationStore& CalibrationStore::getInstance() {
+    static CalibrationStore instance;
+    return instance;
+}
+
+void CalibrationStore::begin() {
+    uint8_t image[HEADER_SIZE + MAX_PROFILES * RECORD_SIZE + 2];
+    for (size_t i = 0; i < HEADER_SIZE; ++i) {
+        image[i] = EEPROM.read(FlashLayout::CALIBRATION_ADDRESS + i);
+    }
+    size_t count = image[3];
+    if (image[0] != 'T' || image[1] != 'C' || image[2] != VERSION || count > MAX_PROFILES || image[4] >= MAX_PROFILES) {
+        ArduinoKeyBridgeLogger::getInstance().info("Calibration", "No stored typing calibration");
+        apply();
+        return;
+    }
+    size_t length = HEADER_SIZE + count * RECORD_SIZE + 2;
+    for (size_t i = HEADER_SIZE; i < length; ++i) {
+        image[i] = EEPROM.read(FlashLayout::CALIBRATION_ADDRESS + i);
+    }
+    uint16_t stored = uint16_t(image[length - 2]) | (uint16_t(image[length - 1]) << 8);
+    if (crc16(image, length - 2) != stored) {
+        ArduinoKeyBridgeLogger::getInstance().warning("Calibration", "Stored typing calibration is invalid");
+        apply();
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t* record = image + HEADER_SIZE + i * RECORD_SIZE;
+        records_[i].profile = uint16_t(record[0]) | (uint16_t(record[1]) << 8);
+        records_[i].intervalUs = uint16_t(record[2]) | (uint16_t(record[3]) << 8);
+    }
+    count_ = count;
+    if (image[4] < count_) profile_ = records_[image[4]].profile;
+    apply();
+}
+
+void CalibrationStore::selectProfile(uint16_t profile) {
+    profile_ = profile;
+    apply();
+    // Remember it for the next boot, if it is calibrated
+    if (find(profile) >= 0) write();
+}
+
+bool CalibrationStore::save(unsigned long intervalUs) {
+    int i = find(profile_);
+    if (i < 0) {
+        // Full: the oldest profile makes room
+        if (count_ == MAX_PROFILES) {
+            memmove(records_, records_ + 1, (MAX_PROFILES - 1) * sizeof(Record));
+            count_--;
+        }
+        i = int(count_++);
+        records_[i].profile = profile_;
+    }
+    records_[i].intervalUs = uint16_t(intervalUs);
+    apply();
+    return write();
+}
+
+int CalibrationStore::find(uint16_t profile) const {
+    for (size_t i = 0; i < count_; ++i) {
+        if (records_[i].profile == profile) return int(i);
+    }
+    return -1;
+}
+
+void CalibrationStore::apply() {
+    int i = find(profile_);
+    unsigned long interval = i >= 0 ? records_[i].intervalUs : ConfigStore::config().hidIntervalUs;
+    MinimalKeyboard::getInstance().reportQueue().setInterval(interval);
+    ArduinoKeyBridgeLogger::getInstance().info("Calibration", String("Host profile 0x") + String(profile_, HEX) + ": " +
+        interval + " us per HID report" + (i >= 0 ? "" : " (not calibrated)"));
+}
+
+bool CalibrationStore::write() {
+    uint8_t image[HEADER_SIZE + MAX_PROFILES * RECORD_SIZE + 2];
+    int active = find(profile_);
+    image[0] = 'T';
+    image[1] = 'C';
+    image[2] = VERSION;
+    image[3] = uint8_t(count_);
+    image[4] = uint8_t(active >= 0 ? active : 0);
+    for (size_t i = 0; i < count_; ++i) {
+        uint8_t* record = image + HEADER_SIZE + i * RECORD_SIZE;
+        record[0] = uint8_t(records_[i].profile & 0xFF);
+        record[1] = uint8_t(records_[i].profile >> 8);
+        record[2] = uint8_t(records_[i].intervalUs & 0xFF);
+        record[3] = uint8_t(records_[i].intervalUs >> 8);
+    }
+    size_t length = HEADER_SIZE + count_ * RECORD_SIZE;
+    uint16_t crc = crc16(image, length);
+    image[length++] = uint8_t(crc & 0xFF);
+    image[length++] = uint8_t(crc >> 8);
+
+    // update() skips bytes that are already equal, sparing flash erase cycles
+    for (size_t i = 0; i < length; ++i) {
+        EEPROM.update(FlashLayout::CALIBRATION_ADDRESS + i, image[i]);
+    }
+    for (size_t i = 0; i < length; ++i) {
+        if (EEPROM.read(FlashLayout::CALIBRATION_ADDRESS + i) != image[i]) {
+            ArduinoKeyBridgeLogger::getInstance().error("Calibration", "Writing typing calibration to flash failed");
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef CALIBRATION_STORE_H
+#define CALIBRATION_STORE_H
+
+#include <Arduino.h>
+#include "FlashLayout.h"
+
+// Calibrated HID report intervals (TypingCalibrator.h) per host profile, in
+// data flash. The server names the host it runs on with a HOST_PROFILE value
+// report; the profile's interval is applied to the HID queue right away, and
+// the last profile used is applied again at boot before anyone connects.
+//
+// Stored as (little endian):
+//
+//   0   'T' 'C' version count active
+//   5   count x (profile id, interval in us) (2 bytes each)
+//   end CRC-16/CCITT-FALSE of everything before it
+class CalibrationStore {
+public:
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t MAX_PROFILES = 8;
+
+    static CalibrationStore& getInstance();
+
+    // Load the stored profiles and apply the last one used
+    void begin();
+    // Switch to profile and apply its interval, the default if it has none
+    void selectProfile(uint16_t profile);
+    uint16_t profile() const { return profile_; }
+    // Store and apply the calibrated interval for the current profile
+    bool save(unsigned long intervalUs);
+    // Apply the current profile's interval to the HID queue, the configured
+    // default (BridgeConfig::hidIntervalUs) if it has none
+    void apply();
+
+private:
+    static constexpr size_t HEADER_SIZE = 5;
+    static constexpr size_t RECORD_SIZE = 4;
+    static_assert(HEADER_SIZE + MAX_PROFILES * RECORD_SIZE + 2 <= FlashLayout::CALIBRATION_SIZE, "calibration doesn't fit its flash region");
+
+    struct Record {
+        uint16_t profile;
+        uint16_t intervalUs;
+    };
+
+    Record records_[MAX_PROFILES];
+    size_t count_ = 0;
+    uint16_t profile_ = 0;
+
+    // Index of profile in records_, or -1
+    int find(uint16_t profile) const;
+    bool write();
+
+    CalibrationStore() = default;
+    ~CalibrationStore() = default;
+    CalibrationStore(const CalibrationStore&) = delete;
+    CalibrationStore& operator=(const CalibrationStore&) = delete;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include "CharterBuffer.h"
+
+bool CharterBuffer::push(char c) {
+    if (count_ == CAPACITY) return false;
+    data_[(head_ + count_) % CAPACITY] = c;
+    count_++;
+    if (count_ > highWater_) highWater_ = count_;
+    return true;
+}
+
+size_t CharterBuffer::append(const char* str) {
+    size_t stored = 0;
+    while (str[stored] != '\0' && push(str[stored])) {
+        stored++;
+    }
+    return stored;
+}
+
+int CharterBuffer::pop() {
+    if (count_ == 0) return -1;
+    char c = data_[head_];
+    head_ = (head_ + 1) % CAPACITY;
+    count_--;
+    return (uint8_t)c;
+}
+
+int CharterBuffer::peek() const {
+    if (count_ == 0) return -1;
+    return (uint8_t)data_[head_];
+}
+
+void CharterBuffer::clear() {
+    head_ = 0;
+    count_ = 0;
+}
@@ -0,0 +1,33 @@
+#ifndef CHARTER_BUFFER_H
+#define CHARTER_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-size FIFO of characters waiting to be typed in charter mode.
+// Replaces the unbounded String so a large paste can't exhaust SRAM;
+// TCPConnection grants the sender credit for free space only
+// (CharterCredit.h).
+class CharterBuffer {
+public:
+    static constexpr size_t CAPACITY = 1024;
+
+    bool push(char c);
+    size_t append(const char* str); // Returns the number of characters stored
+    int pop();                      // -1 when empty
+    int peek() const;
+    void clear();
+
+    size_t length() const { return count_; }
+    size_t freeSpace() const { return CAPACITY - count_; }
+    bool isEmpty() const { return count_ == 0; }
+    size_t highWater() const { return highWater_; }
+
+private:
+    char data_[CAPACITY];
+    size_t head_ = 0;
+    size_t count_ = 0;
+    size_t highWater_ = 0;
+};
+
+#endif
@@ -0,0 +1,204 @@
+#include "CharterCodec.h"
+
+namespace CharterCodec {
+    namespace {
+        // Frequent English words and source code fragments, one byte each on
+        // the wire. Changing this table breaks streams from older tools.
+        const char* const DICTIONARY[] = {
+            // English
+            " the ", " and ", " of ", " to ", " in ", " is ", " that ", " for ",
+            " it ", " with ", " as ", " was ", " on ", " be ", " this ", " are ",
+            " by ", " not ", " or ", " from ", " have ", " an ", " at ", " which ",
+            " you ", " will ", " can ", " all ", " their ", " has ", " more ", " if ",
+            " one ", " would ", " there ", " they ", " we ", " when ", "The ", "tion",
+            "ing ", "ment", "ed ", "er ", "es ", ". ", ", ", "\n\n",
+            // Source code
+            "    ", "        ", "return ", "const ", "int ", "void ", "char ", "struct ",
+            "class ", "static ", "#include ", "#define ", "unsigned ", "uint8_t ", "size_t ", "std::",
+            "string", "true", "false", "nullptr", "for (", "if (", "while (", "else",
+            "} else {\n", ");\n", "();\n", ") {\n", "}\n", " = ", " == ", " != ",
+            " && ", " || ", "->", "++i) ", "def ", "self.", "import ", "function",
+            "print", "value", "length", "public:", "private:", "auto ", "bool ", "this",
+        };
+        static_assert(sizeof(DICTIONARY) / sizeof(DICTIONARY[0]) == DICT_COUNT, "dictionary must fill its token range");
+    }
+
+    const char* dictionaryWord(size_t i) {
+        return i < DICT_COUNT ? DICTIONARY[i] : "";
+    }
+
+    void Decoder::reset() {
+        pos_ = 0;
+        decoded_ = 0;
+        tokenLength_ = 0;
+        tokenNeeded_ = 0;
+        remaining_ = 0;
+        source_ = 0;
+        word_ = nullptr;
+    }
+
+    Decoder::Result Decoder::feed(uint8_t byte) {
+        if (tokenNeeded_ == 0) {
+            if (byte == END) return DONE;
+            if (byte < DICT_BASE) {
+                // Literal: a one character match on itself
+                window_[pos_] = char(byte);
+                source_ = pos_;
+                word_ = nullptr;
+                remaining_ = 1;
+                return OUTPUT;
+            }
+            if (byte < SHORT_MATCH) {
+                word_ = DICTIONARY[byte - DICT_BASE];
+                remaining_ = 0;
+                while (word_[remaining_]) remaining_++;
+                return OUTPUT;
+            }
+            token_[0] = byte;
+            tokenLength_ = 1;
+            tokenNeeded_ = byte < LONG_MATCH ? 2 : 3;
+            return NEED_MORE;
+        }
+
+        token_[tokenLength_++] = byte;
+        if (tokenLength_ < tokenNeeded_) return NEED_MORE;
+        tokenNeeded_ = 0;
+        if (token_[0] < LONG_MATCH) {
+            size_t length = MIN_MATCH + ((token_[0] >> 2) & 0x03);
+            size_t distance = 1 + ((size_t(token_[0] & 0x03) << 8) | token_[1]);
+            return startMatch(length, distance);
+        }
+        uint32_t bits = (uint32_t(token_[0] & 0x0F) << 16) | (uint32_t(token_[1]) << 8) | token_[2];
+        return startMatch(MIN_MATCH + (bits & 0x3FF), 1 + (bits >> 10));
+    }
+
+    Decoder::Result Decoder::startMatch(size_t length, size_t distance) {
+        if (distance > decoded_ || distance > WINDOW_SIZE) return FAILED;
+        source_ = (pos_ + WINDOW_SIZE - distance) % WINDOW_SIZE;
+        word_ = nullptr;
+        remaining_ = length;
+        return OUTPUT;
+    }
+
+    char Decoder::next() {
+        char c;
+        if (word_) {
+            c = *word_++;
+        } else {
+            c = window_[source_];
+            source_ = (source_ + 1) % WINDOW_SIZE;
+        }
+        window_[pos_] = c;
+        pos_ = (pos_ + 1) % WINDOW_SIZE;
+        remaining_--;
+        decoded_++;
+        return c;
+    }
+
+    void Encoder::insert(const uint8_t* text, size_t pos) {
+        size_t h = hash(text + pos);
+        prev_[pos % WINDOW_SIZE] = head_[h];
+        head_[h] = int32_t(pos);
+    }
+
+    size_t Encoder::longestMatch(const uint8_t* text, size_t length, size_t pos, size_t& distance) const {
+        if (pos + MIN_MATCH > length) return 0;
+        size_t limit = length - pos < MAX_MATCH ? length - pos : MAX_MATCH;
+        size_t best = 0;
+        int32_t candidate = head_[hash(text + pos)];
+        for (size_t chain = 0; candidate != NO_POSITION && chain < MAX_CHAIN; ++chain) {
+            size_t c = size_t(candidate);
+            if (pos - c > WINDOW_SIZE) break;
+            size_t n = 0;
+            while (n < limit && text[c + n] == text[pos + n]) n++;
+            if (n > best) {
+                best = n;
+                distance = pos - c;
+                if (n == limit) break;
+            }
+            int32_t older = prev_[c % WINDOW_SIZE];
+            if (older >= candidate) break;
+            candidate = older;
+        }
+        return best >= MIN_MATCH ? best : 0;
+    }
+
+    size_t Encoder::longestWord(const uint8_t* text, size_t length, size_t pos, size_t& word) {
+        size_t best = 0;
+        for (size_t i = 0; i < DICT_COUNT; ++i) {
+            const char* w = DICTIONARY[i];
+            size_t n = 0;
+            while (w[n] && pos + n < length && text[pos + n] == uint8_t(w[n])) n++;
+            if (!w[n] && n > best) {
+                best = n;
+                word = i;
+            }
+        }
+        return best;
+    }
+
+    size_t Encoder::compress(const uint8_t* text, size_t length, uint8_t* out, size_t capacity) {
+        for (size_t i = 0; i < length; ++i) {
+            if (!isTypeable(text[i])) return 0;
+        }
+        for (size_t i = 0; i < HASH_SIZE; ++i) head_[i] = NO_POSITION;
+
+        // Bytes saved by the best token at pos; a literal saves nothing
+        struct Choice {
+            size_t length = 1;
+            size_t distance = 0;
+            size_t word = DICT_COUNT;
+            int saving = 0;
+        };
+        auto choose = [&](size_t pos) {
+            Choice choice;
+            size_t distance = 0, word = 0;
+            size_t matched = longestMatch(text, length, pos, distance);
+            if (matched) {
+                int saving = int(matched) - (matched <= MAX_SHORT_MATCH ? 2 : 3);
+                if (saving > choice.saving) choice = Choice{matched, distance, DICT_COUNT, saving};
+            }
+            size_t worded = longestWord(text, length, pos, word);
+            if (worded && int(worded) - 1 > choice.saving) choice = Choice{worded, 0, word, int(worded) - 1};
+            return choice;
+        };
+
+        size_t written = 0;
+        size_t pos = 0;
+        while (pos < length) {
+            Choice choice = choose(pos);
+            if (pos + MIN_MATCH <= length) insert(text, pos);
+            // Lazy matching: a literal now if the next position has a better token
+            if (choice.saving > 0 && pos + 1 < length && choose(pos + 1).saving > choice.saving) choice = Choice();
+
+            if (choice.saving <= 0) {
+                if (written + 1 > capacity) return 0;
+                out[written++] = text[pos++];
+                continue;
+            }
+            if (choice.word < DICT_COUNT) {
+                if (written + 1 > capacity) return 0;
+                out[written++] = uint8_t(DICT_BASE + choice.word);
+            } else if (choice.length <= MAX_SHORT_MATCH) {
+                if (written + 2 > capacity) return 0;
+                size_t d = choice.distance - 1;
+                out[written++] = uint8_t(SHORT_MATCH | ((choice.length - MIN_MATCH) << 2) | (d >> 8));
+                out[written++] = uint8_t(d & 0xFF);
+            } else {
+                if (written + 3 > capacity) return 0;
+                uint32_t bits = (uint32_t(choice.distance - 1) << 10) | uint32_t(choice.length - MIN_MATCH);
+                out[written++] = uint8_t(LONG_MATCH | (bits >> 16));
+                out[written++] = uint8_t(bits >> 8);
+                out[written++] = uint8_t(bits);
+            }
+            // pos itself is already in the hash chains
+            for (size_t i = pos + 1; i < pos + choice.length; ++i) {
+                if (i + MIN_MATCH <= length) insert(text, i);
+            }
+            pos += choice.length;
+        }
+        if (written + 1 > capacity) return 0;
+        out[written++] = END;
+        return written;
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef CHARTER_CODEC_H
+#define CHARTER_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Compressed charter text, sent after a CHARTER_COMPRESSED control report
+// (see BridgeProtocol.h) instead of plain NUL-terminated text.
+//
+// LZ77 over the last WINDOW_SIZE characters plus a static dictionary of
+// common English words and source code fragments. The stream is a sequence
+// of byte-aligned tokens:
+//
+//   0x00                  END, the stream is complete
+//   0x01-0x7F             literal character
+//   0x80-0xDF             dictionary word (code - 0x80)
+//   0xE0-0xEF  b1         short match: length 3-6, distance 1-1024
+//                         ((len - 3) << 2 | (dist - 1) >> 8 in the low nibble, b1 = (dist - 1) & 0xFF)
+//   0xF0-0xFF  b1 b2      long match: length 3-1026, distance 1-1024
+//                         ((dist - 1) << 10 | (len - 3) in the 20 bits after 0xF)
+//
+// Only 0x01-0x7F can be sent, which is all that can be typed anyway.
+// Distances count back through the decoded text, matches may overlap the
+// text they produce, and dictionary words enter the window like any other
+// output.
+//
+// The decoder keeps only the window and works a character at a time, so
+// TCPConnection can stop when the charter buffer is full and carry on later
+// without holding the whole document.
+namespace CharterCodec {
+    static constexpr size_t WINDOW_SIZE = 1024;
+    static constexpr size_t MIN_MATCH = 3;
+    static constexpr size_t MAX_SHORT_MATCH = 6;
+    static constexpr size_t MAX_MATCH = 1026;
+
+    static constexpr uint8_t END = 0x00;
+    static constexpr uint8_t DICT_BASE = 0x80;
+    static constexpr uint8_t SHORT_MATCH = 0xE0;
+    static constexpr uint8_t LONG_MATCH = 0xF0;
+    static constexpr size_t DICT_COUNT = SHORT_MATCH - DICT_BASE;
+
+    // Word i of the static dictionary
+    const char* dictionaryWord(size_t i);
+
+    inline bool isTypeable(uint8_t c) { return c != 0 && c < 0x80; }
+
+    class Decoder {
+    public:
+        enum Result : uint8_t {
+            NEED_MORE, // Byte consumed, token not complete yet
+            OUTPUT,    // Characters are ready, take them with next()
+            DONE,      // END token, the stream is complete
+            FAILED     // Malformed token (distance before the start of the text), skipped
+        };
+
+        Decoder() { reset(); }
+        void reset();
+
+        // Feeds one compressed byte. Only call it while pending() is 0.
+        Result feed(uint8_t byte);
+        // Characters left from the current token
+        size_t pending() const { return remaining_; }
+        // Next decoded character, call only while pending() > 0
+        char next();
+
+        uint32_t decoded() const { return decoded_; }
+
+    private:
+        char window_[WINDOW_SIZE];
+        size_t pos_;             // Next write position in window_
+        uint32_t decoded_;       // Characters produced so far
+        uint8_t token_[3];
+        uint8_t tokenLength_;
+        uint8_t tokenNeeded_;
+        size_t remaining_;
+        size_t source_;          // Window position of the next match character
+        const char* word_;       // Next dictionary character, nullptr for matches
+
+        Result startMatch(size_t length, size_t distance);
+    };
+
+    // Compresses text on the host. Every byte must be isTypeable(). Returns
+    // the number of bytes written to out, including END, or 0 if text has
+    // bytes that can't be sent or out is too small; length + 1 is always
+    // enough.
+    class Encoder {
+    public:
+        size_t compress(const uint8_t* text, size_t length, uint8_t* out, size_t capacity);
+
+    private:
+        static constexpr size_t HASH_SIZE = 4096;
+        static constexpr int32_t NO_POSITION = -1;
+        static constexpr size_t MAX_CHAIN = 256;
+
+        int32_t head_[HASH_SIZE];
+        int32_t prev_[WINDOW_SIZE];
+
+        static size_t hash(const uint8_t* p) { return ((p[0] << 8) ^ (p[1] << 4) ^ p[2]) & (HASH_SIZE - 1); }
+        void insert(const uint8_t* text, size_t pos);
+        size_t longestMatch(const uint8_t* text, size_t length, size_t pos, size_t& distance) const;
+        static size_t longestWord(const uint8_t* text, size_t length, size_t pos, size_t& word);
+    };
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef CHARTER_CREDIT_H
+#define CHARTER_CREDIT_H
+
+#include <stddef.h>
+#include "CharterBuffer.h"
+
+// Credit accounting for charter text streams. The sender may only have as
+// many bytes in flight as TCPConnection granted with CREDIT reports, and
+// outstanding credit never exceeds the room it was granted against, so the
+// charter buffer can't overflow.
+class CharterCredit {
+public:
+    // Credit is returned in batches of at least this many bytes
+    static constexpr size_t BATCH = CharterBuffer::CAPACITY / 4;
+
+    void reset() { outstanding_ = 0; }
+
+    // A byte arrived against credit
+    void consumed() {
+        if (outstanding_ > 0) outstanding_--;
+    }
+
+    // Credit to grant now for room free bytes, 0 for none. Small grants are
+    // held back while the buffer still has text to type, so returning credit
+    // doesn't cost a report per character; force sends any amount.
+    size_t grant(size_t room, bool bufferEmpty, bool force) {
+        size_t ungranted = room > outstanding_ ? room - outstanding_ : 0;
+        if (ungranted == 0) return 0;
+        if (!force && ungranted < BATCH && !bufferEmpty) return 0;
+        outstanding_ += ungranted;
+        return ungranted;
+    }
+
+    size_t outstanding() const { return outstanding_; }
+
+private:
+    size_t outstanding_ = 0;
+};
+
+#endif
@@ -0,0 +1,256 @@
+#ifndef CHORD_MATCHER_H
+#define CHORD_MATCHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "KeyReport.h"
+
+// Chord and sequence detector over the key event stream.
+//
+// A binding is a sequence of steps; each step is a chord of exact modifiers
+// plus one key, or modifiers alone (key 0). addBinding() compiles bindings
+// into a trie whose edges live in an open-addressed hash table keyed by
+// (node, step), so matching costs one or two table lookups per key event no
+// matter how many bindings there are. A binding added with anyModifiers
+// matches its keys whatever modifiers are held; those edges are a second
+// lookup, made only when the exact chord has none.
+//
+// feed() turns each report into events (one per newly pressed key, plus one
+// when the modifiers gain bits) and walks the trie. A step only has to be
+// pressed, other keys held in the same report don't matter, and a modifier
+// change that is neither the next step nor the start of a binding doesn't
+// interrupt a sequence. When an event doesn't continue the current sequence,
+// matching restarts at the root with that event. If the next step doesn't
+// come within the timeout the sequence is abandoned. A binding that is also
+// the prefix of a longer one fires from poll() once the timeout passes
+// without a continuation.
+//
+// Reports are never held back, so keys that are not part of a completed
+// binding reach the host without delay. Sequences should therefore start
+// with a key that does nothing on the host (e.g. F13-F24). Once the caller
+// has acted on a binding, swallow() keeps the key (or the modifiers, for a
+// modifier chord) that completed it out of the reports passed to strip()
+// until it is released; the other keys of those reports pass on.
+//
+// Capacities are template parameters so the firmware can use a small table
+// and the host benchmark a large one.
+template <size_t MAX_NODES, size_t TABLE_SIZE>
+class ChordMatcher {
+    static_assert((TABLE_SIZE & (TABLE_SIZE - 1)) == 0, "TABLE_SIZE must be a power of two");
+    static_assert(MAX_NODES <= 0x8000, "node ids are 15 bit, the top bit marks anyModifiers edges");
+
+public:
+    static constexpr uint8_t NO_ACTION = 0;
+
+    struct Step {
+        uint8_t modifiers;
+        uint8_t key; // 0 for a modifier-only chord
+    };
+
+    ChordMatcher() { clear(); }
+
+    // Removes all bindings
+    void clear() {
+        memset(edges_, 0xFF, sizeof(edges_));
+        memset(actions_, NO_ACTION, sizeof(actions_));
+        memset(hasChildren_, 0, sizeof(hasChildren_));
+        nodes_ = 1; // Node 0 is the root
+        edgeCount_ = 0;
+        reset();
+    }
+
+    // Returns false if the binding doesn't fit or conflicts with an existing one.
+    // With anyModifiers the modifiers of steps with a key are ignored.
+    bool addBinding(const Step* steps, size_t count, uint8_t action, bool anyModifiers = false) {
+        if (count == 0 || action == NO_ACTION) return false;
+        uint16_t node = 0;
+        for (size_t i = 0; i < count; ++i) {
+            bool any = anyModifiers && steps[i].key != 0;
+            uint16_t from = any ? uint16_t(node | ANY_MODIFIERS) : node;
+            uint16_t symbol = toSymbol(any ? 0 : steps[i].modifiers, steps[i].key);
+            uint16_t next = lookup(from, symbol);
+            if (next == NONE) {
+                // Keep the table at most 3/4 full so probe chains stay short
+                if (nodes_ >= MAX_NODES || (edgeCount_ + 1) * 4 > TABLE_SIZE * 3) return false;
+                next = uint16_t(nodes_++);
+                insert(from, symbol, next);
+                hasChildren_[node] = true;
+            }
+            node = next;
+        }
+        if (actions_[node] != NO_ACTION) return false;
+        actions_[node] = action;
+        return true;
+    }
+
+    void setTimeout(unsigned long ms) { timeoutMs_ = ms; }
+
+    // Forgets the sequence in progress, the last report and what is swallowed
+    void reset() {
+        state_ = 0;
+        pending_ = NO_ACTION;
+        memset(&last_, 0, sizeof(last_));
+        memset(&completed_, 0, sizeof(completed_));
+        memset(&swallowed_, 0, sizeof(swallowed_));
+    }
+
+    // Processes one report. Returns the action it completed, or NO_ACTION.
+    uint8_t feed(const KeyReport& report, unsigned long nowMs) {
+        memset(&completed_, 0, sizeof(completed_));
+        uint8_t fired = poll(nowMs);
+
+        // Modifier chord: the modifiers gained bits
+        if (report.modifiers & ~last_.modifiers) {
+            uint8_t action = step(report.modifiers, 0, nowMs);
+            if (action != NO_ACTION) fired = action;
+        }
+        for (int i = 0; i < 6; ++i) {
+            uint8_t key = report.keys[i];
+            if (key == 0 || hasKey(last_, key)) continue;
+            uint8_t action = step(report.modifiers, key, nowMs);
+            if (action != NO_ACTION) fired = action;
+        }
+        last_ = report;
+        return fired;
+    }
+
+    // Call regularly: abandons a timed out sequence and fires a pending prefix binding
+    uint8_t poll(unsigned long nowMs) {
+        if (state_ == 0 || nowMs - lastStepMs_ < timeoutMs_) return NO_ACTION;
+        uint8_t action = pending_;
+        state_ = 0;
+        pending_ = NO_ACTION;
+        return action;
+    }
+
+    // Swallows the key or modifiers that completed the action feed() just
+    // returned. A binding that fired from poll() or when a sequence broke
+    // off was completed by an earlier report, so there is nothing to swallow.
+    void swallow() {
+        swallowed_.modifiers |= completed_.modifiers;
+        if (completed_.key == 0 || hasKey(swallowed_, completed_.key)) return;
+        for (int i = 0; i < 6; ++i) {
+            if (swallowed_.keys[i] == 0) {
+                swallowed_.keys[i] = completed_.key;
+                return;
+            }
+        }
+    }
+
+    // Removes what is swallowed from report, the current one fed; whatever
+    // report no longer holds stops being swallowed
+    void strip(KeyReport& report) {
+        swallowed_.modifiers &= report.modifiers;
+        report.modifiers &= ~swallowed_.modifiers;
+        for (int i = 0; i < 6; ++i) {
+            if (swallowed_.keys[i] != 0 && !hasKey(report, swallowed_.keys[i])) swallowed_.keys[i] = 0;
+        }
+        int kept = 0;
+        for (int i = 0; i < 6; ++i) {
+            uint8_t key = report.keys[i];
+            if (key != 0 && !hasKey(swallowed_, key)) report.keys[kept++] = key;
+        }
+        while (kept < 6) report.keys[kept++] = 0;
+    }
+
+    size_t nodeCount() const { return nodes_; }
+    size_t edgeCount() const { return edgeCount_; }
+    bool inSequence() const { return state_ != 0; }
+
+private:
+    static constexpr uint16_t NONE = 0xFFFF;
+    // Set in the from node of edges added with anyModifiers
+    static constexpr uint16_t ANY_MODIFIERS = 0x8000;
+
+    struct Edge {
+        uint16_t from;
+        uint16_t symbol;
+        uint16_t to;
+    };
+
+    Edge edges_[TABLE_SIZE];
+    uint8_t actions_[MAX_NODES];
+    bool hasChildren_[MAX_NODES];
+    size_t nodes_;
+    size_t edgeCount_;
+
+    uint16_t state_;
+    uint8_t pending_;
+    unsigned long lastStepMs_ = 0;
+    unsigned long timeoutMs_ = 1000;
+    KeyReport last_;
+    Step completed_;       // What completed the action feed() returned, if it did
+    KeyReport swallowed_;  // Keys and modifiers of acted on bindings, still held
+
+    static uint16_t toSymbol(uint8_t modifiers, uint8_t key) {
+        return uint16_t(modifiers) << 8 | key;
+    }
+
+    static bool hasKey(const KeyReport& report, uint8_t key) {
+        for (int i = 0; i < 6; ++i) {
+            if (report.keys[i] == key) return true;
+        }
+        return false;
+    }
+
+    static size_t slot(uint16_t from, uint16_t symbol) {
+        uint32_t h = (uint32_t(from) << 16 | symbol) * 2654435761u;
+        return (h >> 16) & (TABLE_SIZE - 1);
+    }
+
+    uint16_t lookup(uint16_t from, uint16_t symbol) const {
+        for (size_t i = slot(from, symbol);; i = (i + 1) & (TABLE_SIZE - 1)) {
+            const Edge& edge = edges_[i];
+            if (edge.to == NONE) return NONE;
+            if (edge.from == from && edge.symbol == symbol) return edge.to;
+        }
+    }
+
+    void insert(uint16_t from, uint16_t symbol, uint16_t to) {
+        size_t i = slot(from, symbol);
+        while (edges_[i].to != NONE) i = (i + 1) & (TABLE_SIZE - 1);
+        edges_[i] = Edge{from, symbol, to};
+        edgeCount_++;
+    }
+
+    // The exact chord first, then the key with any modifiers
+    uint16_t follow(uint16_t node, uint8_t modifiers, uint8_t key) const {
+        uint16_t next = lookup(node, toSymbol(modifiers, key));
+        if (next == NONE && key != 0) next = lookup(uint16_t(node | ANY_MODIFIERS), toSymbol(0, key));
+        return next;
+    }
+
+    uint8_t step(uint8_t modifiers, uint8_t key, unsigned long nowMs) {
+        uint8_t fired = NO_ACTION;
+        uint16_t next = NONE;
+        if (state_ != 0) {
+            next = (nowMs - lastStepMs_ < timeoutMs_) ? follow(state_, modifiers, key) : NONE;
+            // Pressing Shift on the way to the next step must not break the
+            // sequence, but a modifier chord that starts a binding does
+            if (next == NONE && key == 0 && follow(0, modifiers, 0) == NONE) return NO_ACTION;
+            if (next == NONE) {
+                // Sequence broken; a shorter binding it already completed still counts
+                fired = pending_;
+                state_ = 0;
+                pending_ = NO_ACTION;
+            }
+        }
+        if (next == NONE) next = follow(0, modifiers, key);
+        if (next == NONE) return fired;
+
+        lastStepMs_ = nowMs;
+        if (!hasChildren_[next]) {
+            state_ = 0;
+            pending_ = NO_ACTION;
+            // Held modifiers of a key step stay the user's
+            completed_ = Step{key == 0 ? modifiers : uint8_t(0), key};
+            return actions_[next];
+        }
+        state_ = next;
+        pending_ = actions_[next];
+        return fired;
+    }
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "ConfigStore.h"
+#include "ArduinoKeyBridgeLogger.h"
+#include "CalibrationStore.h"
+#include <EEPROM.h>
+
+BridgeConfig ConfigStore::config_ = BridgeConfig::defaults();
+
+ConfigStore& ConfigStore::getInstance() {
+    static ConfigStore instance;
+    return instance;
+}
+
+void ConfigStore::begin() {
+    // Straight copies of the flash slots, checked in place
+    BridgeConfig slots[FlashLayout::CONFIG_SLOTS];
+    for (size_t i = 0; i < FlashLayout::CONFIG_SLOTS; ++i) {
+        EEPROM.get(slotAddress(i), slots[i]);
+    }
+    const BridgeConfig* stored = BridgeConfig::newest(slots[0], slots[1]);
+    if (!stored) {
+        ArduinoKeyBridgeLogger::getInstance().info("Config", "No valid stored config, using defaults");
+        return;
+    }
+    config_ = *stored;
+    slot_ = int(stored - slots);
+    ArduinoKeyBridgeLogger::getInstance().info("Config", String("Loaded config ") + config_.sequence + " from slot " + slot_);
+}
+
+bool ConfigStore::beginBlob(size_t length) {
+    staged_ = 0;
+    // A zero length upload restores the defaults
+    return length == 0 || length == sizeof(BridgeConfig);
+}
+
+bool ConfigStore::writeBlob(const uint8_t* data, size_t length, size_t offset) {
+    if (offset + length > sizeof(staging_)) return false;
+    memcpy(reinterpret_cast<uint8_t*>(&staging_) + offset, data, length);
+    staged_ = offset + length;
+    return true;
+}
+
+bool ConfigStore::endBlob() {
+    if (staged_ == 0) {
+        staging_ = BridgeConfig::defaults();
+        ArduinoKeyBridgeLogger::getInstance().info("Config", "Restoring the default config");
+    } else if (staged_ != sizeof(BridgeConfig) || !staging_.valid()) {
+        ArduinoKeyBridgeLogger::getInstance().warning("Config", String("Rejected config blob of ") + staged_ + " bytes");
+        return false;
+    }
+    return save(staging_);
+}
+
+bool ConfigStore::save(BridgeConfig& config) {
+    // Never overwrite the slot in use: a reset halfway leaves it intact
+    size_t slot = slot_ == 0 ? 1 : 0;
+    size_t address = slotAddress(slot);
+    config.sequence = config_.sequence + 1;
+    config.seal();
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&config);
+
+    // update() skips bytes that are already equal, sparing flash erase cycles
+    for (size_t i = 0; i < sizeof(BridgeConfig); ++i) {
+        EEPROM.update(address + i, bytes[i]);
+    }
+    for (size_t i = 0; i < sizeof(BridgeConfig); ++i) {
+        if (EEPROM.read(address + i) != bytes[i]) {
+            ArduinoKeyBridgeLogger::getInstance().error("Config", "Writing config to flash failed");
+            return false;
+        }
+    }
+    config_ = config;
+    slot_ = int(slot);
+    ArduinoKeyBridgeLogger::getInstance().info("Config", String("Stored config ") + config_.sequence + " in slot " + slot_ +
+        ", access point, port, LEDs and status interval change at the next boot");
+    apply();
+    return true;
+}
+
+void ConfigStore::apply() {
+    ArduinoKeyBridgeLogger::getInstance().setLogLevel(LogLevel(config_.logLevel));
+    // The HID interval of hosts without a calibration
+    CalibrationStore::getInstance().apply();
+}
@@ -0,0 +1,52 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <Arduino.h>
+#include "BridgeConfig.h"
+#include "BlobSink.h"
+#include "FlashLayout.h"
+
+// Owns the BridgeConfig the firmware runs with. begin() copies the newer
+// valid of two flash slots to RAM, or takes the defaults if neither is valid
+// (first boot, erased flash, another VERSION).
+//
+// CONFIG_BLOB uploads are checked, then written to the slot that is not in
+// use with the next sequence number. A write cut short by a reset fails its
+// CRC, so the previous slot stays in charge and the update is all or
+// nothing. Log level, LED levels, the HID interval and the charter chunk
+// apply at once; the access point, port, LED wiring and status interval at
+// the next boot.
+class ConfigStore : public BlobSink {
+public:
+    static ConfigStore& getInstance();
+
+    // Load the active config from flash, before anything reads it
+    void begin();
+    // A static object, so hot paths read fields at a fixed address
+    static const BridgeConfig& config() { return config_; }
+
+    bool beginBlob(size_t length) override;
+    bool writeBlob(const uint8_t* data, size_t length, size_t offset) override;
+    bool endBlob() override;
+
+private:
+    static_assert(sizeof(BridgeConfig) <= FlashLayout::CONFIG_SLOT_SIZE, "config doesn't fit its flash slot");
+
+    static BridgeConfig config_;
+    // Upload staging, so a bad upload never replaces the active config
+    BridgeConfig staging_;
+    size_t staged_ = 0;
+    // Slot config_ was loaded from or last written to, -1 for the defaults
+    int slot_ = -1;
+
+    static size_t slotAddress(size_t slot) { return FlashLayout::CONFIG_ADDRESS + slot * FlashLayout::CONFIG_SLOT_SIZE; }
+    bool save(BridgeConfig& config);
+    void apply();
+
+    ConfigStore() = default;
+    ~ConfigStore() = default;
+    ConfigStore(const ConfigStore&) = delete;
+    ConfigStore& operator=(const ConfigStore&) = delete;
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) used to check blobs stored in
+// data flash and uploaded over TCP. Bitwise, so no table in RAM.
+inline uint16_t crc16Update(uint16_t crc, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        crc ^= uint16_t(data[i]) << 8;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) ? uint16_t((crc << 1) ^ 0x1021) : uint16_t(crc << 1);
+        }
+    }
+    return crc;
+}
+
+inline uint16_t crc16(const uint8_t* data, size_t length) {
+    return crc16Update(0xFFFF, data, length);
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef DEVICE_ROUTER_H
+#define DEVICE_ROUTER_H
+
+#include <string.h>
+#include "BridgeConfig.h"
+#include "InputCoalescer.h"
+
+// Splits the key states from InputCoalescer between the host path and the
+// server, as BridgeConfig::macroPadRoute says. With ROUTE_SERVER the host
+// gets the keys of KEYBOARD devices and the server those of MACRO_PAD
+// devices; with ROUTE_HOST the host gets everything.
+//
+// The split uses the per-tag reports stored with each state when it was
+// queued, not the merger's state when the pipeline gets to it, so a tap that
+// is pressed and released before the pipeline runs still reaches its side.
+// A side only gets a report when its keys changed since the previous state.
+class DeviceRouter {
+public:
+    struct Split {
+        bool toHost;      // host changed, it goes on down the pipeline
+        bool toServer;    // server changed, it goes to the server
+        KeyReport host;
+        KeyReport server;
+    };
+
+    static Split route(const InputCoalescer::Entry& previous, const InputCoalescer::Entry& current, uint8_t route) {
+        Split split = {};
+        if (route != BridgeConfig::ROUTE_SERVER) {
+            split.host = current.report;
+            split.toHost = true;
+            return split;
+        }
+        split.host = current.tagged[KeyboardMerger::KEYBOARD];
+        split.server = current.tagged[KeyboardMerger::MACRO_PAD];
+        split.toHost = !same(split.host, previous.tagged[KeyboardMerger::KEYBOARD]);
+        split.toServer = !same(split.server, previous.tagged[KeyboardMerger::MACRO_PAD]);
+        return split;
+    }
+
+private:
+    static bool same(const KeyReport& a, const KeyReport& b) { return memcmp(&a, &b, sizeof(KeyReport)) == 0; }
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef FLASH_LAYOUT_H
+#define FLASH_LAYOUT_H
+
+#include <stddef.h>
+
+// Regions of the 8 KB data flash (EEPROM library) and what owns them
+namespace FlashLayout {
+    // KeyRemap blob (RemapStore)
+    static constexpr size_t REMAP_ADDRESS = 0x0000;
+    static constexpr size_t REMAP_SIZE = 0x0800;
+    // SnippetLibrary image (SnippetStore)
+    static constexpr size_t SNIPPET_ADDRESS = 0x0800;
+    static constexpr size_t SNIPPET_SIZE = 0x1300;
+    // Typing calibration per host profile (CalibrationStore)
+    static constexpr size_t CALIBRATION_ADDRESS = 0x1B00;
+    static constexpr size_t CALIBRATION_SIZE = 0x0100;
+    // BridgeConfig, two slots written in turn (ConfigStore)
+    static constexpr size_t CONFIG_ADDRESS = 0x1C00;
+    static constexpr size_t CONFIG_SLOT_SIZE = 0x0200;
+    static constexpr size_t CONFIG_SLOTS = 2;
+}
+
+#endif
@@ -0,0 +1,49 @@
+#include "FlightRecorder.h"
+#include <string.h>
+
+// Not zeroed or initialised by the startup code, so it survives a reset
+#if defined(ARDUINO)
+__attribute__((section(".noinit")))
+#endif
+FlightRecorder::Image FlightRecorder::image_;
+
+void FlightRecorder::start() {
+    if (!recover()) clear();
+    image_.boots++;
+    image_.inTask = 0;
+    image_.trouble = 0;
+    record(BOOT, 0, uint16_t(image_.boots));
+}
+
+void FlightRecorder::stalled(uint8_t task, unsigned long us) {
+    image_.stalls++;
+    image_.trouble = 1;
+    unsigned long ms = us / 1000;
+    record(STALL, task, uint16_t(ms > 0xFFFF ? 0xFFFF : ms));
+}
+
+void FlightRecorder::halted(uint8_t reason) {
+    image_.trouble = 1;
+    record(HALT, reason);
+}
+
+const char* FlightRecorder::name(uint8_t event) {
+    switch (event) {
+        case BOOT: return "boot";
+        case SETUP: return "setup";
+        case TASK: return "task";
+        case KEY_REPORT: return "key report";
+        case NET_ACCEPT: return "net accept";
+        case NET_READ: return "net read";
+        case NET_WRITE: return "net write";
+        case STALL: return "stall";
+        case HALT: return "halt";
+        default: return "?";
+    }
+}
+
+void FlightRecorder::clear() {
+    memset(&image_, 0, sizeof(image_));
+    image_.magic = MAGIC;
+    image_.inverse = ~MAGIC;
+}
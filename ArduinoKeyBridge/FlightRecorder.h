@@ -0,0 +1,99 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "BridgeClock.h"
+
+// The last CAPACITY events before a freeze: task starts, key reports,
+// network reads and writes, setup steps.
+//
+// The ring lives in RAM the startup code leaves alone (.noinit), so after a
+// watchdog reset it still holds what the bridge was doing when it hung.
+// recover() checks for a record left by the previous run and endedBadly()
+// whether it is worth a look: LoopWatchdog dumps only those, and start()
+// carries on recording after a BOOT event. Nothing is written on a clean
+// run except the ring itself; power-on RAM fails the magic check.
+//
+// record() is an 8-byte store plus micros(), cheap enough to leave on in
+// production (see tools/cpp/keybridge_flight_recorder_bench.cpp).
+class FlightRecorder {
+public:
+    static constexpr size_t CAPACITY = 128; // Power of two
+    static constexpr uint32_t MAGIC = 0x4B424652; // "KBFR"
+
+    enum Event : uint8_t {
+        NONE = 0,
+        BOOT,        // a: 0, b: boot count
+        SETUP,       // a: setup step in percent
+        TASK,        // a: TaskScheduler task id
+        KEY_REPORT,  // a: modifiers, b: first two keys
+        NET_ACCEPT,
+        NET_READ,    // b: bytes read from the link
+        NET_WRITE,   // b: bytes about to be written to the link
+        STALL,       // a: task id, b: loop iteration in ms
+        HALT         // a: reason code
+    };
+
+    struct Entry {
+        uint32_t timeUs;
+        uint8_t event;
+        uint8_t a;
+        uint16_t b;
+    };
+
+    // Layout of the retained RAM; no constructor, so nothing overwrites it at boot
+    struct Image {
+        uint32_t magic;
+        uint32_t inverse;     // ~magic
+        uint32_t head;        // Events recorded, the ring index is head % CAPACITY
+        uint32_t boots;
+        uint32_t stalls;
+        uint8_t task;         // Task running when the record ended, if any
+        uint8_t inTask;
+        uint8_t trouble;      // A stall or halt was recorded since boot
+        uint8_t reserved;
+        uint32_t taskStartUs;
+        Entry entries[CAPACITY];
+    };
+
+    // True if RAM holds a record from before this boot
+    static bool recover() { return image_.magic == MAGIC && image_.inverse == ~MAGIC; }
+    // True if that record ended inside a task, or after a stall or halt
+    static bool endedBadly() { return recover() && (image_.inTask || image_.trouble); }
+    // Starts recording for this boot: keeps a valid record, starts a fresh one otherwise
+    static void start();
+
+    static inline void record(Event event, uint8_t a = 0, uint16_t b = 0) {
+        Entry& entry = image_.entries[image_.head++ % CAPACITY];
+        entry.timeUs = uint32_t(BridgeClock::micros());
+        entry.event = event;
+        entry.a = a;
+        entry.b = b;
+    }
+
+    // A task is running from now on / returned; a reset in between names it
+    static inline void taskStarted(uint8_t task, unsigned long nowUs) {
+        image_.task = task;
+        image_.inTask = 1;
+        image_.taskStartUs = uint32_t(nowUs);
+        record(TASK, task);
+    }
+    static inline void taskEnded() { image_.inTask = 0; }
+    static void stalled(uint8_t task, unsigned long us);
+    static void halted(uint8_t reason);
+
+    // Events in the ring, oldest first
+    static size_t size() { return image_.head < CAPACITY ? image_.head : CAPACITY; }
+    static const Entry& entry(size_t i) { return image_.entries[(image_.head - size() + i) % CAPACITY]; }
+    static const Image& image() { return image_; }
+    static const char* name(uint8_t event);
+
+    // Forget everything, as after power-on
+    static void clear();
+
+private:
+    static Image image_;
+};
+
+#endif
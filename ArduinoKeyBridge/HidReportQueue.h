@@ -0,0 +1,128 @@
+#ifndef HID_REPORT_QUEUE_H
+#define HID_REPORT_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "KeyReport.h"
+
+// Outbound HID reports, sent at most one per host polling interval.
+//
+// The host reads the keyboard endpoint once per bInterval; a report written
+// over one the host hasn't read yet replaces it, so a press and release in
+// the same interval can vanish. Everything that types to the host pushes
+// here instead, and MinimalKeyboard::pump() sends the front report once the
+// interval since the last send has passed. That way every distinct state
+// reaches the host exactly once, in order, as fast as the host polls:
+//
+//   - a report equal to the state before it is skipped
+//   - a send the USB stack refuses (endpoint busy) is retried on the next
+//     pump; one that keeps failing for STALL_US (no host) is dropped
+//   - when the queue is full the newest entry is replaced, counted as an
+//     overrun; producers that must not lose states wait for room first
+//
+// Entries can carry a tag (LatencyTracer) that is handed back when the
+// report is sent.
+class HidReportQueue {
+public:
+    static constexpr size_t CAPACITY = 64;
+    static constexpr unsigned long DEFAULT_INTERVAL_US = 1000; // Full-speed bInterval of 1 ms
+    static constexpr unsigned long STALL_US = 50000;
+
+    struct Stats {
+        uint32_t pushed = 0;
+        uint32_t sent = 0;
+        uint32_t duplicates = 0; // Same state as the one before, skipped
+        uint32_t overruns = 0;   // Queue full, newest entry replaced
+        uint32_t retries = 0;    // Endpoint busy, sent again later
+        uint32_t stalled = 0;    // Dropped after STALL_US of failed sends
+        size_t highWater = 0;
+    };
+
+    void setInterval(unsigned long us) { intervalUs_ = us; }
+    unsigned long interval() const { return intervalUs_; }
+
+    // Returns false if report was skipped as a duplicate
+    bool push(const KeyReport& report, uint8_t tag = 0) {
+        if (same(report, last_)) {
+            stats_.duplicates++;
+            return false;
+        }
+        last_ = report;
+        stats_.pushed++;
+        if (count_ == CAPACITY) {
+            reports_[(head_ + count_ - 1) % CAPACITY] = report;
+            tags_[(head_ + count_ - 1) % CAPACITY] = tag;
+            stats_.overruns++;
+            return true;
+        }
+        reports_[(head_ + count_) % CAPACITY] = report;
+        tags_[(head_ + count_) % CAPACITY] = tag;
+        count_++;
+        if (count_ > stats_.highWater) stats_.highWater = count_;
+        return true;
+    }
+
+    // True if the front report may be sent now. Up to half an interval
+    // early: the pumping task runs with some jitter, and waiting for the full
+    // interval would often skip a whole host poll. A send the host isn't
+    // ready for is refused by the stack and retried.
+    bool due(unsigned long nowUs) const {
+        return count_ > 0 && (!anySent_ || nowUs - lastSendUs_ >= intervalUs_ - intervalUs_ / 2);
+    }
+    const KeyReport& front() const { return reports_[head_]; }
+
+    // The front report was handed to the USB stack. Returns its tag.
+    uint8_t sent(unsigned long nowUs) {
+        uint8_t tag = tags_[head_];
+        pop();
+        stats_.sent++;
+        lastSendUs_ = nowUs;
+        anySent_ = true;
+        failing_ = false;
+        return tag;
+    }
+
+    // The USB stack refused the front report
+    void busy(unsigned long nowUs) {
+        if (!failing_) {
+            failing_ = true;
+            failingSinceUs_ = nowUs;
+        }
+        stats_.retries++;
+        if (nowUs - failingSinceUs_ >= STALL_US) {
+            pop();
+            stats_.stalled++;
+            failing_ = false;
+        }
+    }
+
+    void clear() { head_ = count_ = 0; }
+    size_t size() const { return count_; }
+    size_t freeSpace() const { return CAPACITY - count_; }
+    bool isEmpty() const { return count_ == 0; }
+    const Stats& stats() const { return stats_; }
+    void resetHighWater() { stats_.highWater = count_; }
+
+private:
+    KeyReport reports_[CAPACITY];
+    uint8_t tags_[CAPACITY] = {};
+    size_t head_ = 0;
+    size_t count_ = 0;
+    KeyReport last_ = {0, 0, {0, 0, 0, 0, 0, 0}}; // The host starts with nothing pressed
+    unsigned long intervalUs_ = DEFAULT_INTERVAL_US;
+    unsigned long lastSendUs_ = 0;
+    bool anySent_ = false;
+    bool failing_ = false;
+    unsigned long failingSinceUs_ = 0;
+    Stats stats_;
+
+    static bool same(const KeyReport& a, const KeyReport& b) { return memcmp(&a, &b, sizeof(KeyReport)) == 0; }
+
+    void pop() {
+        head_ = (head_ + 1) % CAPACITY;
+        count_--;
+    }
+};
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef INPUT_COALESCER_H
+#define INPUT_COALESCER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "KeyReport.h"
+#include "KeyboardMerger.h"
+
+// Merged key states from the USB keyboards, on their way to the pipeline.
+//
+// Usb.Task() can deliver several reports (one per keyboard, or a burst after
+// a slow pipeline run) before usbTask gets to them. A single slot kept only
+// the last one, so a tap that came and went in between was lost. States now
+// queue here, and when the consumer is behind, intermediate states that
+// carry no edge of their own are dropped:
+//
+//   - a state equal to the one before it is skipped (keyboards like the
+//     Magic Keyboard repeat their report while keys are held; KeyboardMerger
+//     already drops most of those, this catches the rest)
+//   - a pending state S between the last delivered state L and the next
+//     pending state N is skipped if every key S presses is still down in N
+//     and no key of L is released in S and pressed again in N. Delivering N
+//     straight after L then gives the same press and release edges per key,
+//     just fewer reports
+//   - when the queue is full the newest entry is replaced, coalesced if that
+//     is safe and counted as an overflow if not
+//
+// Each state also carries the merged report of each keyboard tag as it was
+// when the state was queued, so DeviceRouter can split it between the host
+// and the server without reading the merger's newer state. A state is only
+// skipped if that holds for every tag's report as well.
+//
+// A coalesced state hands its arrival time to the one that replaces it, so
+// latency is measured from the earliest press it carries. Modifier bits are
+// treated as keys.
+class InputCoalescer {
+public:
+    static constexpr size_t CAPACITY = 16;
+
+    struct Entry {
+        KeyReport report;
+        unsigned long arrivalUs;
+        uint8_t device; // Keyboard that caused the change
+        KeyReport tagged[KeyboardMerger::TAGS]; // KeyboardMerger::report(tagMask(tag)) when queued
+    };
+
+    struct Stats {
+        uint32_t pushed = 0;
+        uint32_t delivered = 0;
+        uint32_t duplicates = 0; // Same state as the one before, skipped
+        uint32_t coalesced = 0;  // Intermediate states skipped without losing an edge
+        uint32_t overflows = 0;  // Queue full, newest state replaced although that lost an edge
+        size_t highWater = 0;
+    };
+
+    // The merger's state after device changed it. Returns false if it was
+    // skipped as a duplicate.
+    bool push(const KeyboardMerger& merger, unsigned long arrivalUs, uint8_t device) {
+        Entry entry;
+        entry.report = merger.report();
+        entry.arrivalUs = arrivalUs;
+        entry.device = device;
+        for (uint8_t tag = 0; tag < KeyboardMerger::TAGS; ++tag) {
+            entry.tagged[tag] = merger.report(KeyboardMerger::tagMask(KeyboardMerger::Tag(tag)));
+        }
+        return push(entry);
+    }
+
+    // A single keyboard's state, tagged KEYBOARD
+    bool push(const KeyReport& report, unsigned long arrivalUs, uint8_t device = 0) {
+        Entry entry = {report, arrivalUs, device, {}};
+        entry.tagged[KeyboardMerger::KEYBOARD] = report;
+        return push(entry);
+    }
+
+    bool push(const Entry& entry) {
+        if (same(entry, count_ ? at(count_ - 1) : delivered_)) {
+            stats_.duplicates++;
+            return false;
+        }
+        stats_.pushed++;
+        if (count_ == CAPACITY) {
+            Entry& newest = at(count_ - 1);
+            if (canSkip(at(count_ - 2), newest, entry)) stats_.coalesced++;
+            else stats_.overflows++;
+            unsigned long arrivalUs = newest.arrivalUs;
+            newest = entry;
+            newest.arrivalUs = arrivalUs;
+            return true;
+        }
+        at(count_++) = entry;
+        if (count_ > stats_.highWater) stats_.highWater = count_;
+        return true;
+    }
+
+    // Next state for the pipeline, with the intermediate states it makes
+    // redundant skipped. False if nothing is pending.
+    bool pop(Entry& entry) {
+        while (count_ > 1 && canSkip(delivered_, at(0), at(1))) {
+            at(1).arrivalUs = at(0).arrivalUs; // States queue in arrival order
+            drop();
+            stats_.coalesced++;
+        }
+        if (count_ == 0) return false;
+        entry = at(0);
+        drop();
+        delivered_ = entry;
+        stats_.delivered++;
+        return true;
+    }
+
+    // Delivering next straight after last gives the same edges as going
+    // through skipped first
+    static bool canSkip(const KeyReport& last, const KeyReport& skipped, const KeyReport& next) {
+        // Modifiers pressed in skipped must still be down, none released and pressed again
+        if (skipped.modifiers & ~last.modifiers & ~next.modifiers) return false;
+        if (last.modifiers & next.modifiers & ~skipped.modifiers) return false;
+        for (uint8_t key : skipped.keys) {
+            if (key != 0 && !holds(last, key) && !holds(next, key)) return false;
+        }
+        for (uint8_t key : last.keys) {
+            if (key != 0 && holds(next, key) && !holds(skipped, key)) return false;
+        }
+        return true;
+    }
+
+    // canSkip() for the merged report and every tag's report
+    static bool canSkip(const Entry& last, const Entry& skipped, const Entry& next) {
+        if (!canSkip(last.report, skipped.report, next.report)) return false;
+        for (uint8_t tag = 0; tag < KeyboardMerger::TAGS; ++tag) {
+            if (!canSkip(last.tagged[tag], skipped.tagged[tag], next.tagged[tag])) return false;
+        }
+        return true;
+    }
+
+    void clear() { head_ = count_ = 0; }
+    size_t size() const { return count_; }
+    bool isEmpty() const { return count_ == 0; }
+    const KeyReport& lastDelivered() const { return delivered_.report; }
+    const Stats& stats() const { return stats_; }
+    void resetHighWater() { stats_.highWater = count_; }
+
+private:
+    Entry entries_[CAPACITY];
+    size_t head_ = 0;
+    size_t count_ = 0;
+    Entry delivered_ = {}; // The pipeline starts with nothing pressed
+    Stats stats_;
+
+    Entry& at(size_t i) { return entries_[(head_ + i) % CAPACITY]; }
+    void drop() {
+        head_ = (head_ + 1) % CAPACITY;
+        count_--;
+    }
+
+    static bool same(const KeyReport& a, const KeyReport& b) { return memcmp(&a, &b, sizeof(KeyReport)) == 0; }
+    static bool same(const Entry& a, const Entry& b) {
+        if (!same(a.report, b.report)) return false;
+        for (uint8_t tag = 0; tag < KeyboardMerger::TAGS; ++tag) {
+            if (!same(a.tagged[tag], b.tagged[tag])) return false;
+        }
+        return true;
+    }
+    static bool holds(const KeyReport& report, uint8_t key) {
+        for (uint8_t k : report.keys) {
+            if (k == key) return true;
+        }
+        return false;
+    }
+};
+
+#endif
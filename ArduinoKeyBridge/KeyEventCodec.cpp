@@ -0,0 +1,132 @@
+#include "KeyEventCodec.h"
+#include <string.h>
+
+namespace {
+    size_t putEvent(uint8_t op, uint8_t arg, uint8_t* out) {
+        uint16_t value = (uint16_t(arg) << 2) | op;
+        if (value < 0x80) {
+            out[0] = uint8_t(value);
+            return 1;
+        }
+        out[0] = uint8_t(value & 0x7F) | 0x80;
+        out[1] = uint8_t(value >> 7);
+        return 2;
+    }
+
+    bool hasKey(const KeyReport& report, uint8_t key) {
+        for (int i = 0; i < 6; ++i) {
+            if (report.keys[i] == key) return true;
+        }
+        return false;
+    }
+}
+
+namespace KeyEventCodec {
+
+void Encoder::reset() {
+    memset(&last_, 0, sizeof(last_));
+}
+
+size_t Encoder::encode(const KeyReport& next, uint8_t* out) {
+    size_t length = 0;
+
+    // Releases first so a freed slot is available for the presses below
+    for (int i = 0; i < 6; ++i) {
+        uint8_t key = last_.keys[i];
+        if (key != 0 && !hasKey(next, key)) length += putEvent(OP_KEY_UP, key, out + length);
+    }
+    if (next.modifiers != last_.modifiers) {
+        length += putEvent(OP_MODIFIERS, next.modifiers, out + length);
+    }
+    for (int i = 0; i < 6; ++i) {
+        uint8_t key = next.keys[i];
+        if (key != 0 && !hasKey(last_, key)) length += putEvent(OP_KEY_DOWN, key, out + length);
+    }
+
+    last_ = next;
+    return length;
+}
+
+size_t Encoder::encodeControl(uint8_t code, uint8_t* out, uint16_t value) {
+    size_t length = putEvent(OP_CONTROL, code, out);
+    if (code & BridgeProtocol::VALUE_FLAG) {
+        out[length++] = uint8_t(value & 0xFF);
+        out[length++] = uint8_t(value >> 8);
+    }
+    return length;
+}
+
+void Decoder::reset() {
+    memset(&state_, 0, sizeof(state_));
+    partial_ = 0;
+    shift_ = 0;
+    control_ = 0;
+    value_ = 0;
+    valueBytes_ = 0;
+}
+
+Decoder::Result Decoder::feed(uint8_t byte) {
+    if (valueBytes_ > 0) {
+        // Value bytes are raw, low byte first
+        if (valueBytes_ == 2) {
+            value_ = byte;
+        } else {
+            value_ |= uint16_t(byte) << 8;
+        }
+        return --valueBytes_ == 0 ? CONTROL : NEED_MORE;
+    }
+
+    partial_ |= uint16_t(byte & 0x7F) << shift_;
+    if (byte & 0x80) {
+        shift_ += 7;
+        // Events are at most two bytes; anything longer is corrupt, so resync
+        if (shift_ > 7) {
+            partial_ = 0;
+            shift_ = 0;
+        }
+        return NEED_MORE;
+    }
+
+    uint8_t op = partial_ & 0x03;
+    uint8_t arg = uint8_t(partial_ >> 2);
+    partial_ = 0;
+    shift_ = 0;
+
+    switch (op) {
+        case OP_KEY_DOWN:
+            if (arg == 0 || hasKey(state_, arg)) return REPORT;
+            for (int i = 0; i < 6; ++i) {
+                if (state_.keys[i] == 0) {
+                    state_.keys[i] = arg;
+                    return REPORT;
+                }
+            }
+            rolloverDrops_++;
+            return REPORT;
+
+        case OP_KEY_UP: {
+            // Keep keys packed at the front like MinimalKeyboard::onNewKeyReport
+            int out = 0;
+            for (int i = 0; i < 6; ++i) {
+                if (state_.keys[i] != arg) state_.keys[out++] = state_.keys[i];
+            }
+            while (out < 6) state_.keys[out++] = 0;
+            return REPORT;
+        }
+
+        case OP_MODIFIERS:
+            state_.modifiers = arg;
+            return REPORT;
+
+        default:
+            control_ = arg;
+            value_ = 0;
+            if (arg & BridgeProtocol::VALUE_FLAG) {
+                valueBytes_ = 2;
+                return NEED_MORE;
+            }
+            return CONTROL;
+    }
+}
+
+}
@@ -0,0 +1,84 @@
+#ifndef KEY_EVENT_CODEC_H
+#define KEY_EVENT_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "BridgeProtocol.h"
+
+// Delta encoding of key reports, negotiated per connection with the
+// EVENTS_ON control report (see BridgeProtocol.h).
+//
+// Instead of full 8-byte reports each side sends the changes since the last
+// report as events. Every event is one LEB128 varint holding (arg << 2) | op:
+//
+//   op 0  OP_KEY_DOWN   arg = HID keycode
+//   op 1  OP_KEY_UP     arg = HID keycode
+//   op 2  OP_MODIFIERS  arg = new modifier byte
+//   op 3  OP_CONTROL    arg = control code (same codes as 0x22 control reports)
+//
+// Control codes with BridgeProtocol::VALUE_FLAG set are followed by a 16-bit
+// little-endian value.
+//
+// Keycodes below 0x20 (all letters) fit in one byte, everything else in two,
+// so a typed letter costs 2 bytes (down + up) instead of 16. The decoder
+// rebuilds a full KeyReport after every key or modifier event. A report that
+// changes several keys at once is sent as consecutive events, releases
+// first, then the modifier change, then presses.
+namespace KeyEventCodec {
+    enum Op : uint8_t {
+        OP_KEY_DOWN = 0,
+        OP_KEY_UP = 1,
+        OP_MODIFIERS = 2,
+        OP_CONTROL = 3
+    };
+
+    // Worst case for one report: six releases, a modifier change and six presses
+    static constexpr size_t MAX_REPORT_BYTES = 26;
+    static constexpr size_t MAX_EVENT_BYTES = 4;
+
+    class Encoder {
+    public:
+        Encoder() { reset(); }
+        void reset();
+
+        // Writes the events that turn the previous report into next.
+        // Returns the number of bytes written (0 if nothing changed).
+        size_t encode(const KeyReport& next, uint8_t* out);
+        static size_t encodeControl(uint8_t code, uint8_t* out, uint16_t value = 0);
+
+        const KeyReport& last() const { return last_; }
+
+    private:
+        KeyReport last_;
+    };
+
+    class Decoder {
+    public:
+        enum Result : uint8_t {
+            NEED_MORE,  // Byte consumed, event not complete yet
+            REPORT,     // report() holds the updated key state
+            CONTROL     // control() holds a control code, value() its value if any
+        };
+
+        Decoder() { reset(); }
+        void reset();
+        Result feed(uint8_t byte);
+
+        const KeyReport& report() const { return state_; }
+        uint8_t control() const { return control_; }
+        uint16_t value() const { return value_; }
+        // Key-down events dropped because all six slots were in use
+        uint32_t rolloverDrops() const { return rolloverDrops_; }
+
+    private:
+        KeyReport state_;
+        uint16_t partial_ = 0;
+        uint8_t shift_ = 0;
+        uint8_t control_ = 0;
+        uint16_t value_ = 0;
+        uint8_t valueBytes_ = 0; // Value bytes still expected after a control event
+        uint32_t rolloverDrops_ = 0;
+    };
+}
+
+#endif
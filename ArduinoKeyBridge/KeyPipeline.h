@@ -0,0 +1,62 @@
+#ifndef KEY_PIPELINE_H
+#define KEY_PIPELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "KeyReport.h"
+
+// Compile-time chain of key report processing stages.
+//
+// A stage is any class with
+//
+//   KeyPipeline::Result process(KeyReport& report);
+//
+// It may modify the report and return PASS to hand it to the next stage, or
+// return CONSUMED to stop processing. Pipeline<A, B, C> holds the stages by
+// value and calls them in order; every call is resolved at compile time, so
+// there are no virtual calls or heap allocations on the hot path and the
+// compiler can inline the whole chain.
+namespace KeyPipeline {
+    enum Result : uint8_t {
+        PASS,     // Continue with the next stage
+        CONSUMED  // Report handled, later stages don't see it
+    };
+
+    template <typename... Stages>
+    class Pipeline;
+
+    template <>
+    class Pipeline<> {
+    public:
+        static constexpr size_t SIZE = 0;
+        Result process(KeyReport&) { return PASS; }
+    };
+
+    template <typename First, typename... Rest>
+    class Pipeline<First, Rest...> {
+    public:
+        static constexpr size_t SIZE = 1 + sizeof...(Rest);
+
+        // Returns CONSUMED if any stage consumed the report
+        Result process(KeyReport& report) {
+            if (first_.process(report) == CONSUMED) return CONSUMED;
+            return rest_.process(report);
+        }
+
+        // Access to a stage by index, e.g. for configuration or counters
+        template <size_t I>
+        auto& stage() {
+            if constexpr (I == 0) {
+                return first_;
+            } else {
+                return rest_.template stage<I - 1>();
+            }
+        }
+
+    private:
+        First first_;
+        Pipeline<Rest...> rest_;
+    };
+}
+
+#endif
@@ -0,0 +1,142 @@
+#include "KeyRemap.h"
+#include "Crc16.h"
+#include <string.h>
+
+namespace {
+    bool hasKey(const uint8_t* keys, uint8_t key) {
+        for (int i = 0; i < 6; ++i) {
+            if (keys[i] == key) return true;
+        }
+        return false;
+    }
+}
+
+void KeyRemap::clear() {
+    layerCount_ = 0;
+    active_ = 0;
+    toggled_ = 0;
+    memset(previousKeys_, 0, sizeof(previousKeys_));
+    memset(activationKeys_, 0, sizeof(activationKeys_));
+    rebuild();
+}
+
+bool KeyRemap::validate(const Reader& blob, size_t length) {
+    if (length < HEADER_SIZE + 2) return false;
+    if (blob.read(0) != 'K' || blob.read(1) != 'R' || blob.read(2) != VERSION) return false;
+    uint8_t count = blob.read(3);
+    if (count == 0 || count > MAX_LAYERS || length != blobSize(count)) return false;
+
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length - 2; ++i) {
+        uint8_t byte = blob.read(i);
+        crc = crc16Update(crc, &byte, 1);
+    }
+    uint16_t stored = uint16_t(blob.read(length - 2)) | (uint16_t(blob.read(length - 1)) << 8);
+    if (crc != stored) return false;
+
+    for (uint8_t i = 0; i < count; ++i) {
+        size_t layer = HEADER_SIZE + i * LAYER_SIZE;
+        uint8_t type = blob.read(layer);
+        if (i == 0) {
+            if (type != BASE) return false;
+        } else if ((type != MOMENTARY && type != TOGGLE) || blob.read(layer + 1) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool KeyRemap::load(const Reader& blob, size_t length) {
+    if (!validate(blob, length)) return false;
+
+    layerCount_ = blob.read(3);
+    memset(activationKeys_, 0, sizeof(activationKeys_));
+    for (uint8_t i = 0; i < layerCount_; ++i) {
+        size_t source = HEADER_SIZE + i * LAYER_SIZE;
+        Layer& layer = layers_[i];
+        layer.type = blob.read(source);
+        layer.activationKey = blob.read(source + 1);
+        for (size_t j = 0; j < sizeof(layer.modifierMap); ++j) layer.modifierMap[j] = blob.read(source + 2 + j);
+        for (size_t j = 0; j < sizeof(layer.keyMap); ++j) layer.keyMap[j] = blob.read(source + 10 + j);
+        if (i > 0) activationKeys_[layer.activationKey >> 3] |= 1 << (layer.activationKey & 7);
+    }
+    toggled_ = 0;
+    memset(previousKeys_, 0, sizeof(previousKeys_));
+    rebuild();
+    return true;
+}
+
+void KeyRemap::rebuild() {
+    active_ = layerCount_ > 0 ? uint8_t(1 | toggled_) : 0;
+    for (uint8_t i = 1; i < layerCount_; ++i) {
+        if (layers_[i].type == MOMENTARY && hasKey(previousKeys_, layers_[i].activationKey)) active_ |= 1 << i;
+    }
+
+    // Topmost active layer with a non-transparent entry wins
+    keyTable_[0] = 0;
+    for (int key = 1; key < 256; ++key) {
+        uint8_t value = uint8_t(key);
+        for (int i = int(layerCount_) - 1; i >= 0; --i) {
+            if (!(active_ & (1 << i))) continue;
+            uint8_t entry = layers_[i].keyMap[key];
+            if (entry == TRANSPARENT) continue;
+            value = (entry == BLOCKED) ? 0 : entry;
+            break;
+        }
+        keyTable_[key] = value;
+    }
+
+    uint8_t bitMasks[8];
+    for (int bit = 0; bit < 8; ++bit) {
+        bitMasks[bit] = uint8_t(1 << bit);
+        for (int i = int(layerCount_) - 1; i >= 0; --i) {
+            if (!(active_ & (1 << i))) continue;
+            uint8_t entry = layers_[i].modifierMap[bit];
+            if (entry == MOD_TRANSPARENT) continue;
+            bitMasks[bit] = entry;
+            break;
+        }
+    }
+    // Each entry is the entry without its lowest bit plus that bit's mask
+    modifierTable_[0] = 0;
+    for (int modifiers = 1; modifiers < 256; ++modifiers) {
+        int lowest = __builtin_ctz(modifiers);
+        modifierTable_[modifiers] = modifierTable_[modifiers & (modifiers - 1)] | bitMasks[lowest];
+    }
+}
+
+void KeyRemap::apply(KeyReport& report) {
+    if (layerCount_ == 0) return;
+
+    // Layer keys: momentary follow the key, toggles flip on a new press
+    uint8_t toggled = toggled_;
+    uint8_t momentary = 0;
+    for (uint8_t i = 1; i < layerCount_; ++i) {
+        uint8_t key = layers_[i].activationKey;
+        if (!hasKey(report.keys, key)) continue;
+        if (layers_[i].type == MOMENTARY) momentary |= 1 << i;
+        else if (!hasKey(previousKeys_, key)) toggled ^= 1 << i;
+    }
+    memcpy(previousKeys_, report.keys, sizeof(previousKeys_));
+    if (uint8_t(1 | toggled | momentary) != active_) {
+        toggled_ = toggled;
+        rebuild();
+    }
+
+    uint8_t modifiers = modifierTable_[report.modifiers];
+    uint8_t keys[6] = {0, 0, 0, 0, 0, 0};
+    int count = 0;
+    for (int i = 0; i < 6; ++i) {
+        uint8_t key = report.keys[i];
+        if (key == 0 || isActivationKey(key)) continue;
+        uint8_t mapped = keyTable_[key];
+        if (mapped >= 0xE0 && mapped <= 0xE7) {
+            // Key remapped to a modifier
+            modifiers |= 1 << (mapped - 0xE0);
+        } else if (mapped != 0) {
+            keys[count++] = mapped;
+        }
+    }
+    report.modifiers = modifiers;
+    memcpy(report.keys, keys, sizeof(keys));
+}
@@ -0,0 +1,105 @@
+#ifndef KEY_REMAP_H
+#define KEY_REMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "KeyReport.h"
+
+// Layered key remapping with 256-entry lookup tables.
+//
+// Up to MAX_LAYERS layers, each with a keycode table and a per-bit modifier
+// table. Layer 0 is always active; the others are momentary (active while
+// their activation key is held) or toggle (flipped each time it is pressed).
+// Activation keys are swallowed. Higher layers win; a TRANSPARENT entry
+// falls through to the layer below and finally to the unmapped key.
+//
+// Whenever the set of active layers changes the layers are flattened into
+// one key table and one modifier table, so remapping a report costs a
+// modifier lookup plus one table load per key. Keys can be remapped to
+// modifiers (0xE0-0xE7), e.g. Caps Lock to Left Control.
+//
+// Tables are loaded from one binary blob (little endian), read through a
+// Reader so RemapStore can load it straight from data flash:
+//
+//   0   'K' 'R' version layerCount
+//   4   layerCount x LAYER_SIZE:
+//         type, activation key, modifier map[8], key map[256]
+//   end CRC-16/CCITT-FALSE of everything before it
+class KeyRemap {
+public:
+    static constexpr uint8_t MAX_LAYERS = 4;
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 4;
+    static constexpr size_t LAYER_SIZE = 2 + 8 + 256;
+    static constexpr size_t MAX_BLOB_SIZE = HEADER_SIZE + MAX_LAYERS * LAYER_SIZE + 2;
+
+    enum LayerType : uint8_t {
+        BASE = 0,       // Always active (layer 0 only)
+        MOMENTARY = 1,  // Active while the activation key is held
+        TOGGLE = 2      // Flipped by each press of the activation key
+    };
+
+    // Key map values
+    static constexpr uint8_t TRANSPARENT = 0x00; // Use the layer below
+    static constexpr uint8_t BLOCKED = 0x01;     // Drop the key
+    // Modifier map value that uses the layer below; anything else is the new modifier mask
+    static constexpr uint8_t MOD_TRANSPARENT = 0xFF;
+
+    // Byte source for a blob: data flash on the board, memory on the host
+    class Reader {
+    public:
+        virtual ~Reader() = default;
+        virtual uint8_t read(size_t offset) const = 0;
+    };
+
+    class MemoryReader : public Reader {
+    public:
+        explicit MemoryReader(const uint8_t* data) : data_(data) {}
+        uint8_t read(size_t offset) const override { return data_[offset]; }
+    private:
+        const uint8_t* data_;
+    };
+
+    KeyRemap() { clear(); }
+
+    // Back to pass-through with no layers
+    void clear();
+
+    // Validates and loads a blob. On failure the current tables stay in place.
+    bool load(const Reader& blob, size_t length);
+    bool load(const uint8_t* blob, size_t length) { return load(MemoryReader(blob), length); }
+    static bool validate(const Reader& blob, size_t length);
+    static bool validate(const uint8_t* blob, size_t length) { return validate(MemoryReader(blob), length); }
+    static size_t blobSize(uint8_t layerCount) { return HEADER_SIZE + layerCount * LAYER_SIZE + 2; }
+
+    // Remaps report in place and updates the layer state from its keys
+    void apply(KeyReport& report);
+
+    uint8_t layerCount() const { return layerCount_; }
+    uint8_t activeLayers() const { return active_; } // Bit i set if layer i is active
+    bool isEnabled() const { return layerCount_ > 0; }
+
+private:
+    struct Layer {
+        uint8_t type;
+        uint8_t activationKey;
+        uint8_t modifierMap[8];
+        uint8_t keyMap[256];
+    };
+
+    Layer layers_[MAX_LAYERS];
+    uint8_t layerCount_;
+    uint8_t active_;
+    uint8_t toggled_;
+    uint8_t previousKeys_[6];
+    uint8_t activationKeys_[32]; // Bitmap of keys that switch layers
+
+    // Flattened tables for the active layers
+    uint8_t keyTable_[256];
+    uint8_t modifierTable_[256];
+
+    void rebuild();
+    bool isActivationKey(uint8_t key) const { return activationKeys_[key >> 3] & (1 << (key & 7)); }
+};
+
+#endif
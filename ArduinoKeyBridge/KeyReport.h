@@ -0,0 +1,13 @@
+#ifndef KEY_REPORT_H
+#define KEY_REPORT_H
+
+#include <stdint.h>
+
+// Key report structure (boot keyboard layout, also the 8-byte TCP frame)
+typedef struct {
+    uint8_t modifiers;
+    uint8_t reserved;
+    uint8_t keys[6];
+} KeyReport;
+
+#endif
@@ -0,0 +1,161 @@
+#include "KeyStages.h"
+#include "ArduinoKeyBridgeLogger.h"
+#include "BridgeClock.h"
+#include "ConfigStore.h"
+
+KeyPipeline::Result DeviceRouteStage::process(KeyReport& report) {
+    DeviceRouter::Split split = DeviceRouter::route(keyboard_.previous(), keyboard_.current(),
+                                                    ConfigStore::config().macroPadRoute);
+    if (split.toServer) tcp_.forwardKeyReport(split.server);
+    if (!split.toHost) return KeyPipeline::CONSUMED;
+    report = split.host;
+    return KeyPipeline::PASS;
+}
+
+namespace {
+    typedef ChordStage::Matcher::Step Step;
+
+    struct Binding {
+        const Step* steps;
+        uint8_t count;
+        uint8_t action;
+        bool anyModifiers; // The mode keys work with modifiers held, as they always did
+    };
+
+    const Step F19[] = {{0x00, 0x6E}};
+    const Step BOTH_SHIFTS[] = {{0x22, 0x00}};
+    const Step F18[] = {{0x00, 0x6D}};
+    const Step F17[] = {{0x00, 0x6C}};
+    const Step F13_R[] = {{0x00, 0x68}, {0x00, 0x15}};
+    constexpr uint8_t F14 = 0x69;
+    constexpr uint8_t KEY_1 = 0x1E; // 1-9 then 0 are consecutive
+
+    const Binding BINDINGS[] = {
+        {F19, 1, ChordStage::TOGGLE_CHARTER, true},
+        {BOTH_SHIFTS, 1, ChordStage::TOGGLE_COMMAND, false},
+        {F18, 1, ChordStage::CHARTER_DUMP, true},
+        {F17, 1, ChordStage::CHARTER_CLEAR, true},
+        {F13_R, 2, ChordStage::TOGGLE_ROLLOVER, false},
+    };
+}
+
+ChordStage::ChordStage() {
+    matcher_.setTimeout(SEQUENCE_TIMEOUT_MS);
+    for (const Binding& binding : BINDINGS) {
+        matcher_.addBinding(binding.steps, binding.count, binding.action, binding.anyModifiers);
+    }
+    for (uint8_t i = 0; i < SNIPPET_KEYS; ++i) {
+        const Step steps[] = {{0x00, F14}, {0x00, uint8_t(KEY_1 + i)}};
+        matcher_.addBinding(steps, 2, TYPE_SNIPPET + i);
+    }
+}
+
+KeyPipeline::Result ChordStage::process(KeyReport& report) {
+    uint8_t action = matcher_.feed(report, BridgeClock::millis());
+    if (action != Matcher::NO_ACTION) {
+        bool toHost = hostGetsReports();
+        if (runAction(action)) {
+            matcher_.swallow();
+            if (toHost && !hostGetsReports()) {
+                // The stages after this one stop sending the host anything
+                KeyReport released = {0, 0, {0, 0, 0, 0, 0, 0}};
+                keyboard_.sendReport(&released);
+            }
+        }
+    }
+    matcher_.strip(report);
+    return KeyPipeline::PASS;
+}
+
+bool ChordStage::hostGetsReports() {
+    return !tcp_.is_charter_mode() && (!tcp_.is_command_mode() || tcp_.is_mirror_mode());
+}
+
+void ChordStage::poll() {
+    uint8_t action = matcher_.poll(BridgeClock::millis());
+    if (action != Matcher::NO_ACTION) runAction(action);
+}
+
+bool ChordStage::runAction(uint8_t action) {
+    switch (action) {
+        case TOGGLE_CHARTER:
+            // Manual charter mode toggle (F19)
+            tcp_.toggleCharterMode();
+            ArduinoKeyBridgeLogger::getInstance().debug("Loop", "Manual charter mode toggled - Now " + String(tcp_.is_charter_mode() ? "ON" : "OFF"));
+            return true;
+
+        case TOGGLE_COMMAND:
+            // In charter mode the chord types like any other key
+            if (tcp_.is_charter_mode()) return false;
+            toggleCommandMode();
+            return true;
+
+        case CHARTER_DUMP:
+            if (!tcp_.is_charter_mode()) return false;
+            tcp_.dumpCharterBuffer();
+            return true;
+
+        case CHARTER_CLEAR:
+            if (!tcp_.is_charter_mode()) return false;
+            tcp_.clearCharterBuffer();
+            return true;
+
+        case TOGGLE_ROLLOVER:
+            tcp_.set_rollover_typing(!tcp_.is_rollover_typing());
+            return true;
+
+        default:
+            // Typed from flash, works without a server
+            if (action >= TYPE_SNIPPET && action < TYPE_SNIPPET + SNIPPET_KEYS) {
+                return tcp_.typeSnippet(action - TYPE_SNIPPET + 1);
+            }
+            return false;
+    }
+}
+
+void ChordStage::toggleCommandMode() {
+    ArduinoKeyBridgeLogger::getInstance().debug("Loop", "Command mode detected");
+    tcp_.set_command_mode(!tcp_.is_command_mode());
+    pixels_.setColor(tcp_.is_command_mode() ? NeoPixelColors::BLUE : NeoPixelColors::WHITE);
+    ArduinoKeyBridgeLogger::getInstance().debug("Loop", "Command mode toggled");
+    if (tcp_.is_command_mode()) {
+        ArduinoKeyBridgeLogger::getInstance().debug("Loop", "Command mode ON");
+        tcp_.sendKeyReport(BridgeProtocol::makeControlReport(BridgeProtocol::Notify::COMMAND_ON));
+        pixels_.setBrightness(ConfigStore::config().ledModeBrightness);
+    } else {
+        ArduinoKeyBridgeLogger::getInstance().debug("Loop", "Command mode OFF");
+        tcp_.sendKeyReport(BridgeProtocol::makeControlReport(BridgeProtocol::Notify::COMMAND_OFF));
+        pixels_.setBrightness(ConfigStore::config().ledIdleBrightness);
+    }
+}
+
+KeyPipeline::Result CharterStage::process(KeyReport& report) {
+    if (!tcp_.is_charter_mode()) return KeyPipeline::PASS;
+    // Handle charter mode key reports
+    ArduinoKeyBridgeLogger::getInstance().debug("Loop", "Charter mode is on, handling key report");
+    tcp_.handleCharterKeyReport(report);
+    return KeyPipeline::CONSUMED;
+}
+
+KeyPipeline::Result RemapStage::process(KeyReport& report) {
+    remap_.apply(report);
+    return KeyPipeline::PASS;
+}
+
+KeyPipeline::Result ServerForwardStage::process(KeyReport& report) {
+    if (!tcp_.is_command_mode()) return KeyPipeline::PASS;
+    // Local first: the host gets the report now, the server when the link allows
+    if (tcp_.is_mirror_mode()) {
+        tcp_.mirrorKeyReport(report);
+        return KeyPipeline::PASS;
+    }
+    // In command mode: send all other key reports to the server
+    tcp_.forwardKeyReport(report);
+    ArduinoKeyBridgeLogger::getInstance().debug("Loop", "Sending key report to TCP connection");
+    return KeyPipeline::CONSUMED;
+}
+
+KeyPipeline::Result HostStage::process(KeyReport& report) {
+    keyboard_.sendReport(&report, tracer_.passThrough());
+    return KeyPipeline::CONSUMED;
+}
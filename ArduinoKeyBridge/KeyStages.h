@@ -0,0 +1,103 @@
+#ifndef KEY_STAGES_H
+#define KEY_STAGES_H
+
+#include "KeyPipeline.h"
+#include "ChordMatcher.h"
+#include "DeviceRouter.h"
+#include "MinimalKeyboard.h"
+#include "TCPConnection.h"
+#include "ArduinoKeyBridgeNeoPixel.h"
+#include "RemapStore.h"
+#include "LatencyTracer.h"
+
+// Stages of the KeyPipeline that handle_new_key_report runs every report
+// from the USB keyboard through. Each stage looks up the singletons it needs
+// once, when the pipeline is constructed.
+
+// Sends the keys of MACRO_PAD keyboards to the server when
+// BridgeConfig::macroPadRoute is ROUTE_SERVER, and takes them out of what the
+// main keyboard sends on (see DeviceRouter.h). With ROUTE_HOST, or a single
+// keyboard, reports pass untouched.
+class DeviceRouteStage {
+public:
+    KeyPipeline::Result process(KeyReport& report);
+private:
+    MinimalKeyboard& keyboard_ = MinimalKeyboard::getInstance();
+    TCPConnection& tcp_ = TCPConnection::getInstance();
+};
+
+// Recognises mode switch chords and sequences anywhere in the key event
+// stream (see ChordMatcher.h) and runs their actions. Comes before the
+// stages that consume reports so the matcher sees every one. The key that
+// completes a binding is kept out of the reports until it is released,
+// everything else passes on undelayed. An action that stops reports from
+// reaching the host (charter mode, command mode without mirroring) first
+// releases whatever the host holds.
+class ChordStage {
+public:
+    typedef ChordMatcher<32, 64> Matcher;
+
+    enum Action : uint8_t {
+        TOGGLE_CHARTER = 1,  // F19
+        TOGGLE_COMMAND,      // Both shift keys (modifiers 0x22)
+        CHARTER_DUMP,        // F18, charter mode only
+        CHARTER_CLEAR,       // F17, charter mode only
+        TOGGLE_ROLLOVER,     // F13 then R
+        TYPE_SNIPPET         // F14 then 1-9, 0: snippets 1-10 (TYPE_SNIPPET + id - 1)
+    };
+    static constexpr uint8_t SNIPPET_KEYS = 10;
+    static constexpr unsigned long SEQUENCE_TIMEOUT_MS = 1000;
+
+    ChordStage();
+    KeyPipeline::Result process(KeyReport& report);
+    // Fires bindings that complete by timing out; call from the USB task
+    void poll();
+
+private:
+    Matcher matcher_;
+    TCPConnection& tcp_ = TCPConnection::getInstance();
+    MinimalKeyboard& keyboard_ = MinimalKeyboard::getInstance();
+    ArduinoKeyBridgeNeoPixel& pixels_ = ArduinoKeyBridgeNeoPixel::getInstance();
+
+    bool hostGetsReports();
+
+    // Returns false if the action doesn't apply right now, the report then passes on
+    bool runAction(uint8_t action);
+    void toggleCommandMode();
+};
+
+// In charter mode every key types from the charter buffer
+class CharterStage {
+public:
+    KeyPipeline::Result process(KeyReport& report);
+private:
+    TCPConnection& tcp_ = TCPConnection::getInstance();
+};
+
+// Applies the KeyRemap layers, so the server and the host both see remapped keys
+class RemapStage {
+public:
+    KeyPipeline::Result process(KeyReport& report);
+private:
+    KeyRemap& remap_ = RemapStore::getInstance().remap();
+};
+
+// In command mode reports go to the server instead of the host, or with
+// mirroring on to the host first and a copy to the server
+class ServerForwardStage {
+public:
+    KeyPipeline::Result process(KeyReport& report);
+private:
+    TCPConnection& tcp_ = TCPConnection::getInstance();
+};
+
+// Last stage: pass the report through to the host computer
+class HostStage {
+public:
+    KeyPipeline::Result process(KeyReport& report);
+private:
+    MinimalKeyboard& keyboard_ = MinimalKeyboard::getInstance();
+    LatencyTracer& tracer_ = LatencyTracer::getInstance();
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "KeyboardMerger.h"
+
+void KeyboardMerger::reset() {
+    for (uint8_t d = 0; d < MAX_DEVICES; ++d) {
+        Tag tag = devices_[d].tag;
+        devices_[d] = Device();
+        devices_[d].tag = tag;
+    }
+    heldCount_ = 0;
+    merged_ = KeyReport{0, 0, {0, 0, 0, 0, 0, 0}};
+}
+
+void KeyboardMerger::setTag(uint8_t device, Tag tag) {
+    if (device < MAX_DEVICES) devices_[device].tag = tag;
+}
+
+bool KeyboardMerger::isHeld(uint8_t device, uint8_t key) const {
+    return device < MAX_DEVICES && test(devices_[device].keys, key);
+}
+
+bool KeyboardMerger::update(uint8_t device, const uint8_t* buf, uint8_t len) {
+    if (device >= MAX_DEVICES || len < 8) return false;
+    Device& dev = devices_[device];
+    reports_++;
+    dev.modifiers = buf[0];
+
+    // Phantom state: the keyboard can't tell which keys are down, keep the old ones
+    for (uint8_t i = 2; i < 8; ++i) {
+        if (buf[i] == ERROR_ROLLOVER) {
+            rollovers_++;
+            return remerge();
+        }
+    }
+
+    uint32_t keys[8] = {};
+    for (uint8_t i = 2; i < 8; ++i) {
+        if (buf[i] != 0) set(keys, buf[i]);
+    }
+    // Releases first so a full press order has room for the new keys
+    for (uint8_t w = 0; w < 8; ++w) {
+        uint32_t released = dev.keys[w] & ~keys[w];
+        while (released) {
+            uint8_t bit = uint8_t(__builtin_ctzl(released));
+            released &= released - 1;
+            release(device, uint8_t(w * 32 + bit));
+        }
+    }
+    // Presses in the order the device reports them
+    for (uint8_t i = 2; i < 8; ++i) {
+        uint8_t key = buf[i];
+        if (key != 0 && !test(dev.keys, key)) {
+            set(dev.keys, key);
+            press(device, key);
+        }
+    }
+    return remerge();
+}
+
+bool KeyboardMerger::releaseDevice(uint8_t device) {
+    if (device >= MAX_DEVICES) return false;
+    Device& dev = devices_[device];
+    for (uint8_t w = 0; w < 8; ++w) {
+        uint32_t held = dev.keys[w];
+        while (held) {
+            uint8_t bit = uint8_t(__builtin_ctzl(held));
+            held &= held - 1;
+            release(device, uint8_t(w * 32 + bit));
+        }
+    }
+    dev.modifiers = 0;
+    return remerge();
+}
+
+void KeyboardMerger::press(uint8_t device, uint8_t key) {
+    if (heldCount_ >= MAX_HELD) {
+        dropped_++;
+        return;
+    }
+    held_[heldCount_++] = Press{device, key};
+}
+
+void KeyboardMerger::release(uint8_t device, uint8_t key) {
+    Device& dev = devices_[device];
+    dev.keys[key >> 5] &= ~(1UL << (key & 31));
+
+    size_t index = heldCount_;
+    for (size_t i = 0; i < heldCount_; ++i) {
+        if (held_[i].device == device && held_[i].key == key) {
+            index = i;
+            break;
+        }
+    }
+    if (index == heldCount_) return; // Dropped press
+    // Another device still holding the key takes over this entry, so the key
+    // keeps its place in the report
+    size_t from = index;
+    for (size_t i = index + 1; i < heldCount_; ++i) {
+        if (held_[i].key == key) {
+            held_[index].device = held_[i].device;
+            from = i;
+            break;
+        }
+    }
+    for (size_t i = from + 1; i < heldCount_; ++i) held_[i - 1] = held_[i];
+    heldCount_--;
+}
+
+KeyReport KeyboardMerger::report(uint8_t mask) const {
+    KeyReport out{0, 0, {0, 0, 0, 0, 0, 0}};
+    for (uint8_t d = 0; d < MAX_DEVICES; ++d) {
+        if (mask & tagMask(devices_[d].tag)) out.modifiers |= devices_[d].modifiers;
+    }
+    size_t slots = 0;
+    for (size_t i = 0; i < heldCount_ && slots < 6; ++i) {
+        const Press& p = held_[i];
+        if (!(mask & tagMask(devices_[p.device].tag))) continue;
+        bool duplicate = false;
+        for (size_t s = 0; s < slots; ++s) duplicate |= out.keys[s] == p.key;
+        if (!duplicate) out.keys[slots++] = p.key;
+    }
+    return out;
+}
+
+bool KeyboardMerger::remerge() {
+    KeyReport next = report(ALL_TAGS);
+    bool changed = next.modifiers != merged_.modifiers;
+    for (size_t i = 0; i < 6; ++i) changed |= next.keys[i] != merged_.keys[i];
+    merged_ = next;
+    return changed;
+}
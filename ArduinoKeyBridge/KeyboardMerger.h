@@ -0,0 +1,97 @@
+#ifndef KEYBOARD_MERGER_H
+#define KEYBOARD_MERGER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "KeyReport.h"
+
+// Merges the boot reports of several keyboards (behind a USB hub) into one
+// report for the host.
+//
+// Each device keeps its own key state as a 256-bit set, so a report from one
+// keyboard only changes that keyboard's keys. A key stays in the merged
+// report until every device holding it has released it, and the modifiers
+// are the OR of all devices.
+//
+// Rollover arbitration: held keys are kept in press order, and the merged
+// report takes the first six distinct ones. A key that is in the report
+// stays there until it is released; keys pressed while all six slots are
+// taken wait and move in as slots free up, so the host never sees a held key
+// released early. A device reporting ErrorRollOver (0x01 in its key slots)
+// keeps its previous keys.
+//
+// Every device has a tag (a bit index, e.g. KEYBOARD or MACRO_PAD) so
+// routing can tell devices apart: report(mask) merges only devices whose
+// tag is in mask.
+class KeyboardMerger {
+public:
+    static constexpr uint8_t MAX_DEVICES = 4;
+    // Presses tracked across all devices, in press order
+    static constexpr size_t MAX_HELD = 32;
+    static constexpr uint8_t ERROR_ROLLOVER = 0x01;
+
+    enum Tag : uint8_t {
+        KEYBOARD = 0,
+        MACRO_PAD = 1
+    };
+    static constexpr uint8_t TAGS = 2;
+    static constexpr uint8_t ALL_TAGS = 0xFF;
+    static constexpr uint8_t tagMask(Tag tag) { return uint8_t(1u << tag); }
+
+    KeyboardMerger() { reset(); }
+    void reset();
+
+    void setTag(uint8_t device, Tag tag);
+    Tag tag(uint8_t device) const { return devices_[device].tag; }
+
+    // Applies a boot report (modifiers, reserved, six keys) from device.
+    // Returns true if the merged report for all devices changed.
+    bool update(uint8_t device, const uint8_t* buf, uint8_t len);
+    // Releases everything device holds, e.g. when it is unplugged.
+    // Returns true if the merged report changed.
+    bool releaseDevice(uint8_t device);
+
+    // Merged report of all devices, as of the last update
+    const KeyReport& report() const { return merged_; }
+    // Merged report of the devices whose tag is in mask
+    KeyReport report(uint8_t mask) const;
+
+    bool isHeld(uint8_t device, uint8_t key) const;
+    size_t heldCount() const { return heldCount_; }
+
+    // Reports applied, ErrorRollOver reports ignored, and presses that did
+    // not fit in the press order (they still count as held for releases)
+    uint32_t reports() const { return reports_; }
+    uint32_t rollovers() const { return rollovers_; }
+    uint32_t dropped() const { return dropped_; }
+
+private:
+    struct Device {
+        Tag tag = KEYBOARD;
+        uint8_t modifiers = 0;
+        uint32_t keys[8] = {};
+    };
+
+    struct Press {
+        uint8_t device;
+        uint8_t key;
+    };
+
+    Device devices_[MAX_DEVICES];
+    Press held_[MAX_HELD];
+    size_t heldCount_ = 0;
+    KeyReport merged_;
+    uint32_t reports_ = 0;
+    uint32_t rollovers_ = 0;
+    uint32_t dropped_ = 0;
+
+    static bool test(const uint32_t* keys, uint8_t key) { return keys[key >> 5] & (1UL << (key & 31)); }
+    static void set(uint32_t* keys, uint8_t key) { keys[key >> 5] |= 1UL << (key & 31); }
+
+    void press(uint8_t device, uint8_t key);
+    void release(uint8_t device, uint8_t key);
+    // Rebuilds merged_, returns true if it changed
+    bool remerge();
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include "LatencyTracer.h"
+
+LatencyTracer& LatencyTracer::getInstance() {
+    static LatencyTracer instance;
+    return instance;
+}
+
+void LatencyTracer::setSampling(uint16_t every) {
+    every_ = every;
+    counter_ = 0;
+    arrivalTraced_ = false;
+}
+
+void LatencyTracer::arrival(unsigned long nowUs) {
+    arrivalTraced_ = false;
+    if (every_ == 0) return;
+    if (++counter_ < every_) return;
+    counter_ = 0;
+    arrivalTraced_ = true;
+    arrivalUs_ = nowUs;
+}
+
+uint8_t LatencyTracer::passThrough() {
+    if (!arrivalTraced_) return 0;
+    arrivalTraced_ = false;
+    return start(PASS_THROUGH, 0, arrivalUs_);
+}
+
+bool LatencyTracer::forward(uint16_t& id) {
+    if (!arrivalTraced_) return false;
+    arrivalTraced_ = false;
+    // Ids the device hands out are never 0
+    if (nextId_ == 0) nextId_ = 1;
+    if (!start(ROUND_TRIP, nextId_, arrivalUs_)) return false;
+    id = nextId_++;
+    return true;
+}
+
+void LatencyTracer::forwarded(uint16_t id, unsigned long nowUs) {
+    for (Trace& trace : traces_) {
+        if (trace.active && trace.path == ROUND_TRIP && trace.id == id) trace.forwarded = nowUs;
+    }
+}
+
+void LatencyTracer::serverTrace(uint16_t id, unsigned long nowUs) {
+    uint16_t hold = hold_;
+    hold_ = 0;
+    serverTag_ = 0;
+    // The answer to a forwarded report still waiting for one
+    for (size_t i = 0; i < MAX_TRACES; ++i) {
+        Trace& trace = traces_[i];
+        if (trace.active && trace.path == ROUND_TRIP && trace.id == id && trace.echoed == 0) {
+            trace.echoed = nowUs ? nowUs : 1;
+            trace.hold = hold;
+            serverTag_ = uint8_t(i + 1);
+            return;
+        }
+    }
+    serverTag_ = start(INJECTED, id, nowUs);
+}
+
+uint8_t LatencyTracer::takeServerTag() {
+    uint8_t tag = serverTag_;
+    serverTag_ = 0;
+    return tag;
+}
+
+void LatencyTracer::queued(uint8_t tag, unsigned long nowUs) {
+    Trace* trace = find(tag);
+    if (trace) trace->queued = nowUs;
+}
+
+void LatencyTracer::skipped(uint8_t tag) {
+    // The host already had that state, nothing to measure
+    Trace* trace = find(tag);
+    if (trace) trace->active = false;
+}
+
+void LatencyTracer::delivered(uint8_t tag, unsigned long nowUs) {
+    Trace* trace = find(tag);
+    if (!trace) return;
+    trace->active = false;
+    completed_++;
+    record(trace->path, trace->start, nowUs);
+    record(PATH_COUNT + HID_QUEUE, trace->queued, nowUs);
+    switch (trace->path) {
+        case PASS_THROUGH:
+            record(PATH_COUNT + PIPELINE, trace->start, trace->queued);
+            return;
+        case ROUND_TRIP: {
+            record(PATH_COUNT + PIPELINE, trace->start, trace->forwarded);
+            unsigned long network = trace->echoed - trace->forwarded;
+            record(PATH_COUNT + NETWORK, 0, network > trace->hold ? network - trace->hold : 0);
+            record(PATH_COUNT + SERVER, 0, trace->hold);
+            record(PATH_COUNT + RECEIVE, trace->echoed, trace->queued);
+            break;
+        }
+        case INJECTED:
+            record(PATH_COUNT + RECEIVE, trace->start, trace->queued);
+            break;
+    }
+    // The server times its side by this echo
+    if (doneCount_ == DONE_QUEUE) {
+        doneHead_ = (doneHead_ + 1) % DONE_QUEUE;
+        doneCount_--;
+    }
+    done_[(doneHead_ + doneCount_) % DONE_QUEUE] = trace->id;
+    doneCount_++;
+}
+
+void LatencyTracer::expire(unsigned long nowUs) {
+    for (Trace& trace : traces_) {
+        if (trace.active && nowUs - trace.start >= TIMEOUT_US) {
+            trace.active = false;
+            lost_++;
+        }
+    }
+}
+
+bool LatencyTracer::takeDone(uint16_t& id) {
+    if (doneCount_ == 0) return false;
+    id = done_[doneHead_];
+    doneHead_ = (doneHead_ + 1) % DONE_QUEUE;
+    doneCount_--;
+    return true;
+}
+
+void LatencyTracer::clear() {
+    for (LatencyHistogram& histogram : histograms_) histogram.clear();
+    lost_ = 0;
+    completed_ = 0;
+}
+
+uint8_t LatencyTracer::start(Path path, uint16_t id, unsigned long nowUs) {
+    for (size_t i = 0; i < MAX_TRACES; ++i) {
+        Trace& trace = traces_[i];
+        if (trace.active) continue;
+        trace = Trace{true, uint8_t(path), id, 0, nowUs, 0, 0, 0};
+        return uint8_t(i + 1);
+    }
+    return 0;
+}
+
+LatencyTracer::Trace* LatencyTracer::find(uint8_t tag) {
+    if (tag == 0 || tag > MAX_TRACES || !traces_[tag - 1].active) return nullptr;
+    return &traces_[tag - 1];
+}
+
+void LatencyTracer::record(size_t histogram, unsigned long from, unsigned long to) {
+    histograms_[histogram].record(uint32_t(to - from));
+}
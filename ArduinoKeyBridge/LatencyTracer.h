@@ -0,0 +1,179 @@
+#ifndef LATENCY_TRACER_H
+#define LATENCY_TRACER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Latency histogram with four linear buckets per power of two, so every
+// bucket is at most 25% of its lower bound wide. Values are microseconds;
+// 0-7 get a bucket each, anything from 2^24 us (16.8 s) up lands in the last.
+// Counts are 16 bits: when one would overflow every bucket is halved, which
+// keeps the shape of the distribution.
+class LatencyHistogram {
+public:
+    static constexpr uint8_t SUB_BUCKETS = 4;
+    static constexpr uint8_t LINEAR = 8;
+    static constexpr uint8_t MAX_OCTAVE = 23;
+    static constexpr size_t BUCKET_COUNT = LINEAR + (MAX_OCTAVE - 2) * SUB_BUCKETS;
+
+    static size_t bucketFor(uint32_t us) {
+        if (us < LINEAR) return us;
+        uint8_t octave = 31 - __builtin_clz(us);
+        if (octave > MAX_OCTAVE) return BUCKET_COUNT - 1;
+        return LINEAR + (octave - 3) * SUB_BUCKETS + ((us >> (octave - 2)) & (SUB_BUCKETS - 1));
+    }
+    // Smallest value in bucket
+    static uint32_t bucketLow(size_t bucket) {
+        if (bucket < LINEAR) return uint32_t(bucket);
+        size_t octave = 3 + (bucket - LINEAR) / SUB_BUCKETS;
+        return uint32_t(SUB_BUCKETS + (bucket - LINEAR) % SUB_BUCKETS) << (octave - 2);
+    }
+    static uint32_t bucketHigh(size_t bucket) {
+        return bucket + 1 < BUCKET_COUNT ? bucketLow(bucket + 1) - 1 : 0xFFFFFFFFu;
+    }
+
+    void record(uint32_t us) {
+        size_t bucket = bucketFor(us);
+        if (counts_[bucket] == 0xFFFF) {
+            for (size_t i = 0; i < BUCKET_COUNT; ++i) counts_[i] /= 2;
+        }
+        counts_[bucket]++;
+        total_++;
+        if (us > max_) max_ = us;
+    }
+    void clear() {
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) counts_[i] = 0;
+        total_ = 0;
+        max_ = 0;
+    }
+
+    uint16_t count(size_t bucket) const { return counts_[bucket]; }
+    // Samples recorded, including the ones halving took off the buckets
+    uint32_t total() const { return total_; }
+    uint32_t max() const { return max_; }
+
+private:
+    uint16_t counts_[BUCKET_COUNT] = {};
+    uint32_t total_ = 0;
+    uint32_t max_ = 0;
+};
+
+// Follows sampled key reports through the bridge and keeps a latency
+// histogram per path and per hop.
+//
+// Paths:
+//   - PASS_THROUGH: USB keyboard report to the host
+//   - ROUND_TRIP:   command mode, USB report forwarded to the server and the
+//                   server's answer typed to the host
+//   - INJECTED:     a report the server sends on its own, typed to the host
+//
+// Timestamps are device micros() and stay on the device, in a slot per
+// trace; only the 16-bit trace id goes over the wire. The device announces
+// the id before a forwarded report, and the server puts it (plus how long it
+// held the report) in front of its answer. Injected reports carry an id the
+// server picks. When a traced report leaves the HID queue the device echoes
+// the id back, so the server can time its side too.
+//
+// Hops, summed over the paths that have them:
+//   - PIPELINE:  USB arrival until the report is queued for the host or
+//                written to the server
+//   - NETWORK:   written to the server until its answer arrived, minus the
+//                time the server says it held the report
+//   - SERVER:    time the server held the report
+//   - RECEIVE:   server report arrived until it is queued for the host
+//   - HID_QUEUE: queued until the USB stack took it for the host
+//
+// Callers pass BridgeClock::micros().
+class LatencyTracer {
+public:
+    enum Path : uint8_t { PASS_THROUGH, ROUND_TRIP, INJECTED, PATH_COUNT };
+    enum Hop : uint8_t { PIPELINE, NETWORK, SERVER, RECEIVE, HID_QUEUE, HOP_COUNT };
+    // Histograms are numbered paths first, then hops
+    static constexpr size_t HISTOGRAM_COUNT = PATH_COUNT + HOP_COUNT;
+    static constexpr const char* NAMES[HISTOGRAM_COUNT] = {
+        "pass-through", "round-trip", "injected",
+        "pipeline", "network", "server", "receive", "hid-queue"
+    };
+
+    // Traces in flight; more are not started
+    static constexpr size_t MAX_TRACES = 8;
+    // Traces that take longer are counted as lost (a dropped or merged report)
+    static constexpr unsigned long TIMEOUT_US = 2000000;
+    static constexpr size_t DONE_QUEUE = 8;
+
+    static LatencyTracer& getInstance();
+
+    // Trace one in every USB reports, 0 turns sampling off. Server traces
+    // are followed either way.
+    void setSampling(uint16_t every);
+    uint16_t sampling() const { return every_; }
+
+    // A USB report arrived; decides whether it is traced
+    void arrival(unsigned long nowUs);
+    // That report is being queued for the host. Returns the tag to queue it
+    // with (HidReportQueue), 0 if it isn't traced.
+    uint8_t passThrough();
+    // That report is being forwarded to the server. Returns false if it isn't
+    // traced, otherwise id is to be announced before it.
+    bool forward(uint16_t& id);
+    // The forwarded report was written
+    void forwarded(uint16_t id, unsigned long nowUs);
+
+    // The server held the report that follows for this long
+    void serverHold(uint16_t us) { hold_ = us; }
+    // The server's next report belongs to trace id: the answer to a forwarded
+    // report, or an injected one
+    void serverTrace(uint16_t id, unsigned long nowUs);
+    // Tag for the server report being queued, 0 if it isn't traced
+    uint8_t takeServerTag();
+
+    // A tagged report was queued for the host, or skipped because the host
+    // already had that state
+    void queued(uint8_t tag, unsigned long nowUs);
+    void skipped(uint8_t tag);
+    // A tagged report left the HID queue
+    void delivered(uint8_t tag, unsigned long nowUs);
+
+    // Frees traces older than TIMEOUT_US; call regularly
+    void expire(unsigned long nowUs);
+    // Ids of server traces that reached the host, to be echoed
+    bool takeDone(uint16_t& id);
+
+    const LatencyHistogram& histogram(size_t index) const { return histograms_[index]; }
+    uint32_t lost() const { return lost_; }
+    uint32_t completed() const { return completed_; }
+    void clear();
+
+private:
+    struct Trace {
+        bool active;
+        uint8_t path;
+        uint16_t id;
+        uint16_t hold;
+        unsigned long start;     // USB arrival, or server report arrival
+        unsigned long forwarded; // Written to the server
+        unsigned long echoed;    // Server's answer arrived
+        unsigned long queued;    // Pushed to the HID queue
+    };
+
+    Trace traces_[MAX_TRACES] = {};
+    LatencyHistogram histograms_[HISTOGRAM_COUNT];
+    uint16_t every_ = 0;
+    uint16_t counter_ = 0;
+    bool arrivalTraced_ = false;
+    unsigned long arrivalUs_ = 0;
+    uint16_t nextId_ = 1;
+    uint16_t hold_ = 0;
+    uint8_t serverTag_ = 0;
+    uint16_t done_[DONE_QUEUE] = {};
+    size_t doneHead_ = 0;
+    size_t doneCount_ = 0;
+    uint32_t lost_ = 0;
+    uint32_t completed_ = 0;
+
+    uint8_t start(Path path, uint16_t id, unsigned long nowUs);
+    Trace* find(uint8_t tag);
+    void record(size_t histogram, unsigned long from, unsigned long to);
+};
+
+#endif
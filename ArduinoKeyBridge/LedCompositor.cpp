@@ -0,0 +1,106 @@
+#include "LedCompositor.h"
+
+void LedCompositor::setSolid(Layer layer, const NeoPixelColor& color, uint8_t level, unsigned long durationMs) {
+    LayerState& state = layers_[layer];
+    state.pattern = SOLID;
+    state.color = color;
+    state.level = level;
+    state.durationMs = durationMs;
+    state.started = false;
+}
+
+void LedCompositor::setProgress(Layer layer, const NeoPixelColor& color, float progress, uint8_t level) {
+    progress = progress < 0.0f ? 0.0f : (progress > 1.0f ? 1.0f : progress);
+    LayerState& state = layers_[layer];
+    state.pattern = PROGRESS;
+    state.color = color;
+    state.level = level;
+    state.lit = uint16_t(progress * pixelCount_ + 0.5f);
+    state.durationMs = 0;
+}
+
+void LedCompositor::setRolling(Layer layer, const NeoPixelColor& color, uint8_t level) {
+    LayerState& state = layers_[layer];
+    state.pattern = ROLLING;
+    state.color = color;
+    state.level = level;
+    state.durationMs = 0;
+}
+
+void LedCompositor::setLevel(Layer layer, uint8_t level) {
+    layers_[layer].level = level;
+}
+
+void LedCompositor::clearLayer(Layer layer) {
+    layers_[layer].pattern = OFF;
+}
+
+void LedCompositor::clearAll() {
+    for (size_t i = 0; i < LAYER_COUNT; ++i) layers_[i].pattern = OFF;
+}
+
+NeoPixelColor LedCompositor::scale(const NeoPixelColor& color, uint8_t level) {
+    // Same scaling as Adafruit_NeoPixel::setBrightness, 255 leaves the color as is
+    uint16_t factor = uint16_t(level) + 1;
+    return NeoPixelColor(uint8_t((color.r * factor) >> 8), uint8_t((color.g * factor) >> 8), uint8_t((color.b * factor) >> 8));
+}
+
+bool LedCompositor::layerPixel(const LayerState& layer, size_t i, unsigned long nowMs, NeoPixelColor& out) const {
+    switch (layer.pattern) {
+        case SOLID:
+            out = scale(layer.color, layer.level);
+            return true;
+        case PROGRESS:
+            out = i < layer.lit ? scale(layer.color, layer.level) : NeoPixelColors::BLACK;
+            return true;
+        case ROLLING: {
+            if (pixelCount_ < 2) return false;
+            // Bottom to top and back, one pixel per step
+            size_t period = 2 * (pixelCount_ - 1);
+            size_t step = (nowMs / AMBIENT_STEP_MS) % period;
+            size_t position = step < pixelCount_ ? step : period - step;
+            if (i != position) return false;
+            out = scale(layer.color, layer.level);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool LedCompositor::render(unsigned long nowMs, bool force) {
+    if (!force && composed_ > 0 && nowMs - lastFrameMs_ < FRAME_INTERVAL_MS) return false;
+    lastFrameMs_ = nowMs;
+    composed_++;
+
+    // Timed layers expire on the frame after their duration
+    for (size_t l = 0; l < LAYER_COUNT; ++l) {
+        LayerState& layer = layers_[l];
+        if (layer.pattern == OFF || layer.durationMs == 0) continue;
+        if (!layer.started) {
+            layer.started = true;
+            layer.startMs = nowMs;
+        } else if (nowMs - layer.startMs >= layer.durationMs) {
+            layer.pattern = OFF;
+        }
+    }
+
+    bool changed = false;
+    for (size_t i = 0; i < pixelCount_; ++i) {
+        NeoPixelColor color = NeoPixelColors::BLACK;
+        for (size_t l = LAYER_COUNT; l-- > 0;) {
+            if (layerPixel(layers_[l], i, nowMs, color)) break;
+        }
+        if (color != frame_[i]) {
+            frame_[i] = color;
+            changed = true;
+        }
+    }
+    // The first frame is always sent so the strip matches the framebuffer
+    if (dirty_) {
+        dirty_ = false;
+        changed = true;
+    }
+    if (changed) changed_++;
+    return changed;
+}
@@ -0,0 +1,107 @@
+#ifndef LED_COMPOSITOR_H
+#define LED_COMPOSITOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Color constants for easy reference
+struct NeoPixelColor {
+    uint8_t r, g, b;
+    constexpr NeoPixelColor(uint8_t r_ = 0, uint8_t g_ = 0, uint8_t b_ = 0) : r(r_), g(g_), b(b_) {}
+    bool operator==(const NeoPixelColor& other) const { return r == other.r && g == other.g && b == other.b; }
+    bool operator!=(const NeoPixelColor& other) const { return !(*this == other); }
+};
+
+namespace NeoPixelColors {
+    static constexpr NeoPixelColor RED(255, 0, 0);
+    static constexpr NeoPixelColor GREEN(0, 255, 0);
+    static constexpr NeoPixelColor BLUE(0, 0, 255);
+    static constexpr NeoPixelColor YELLOW(255, 255, 0);
+    static constexpr NeoPixelColor MAGENTA(255, 0, 255);
+    static constexpr NeoPixelColor CYAN(0, 255, 255);
+    static constexpr NeoPixelColor WHITE(255, 255, 255);
+    static constexpr NeoPixelColor BLACK(0, 0, 0);
+    static constexpr NeoPixelColor ORANGE(255, 165, 0);
+}
+
+// Layered LED status. Callers set layers, render() composes them into one
+// framebuffer at most once per FRAME_INTERVAL_MS and reports whether the
+// frame changed, so the strip is only sent when something is different.
+//
+// Layers from bottom to top; a pixel shows the topmost layer covering it:
+//
+//   MODE      solid mode color (command, charter, ...)
+//   AMBIENT   dot rolling back and forth over the mode color
+//   ACTIVITY  short flashes (server feedback, charter buffer state)
+//   ERROR     solid error color until cleared
+//   BOOT      setup progress bar
+//
+// Each layer has its own level (brightness, 0-255) and an optional duration
+// after which it clears itself.
+class LedCompositor {
+public:
+    enum Layer : uint8_t {
+        MODE = 0,
+        AMBIENT,
+        ACTIVITY,
+        ERROR,
+        BOOT,
+        LAYER_COUNT
+    };
+
+    static constexpr size_t MAX_PIXELS = 24;
+    static constexpr unsigned long FRAME_INTERVAL_MS = 33; // About 30 frames per second
+    static constexpr unsigned long AMBIENT_STEP_MS = 100;
+
+    void begin(uint16_t pixels) { pixelCount_ = pixels < MAX_PIXELS ? pixels : MAX_PIXELS; }
+
+    // durationMs 0 keeps the layer until it is changed or cleared
+    void setSolid(Layer layer, const NeoPixelColor& color, uint8_t level = 255, unsigned long durationMs = 0);
+    void setProgress(Layer layer, const NeoPixelColor& color, float progress, uint8_t level = 255);
+    void setRolling(Layer layer, const NeoPixelColor& color, uint8_t level = 255);
+    void setLevel(Layer layer, uint8_t level);
+    void clearLayer(Layer layer);
+    void clearAll();
+    bool isActive(Layer layer) const { return layers_[layer].pattern != OFF; }
+
+    // Composes a frame if one is due (or force is set). Returns true if it
+    // differs from the last frame returned, i.e. the strip needs a show().
+    bool render(unsigned long nowMs, bool force = false);
+    const NeoPixelColor& pixel(size_t i) const { return frame_[i]; }
+    uint16_t pixelCount() const { return pixelCount_; }
+
+    uint32_t framesComposed() const { return composed_; }
+    uint32_t framesChanged() const { return changed_; }
+
+private:
+    enum Pattern : uint8_t {
+        OFF = 0,
+        SOLID,
+        PROGRESS,
+        ROLLING
+    };
+
+    struct LayerState {
+        Pattern pattern = OFF;
+        NeoPixelColor color;
+        uint8_t level = 255;
+        uint16_t lit = 0;              // PROGRESS: pixels lit
+        unsigned long durationMs = 0;
+        unsigned long startMs = 0;
+        bool started = false;          // startMs is taken on the first frame
+    };
+
+    LayerState layers_[LAYER_COUNT];
+    NeoPixelColor frame_[MAX_PIXELS];
+    uint16_t pixelCount_ = 0;
+    unsigned long lastFrameMs_ = 0;
+    bool dirty_ = true;
+    uint32_t composed_ = 0;
+    uint32_t changed_ = 0;
+
+    // Color of pixel i in layer, false if the layer doesn't cover it
+    bool layerPixel(const LayerState& layer, size_t i, unsigned long nowMs, NeoPixelColor& out) const;
+    static NeoPixelColor scale(const NeoPixelColor& color, uint8_t level);
+};
+
+#endif
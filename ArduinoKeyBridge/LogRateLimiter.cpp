@@ -0,0 +1,102 @@
+#include "LogRateLimiter.h"
+#include <string.h>
+
+void LogRateLimiter::setDefault(const Limit& limit) {
+    defaultLimit_ = limit;
+    for (size_t i = 0; i < sourceCount_; ++i) {
+        if (!sources_[i].ownLimit) sources_[i].limit = limit;
+    }
+}
+
+bool LogRateLimiter::setLimit(const char* source, const Limit& limit) {
+    Source* entry = find(source, true);
+    if (!entry) return false;
+    entry->limit = limit;
+    entry->ownLimit = true;
+    reset(*entry, entry->lastRefillMs);
+    return true;
+}
+
+void LogRateLimiter::clearLimits() {
+    for (size_t i = 0; i < sourceCount_; ++i) {
+        sources_[i].limit = defaultLimit_;
+        sources_[i].ownLimit = false;
+    }
+}
+
+void LogRateLimiter::reset(Source& source, unsigned long nowMs) {
+    // Start with a full bucket
+    source.tokens = uint32_t(source.limit.burst) * 1000;
+    source.lastRefillMs = nowMs;
+    source.sampleCount = 0;
+}
+
+LogRateLimiter::Source* LogRateLimiter::find(const char* name, bool create) {
+    for (size_t i = 0; i < sourceCount_; ++i) {
+        if (sources_[i].name == name) return &sources_[i];
+    }
+    // The same literal can have different addresses in different files
+    for (size_t i = 0; i < sourceCount_; ++i) {
+        if (strcmp(sources_[i].name, name) == 0) return &sources_[i];
+    }
+    if (!create || sourceCount_ >= MAX_SOURCES) return nullptr;
+    Source& source = sources_[sourceCount_++];
+    source.name = name;
+    source.limit = defaultLimit_;
+    source.ownLimit = false;
+    source.suppressed = 0;
+    reset(source, 0);
+    return &source;
+}
+
+bool LogRateLimiter::allow(const char* source, unsigned long nowMs, uint32_t& suppressed) {
+    suppressed = 0;
+    Source* entry = find(source, true);
+    if (!entry) {
+        // Table full, sources beyond it are not limited
+        return true;
+    }
+    const Limit& limit = entry->limit;
+
+    bool pass = true;
+    if (limit.sampleEvery > 1) {
+        pass = entry->sampleCount == 0;
+        if (++entry->sampleCount >= limit.sampleEvery) entry->sampleCount = 0;
+    }
+    if (pass && limit.perSecond > 0) {
+        unsigned long elapsed = nowMs - entry->lastRefillMs;
+        entry->lastRefillMs = nowMs;
+        uint32_t capacity = uint32_t(limit.burst ? limit.burst : 1) * 1000;
+        // perSecond tokens per 1000 ms is perSecond milli-tokens per ms
+        uint64_t tokens = uint64_t(entry->tokens) + uint64_t(elapsed) * limit.perSecond;
+        entry->tokens = tokens > capacity ? capacity : uint32_t(tokens);
+        if (entry->tokens >= 1000) {
+            entry->tokens -= 1000;
+        } else {
+            pass = false;
+        }
+    }
+
+    if (!pass) {
+        entry->suppressed++;
+        totalSuppressed_++;
+        return false;
+    }
+    suppressed = entry->suppressed;
+    entry->suppressed = 0;
+    return true;
+}
+
+const char* LogRateLimiter::takeSuppressed(uint32_t& suppressed) {
+    for (size_t n = 0; n < sourceCount_; ++n) {
+        Source& source = sources_[scan_];
+        scan_ = (scan_ + 1) % sourceCount_;
+        if (source.suppressed > 0) {
+            suppressed = source.suppressed;
+            source.suppressed = 0;
+            return source.name;
+        }
+    }
+    suppressed = 0;
+    return nullptr;
+}
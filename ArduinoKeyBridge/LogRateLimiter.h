@@ -0,0 +1,65 @@
+#ifndef LOG_RATE_LIMITER_H
+#define LOG_RATE_LIMITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Per-source token buckets and 1-in-N sampling for the logger.
+//
+// Every source gets a bucket of `burst` messages refilled at `perSecond`
+// messages per second; with sampling only every Nth message is offered to
+// the bucket at all. A rate of 0 means unlimited. Sources without their own
+// limit use the default one. Suppressed messages are counted per source so
+// the logger can report them when the source logs again.
+//
+// Sources are matched by pointer first and then by name, and must be string
+// literals.
+class LogRateLimiter {
+public:
+    static constexpr size_t MAX_SOURCES = 16;
+
+    struct Limit {
+        uint16_t perSecond = 0;  // 0 = unlimited
+        uint16_t burst = 0;
+        uint16_t sampleEvery = 1; // 1 = keep every message
+    };
+
+    void setDefault(const Limit& limit);
+    // Returns false if the source table is full
+    bool setLimit(const char* source, const Limit& limit);
+    // Back to the default limit for every source
+    void clearLimits();
+
+    // True if a message from source may be printed now. suppressed is set
+    // to the number of messages dropped since the last one that was printed.
+    bool allow(const char* source, unsigned long nowMs, uint32_t& suppressed);
+
+    // Takes the suppressed count of the next source that has one, for
+    // summaries of sources that went quiet. Returns nullptr when there are none.
+    const char* takeSuppressed(uint32_t& suppressed);
+
+    const Limit& defaultLimit() const { return defaultLimit_; }
+    uint32_t totalSuppressed() const { return totalSuppressed_; }
+
+private:
+    struct Source {
+        const char* name;
+        Limit limit;
+        bool ownLimit;
+        uint32_t tokens;     // In 1/1000 messages
+        unsigned long lastRefillMs;
+        uint16_t sampleCount;
+        uint32_t suppressed;
+    };
+
+    Source sources_[MAX_SOURCES];
+    size_t sourceCount_ = 0;
+    Limit defaultLimit_;
+    uint32_t totalSuppressed_ = 0;
+    size_t scan_ = 0;
+
+    Source* find(const char* name, bool create);
+    static void reset(Source& source, unsigned long nowMs);
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "LoopWatchdog.h"
+#include <WDT.h>
+#include "ArduinoKeyBridgeLogger.h"
+#include "TaskScheduler.h"
+
+namespace {
+    // RSTSR1.WDTRF: the last reset came from the watchdog. The flag stays set
+    // across resets until written with 0.
+    bool watchdogReset() {
+#if defined(ARDUINO_ARCH_RENESAS)
+        bool fired = R_SYSTEM->RSTSR1_b.WDTRF;
+        if (fired) R_SYSTEM->RSTSR1_b.WDTRF = 0;
+        return fired;
+#else
+        return false;
+#endif
+    }
+}
+
+LoopWatchdog& LoopWatchdog::getInstance() {
+    static LoopWatchdog instance;
+    return instance;
+}
+
+void LoopWatchdog::begin() {
+    bool watchdog = watchdogReset();
+    if (FlightRecorder::recover()) {
+        // A reset button press or an upload leaves a record too; only a hang is worth the dump
+        if (watchdog || FlightRecorder::endedBadly()) dump(watchdog);
+        else ArduinoKeyBridgeLogger::getInstance().info("LoopWatchdog", String("Boot ") + FlightRecorder::image().boots + " ended cleanly");
+    }
+    FlightRecorder::start();
+}
+
+void LoopWatchdog::arm() {
+    hardware_ = WDT.begin(HARDWARE_TIMEOUT_MS);
+    if (!hardware_) ArduinoKeyBridgeLogger::getInstance().warning("LoopWatchdog", "Hardware watchdog not available, hangs won't reset");
+}
+
+void LoopWatchdog::iterationEnded() {
+    unsigned long elapsed = BridgeClock::micros() - start_;
+    if (elapsed > max_us_) max_us_ = elapsed;
+    if (budget_ > 0 && elapsed > budget_) {
+        const FlightRecorder::Image& image = FlightRecorder::image();
+        FlightRecorder::stalled(image.task, elapsed);
+        stalls_++;
+        ArduinoKeyBridgeLogger::getInstance().warning("LoopWatchdog", String("Loop stalled for ") + elapsed + " us in task " +
+            TaskScheduler::getInstance().taskName(image.task));
+    }
+    if (hardware_) WDT.refresh();
+}
+
+void LoopWatchdog::setupStep(uint8_t percent) {
+    FlightRecorder::record(FlightRecorder::SETUP, percent);
+    if (hardware_) WDT.refresh();
+}
+
+void LoopWatchdog::halt(uint8_t reason) {
+    FlightRecorder::halted(reason);
+    while (true) {
+        // No refresh: the hardware watchdog resets the board
+    }
+}
+
+void LoopWatchdog::logStats() {
+    ArduinoKeyBridgeLogger::getInstance().debug("LoopWatchdog", String("Longest loop iteration ") + max_us_ + " us, stalls " +
+        (stalls_ - stalls_logged_) + " (budget " + budget_ + " us)");
+    max_us_ = 0;
+    stalls_logged_ = stalls_;
+}
+
+void LoopWatchdog::dump(bool watchdog) {
+    ArduinoKeyBridgeLogger& logger = ArduinoKeyBridgeLogger::getInstance();
+    const FlightRecorder::Image& image = FlightRecorder::image();
+    size_t count = FlightRecorder::size();
+    logger.warning("LoopWatchdog", String("Flight record of boot ") + image.boots + ": " + count + " events, " + image.stalls + " stalls" +
+        (watchdog ? ", reset by the watchdog" : ""));
+    if (count == 0) return;
+    uint32_t end = FlightRecorder::entry(count - 1).timeUs;
+    // Task ids are in the order setup() adds the tasks
+    if (image.inTask) {
+        logger.warning("LoopWatchdog", String("It ended inside task ") + image.task + ", " + (end - image.taskStartUs) +
+            " us after the task started");
+    }
+    // Oldest first, times relative to the last event
+    for (size_t i = 0; i < count; ++i) {
+        const FlightRecorder::Entry& entry = FlightRecorder::entry(i);
+        logger.warning("FlightRecorder", String("-") + (end - entry.timeUs) + " us " + FlightRecorder::name(entry.event) +
+            " " + entry.a + " " + entry.b);
+    }
+}
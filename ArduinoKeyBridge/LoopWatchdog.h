@@ -0,0 +1,59 @@
+#ifndef LOOP_WATCHDOG_H
+#define LOOP_WATCHDOG_H
+
+#include <Arduino.h>
+#include "FlightRecorder.h"
+
+// Catches loop() iterations that take too long and, with the hardware
+// watchdog, ones that never end.
+//
+// An iteration over the budget is a stall: logged with the task that ran,
+// counted, and recorded in the FlightRecorder. An iteration that hangs
+// (an unbounded wait, a blocking modem write, halt()) stops refreshing the
+// hardware watchdog, which resets the board; the next boot dumps the
+// flight recorder so the events before the hang are not lost. A clean
+// reset only gets one line.
+class LoopWatchdog {
+public:
+    static LoopWatchdog& getInstance();
+
+    static constexpr unsigned long DEFAULT_BUDGET_US = 50000;
+    // The UNO R4's WDT allows up to about 5.5 s
+    static constexpr uint32_t HARDWARE_TIMEOUT_MS = 5000;
+
+    // Dumps what the previous run recorded if it hung, stalled or was reset by
+    // the watchdog, then starts recording. Call first thing in setup().
+    void begin();
+    // Starts the hardware watchdog. Call once the transport is up: bringing
+    // up the access point can take longer than HARDWARE_TIMEOUT_MS.
+    void arm();
+    // Loop iterations longer than this are stalls, 0 turns detection off
+    void setBudget(unsigned long us) { budget_ = us; }
+    unsigned long budget() const { return budget_; }
+
+    // Around every loop() iteration
+    void iterationStarted() { start_ = BridgeClock::micros(); }
+    void iterationEnded();
+    // Setup progress; also keeps the hardware watchdog quiet between steps
+    void setupStep(uint8_t percent);
+    // Records why and stops; the hardware watchdog resets the board
+    void halt(uint8_t reason);
+
+    void logStats();
+
+private:
+    LoopWatchdog() = default;
+    LoopWatchdog(const LoopWatchdog&) = delete;
+    LoopWatchdog& operator=(const LoopWatchdog&) = delete;
+
+    unsigned long budget_ = DEFAULT_BUDGET_US;
+    unsigned long start_ = 0;
+    unsigned long max_us_ = 0; // Longest iteration since the last logStats()
+    uint32_t stalls_ = 0;
+    uint32_t stalls_logged_ = 0;
+    bool hardware_ = false;
+
+    void dump(bool watchdog);
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef LOOPBACK_TRANSPORT_H
+#define LOOPBACK_TRANSPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Transport.h"
+
+// In-memory transport for host tools: two ends joined with connect(), what
+// one end writes the other reads. Each end owns a fixed ring buffer, a write
+// that doesn't fit is cut short like a full socket buffer.
+class LoopbackTransport : public Transport {
+public:
+    static constexpr size_t CAPACITY = 4096;
+
+    explicit LoopbackTransport(size_t maxPayload = 64, bool batch = false)
+        : maxPayload_(maxPayload), batch_(batch) {}
+
+    // Joins two ends; both report a new peer on their next accept()
+    void connect(LoopbackTransport& other) {
+        peer_ = &other;
+        other.peer_ = this;
+        accepted_ = other.accepted_ = false;
+    }
+
+    bool accept() override {
+        if (!peer_ || accepted_) return false;
+        accepted_ = true;
+        return true;
+    }
+    bool connected() override { return peer_ != nullptr; }
+
+    int available() override { return int(count_); }
+    int read() override {
+        if (count_ == 0) return -1;
+        uint8_t byte = buffer_[head_];
+        head_ = (head_ + 1) % CAPACITY;
+        count_--;
+        return byte;
+    }
+    int read(uint8_t* buf, size_t length) override {
+        size_t n = 0;
+        while (n < length && count_ > 0) buf[n++] = uint8_t(read());
+        return int(n);
+    }
+
+    size_t write(const uint8_t* data, size_t length) override {
+        if (!peer_) return 0;
+        writes_++;
+        return peer_->receive(data, length);
+    }
+
+    size_t maxPayload() const override { return maxPayload_; }
+    bool batchWrites() const override { return batch_; }
+    const char* name() const override { return "loopback"; }
+
+    // write() calls made on this end, i.e. packets on a real link
+    uint32_t writes() const { return writes_; }
+
+private:
+    LoopbackTransport* peer_ = nullptr;
+    bool accepted_ = false;
+    size_t maxPayload_;
+    bool batch_;
+    uint8_t buffer_[CAPACITY];
+    size_t head_ = 0;
+    size_t count_ = 0;
+    uint32_t writes_ = 0;
+
+    size_t receive(const uint8_t* data, size_t length) {
+        size_t n = 0;
+        for (; n < length && count_ < CAPACITY; ++n) {
+            buffer_[(head_ + count_) % CAPACITY] = data[n];
+            count_++;
+        }
+        return n;
+    }
+};
+
+#endif
@@ -1,7 +1,11 @@
 #ifndef MAGIC_KEYBOARD_KEYMAP_H
 #define MAGIC_KEYBOARD_KEYMAP_H
 
+#include <stdint.h>
+#include <stddef.h>
+#ifdef ARDUINO
 #include <avr/pgmspace.h>
+#endif
 
 // Define a struct to hold key information
 struct KeyInfo {
@@ -98,4 +102,12 @@ const KeyInfo unifiedKeyMap[] = {
 // Number of entries in the unified key map
 constexpr size_t unifiedKeyMapSize = sizeof(unifiedKeyMap) / sizeof(KeyInfo);
 
+// Key map entry that types the given character, or nullptr if there is none
+inline const KeyInfo* findKeyForChar(char c) {
+    for (size_t i = 0; i < unifiedKeyMapSize; ++i) {
+        if (unifiedKeyMap[i].asciiValue == c) return &unifiedKeyMap[i];
+    }
+    return nullptr;
+}
+
 #endif // MAGIC_KEYBOARD_KEYMAP_H
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "MinimalKeyboard.h"
 #include <HID.h>
+#include "BridgeClock.h"
+#include "LatencyTracer.h"
 
 // Define the HID report descriptor
 const uint8_t MinimalKeyboard::HID_REPORT_DESCRIPTOR[] PROGMEM = {
@@ -48,29 +50,76 @@ void MinimalKeyboard::begin() {
     // No USB.begin() needed for USB Host operation
 }
 
-void MinimalKeyboard::sendReport(KeyReport* report) {
-    HID().SendReport(2, report, sizeof(KeyReport));
+void MinimalKeyboard::sendReport(KeyReport* report, uint8_t traceTag) {
+    bool queued = queue_.push(*report, traceTag);
+    if (traceTag) {
+        if (queued) LatencyTracer::getInstance().queued(traceTag, BridgeClock::micros());
+        else LatencyTracer::getInstance().skipped(traceTag);
+    }
+    // Straight out if the endpoint is free, no need to wait for the next USB task
+    pump();
 }
 
-void MinimalKeyboard::onNewKeyReport(const uint8_t* buf, uint8_t len) {
-    if (len < 8) return; // HID report should be at least 8 bytes
-
-    KeyReport report = {0};
-    report.modifiers = buf[1];
+void MinimalKeyboard::pump() {
+    unsigned long now = BridgeClock::micros();
+    if (!queue_.due(now)) return;
+    KeyReport report = queue_.front();
+    if (HID().SendReport(2, &report, sizeof(KeyReport)) > 0) {
+        uint8_t tag = queue_.sent(now);
+        if (tag) LatencyTracer::getInstance().delivered(tag, BridgeClock::micros());
+    } else {
+        queue_.busy(now);
+    }
+}
 
-    int reportIndex = 0;
-    for (int i = 2; i < 8 && reportIndex < 6; ++i) {
-        uint8_t keyCode = buf[i];
-        if (keyCode == 0) continue;
-        report.keys[reportIndex++] = keyCode;
+void MinimalKeyboard::waitForRoom(size_t count) {
+    while (queue_.freeSpace() < count) {
+        pump();
+        BridgeClock::delayMicroseconds(WAIT_STEP_US);
     }
+}
 
-    // Store and flag
-    currentReport = report;
-    hasNewReport = true;
+void MinimalKeyboard::logStats() {
+    const HidReportQueue::Stats& stats = queue_.stats();
+    ArduinoKeyBridgeLogger::getInstance().debug("MinimalKeyboard",
+        String("HID reports: ") + (stats.sent - stats_sent_) + " sent, queued " + queue_.size() +
+        ", high water " + stats.highWater + "/" + HidReportQueue::CAPACITY +
+        ", overruns " + stats.overruns + ", duplicates " + stats.duplicates +
+        ", retries " + stats.retries + ", stalled " + stats.stalled);
+    stats_sent_ = stats.sent;
+    queue_.resetHighWater();
+
+    const InputCoalescer::Stats& input = input_.stats();
+    uint32_t received = merger_.reports();
+    ArduinoKeyBridgeLogger::getInstance().debug("MinimalKeyboard",
+        String("USB reports: ") + (received - stats_received_) + " received, " + input.delivered +
+        " states delivered, repeats " + repeats_ + ", duplicates " + input.duplicates + ", coalesced " + input.coalesced +
+        ", overflows " + input.overflows + ", high water " + input.highWater + "/" + InputCoalescer::CAPACITY);
+    stats_received_ = received;
+    input_.resetHighWater();
+}
 
-    // Logging (with key map lookup)
-    String logMsg = "New KeyReport: Modifiers: 0x" + String(report.modifiers, HEX) + " Keys:";
+void MinimalKeyboard::onNewKeyReport(uint8_t device, const uint8_t* buf, uint8_t len) {
+    if (len < 8) return; // HID report should be at least 8 bytes
+
+    // Merge with the other keyboards, nothing to queue if the merged state is the same
+    uint8_t boot[8] = {buf[1], 0, buf[2], buf[3], buf[4], buf[5], buf[6], buf[7]};
+    bool changed = merger_.update(device, boot, sizeof(boot));
+    // With six keys held one tag's report can change while the merged one doesn't
+    if (!input_.push(merger_, BridgeClock::micros(), device) && !changed) repeats_++;
+}
+
+bool MinimalKeyboard::nextReport(KeyReport& report, unsigned long& arrivalUs) {
+    InputCoalescer::Entry entry;
+    if (!input_.pop(entry)) return false;
+    report = entry.report;
+    arrivalUs = entry.arrivalUs;
+    previous_ = current_;
+    current_ = entry;
+
+    // Logging (with key map lookup), only built if it gets printed
+    if (!ArduinoKeyBridgeLogger::getInstance().allow(LogLevel::DEBUG, "MinimalKeyboard")) return true;
+    String logMsg = "New KeyReport from keyboard " + String(entry.device) + ": Modifiers: 0x" + String(report.modifiers, HEX) + " Keys:";
     for (int i = 0; i < 6; ++i) {
         logMsg += " 0x" + String(report.keys[i], HEX);
         if (report.keys[i] != 0) {
@@ -84,4 +133,11 @@ void MinimalKeyboard::onNewKeyReport(const uint8_t* buf, uint8_t len) {
         }
     }
     ArduinoKeyBridgeLogger::getInstance().debug("MinimalKeyboard", logMsg);
+    return true;
+}
+
+void MinimalKeyboard::onDeviceGone(uint8_t device) {
+    if (!merger_.releaseDevice(device)) return;
+    input_.push(merger_, BridgeClock::micros(), device);
+    ArduinoKeyBridgeLogger::getInstance().info("MinimalKeyboard", "Keyboard " + String(device) + " disconnected, keys released");
 }
@@ -5,41 +5,67 @@
 #include <HID.h>
 #include "MagicKeyboardKeyMap.h"
 #include "ArduinoKeyBridgeLogger.h"
-
-// Key report structure
-typedef struct {
-    uint8_t modifiers;
-    uint8_t reserved;
-    uint8_t keys[6];
-} KeyReport;
+#include "KeyReport.h"
+#include "KeyboardMerger.h"
+#include "HidReportQueue.h"
+#include "InputCoalescer.h"
 
 class MinimalKeyboard {
 public:
     static MinimalKeyboard& getInstance();
     void begin();
-    void sendReport(KeyReport* report);
-    void onNewKeyReport(const uint8_t* buf, uint8_t len);
+    // Queues report for the host, see HidReportQueue. A LatencyTracer tag
+    // marks a traced report.
+    void sendReport(KeyReport* report, uint8_t traceTag = 0);
+    // Sends the next queued report if the host's polling interval has passed
+    void pump();
+    // Pumps until count more reports fit without overrunning the queue
+    void waitForRoom(size_t count);
+    HidReportQueue& reportQueue() { return queue_; }
+    void logStats();
+    // Boot report from the keyboard in slot device (KeyboardMerger::MAX_DEVICES slots)
+    void onNewKeyReport(uint8_t device, const uint8_t* buf, uint8_t len);
+    // Releases the keys of a keyboard that went away
+    void onDeviceGone(uint8_t device);
+
+    // Next merged state of all keyboards for the pipeline, and micros() when
+    // it came in. False if none is pending, see InputCoalescer.
+    bool nextReport(KeyReport& report, unsigned long& arrivalUs);
 
-    // Flag to indicate new report available
-    bool hasNewReport = false;
-    KeyReport currentReport;
+    KeyboardMerger& merger() { return merger_; }
+    InputCoalescer& input() { return input_; }
+    // The state behind the last report from nextReport(), with its per-tag
+    // reports, and the one delivered before it
+    const InputCoalescer::Entry& current() const { return current_; }
+    const InputCoalescer::Entry& previous() const { return previous_; }
 
 private:
     MinimalKeyboard();  // Private constructor
     static const uint8_t HID_REPORT_DESCRIPTOR[];
+    static constexpr unsigned long WAIT_STEP_US = 100;
     MinimalKeyboard(const MinimalKeyboard&) = delete;
     MinimalKeyboard& operator=(const MinimalKeyboard&) = delete;
+
+    KeyboardMerger merger_;
+    InputCoalescer input_;
+    HidReportQueue queue_;
+    InputCoalescer::Entry current_ = {};
+    InputCoalescer::Entry previous_ = {};
+    uint32_t repeats_ = 0; // Reports that left the merged state as it was
+    uint32_t stats_sent_ = 0; // queue_ count at the last logStats()
+    uint32_t stats_received_ = 0; // merger_ reports at the last logStats()
 };
 
 class MinimalKeyboardParser : public KeyboardReportParser {
 public:
-    MinimalKeyboardParser(MinimalKeyboard& keyboard) : keyboard_(keyboard) {}
+    MinimalKeyboardParser(MinimalKeyboard& keyboard, uint8_t device = 0) : keyboard_(keyboard), device_(device) {}
 protected:
     void Parse(USBHID* hid, bool is_rpt_id, uint8_t len, uint8_t* buf) override {
-        keyboard_.onNewKeyReport(buf, len);
+        keyboard_.onNewKeyReport(device_, buf, len);
     }
 private:
     MinimalKeyboard& keyboard_;
+    uint8_t device_;
 };
 
 #endif
\ No newline at end of file
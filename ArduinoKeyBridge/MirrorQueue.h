@@ -0,0 +1,55 @@
+#ifndef MIRROR_QUEUE_H
+#define MIRROR_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "KeyReport.h"
+
+// Bounded queue of key reports copied to the server in local-first command
+// mode. The USB task pushes, the network task drains whatever the link takes.
+//
+// Reports are full key states, so when the queue is full the oldest one is
+// dropped: the server misses an intermediate state but always ends up with
+// the latest one. Drops are counted so the server's view can be judged.
+// Capacity is a template parameter.
+template <size_t CAPACITY>
+class MirrorQueue {
+public:
+    void push(const KeyReport& report) {
+        if (count_ == CAPACITY) {
+            head_ = (head_ + 1) % CAPACITY;
+            count_--;
+            dropped_++;
+        }
+        reports_[(head_ + count_) % CAPACITY] = report;
+        count_++;
+        pushed_++;
+        if (count_ > highWater_) highWater_ = count_;
+    }
+
+    bool pop(KeyReport& report) {
+        if (count_ == 0) return false;
+        report = reports_[head_];
+        head_ = (head_ + 1) % CAPACITY;
+        count_--;
+        return true;
+    }
+
+    void clear() { head_ = count_ = 0; }
+    size_t size() const { return count_; }
+    bool isEmpty() const { return count_ == 0; }
+
+    uint32_t pushed() const { return pushed_; }
+    uint32_t dropped() const { return dropped_; }
+    size_t highWater() const { return highWater_; }
+
+private:
+    KeyReport reports_[CAPACITY];
+    size_t head_ = 0;
+    size_t count_ = 0;
+    size_t highWater_ = 0;
+    uint32_t pushed_ = 0;
+    uint32_t dropped_ = 0;
+};
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef MODEM_TRANSPORT_H
+#define MODEM_TRANSPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Transport.h"
+#include "BridgeClock.h"
+#include "FlightRecorder.h"
+
+// Polling strategy for a TCP server whose socket calls are round trips to a
+// network coprocessor. On the UNO R4 WiFi every WiFiServer/WiFiClient call
+// is an AT transaction to the ESP32, so this keeps them to a minimum:
+//
+//  - connected() is answered from a cached state, refreshed every
+//    CONNECTED_CHECK_MS or right after a read or write fails
+//  - new clients are looked for every ACCEPT_INTERVAL_MS, and only while
+//    no client is connected
+//  - available() asks the modem only when the local buffer is empty, and
+//    then reads everything it reported (up to RX_BUFFER_SIZE) in one read
+//  - while the link is idle the modem is asked less and less often, up to
+//    every MAX_IDLE_BACKOFF_MS; any data resets that to every poll
+//  - writes are not followed by a flush
+//
+// Every modem call is counted in stats(). Templated on the server and client
+// types so tools/cpp can run it against counting shims.
+template <typename Server, typename Client>
+class ModemTransport : public Transport {
+public:
+    static constexpr size_t RX_BUFFER_SIZE = 256;
+    static constexpr unsigned long CONNECTED_CHECK_MS = 250;
+    static constexpr unsigned long ACCEPT_INTERVAL_MS = 100;
+    static constexpr unsigned long MAX_IDLE_BACKOFF_MS = 8;
+
+    struct Stats {
+        uint32_t accepts = 0;    // server.available()
+        uint32_t connected = 0;  // client.connected()
+        uint32_t available = 0;  // client.available()
+        uint32_t reads = 0;
+        uint32_t writes = 0;
+        uint32_t total() const { return accepts + connected + available + reads + writes; }
+    };
+
+    explicit ModemTransport(uint16_t port) : server_(port) {}
+
+    bool accept() override {
+        unsigned long now = BridgeClock::millis();
+        if (connected_) {
+            // Notice a peer that went away even when nothing is read or written
+            if (now - lastConnectedCheckMs_ >= CONNECTED_CHECK_MS) refreshConnected(now);
+            return false;
+        }
+        if (acceptChecked_ && now - lastAcceptMs_ < ACCEPT_INTERVAL_MS) return false;
+        acceptChecked_ = true;
+        lastAcceptMs_ = now;
+        stats_.accepts++;
+        Client client = server_.available();
+        if (!client) return false;
+        client_ = client;
+        connected_ = true;
+        FlightRecorder::record(FlightRecorder::NET_ACCEPT);
+        lastConnectedCheckMs_ = now;
+        rxHead_ = rxCount_ = 0;
+        backoffMs_ = 0;
+        return true;
+    }
+
+    bool connected() override { return connected_; }
+
+    int available() override {
+        if (rxCount_ > 0) return int(rxCount_);
+        if (!connected_) return 0;
+        fill(BridgeClock::millis());
+        return int(rxCount_);
+    }
+
+    int read() override {
+        if (rxCount_ == 0 && available() == 0) return -1;
+        rxCount_--;
+        return rx_[rxHead_++];
+    }
+
+    int read(uint8_t* buf, size_t length) override {
+        size_t n = 0;
+        while (n < length) {
+            if (rxCount_ == 0 && available() == 0) break;
+            size_t chunk = rxCount_ < length - n ? rxCount_ : length - n;
+            for (size_t i = 0; i < chunk; ++i) buf[n + i] = rx_[rxHead_ + i];
+            rxHead_ += chunk;
+            rxCount_ -= chunk;
+            n += chunk;
+        }
+        return int(n);
+    }
+
+    size_t write(const uint8_t* data, size_t length) override {
+        if (!connected_) return 0;
+        stats_.writes++;
+        // A write that never returns is the last thing in the flight record
+        FlightRecorder::record(FlightRecorder::NET_WRITE, 0, uint16_t(length));
+        size_t written = client_.write(data, length);
+        if (written == 0) refreshConnected(BridgeClock::millis());
+        return written;
+    }
+
+    // Nothing to do: the modem sends without a flush, and a flush would cost a transaction
+    void flush() override {}
+
+    const Stats& stats() const { return stats_; }
+    unsigned long backoffMs() const { return backoffMs_; }
+    Client& client() { return client_; }
+
+protected:
+    Server server_;
+    Client client_;
+
+private:
+    bool connected_ = false;
+    bool acceptChecked_ = false;
+    unsigned long lastAcceptMs_ = 0;
+    unsigned long lastConnectedCheckMs_ = 0;
+    unsigned long lastPollMs_ = 0;
+    unsigned long backoffMs_ = 0;
+    uint8_t rx_[RX_BUFFER_SIZE];
+    size_t rxHead_ = 0;
+    size_t rxCount_ = 0;
+    Stats stats_;
+
+    void refreshConnected(unsigned long now) {
+        stats_.connected++;
+        lastConnectedCheckMs_ = now;
+        connected_ = client_.connected();
+        if (!connected_) rxHead_ = rxCount_ = 0;
+    }
+
+    void fill(unsigned long now) {
+        if (backoffMs_ > 0 && now - lastPollMs_ < backoffMs_) return;
+        lastPollMs_ = now;
+        stats_.available++;
+        int ready = client_.available();
+        if (ready <= 0) {
+            // Idle: ask half as often each time, up to the limit
+            backoffMs_ = backoffMs_ == 0 ? 1 : (backoffMs_ * 2 > MAX_IDLE_BACKOFF_MS ? MAX_IDLE_BACKOFF_MS : backoffMs_ * 2);
+            // A closed connection reads as nothing available, check it now and then
+            if (now - lastConnectedCheckMs_ >= CONNECTED_CHECK_MS) refreshConnected(now);
+            return;
+        }
+        backoffMs_ = 0;
+        size_t want = size_t(ready) < RX_BUFFER_SIZE ? size_t(ready) : RX_BUFFER_SIZE;
+        stats_.reads++;
+        int got = client_.read(rx_, want);
+        if (got <= 0) {
+            refreshConnected(now);
+            return;
+        }
+        FlightRecorder::record(FlightRecorder::NET_READ, 0, uint16_t(got));
+        rxHead_ = 0;
+        rxCount_ = size_t(got);
+    }
+};
+
+#endif
@@ -0,0 +1,65 @@
+#include "RemapStore.h"
+#include "ArduinoKeyBridgeLogger.h"
+#include <EEPROM.h>
+
+RemapStore& RemapStore::getInstance() {
+    static RemapStore instance;
+    return instance;
+}
+
+uint8_t RemapStore::FlashReader::read(size_t offset) const {
+    return EEPROM.read(FlashLayout::REMAP_ADDRESS + offset);
+}
+
+void RemapStore::begin() {
+    // Size the read from the stored header; erased flash fails validation
+    uint8_t layers = reader_.read(3);
+    if (reader_.read(0) != 'K' || layers == 0 || layers > KeyRemap::MAX_LAYERS) {
+        ArduinoKeyBridgeLogger::getInstance().info("Remap", "No stored remap tables, passing keys through");
+        return;
+    }
+    if (remap_.load(reader_, KeyRemap::blobSize(layers))) {
+        ArduinoKeyBridgeLogger::getInstance().info("Remap", String("Loaded ") + layers + " remap layers from flash");
+    } else {
+        ArduinoKeyBridgeLogger::getInstance().warning("Remap", "Stored remap tables are invalid, passing keys through");
+    }
+}
+
+bool RemapStore::beginBlob(size_t length) {
+    // A zero length upload clears the tables
+    if (length > KeyRemap::MAX_BLOB_SIZE) return false;
+    length_ = 0;
+    // Invalidate the stored tables first, so a broken upload never loads at boot
+    EEPROM.update(FlashLayout::REMAP_ADDRESS, 0xFF);
+    return true;
+}
+
+bool RemapStore::writeBlob(const uint8_t* data, size_t length, size_t offset) {
+    if (offset + length > KeyRemap::MAX_BLOB_SIZE) return false;
+    // update() skips bytes that are already equal, sparing flash erase cycles
+    for (size_t i = 0; i < length; ++i) {
+        // The magic byte goes last, in endBlob()
+        if (offset + i == 0) continue;
+        EEPROM.update(FlashLayout::REMAP_ADDRESS + offset + i, data[i]);
+    }
+    if (offset == 0 && length > 0) first_ = data[0];
+    length_ = offset + length;
+    return true;
+}
+
+bool RemapStore::endBlob() {
+    if (length_ == 0) {
+        remap_.clear();
+        ArduinoKeyBridgeLogger::getInstance().info("Remap", "Remap tables cleared");
+        return true;
+    }
+    EEPROM.update(FlashLayout::REMAP_ADDRESS, first_);
+    if (!remap_.load(reader_, length_)) {
+        EEPROM.update(FlashLayout::REMAP_ADDRESS, 0xFF);
+        ArduinoKeyBridgeLogger::getInstance().warning("Remap", String("Rejected remap blob of ") + length_ +
+            " bytes, the running tables stay until the next boot");
+        return false;
+    }
+    ArduinoKeyBridgeLogger::getInstance().info("Remap", String("Loaded ") + remap_.layerCount() + " remap layers over TCP");
+    return true;
+}
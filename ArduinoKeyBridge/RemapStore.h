@@ -0,0 +1,46 @@
+#ifndef REMAP_STORE_H
+#define REMAP_STORE_H
+
+#include <Arduino.h>
+#include "KeyRemap.h"
+#include "BlobSink.h"
+#include "FlashLayout.h"
+
+// Owns the active KeyRemap tables. They are loaded from data flash at boot
+// and replaced by REMAP_BLOB uploads over TCP. Uploads are written to flash
+// a chunk at a time as they arrive, with the magic byte last, and loaded
+// from there once they validate; there is no staging copy in RAM. The
+// running tables stay in use until then.
+class RemapStore : public BlobSink {
+public:
+    static RemapStore& getInstance();
+
+    // Load the stored tables, if there are any
+    void begin();
+    KeyRemap& remap() { return remap_; }
+
+    bool beginBlob(size_t length) override;
+    bool writeBlob(const uint8_t* data, size_t length, size_t offset) override;
+    bool endBlob() override;
+
+private:
+    static_assert(KeyRemap::MAX_BLOB_SIZE <= FlashLayout::REMAP_SIZE, "remap blob doesn't fit its flash region");
+
+    // Reads the remap region of data flash
+    class FlashReader : public KeyRemap::Reader {
+    public:
+        uint8_t read(size_t offset) const override;
+    };
+
+    KeyRemap remap_;
+    FlashReader reader_;
+    size_t length_ = 0;
+    uint8_t first_ = 0xFF; // Magic byte of the upload, written once the rest is in flash
+
+    RemapStore() = default;
+    ~RemapStore() = default;
+    RemapStore(const RemapStore&) = delete;
+    RemapStore& operator=(const RemapStore&) = delete;
+};
+
+#endif
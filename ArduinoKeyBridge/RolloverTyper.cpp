@@ -0,0 +1,47 @@
+#include "RolloverTyper.h"
+#include <string.h>
+
+void RolloverTyper::reset() {
+    memset(&current_, 0, sizeof(current_));
+    held_ = 0;
+}
+
+size_t RolloverTyper::press(uint8_t key, uint8_t modifiers, KeyReport* out) {
+    size_t count = 0;
+
+    for (uint8_t i = 0; i < held_; ++i) {
+        if (current_.keys[i] == key) {
+            // Same key again: the host needs to see it go up first, even if the
+            // modifiers change as well
+            memmove(&current_.keys[i], &current_.keys[i + 1], held_ - i - 1);
+            current_.keys[--held_] = 0;
+            out[count++] = current_;
+            break;
+        }
+    }
+
+    if (modifiers != current_.modifiers) {
+        // Keys held under the old modifiers are released in the same report
+        memset(&current_, 0, sizeof(current_));
+        current_.modifiers = modifiers;
+        current_.keys[0] = key;
+        held_ = 1;
+        out[count++] = current_;
+        return count;
+    }
+
+    if (held_ == sizeof(current_.keys)) {
+        memmove(&current_.keys[0], &current_.keys[1], held_ - 1);
+        current_.keys[--held_] = 0;
+    }
+    current_.keys[held_++] = key;
+    out[count++] = current_;
+    return count;
+}
+
+size_t RolloverTyper::release(KeyReport* out) {
+    if (!isHolding()) return 0;
+    reset();
+    out[0] = current_;
+    return 1;
+}
@@ -0,0 +1,41 @@
+#ifndef ROLLOVER_TYPER_H
+#define ROLLOVER_TYPER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "KeyReport.h"
+
+// Builds the report stream for typing text with overlapping key presses.
+//
+// Classic typing sends press + full release for every character. Here each
+// report is built from the previous one: keys stay held in the six report
+// slots and are only released when
+//   - the same key has to be pressed again (release it, then press),
+//   - the modifiers change (one report with the new modifiers and only the
+//     new key), or
+//   - all slots are full (the oldest key is dropped in the same report).
+// A host sees exactly one new key per report, so the typed text is the same
+// with about one report per character instead of two. Call release() at the
+// end of a run so nothing is left held long enough to autorepeat.
+class RolloverTyper {
+public:
+    static constexpr size_t MAX_REPORTS_PER_KEY = 2;
+
+    RolloverTyper() { reset(); }
+    void reset();
+
+    // Writes the reports that press key with modifiers to out.
+    // Returns the number of reports written (1 or 2).
+    size_t press(uint8_t key, uint8_t modifiers, KeyReport* out);
+    // Writes the report releasing everything still held. Returns 0 if nothing is held.
+    size_t release(KeyReport* out);
+
+    const KeyReport& current() const { return current_; }
+    bool isHolding() const { return held_ > 0 || current_.modifiers != 0; }
+
+private:
+    KeyReport current_;
+    uint8_t held_; // Keys fill slots 0..held_-1, oldest first
+};
+
+#endif
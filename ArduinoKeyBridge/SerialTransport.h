@@ -0,0 +1,42 @@
+#ifndef SERIAL_TRANSPORT_H
+#define SERIAL_TRANSPORT_H
+
+#include <Arduino.h>
+#include "Transport.h"
+
+// Bridge protocol over a serial port. Serial carries the log, so use a
+// second port (e.g. Serial1 on the UNO R4 header pins). A serial link has no
+// connection, the peer counts as connected from the first poll on.
+class SerialTransport : public Transport {
+public:
+    explicit SerialTransport(Stream& stream) : stream_(stream) {}
+
+    bool accept() override {
+        if (accepted_) return false;
+        accepted_ = true;
+        return true;
+    }
+    bool connected() override { return true; }
+
+    int available() override { return stream_.available(); }
+    int read() override { return stream_.read(); }
+    int read(uint8_t* buf, size_t length) override {
+        // readBytes() waits for missing bytes, only ask for what is there
+        int ready = stream_.available();
+        if (ready <= 0) return 0;
+        if (size_t(ready) < length) length = size_t(ready);
+        return int(stream_.readBytes(buf, length));
+    }
+
+    size_t write(const uint8_t* data, size_t length) override { return stream_.write(data, length); }
+    void flush() override { stream_.flush(); }
+    // One USB full speed bulk packet
+    size_t maxPayload() const override { return 64; }
+    const char* name() const override { return "serial"; }
+
+private:
+    Stream& stream_;
+    bool accepted_ = false;
+};
+
+#endif
@@ -0,0 +1,182 @@
+#include "SnippetLibrary.h"
+#include "Crc16.h"
+#include <string.h>
+
+namespace {
+    uint16_t read16(const SnippetLibrary::Reader& reader, size_t offset) {
+        return uint16_t(reader.read(offset)) | (uint16_t(reader.read(offset + 1)) << 8);
+    }
+
+    void write16(uint8_t* out, uint16_t value) {
+        out[0] = uint8_t(value & 0xFF);
+        out[1] = uint8_t(value >> 8);
+    }
+}
+
+void SnippetLibrary::clear() {
+    count_ = 0;
+    imageSize_ = 0;
+    reader_ = nullptr;
+}
+
+uint16_t SnippetLibrary::hashName(const char* name, size_t length) {
+    // FNV-1a, folded to 16 bits
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= uint8_t(name[i]);
+        hash *= 16777619u;
+    }
+    return uint16_t((hash >> 16) ^ (hash & 0xFFFF));
+}
+
+bool SnippetLibrary::load(const Reader& reader, size_t capacity) {
+    clear();
+    if (capacity < HEADER_SIZE + 2) return false;
+    if (reader.read(0) != 'S' || reader.read(1) != 'L' || reader.read(2) != VERSION) return false;
+    size_t count = reader.read(3);
+    size_t length = read16(reader, 4);
+    size_t dataStart = HEADER_SIZE + count * (ENTRY_SIZE + 1);
+    if (count > MAX_SNIPPETS || length > capacity || length < dataStart + 2) return false;
+
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length - 2; ++i) {
+        uint8_t byte = reader.read(i);
+        crc = crc16Update(crc, &byte, 1);
+    }
+    if (crc != read16(reader, length - 2)) return false;
+
+    size_t textEnd = length - 2;
+    for (size_t i = 0; i < count; ++i) {
+        size_t at = HEADER_SIZE + i * ENTRY_SIZE;
+        Entry& entry = entries_[i];
+        entry.id = read16(reader, at);
+        entry.record = read16(reader, at + 2);
+        entry.length = read16(reader, at + 4);
+        entry.hash = read16(reader, at + 6);
+        if (i > 0 && entry.id <= entries_[i - 1].id) return false;
+        if (entry.record < dataStart) return false;
+
+        // Name: NUL terminated, matching its hash
+        char name[MAX_NAME_LENGTH + 1];
+        size_t n = 0;
+        while (n <= MAX_NAME_LENGTH && entry.record + n < textEnd && (name[n] = char(reader.read(entry.record + n))) != 0) n++;
+        if (n == 0 || n > MAX_NAME_LENGTH || entry.record + n >= textEnd) return false;
+        if (hashName(name, n) != entry.hash) return false;
+        entry.text = uint16_t(entry.record + n + 1);
+        if (entry.text + size_t(entry.length) > textEnd) return false;
+    }
+
+    // The name index must be a permutation sorted by hash
+    bool seen[MAX_SNIPPETS] = {};
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t e = reader.read(HEADER_SIZE + count * ENTRY_SIZE + i);
+        if (e >= count || seen[e]) return false;
+        if (i > 0 && entries_[e].hash < entries_[byName_[i - 1]].hash) return false;
+        seen[e] = true;
+        byName_[i] = e;
+    }
+
+    count_ = count;
+    imageSize_ = length;
+    reader_ = &reader;
+    return true;
+}
+
+bool SnippetLibrary::find(uint16_t id, Snippet& out) const {
+    size_t lo = 0, hi = count_;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (entries_[mid].id < id) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == count_ || entries_[lo].id != id) return false;
+    out = Snippet{entries_[lo].id, entries_[lo].text, entries_[lo].length};
+    return true;
+}
+
+bool SnippetLibrary::find(const char* name, Snippet& out) const {
+    size_t length = strlen(name);
+    if (length == 0 || length > MAX_NAME_LENGTH) return false;
+    uint16_t hash = hashName(name, length);
+    size_t lo = 0, hi = count_;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (entries_[byName_[mid]].hash < hash) lo = mid + 1;
+        else hi = mid;
+    }
+    // Names with the same hash sit next to each other
+    for (; lo < count_ && entries_[byName_[lo]].hash == hash; ++lo) {
+        const Entry& entry = entries_[byName_[lo]];
+        if (nameEquals(entry, name, length)) {
+            out = Snippet{entry.id, entry.text, entry.length};
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SnippetLibrary::nameEquals(const Entry& entry, const char* name, size_t length) const {
+    // The name ends right before the text
+    if (size_t(entry.text - entry.record - 1) != length) return false;
+    for (size_t i = 0; i < length; ++i) {
+        if (char(reader_->read(entry.record + i)) != name[i]) return false;
+    }
+    return true;
+}
+
+size_t SnippetLibrary::build(const Source* sources, size_t count, uint8_t* out, size_t capacity) {
+    if (count > MAX_SNIPPETS) return 0;
+    // Insertion sorts, the library is small
+    uint8_t byId[MAX_SNIPPETS];
+    uint8_t byName[MAX_SNIPPETS];
+    uint16_t hashes[MAX_SNIPPETS];
+    for (size_t i = 0; i < count; ++i) {
+        size_t nameLength = strlen(sources[i].name);
+        if (nameLength == 0 || nameLength > MAX_NAME_LENGTH) return 0;
+        hashes[i] = hashName(sources[i].name, nameLength);
+        for (size_t j = 0; j < i; ++j) {
+            if (sources[j].id == sources[i].id || !strcmp(sources[j].name, sources[i].name)) return 0;
+        }
+        size_t k = i;
+        while (k > 0 && sources[byId[k - 1]].id > sources[i].id) {
+            byId[k] = byId[k - 1];
+            k--;
+        }
+        byId[k] = uint8_t(i);
+    }
+    // byName holds positions in the id order, which is what the image stores
+    for (size_t i = 0; i < count; ++i) {
+        size_t k = i;
+        while (k > 0 && hashes[byId[byName[k - 1]]] > hashes[byId[i]]) {
+            byName[k] = byName[k - 1];
+            k--;
+        }
+        byName[k] = uint8_t(i);
+    }
+
+    size_t at = HEADER_SIZE + count * (ENTRY_SIZE + 1);
+    if (at > capacity) return 0;
+    for (size_t i = 0; i < count; ++i) {
+        const Source& source = sources[byId[i]];
+        size_t nameLength = strlen(source.name);
+        if (source.length > 0xFFFF || at + nameLength + 1 + source.length + 2 > capacity || at > 0xFFFF) return 0;
+        uint8_t* entry = out + HEADER_SIZE + i * ENTRY_SIZE;
+        write16(entry, source.id);
+        write16(entry + 2, uint16_t(at));
+        write16(entry + 4, uint16_t(source.length));
+        write16(entry + 6, hashes[byId[i]]);
+        memcpy(out + at, source.name, nameLength + 1);
+        at += nameLength + 1;
+        memcpy(out + at, source.text, source.length);
+        at += source.length;
+        out[HEADER_SIZE + count * ENTRY_SIZE + i] = byName[i];
+    }
+    if (at + 2 > 0xFFFF) return 0;
+    out[0] = 'S';
+    out[1] = 'L';
+    out[2] = VERSION;
+    out[3] = uint8_t(count);
+    write16(out + 4, uint16_t(at + 2));
+    write16(out + at, crc16(out, at));
+    return at + 2;
+}
@@ -0,0 +1,100 @@
+#ifndef SNIPPET_LIBRARY_H
+#define SNIPPET_LIBRARY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Canned text (signatures, boilerplate, commands) stored in data flash and
+// typed from there without asking the server.
+//
+// The library is one image, uploaded as a SNIPPET_BLOB (little endian):
+//
+//   0   'S' 'L' version count, image length (2 bytes)
+//   6   count x ENTRY_SIZE, sorted by id:
+//         id, record offset, text length, name hash (2 bytes each)
+//   ..  count x entry number, sorted by name hash
+//   ..  records: name, NUL, text (offsets from the start of the image)
+//   end CRC-16/CCITT-FALSE of everything before it
+//
+// load() validates the image and copies the index to RAM, so finding a
+// snippet by id is a binary search without touching flash; by name it is a
+// binary search on the hash plus a name compare. The text stays in flash and
+// is read a character at a time through a Reader, so a 4 KB snippet never
+// needs 4 KB of RAM.
+class SnippetLibrary {
+public:
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 6;
+    static constexpr size_t ENTRY_SIZE = 8;
+    static constexpr size_t MAX_SNIPPETS = 64;
+    static constexpr size_t MAX_NAME_LENGTH = 23;
+
+    // Byte source for the image: data flash on the board, memory on the host
+    class Reader {
+    public:
+        virtual ~Reader() = default;
+        virtual uint8_t read(size_t offset) const = 0;
+    };
+
+    class MemoryReader : public Reader {
+    public:
+        explicit MemoryReader(const uint8_t* data) : data_(data) {}
+        uint8_t read(size_t offset) const override { return data_[offset]; }
+    private:
+        const uint8_t* data_;
+    };
+
+    struct Snippet {
+        uint16_t id;
+        uint16_t text;   // Offset of the text in the image
+        uint16_t length;
+    };
+
+    // One snippet for build()
+    struct Source {
+        uint16_t id;
+        const char* name;
+        const char* text;
+        size_t length;
+    };
+
+    SnippetLibrary() { clear(); }
+    void clear();
+
+    // Validates the image read through reader, at most capacity bytes, and
+    // loads its index. reader must outlive the library. On failure the
+    // library is empty.
+    bool load(const Reader& reader, size_t capacity);
+
+    bool find(uint16_t id, Snippet& out) const;
+    bool find(const char* name, Snippet& out) const;
+    // Character i of snippet, straight from the image
+    char textAt(const Snippet& snippet, size_t i) const { return char(reader_->read(snippet.text + i)); }
+
+    size_t count() const { return count_; }
+    size_t imageSize() const { return imageSize_; }
+
+    // Builds an image on the host. Returns its size, or 0 if ids or names
+    // repeat, a name is empty or too long, or out is too small.
+    static size_t build(const Source* sources, size_t count, uint8_t* out, size_t capacity);
+    static uint16_t hashName(const char* name, size_t length);
+
+private:
+    struct Entry {
+        uint16_t id;
+        uint16_t hash;
+        uint16_t record;
+        uint16_t text;
+        uint16_t length;
+    };
+
+    Entry entries_[MAX_SNIPPETS];    // Sorted by id
+    uint8_t byName_[MAX_SNIPPETS];  // Entry numbers sorted by name hash
+    size_t count_;
+    size_t imageSize_;
+    const Reader* reader_;
+
+    bool nameEquals(const Entry& entry, const char* name, size_t length) const;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#include "SnippetStore.h"
+#include "TCPConnection.h"
+#include "ArduinoKeyBridgeLogger.h"
+#include <EEPROM.h>
+
+SnippetStore& SnippetStore::getInstance() {
+    static SnippetStore instance;
+    return instance;
+}
+
+uint8_t SnippetStore::FlashReader::read(size_t offset) const {
+    return EEPROM.read(FlashLayout::SNIPPET_ADDRESS + offset);
+}
+
+void SnippetStore::begin() {
+    if (library_.load(reader_, FlashLayout::SNIPPET_SIZE)) {
+        ArduinoKeyBridgeLogger::getInstance().info("Snippets", String("Loaded ") + library_.count() + " snippets, " + library_.imageSize() + " bytes");
+    } else {
+        ArduinoKeyBridgeLogger::getInstance().info("Snippets", "No stored snippets");
+    }
+}
+
+bool SnippetStore::beginBlob(size_t length) {
+    if (length > FlashLayout::SNIPPET_SIZE) return false;
+    // The text about to be overwritten may be typing right now
+    TCPConnection::getInstance().cancelSnippet();
+    library_.clear();
+    length_ = 0;
+    // Invalidate the old image first, so a broken upload never half loads
+    EEPROM.update(FlashLayout::SNIPPET_ADDRESS, 0xFF);
+    return true;
+}
+
+bool SnippetStore::writeBlob(const uint8_t* data, size_t length, size_t offset) {
+    if (offset + length > FlashLayout::SNIPPET_SIZE) return false;
+    // update() skips bytes that are already equal, sparing flash erase cycles
+    for (size_t i = 0; i < length; ++i) {
+        // The magic byte goes last, in endBlob()
+        if (offset + i == 0) continue;
+        EEPROM.update(FlashLayout::SNIPPET_ADDRESS + offset + i, data[i]);
+    }
+    if (offset == 0 && length > 0) first_ = data[0];
+    length_ = offset + length;
+    return true;
+}
+
+bool SnippetStore::endBlob() {
+    // A zero length upload clears the library
+    if (length_ == 0) {
+        ArduinoKeyBridgeLogger::getInstance().info("Snippets", "Snippets cleared");
+        return true;
+    }
+    EEPROM.update(FlashLayout::SNIPPET_ADDRESS, first_);
+    if (!library_.load(reader_, length_)) {
+        EEPROM.update(FlashLayout::SNIPPET_ADDRESS, 0xFF);
+        ArduinoKeyBridgeLogger::getInstance().warning("Snippets", String("Rejected snippet image of ") + length_ + " bytes");
+        return false;
+    }
+    ArduinoKeyBridgeLogger::getInstance().info("Snippets", String("Loaded ") + library_.count() + " snippets over TCP");
+    return true;
+}
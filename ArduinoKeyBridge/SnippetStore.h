@@ -0,0 +1,43 @@
+#ifndef SNIPPET_STORE_H
+#define SNIPPET_STORE_H
+
+#include <Arduino.h>
+#include "SnippetLibrary.h"
+#include "BlobSink.h"
+#include "FlashLayout.h"
+
+// Owns the SnippetLibrary in data flash. Loaded at boot and replaced by
+// SNIPPET_BLOB uploads over TCP. An image is too big to stage in RAM, so
+// uploads are written straight to flash and the library stays empty until
+// the new image validates.
+class SnippetStore : public BlobSink {
+public:
+    static SnippetStore& getInstance();
+
+    // Load the stored library, if there is one
+    void begin();
+    const SnippetLibrary& library() const { return library_; }
+
+    bool beginBlob(size_t length) override;
+    bool writeBlob(const uint8_t* data, size_t length, size_t offset) override;
+    bool endBlob() override;
+
+private:
+    // Reads the snippet region of data flash
+    class FlashReader : public SnippetLibrary::Reader {
+    public:
+        uint8_t read(size_t offset) const override;
+    };
+
+    SnippetLibrary library_;
+    FlashReader reader_;
+    size_t length_ = 0;
+    uint8_t first_ = 0xFF; // Magic byte of the upload, written once the rest is in flash
+
+    SnippetStore() = default;
+    ~SnippetStore() = default;
+    SnippetStore(const SnippetStore&) = delete;
+    SnippetStore& operator=(const SnippetStore&) = delete;
+};
+
+#endif
@@ -1,103 +1,215 @@
 #include "TCPConnection.h"
 #include "ArduinoKeyBridgeLogger.h"
+#include "BridgeClock.h"
+#include "SnippetStore.h"
+#include "CalibrationStore.h"
+#include "ConfigStore.h"
+#include "LoopWatchdog.h"
 
 TCPConnection& TCPConnection::getInstance() {
     static TCPConnection instance;
     return instance;
 }
 
-TCPConnection::TCPConnection() {}
+TCPConnection::TCPConnection() {
+    writer_.setTransport(transport_);
+}
 
 void TCPConnection::startAP() {
-    WiFi.beginAP(AP_SSID, AP_PASSWORD);
-    while (WiFi.status() != WL_AP_LISTENING) {
-        ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Starting access point");
-        delay(100);
-    }
-    ArduinoKeyBridgeLogger::getInstance().info("TCPConnection", "Access Point started");
-    ArduinoKeyBridgeLogger::getInstance().info("TCPConnection", String("Local IP address: ") + WiFi.localIP().toString());
-    server_.begin();
+    const BridgeConfig& config = ConfigStore::config();
+    wifi_.begin(config.apSsid, config.apPassword, config.port);
+}
+
+void TCPConnection::useTransport(Transport& transport) {
+    transport_ = &transport;
+    writer_.setTransport(transport_);
+    ArduinoKeyBridgeLogger::getInstance().info("TCPConnection", String("Transport: ") + transport.name());
 }
 
 void TCPConnection::poll() {
     // First check for new client connection
-    if (!client_ || !client_.connected()) {
-        client_ = server_.available();
-        if (client_) {
-            IPAddress clientIP = client_.remoteIP();
-            ArduinoKeyBridgeLogger::getInstance().info("TCPConnection", String("New client connected from IP: ") + clientIP.toString() );
-            ready_ = true;
-        }
+    if (transport_->accept()) {
+        ready_ = true;
+        // Every connection starts with raw 8-byte framing
+        parser_.reset();
+        writer_.reset();
+        charter_receiving_ = false;
+        blob_receiving_ = false;
+        // Reports typed before this client connected are not its business
+        mirror_.clear();
+        // The server that asked for calibration is gone
+        if (isCalibrating()) finishCalibration(false);
+        trace_exporting_ = false;
     }
 
-    if (client_ && client_.connected()) {
+    // F18 dumps are typed a chunk at a time so streamed text keeps flowing in
+    if (charter_dumping_) {
+        serviceCharterDump();
+    }
+    if (snippet_typing_) {
+        serviceSnippet();
+    }
+    if (isCalibrating()) {
+        serviceCalibration();
+    }
+    serviceTracing();
 
-        /*
-        if (is_charter_mode()) {
-            // Type out packet and then revert to false for charter mode 
-            ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Charter executing");
-            type_charter(client_.readStringUntil('\0').c_str());
-            //charter_mode_ = false;
-            //change_mode(KeyReport{0x22, 0x00, {0x11, 0x11, 0x11, 0x11, 0x11, 0x11}});
-            return;
+    if (transport_->connected()) {
+        if (charter_receiving_) {
+            pollCharterText();
+        } else if (blob_receiving_) {
+            pollBlob();
+        } else {
+            pollFrames();
         }
-        */
-
-        if (is_charter_mode()) {
-            static String buffer = "";
-            while (client_.available() > 0) {
-                char c = client_.read();
-                if (c == '\0') {
-                    if (buffer.length() > 0) {
-                        ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Charter mode EXITING");
-                        charterBuffer = buffer;
-                        charter_mode_ = false;
-                        change_mode(KeyReport{0x22, 0x00, {0x11, 0x11, 0x11, 0x11, 0x11, 0x11}});
-                        break;
-                    } else {
-                        // Ignore empty strings, stay in charter mode
-                        continue;
-                    }
-                } else {
-                    buffer += c;
-                }
+        drainMirror();
+        // Batching transports send what this poll produced in as few packets as possible
+        writer_.flush();
+    }
+}
+
+void TCPConnection::startCharterStream(bool compressed) {
+    // A new transfer replaces whatever was left from the previous one
+    charterBuffer.clear();
+    charter_receiving_ = true;
+    charter_compressed_ = compressed;
+    charter_decoder_.reset();
+    charter_wire_bytes_ = 0;
+    charter_decode_errors_ = 0;
+    charter_stream_bytes_ = 0;
+    charter_stream_typed_ = false;
+    charter_credit_.reset();
+    grantCharterCredit(true, true);
+}
+
+void TCPConnection::pollCharterText() {
+    if (charter_compressed_) {
+        pollCompressedCharterText();
+        return;
+    }
+    // Never read more than there is room for; anything beyond stays queued in
+    // the WiFi module and TCP pushes back on a sender that ignores credit.
+    while (charterBuffer.freeSpace() > 0 && transport_->available() > 0) {
+        int c = transport_->read();
+        if (c < 0) break;
+        charter_credit_.consumed();
+        charter_wire_bytes_++;
+
+        if (c == BridgeProtocol::TEXT_TERMINATOR) {
+            if (charter_stream_bytes_ == 0) {
+                // Ignore empty strings, stay in charter mode
+                continue;
             }
+            finishCharterStream();
             return;
         }
 
-        // if packet is less than 8 bytes but larger than 0, log it
-        if (client_.available() > 0 && client_.available() < 8) {
-            ArduinoKeyBridgeLogger::getInstance().warning("TCPConnection", "Received incomplete key report: " + String(client_.available()) + " bytes");
+        charterBuffer.push((char)c);
+        charter_stream_bytes_++;
+    }
+}
 
+void TCPConnection::pollCompressedCharterText() {
+    // Expand one character at a time into free space; compressed bytes are
+    // only read once the previous token is fully written out
+    while (charterBuffer.freeSpace() > 0) {
+        if (charter_decoder_.pending() > 0) {
+            charterBuffer.push(charter_decoder_.next());
+            charter_stream_bytes_++;
+            continue;
         }
-
-        // if packet is too large log it 
-        if (client_.available() > 8) {
-            ArduinoKeyBridgeLogger::getInstance().warning("TCPConnection", "Received too large key report: " + String(client_.available()) + " bytes");
+        if (transport_->available() <= 0) break;
+        int c = transport_->read();
+        if (c < 0) break;
+        charter_credit_.consumed();
+        charter_wire_bytes_++;
+
+        CharterCodec::Decoder::Result result = charter_decoder_.feed(uint8_t(c));
+        if (result == CharterCodec::Decoder::DONE) {
+            finishCharterStream();
+            return;
         }
+        // The bad token is skipped, the stream stays in sync
+        if (result == CharterCodec::Decoder::FAILED) charter_decode_errors_++;
+    }
+    grantCharterCredit(false);
+}
 
-        // Only process 8-byte key report packets
-        while (client_.available() >= 8) {
-            uint8_t buf[8];
-            size_t bytesRead = client_.read(buf, 8);
-            
-            if (bytesRead == 8) {
-                ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Received 8-byte KeyReport from client");
-                ArduinoKeyBridgeLogger::getInstance().hexDump("TCPConnection", buf, 8);
-                
-                KeyReport report = bufferToKeyReport(buf);
-                if (change_mode(report)) {
-                    if (charter_mode_) break;
-                    continue;
+void TCPConnection::finishCharterStream() {
+    ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", String("Charter stream complete: ") + charter_stream_bytes_ + " bytes (" + charter_wire_bytes_ + " on the wire), peak buffer " + charterBuffer.highWater() + " bytes");
+    if (charter_decode_errors_ > 0) {
+        ArduinoKeyBridgeLogger::getInstance().warning("TCPConnection", String("Compressed charter stream had ") + charter_decode_errors_ + " bad tokens");
+        ArduinoKeyBridgeNeoPixel::getInstance().flash(NeoPixelColors::RED);
+    }
+    charter_receiving_ = false;
+    // A short paste ends charter mode as before; a long stream the user
+    // is already typing along with stays in charter mode
+    if (!charter_stream_typed_) {
+        ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Charter mode EXITING");
+        charter_mode_ = false;
+        change_mode(BridgeProtocol::makeControlReport(BridgeProtocol::Control::COMMAND_OFF));
+    }
+}
+
+void TCPConnection::grantCharterCredit(bool force, bool start) {
+    if (!charter_receiving_) return;
+    // Outstanding credit never exceeds free space, so the buffer can't overflow.
+    // Compressed bytes expand by an unknown factor and are read only when
+    // there is room, so for them the credit is a fixed window instead.
+    size_t room = charter_compressed_ ? COMPRESSED_CHARTER_CREDIT : charterBuffer.freeSpace();
+    size_t ungranted = charter_credit_.grant(room, charterBuffer.isEmpty(), force);
+    if (ungranted == 0) return;
+    uint8_t code = start ? BridgeProtocol::Notify::CREDIT_START : BridgeProtocol::Notify::CREDIT;
+    writeReport(BridgeProtocol::makeValueReport(code, (uint16_t)ungranted));
+}
+
+void TCPConnection::serviceCharterDump() {
+    if (!charter_mode_) {
+        charter_dumping_ = false;
+        return;
+    }
+    // Only type a chunk the HID queue can take whole, so the dump never blocks
+    if (MinimalKeyboard::getInstance().reportQueue().freeSpace() < CHARTER_DUMP_REPORTS) return;
+    for (size_t i = 0; i < ConfigStore::config().charterChunk && !charterBuffer.isEmpty(); ++i) {
+        typeNextCharFromBuffer();
+    }
+    // Keys may overlap within a chunk but never stay held between polls
+    finishTyping();
+    if (charterBuffer.isEmpty() && !charter_receiving_) {
+        charter_dumping_ = false;
+    }
+}
+
+void TCPConnection::pollFrames() {
+    while (transport_->available() > 0) {
+        int byte = transport_->read();
+        if (byte < 0) break;
+
+        switch (parser_.feed(uint8_t(byte))) {
+            case BridgeFraming::FrameParser::REPORT: {
+                KeyReport report = parser_.report();
+                if (parser_.eventEncoding()) {
+                    ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Received event-encoded KeyReport from client");
+                } else {
+                    ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Received 8-byte KeyReport from client");
+                    ArduinoKeyBridgeLogger::getInstance().hexDump("TCPConnection", (const uint8_t*)&report, sizeof(report));
+                    report = bufferToKeyReport((const uint8_t*)&report);
                 }
-                MinimalKeyboard::getInstance().sendReport(&report);
-            } else {
-                ArduinoKeyBridgeLogger::getInstance().warning("TCPConnection", String("Received incomplete key report: ") + bytesRead + " bytes");
-                // Clear any remaining data to prevent buffer issues
-                while (client_.available()) {
-                    client_.read();
+                MinimalKeyboard::getInstance().sendReport(&report, LatencyTracer::getInstance().takeServerTag());
+                break;
+            }
+            case BridgeFraming::FrameParser::CONTROL: {
+                KeyReport control = parser_.controlReport();
+                // A raw frame that only looks like an unknown control report is still keys
+                if (!change_mode(control) && !parser_.eventEncoding()) {
+                    MinimalKeyboard::getInstance().sendReport(&control, LatencyTracer::getInstance().takeServerTag());
                 }
+                // Charter text, blobs and framing changes apply to what follows
+                if (charter_receiving_ || blob_receiving_) return;
+                break;
             }
+            default:
+                break;
         }
     }
 }
@@ -118,87 +230,298 @@ void TCPConnection::set_charter_mode(bool mode) {
     charter_mode_ = mode;
 }
 
+void TCPConnection::set_mirror_mode(bool enabled) {
+    mirror_mode_ = enabled;
+    mirror_.clear();
+    writeReport(BridgeProtocol::makeControlReport(enabled ? BridgeProtocol::Notify::MIRROR_ON : BridgeProtocol::Notify::MIRROR_OFF));
+    ArduinoKeyBridgeLogger::getInstance().info("TCPConnection", String("Command mode mirroring ") + (enabled ? "ON (local first)" : "OFF (server only)"));
+}
+
+bool TCPConnection::is_mirror_mode() {
+    return mirror_mode_;
+}
+
+void TCPConnection::mirrorKeyReport(const KeyReport& report) {
+    // Only queued for a client that can receive it; the USB task never writes
+    if (transport_->connected()) mirror_.push(report);
+}
+
+void TCPConnection::drainMirror() {
+    // A batch per poll, the rest waits for the next one
+    KeyReport report;
+    for (size_t i = 0; i < MIRROR_BATCH && mirror_.pop(report); ++i) {
+        writeReport(report);
+    }
+}
+
+bool TCPConnection::is_event_encoding() {
+    return parser_.eventEncoding();
+}
+
+void TCPConnection::set_event_encoding(bool enabled) {
+    if (enabled == parser_.eventEncoding()) return;
+    if (enabled) {
+        // The ack is the last raw frame; both directions start from an empty report
+        writeReport(BridgeProtocol::makeControlReport(BridgeProtocol::Notify::EVENTS_ON));
+    } else {
+        // The encoded EVENTS_OFF marks where raw frames start again
+        writeReport(BridgeProtocol::makeControlReport(BridgeProtocol::Control::EVENTS_OFF));
+    }
+    parser_.setEventEncoding(enabled);
+    writer_.setEventEncoding(enabled);
+    ArduinoKeyBridgeLogger::getInstance().info("TCPConnection", String("Event encoding ") + (enabled ? "ON" : "OFF"));
+}
+
 bool TCPConnection::change_mode(const KeyReport& report) {
-    // Convert keys to uint8_t for hex comparison
-    uint8_t modifiers = report.modifiers;
-    uint8_t k0 = (uint8_t)report.keys[0];
-    uint8_t k1 = (uint8_t)report.keys[1];
-    uint8_t k2 = (uint8_t)report.keys[2];
-    uint8_t k3 = (uint8_t)report.keys[3];
-    uint8_t k4 = (uint8_t)report.keys[4];
-    uint8_t k5 = (uint8_t)report.keys[5];
-
-    // Example "switch" on key report patterns
-    if (modifiers == 0x22 && k0 == 10 && k1 == 10 && k2 == 10 && k3 == 10 && k4 == 10 && k5 == 10) {
-        ArduinoKeyBridgeNeoPixel::getInstance().setColor(NeoPixelColors::BLUE);
-        ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Special report: ALL -10 (e.g., command mode ON)");
-        //TCPConnection::getInstance().sendKeyReport(KeyReport{0x22, 0x00, {0x10, 0x10, 0x10, 0x10, 0x10, 0x10}});
-        return true;
-
-    } else if (modifiers == 0x22 && k0 == 11 && k1 == 11 && k2 == 11 && k3 == 11 && k4 == 11 && k5 == 11) {
-        ArduinoKeyBridgeNeoPixel::getInstance().setColor(NeoPixelColors::WHITE);
-        ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Special report: ALL 11 (e.g., command mode OFF)");
-        //TCPConnection::getInstance().sendKeyReport(KeyReport{0x22, 0x00, {0x11, 0x11, 0x11, 0x11, 0x11, 0x11}});
-        return true;
-
-    } else if (modifiers == 0x22 && k0 == 12 && k1 == 12 && k2 == 12 && k3 == 12 && k4 == 12 && k5 == 12) {
-        ArduinoKeyBridgeNeoPixel::getInstance().setColor(NeoPixelColors::GREEN);
-        ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Special report: ALL 12 (another custom command)");
-        // good command
-        return true;
-    } else if (modifiers == 0x22 && k0 == 13 && k1 == 13 && k2 == 13 && k3 == 13 && k4 == 13 && k5 == 13) {
-        ArduinoKeyBridgeNeoPixel::getInstance().setColor(NeoPixelColors::RED);
-        ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Special report: ALL 13 (another custom command)");
-        // bad command
-        return true;
-    } else if (modifiers == 0x22 && k0 == 14 && k1 == 14 && k2 == 14 && k3 == 14 && k4 == 14 && k5 == 14) {
-        ArduinoKeyBridgeNeoPixel::getInstance().setColor(NeoPixelColors::YELLOW);
-        ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Special report: ALL 14 (another custom command)");
-        // bad command
-        return true;
-    } else if (modifiers == 0x22 && k0 == 2 && k1 == 2 && k2 == 2 && k3 == 2 && k4 == 2 && k5 == 2) {
-        ArduinoKeyBridgeNeoPixel::getInstance().setColor(NeoPixelColors::MAGENTA);
-        ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Special report: ALL 2 (charter mode)");
-        charter_mode_ = true;
-        // bad command
-        return true;
-    }
-    // ...add more patterns as needed...
-
-    // Default: not a special report
-    return false;
+    // Value reports carry a 16-bit argument
+    uint16_t value = 0;
+    uint8_t valueCode = BridgeProtocol::valueCode(report, value);
+    if (valueCode != BridgeProtocol::Control::NONE) {
+        return change_value(valueCode, value);
+    }
+
+    // Control reports carry the same code in all six key slots
+    switch (BridgeProtocol::controlCode(report)) {
+        case BridgeProtocol::Control::COMMAND_ON:
+            ArduinoKeyBridgeNeoPixel::getInstance().setColor(NeoPixelColors::BLUE);
+            ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Special report: ALL -10 (e.g., command mode ON)");
+            return true;
+
+        case BridgeProtocol::Control::COMMAND_OFF:
+            ArduinoKeyBridgeNeoPixel::getInstance().setColor(NeoPixelColors::WHITE);
+            ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Special report: ALL 11 (e.g., command mode OFF)");
+            return true;
+
+        case BridgeProtocol::Control::GOOD:
+            ArduinoKeyBridgeNeoPixel::getInstance().flash(NeoPixelColors::GREEN);
+            ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Special report: ALL 12 (another custom command)");
+            // good command
+            return true;
+
+        case BridgeProtocol::Control::BAD:
+            ArduinoKeyBridgeNeoPixel::getInstance().flash(NeoPixelColors::RED);
+            ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Special report: ALL 13 (another custom command)");
+            // bad command
+            return true;
+
+        case BridgeProtocol::Control::WARN:
+            ArduinoKeyBridgeNeoPixel::getInstance().flash(NeoPixelColors::YELLOW);
+            ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Special report: ALL 14 (another custom command)");
+            return true;
+
+        case BridgeProtocol::Control::EVENTS_ON:
+            set_event_encoding(true);
+            return true;
+
+        case BridgeProtocol::Control::EVENTS_OFF:
+            set_event_encoding(false);
+            return true;
+
+        case BridgeProtocol::Control::MIRROR_ON:
+            set_mirror_mode(true);
+            return true;
+
+        case BridgeProtocol::Control::MIRROR_OFF:
+            set_mirror_mode(false);
+            return true;
+
+        case BridgeProtocol::Control::TYPING_CLASSIC:
+            set_rollover_typing(false);
+            return true;
+
+        case BridgeProtocol::Control::TYPING_ROLLOVER:
+            set_rollover_typing(true);
+            return true;
+
+        case BridgeProtocol::Control::CHARTER:
+            ArduinoKeyBridgeNeoPixel::getInstance().setColor(NeoPixelColors::MAGENTA);
+            ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Special report: ALL 2 (charter mode)");
+            charter_mode_ = true;
+            startCharterStream(false);
+            return true;
+
+        case BridgeProtocol::Control::CHARTER_COMPRESSED:
+            ArduinoKeyBridgeNeoPixel::getInstance().setColor(NeoPixelColors::MAGENTA);
+            ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Special report: ALL 7 (compressed charter)");
+            charter_mode_ = true;
+            startCharterStream(true);
+            return true;
+
+        case BridgeProtocol::Control::CALIBRATE:
+            ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Special report: ALL 15 (typing calibration)");
+            startCalibration();
+            return true;
+
+        case BridgeProtocol::Control::TRACE_QUERY:
+            trace_exporting_ = true;
+            trace_export_histogram_ = 0;
+            trace_export_bucket_ = 0;
+            return true;
+
+        case BridgeProtocol::Control::TRACE_RESET:
+            LatencyTracer::getInstance().clear();
+            return true;
+
+        // ...add more patterns as needed...
+        default:
+            // Default: not a special report
+            return false;
+    }
+}
+
+bool TCPConnection::change_value(uint8_t code, uint16_t value) {
+    switch (code) {
+        case BridgeProtocol::Control::REMAP_BLOB:
+        case BridgeProtocol::Control::SNIPPET_BLOB:
+        case BridgeProtocol::Control::CONFIG_BLOB:
+            startBlob(code, value);
+            return true;
+
+        case BridgeProtocol::Control::SNIPPET_TYPE:
+            typeSnippet(value);
+            return true;
+
+        case BridgeProtocol::Control::HOST_PROFILE:
+            CalibrationStore::getInstance().selectProfile(value);
+            return true;
+
+        case BridgeProtocol::Control::CALIBRATE_RESULT:
+            if (calibration_ == CALIBRATION_WAITING) calibrationResult(value == TypingCalibrator::probeCrc());
+            return true;
+
+        case BridgeProtocol::Control::TRACE_SAMPLE:
+            LatencyTracer::getInstance().setSampling(value);
+            ArduinoKeyBridgeLogger::getInstance().info("TCPConnection", value ? String("Latency tracing 1 in ") + value + " key reports" : String("Latency tracing OFF"));
+            return true;
+
+        case BridgeProtocol::Control::TRACE_HOLD:
+            LatencyTracer::getInstance().serverHold(value);
+            return true;
+
+        case BridgeProtocol::Control::TRACE_ID:
+            LatencyTracer::getInstance().serverTrace(value, BridgeClock::micros());
+            return true;
+
+        case BridgeProtocol::Control::STALL_BUDGET:
+            LoopWatchdog::getInstance().setBudget(value * 1000UL);
+            return true;
+
+        case BridgeProtocol::Control::LOG_RATE: {
+            // Burst of two seconds worth of messages
+            ArduinoKeyBridgeLogger& logger = ArduinoKeyBridgeLogger::getInstance();
+            logger.setRateLimit(value, value * 2, logger.rateLimit().sampleEvery);
+            return true;
+        }
+
+        case BridgeProtocol::Control::LOG_SAMPLE: {
+            ArduinoKeyBridgeLogger& logger = ArduinoKeyBridgeLogger::getInstance();
+            logger.setRateLimit(logger.rateLimit().perSecond, logger.rateLimit().burst, value ? value : 1);
+            return true;
+        }
+
+        default:
+            ArduinoKeyBridgeLogger::getInstance().warning("TCPConnection", String("Unknown value report 0x") + String(code, HEX));
+            return true;
+    }
+}
+
+bool TCPConnection::registerBlobSink(uint8_t code, BlobSink* sink) {
+    if (blob_route_count_ >= MAX_BLOB_SINKS) return false;
+    blob_routes_[blob_route_count_++] = BlobRoute{code, sink};
+    return true;
+}
+
+void TCPConnection::startBlob(uint8_t code, uint16_t length) {
+    blob_sink_ = nullptr;
+    for (size_t i = 0; i < blob_route_count_; ++i) {
+        if (blob_routes_[i].code == code) blob_sink_ = blob_routes_[i].sink;
+    }
+    blob_length_ = length;
+    blob_offset_ = 0;
+    // Unknown or rejected uploads are still read, so the stream stays in sync
+    blob_ok_ = blob_sink_ && blob_sink_->beginBlob(length);
+    blob_receiving_ = true;
+    ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", String("Receiving blob 0x") + String(code, HEX) + ": " + length + " bytes");
+    if (length == 0) finishBlob();
+}
+
+void TCPConnection::pollBlob() {
+    uint8_t buf[64];
+    while (blob_offset_ < blob_length_ && transport_->available() > 0) {
+        size_t remaining = blob_length_ - blob_offset_;
+        size_t want = remaining < sizeof(buf) ? remaining : sizeof(buf);
+        int got = transport_->read(buf, want);
+        if (got <= 0) break;
+        if (blob_ok_) blob_ok_ = blob_sink_->writeBlob(buf, got, blob_offset_);
+        blob_offset_ += got;
+    }
+    if (blob_offset_ >= blob_length_) finishBlob();
+}
+
+void TCPConnection::finishBlob() {
+    blob_receiving_ = false;
+    bool ok = blob_ok_ && blob_sink_->endBlob();
+    ArduinoKeyBridgeLogger::getInstance().info("TCPConnection", String("Blob of ") + blob_length_ + " bytes " + (ok ? "applied" : "rejected"));
+    writeReport(BridgeProtocol::makeControlReport(ok ? BridgeProtocol::Notify::BLOB_OK : BridgeProtocol::Notify::BLOB_ERROR));
 }
 
 void TCPConnection::sendKeyReport(const KeyReport& report) {
     ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Sending key report to client (sendKeyReport)");
-    if (client_ && client_.connected()) {
-        client_.write((const uint8_t*)&report, sizeof(KeyReport));
-        client_.flush();
+    if (transport_->connected()) {
+        writeReport(report);
         ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Sent key report to client (sendKeyReport)");
     }
 }
 
+void TCPConnection::forwardKeyReport(const KeyReport& report) {
+    if (!transport_->connected()) return;
+    LatencyTracer& tracer = LatencyTracer::getInstance();
+    uint16_t id = 0;
+    if (!tracer.forward(id)) {
+        sendKeyReport(report);
+        return;
+    }
+    writeReport(BridgeProtocol::makeValueReport(BridgeProtocol::Notify::TRACE_ID, id));
+    writeReport(report);
+    tracer.forwarded(id, BridgeClock::micros());
+}
+
 void TCPConnection::sendEmptyKeyReport() {
     ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Sending empty key report to client (sendEmptyKeyReport)");
-    if (client_ && client_.connected()) {
+    if (transport_->connected()) {
         KeyReport emptyKeyReport = {0};
-        client_.write((const uint8_t*)&emptyKeyReport, sizeof(KeyReport));
-        client_.flush();
+        writeReport(emptyKeyReport);
         ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Sent key report to client (sendKeyReport)");
     }
 }
 
+void TCPConnection::writeReport(const KeyReport& report) {
+    writer_.write(report);
+}
+
 bool TCPConnection::isReady() const {
     return ready_;
 }
 
 void TCPConnection::status() {
-    ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "WiFi Status: " + String(WiFiStatus::toString(WiFi.status())));
+    ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "WiFi Status: " + String(wifi_.wifiStatus()));
+    unsigned long now = BridgeClock::millis();
+    uint32_t calls = wifi_.stats().total();
+    if (now > status_ms_) {
+        ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", String("Modem transactions: ") + ((calls - status_modem_calls_) * 1000UL / (now - status_ms_)) + "/s, idle backoff " + wifi_.backoffMs() + " ms");
+    }
+    status_modem_calls_ = calls;
+    status_ms_ = now;
+    ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", String("Transport ") + transport_->name() + ": " + writer_.frames() + " frames in " + writer_.packets() + " packets, " + writer_.bytes() + " bytes");
+    ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", String("Mirror queue: ") + mirror_.pushed() + " mirrored, " + mirror_.dropped() + " dropped, peak " + mirror_.highWater() + "/" + MIRROR_QUEUE_SIZE);
+    ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", String("Charter buffer: ") + charterBuffer.length() + "/" + CharterBuffer::CAPACITY + " bytes, peak " + charterBuffer.highWater());
 }
 
 void TCPConnection::clientStatus() {
-    if (client_ && client_.connected()) {
-        ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Client connected: " + client_.remoteIP().toString());
+    if (transport_ == &wifi_ && wifi_.connected()) {
+        ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Client connected: " + wifi_.client().remoteIP().toString());
+    } else if (transport_->connected()) {
+        ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", String("Client connected over ") + transport_->name());
     } else {
         ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "No client connected.");
     }
@@ -210,20 +533,24 @@ KeyReport TCPConnection::bufferToKeyReport(const uint8_t* buf) {
     KeyReport report;
     report.modifiers = buf[0];
     report.reserved = buf[1];
+    // The messages below are only built if the first one gets printed
+    bool verbose = ArduinoKeyBridgeLogger::getInstance().allow(LogLevel::DEBUG, "TCPConnection");
     
     // Log the modifiers
-    String modifierStr = "";
-    if (report.modifiers & 0x01) modifierStr += "CTRL ";
-    if (report.modifiers & 0x02) modifierStr += "SHIFT ";
-    if (report.modifiers & 0x04) modifierStr += "ALT ";
-    if (report.modifiers & 0x08) modifierStr += "GUI ";
-    if (report.modifiers & 0x10) modifierStr += "LEFT_CTRL ";
-    if (report.modifiers & 0x20) modifierStr += "LEFT_SHIFT ";
-    if (report.modifiers & 0x40) modifierStr += "LEFT_ALT ";
-    if (report.modifiers & 0x80) modifierStr += "LEFT_GUI ";
-    
-    ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", 
-        "Received modifiers: 0x" + String(report.modifiers, HEX) + " (" + modifierStr + ")");
+    if (verbose) {
+        String modifierStr = "";
+        if (report.modifiers & 0x01) modifierStr += "CTRL ";
+        if (report.modifiers & 0x02) modifierStr += "SHIFT ";
+        if (report.modifiers & 0x04) modifierStr += "ALT ";
+        if (report.modifiers & 0x08) modifierStr += "GUI ";
+        if (report.modifiers & 0x10) modifierStr += "LEFT_CTRL ";
+        if (report.modifiers & 0x20) modifierStr += "LEFT_SHIFT ";
+        if (report.modifiers & 0x40) modifierStr += "LEFT_ALT ";
+        if (report.modifiers & 0x80) modifierStr += "LEFT_GUI ";
+
+        ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", 
+            "Received modifiers: 0x" + String(report.modifiers, HEX) + " (" + modifierStr + ")");
+    }
 
     // Process each key
     for (int i = 0; i < 6; ++i) {
@@ -237,7 +564,7 @@ KeyReport TCPConnection::bufferToKeyReport(const uint8_t* buf) {
                     // Check if this is the correct shifted/unshifted version
                     bool isShifted = (report.modifiers & 0x02) != 0;
                     if (unifiedKeyMap[j].shifted == isShifted) {
-                        ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", 
+                        if (verbose) ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", 
                             String("Key[") + i + "]: 0x" + String(report.keys[i], HEX) + 
                             " (" + unifiedKeyMap[j].description + ")");
                         found = true;
@@ -254,6 +581,7 @@ KeyReport TCPConnection::bufferToKeyReport(const uint8_t* buf) {
     }
 
     // Log the full report
+    if (!verbose) return report;
     String reportStr = "Full KeyReport: [";
     for (int i = 0; i < 6; i++) {
         if (i > 0) reportStr += ", ";
@@ -267,40 +595,232 @@ KeyReport TCPConnection::bufferToKeyReport(const uint8_t* buf) {
 
 void TCPConnection::type_charter(const char* str) {
     ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Typing charter: " + String(str));
-    for (size_t i = 0; i < strlen(str); ++i) {
-        char c = str[i];
-        KeyReport report = {0};
-        bool found = false;
-
-        // Search the key map for the character
-        for (size_t j = 0; j < unifiedKeyMapSize; ++j) {
-            if (unifiedKeyMap[j].asciiValue == c) {
-                report.keys[0] = unifiedKeyMap[j].hexCode;
-                report.modifiers = unifiedKeyMap[j].shifted ? 0x02 : 0x00; // Set Shift if needed
-                found = true;
-                break;
+    for (size_t i = 0; str[i] != '\0'; ++i) {
+        typeChar(str[i]);
+    }
+    finishTyping();
+}
+
+void TCPConnection::typeChar(char c) {
+    const KeyInfo* key = findKeyForChar(c);
+    if (!key) {
+        // Optionally log or handle unmapped characters
+        ArduinoKeyBridgeLogger::getInstance().warning("TCPConnection", String("No keycode for char: ") + c);
+        return;
+    }
+    uint8_t modifiers = key->shifted ? 0x02 : 0x00; // Set Shift if needed
+
+    if (rollover_typing_) {
+        KeyReport reports[RolloverTyper::MAX_REPORTS_PER_KEY];
+        size_t count = rollover_typer_.press(key->hexCode, modifiers, reports);
+        // The queue paces reports to the host's polling, no delays needed here
+        MinimalKeyboard::getInstance().waitForRoom(count);
+        for (size_t i = 0; i < count; ++i) {
+            MinimalKeyboard::getInstance().sendReport(&reports[i]);
+        }
+        return;
+    }
+
+    MinimalKeyboard::getInstance().waitForRoom(2);
+    KeyReport report = {modifiers, 0x00, {key->hexCode, 0, 0, 0, 0, 0}};
+    MinimalKeyboard::getInstance().sendReport(&report); // Key down
+    KeyReport release = {0}; // Key up (release)
+    MinimalKeyboard::getInstance().sendReport(&release);
+}
+
+void TCPConnection::finishTyping() {
+    // Release whatever rollover typing still holds so the host can't autorepeat it
+    KeyReport release;
+    if (rollover_typer_.release(&release) > 0) {
+        MinimalKeyboard::getInstance().waitForRoom(1);
+        MinimalKeyboard::getInstance().sendReport(&release);
+    }
+}
+
+bool TCPConnection::typeSnippet(uint16_t id) {
+    SnippetLibrary::Snippet snippet;
+    if (!SnippetStore::getInstance().library().find(id, snippet)) {
+        ArduinoKeyBridgeLogger::getInstance().warning("TCPConnection", String("No snippet ") + id);
+        ArduinoKeyBridgeNeoPixel::getInstance().flash(NeoPixelColors::RED);
+        return false;
+    }
+    // A new snippet replaces the one still typing
+    finishTyping();
+    snippet_ = snippet;
+    snippet_typed_ = 0;
+    snippet_typing_ = true;
+    ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", String("Typing snippet ") + id + ", " + snippet.length + " characters");
+    return true;
+}
+
+void TCPConnection::cancelSnippet() {
+    if (!snippet_typing_) return;
+    snippet_typing_ = false;
+    finishTyping();
+}
+
+void TCPConnection::serviceSnippet() {
+    // Only type a chunk the HID queue can take whole, so typing never blocks
+    if (MinimalKeyboard::getInstance().reportQueue().freeSpace() < CHARTER_DUMP_REPORTS) return;
+    const SnippetLibrary& library = SnippetStore::getInstance().library();
+    for (size_t i = 0; i < ConfigStore::config().charterChunk && snippet_typed_ < snippet_.length; ++i) {
+        typeChar(library.textAt(snippet_, snippet_typed_++));
+    }
+    finishTyping();
+    if (snippet_typed_ >= snippet_.length) {
+        snippet_typing_ = false;
+        ArduinoKeyBridgeNeoPixel::getInstance().flash(NeoPixelColors::GREEN);
+    }
+}
+
+void TCPConnection::startCalibration() {
+    if (isCalibrating()) return;
+    // The probe must be the only thing typing
+    cancelSnippet();
+    charter_dumping_ = false;
+    finishTyping();
+    calibration_previous_interval_ = MinimalKeyboard::getInstance().reportQueue().interval();
+    calibrator_.begin();
+    ArduinoKeyBridgeLogger::getInstance().info("TCPConnection", "Typing calibration started");
+    startProbe();
+}
+
+void TCPConnection::startProbe() {
+    unsigned long interval = calibrator_.probeInterval();
+    MinimalKeyboard::getInstance().reportQueue().setInterval(interval);
+    writeReport(BridgeProtocol::makeValueReport(BridgeProtocol::Notify::CALIBRATE_PROBE, (uint16_t)interval));
+    calibration_typed_ = 0;
+    calibration_ = CALIBRATION_TYPING;
+}
+
+void TCPConnection::serviceCalibration() {
+    if (!transport_->connected()) {
+        finishCalibration(false);
+        return;
+    }
+    HidReportQueue& queue = MinimalKeyboard::getInstance().reportQueue();
+    switch (calibration_) {
+        case CALIBRATION_TYPING: {
+            // Chunked like a charter dump; the probe ends with Enter
+            if (queue.freeSpace() < CHARTER_DUMP_REPORTS) return;
+            size_t length = strlen(TypingCalibrator::PROBE);
+            for (size_t i = 0; i < ConfigStore::config().charterChunk && calibration_typed_ <= length; ++i) {
+                typeChar(calibration_typed_ < length ? TypingCalibrator::PROBE[calibration_typed_] : '\n');
+                calibration_typed_++;
             }
+            finishTyping();
+            if (calibration_typed_ > length) calibration_ = CALIBRATION_DRAINING;
+            return;
         }
+        case CALIBRATION_DRAINING:
+            // Only ask once the host has had every report
+            if (!queue.isEmpty()) return;
+            writeReport(BridgeProtocol::makeControlReport(BridgeProtocol::Notify::CALIBRATE_END));
+            calibration_since_ = BridgeClock::millis();
+            calibration_ = CALIBRATION_WAITING;
+            return;
+        case CALIBRATION_WAITING:
+            // No answer counts as lost keys, the server may not have seen anything
+            if (BridgeClock::millis() - calibration_since_ >= CALIBRATION_RESULT_TIMEOUT_MS) calibrationResult(false);
+            return;
+        default:
+            return;
+    }
+}
 
-        if (found) {
-            MinimalKeyboard::getInstance().sendReport(&report); // Key down
-            delay(8); // Small delay for key press
-            KeyReport release = {0}; // Key up (release)
-            MinimalKeyboard::getInstance().sendReport(&release);
-            delay(2); // Small delay for key release
-        } else {
-            // Optionally log or handle unmapped characters
-            ArduinoKeyBridgeLogger::getInstance().warning("TCPConnection", String("No keycode for char: ") + c);
+void TCPConnection::calibrationResult(bool lossFree) {
+    ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", String("Calibration probe at ") + calibrator_.probeInterval() +
+        " us: " + (lossFree ? "loss-free" : "keys lost"));
+    calibrator_.report(lossFree);
+    if (calibrator_.isRunning()) {
+        startProbe();
+    } else {
+        finishCalibration(true);
+    }
+}
+
+void TCPConnection::finishCalibration(bool completed) {
+    calibration_ = CALIBRATION_IDLE;
+    unsigned long result = completed ? calibrator_.result() : 0;
+    if (result == 0) {
+        MinimalKeyboard::getInstance().reportQueue().setInterval(calibration_previous_interval_);
+        ArduinoKeyBridgeLogger::getInstance().warning("TCPConnection", completed
+            ? "Typing calibration failed, the host lost keys even at the slowest rate"
+            : "Typing calibration aborted");
+        ArduinoKeyBridgeNeoPixel::getInstance().flash(NeoPixelColors::RED);
+    } else {
+        CalibrationStore::getInstance().save(result);
+        ArduinoKeyBridgeLogger::getInstance().info("TCPConnection", String("Typing calibrated: ") + result + " us per HID report after " +
+            calibrator_.probes() + " probes");
+        ArduinoKeyBridgeNeoPixel::getInstance().flash(NeoPixelColors::GREEN);
+    }
+    if (completed) writeReport(BridgeProtocol::makeValueReport(BridgeProtocol::Notify::CALIBRATE_DONE, (uint16_t)result));
+}
+
+void TCPConnection::serviceTracing() {
+    LatencyTracer& tracer = LatencyTracer::getInstance();
+    tracer.expire(BridgeClock::micros());
+    if (!transport_->connected()) return;
+
+    // Echo the ids of server reports that reached the host
+    uint16_t id;
+    while (tracer.takeDone(id)) {
+        writeReport(BridgeProtocol::makeValueReport(BridgeProtocol::Notify::TRACE_DONE, id));
+    }
+
+    if (!trace_exporting_) return;
+    size_t written = 0;
+    while (written < TRACE_EXPORT_BATCH) {
+        if (trace_export_histogram_ == LatencyTracer::HISTOGRAM_COUNT) {
+            uint32_t lost = tracer.lost();
+            writeReport(BridgeProtocol::makeValueReport(BridgeProtocol::Notify::TRACE_END, lost > 0xFFFF ? 0xFFFF : uint16_t(lost)));
+            trace_exporting_ = false;
+            return;
+        }
+        const LatencyHistogram& histogram = tracer.histogram(trace_export_histogram_);
+        // 0 until the header is written, then the next bucket to look at + 1
+        if (trace_export_bucket_ == 0) {
+            // Empty histograms are left out
+            if (histogram.total() == 0) {
+                trace_export_histogram_++;
+                continue;
+            }
+            writeReport(BridgeProtocol::makeValueReport(BridgeProtocol::Notify::TRACE_HISTOGRAM, uint16_t(trace_export_histogram_)));
+            written++;
+            trace_export_bucket_ = 1;
+            continue;
+        }
+        size_t bucket = trace_export_bucket_ - 1;
+        while (bucket < LatencyHistogram::BUCKET_COUNT && histogram.count(bucket) == 0) bucket++;
+        if (bucket == LatencyHistogram::BUCKET_COUNT) {
+            trace_export_histogram_++;
+            trace_export_bucket_ = 0;
+            continue;
         }
+        writeReport(BridgeProtocol::makeValueReport(BridgeProtocol::Notify::TRACE_BUCKET, uint16_t(bucket)));
+        writeReport(BridgeProtocol::makeValueReport(BridgeProtocol::Notify::TRACE_COUNT, histogram.count(bucket)));
+        written += 2;
+        trace_export_bucket_ = bucket + 2;
     }
 }
 
+void TCPConnection::set_rollover_typing(bool enabled) {
+    finishTyping();
+    rollover_typing_ = enabled;
+    ArduinoKeyBridgeLogger::getInstance().info("TCPConnection", String("Charter typing mode: ") + (enabled ? "rollover" : "classic"));
+}
+
+bool TCPConnection::is_rollover_typing() {
+    return rollover_typing_;
+}
+
 void TCPConnection::toggleCharterMode() {
     bool prev = charter_mode_;
     charter_mode_ = !charter_mode_;
     ArduinoKeyBridgeLogger::getInstance().info("CharterMode", String("Manual charter mode toggled from ") + (prev ? "ON" : "OFF") + " to " + (charter_mode_ ? "ON" : "OFF"));
     ArduinoKeyBridgeNeoPixel::getInstance().setColor(charter_mode_ ? NeoPixelColors::MAGENTA : NeoPixelColors::WHITE);
-    ArduinoKeyBridgeNeoPixel::getInstance().setBrightness(charter_mode_ ? 15 : 1);
+    const BridgeConfig& config = ConfigStore::config();
+    ArduinoKeyBridgeNeoPixel::getInstance().setBrightness(charter_mode_ ? config.ledModeBrightness : config.ledIdleBrightness);
 }
 
 void TCPConnection::handleCharterKeyReport(const KeyReport& report) {
@@ -328,40 +848,41 @@ void TCPConnection::handleCharterKeyReport(const KeyReport& report) {
 
 void TCPConnection::clearCharterBuffer() {
     if (charter_mode_) {
-        charterBuffer = "";
+        charterBuffer.clear();
+        charter_dumping_ = false;
+        grantCharterCredit(true);
         // Optionally update LEDs or log
     }
 }
 
 void TCPConnection::dumpCharterBuffer() {
     if (charter_mode_ && charterBuffer.length() > 0) {
-        bool shitToDump = true;
-        while (charterBuffer.length() > 0) {
-            typeNextCharFromBuffer();
-        }
-
-
+        // Typed from poll() so the rest of a streamed transfer can arrive meanwhile
+        charter_dumping_ = true;
         // Optionally update LEDs or log
     }
 }
 
 void TCPConnection::typeNextCharFromBuffer() {
     if (charter_mode_ && charterBuffer.length() > 0) {
-        char c = charterBuffer[0];
-        charterBuffer.remove(0, 1);
+        char c = (char)charterBuffer.pop();
+        if (charter_receiving_) charter_stream_typed_ = true;
+        grantCharterCredit(false);
 
-        char singleCharStr[2] = {c, '\0'};
-        type_charter(singleCharStr);
+        typeChar(c);
+        if (!charter_dumping_) finishTyping();
 
-        ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Typed next char from buffer: " + String(c));
+        if (ArduinoKeyBridgeLogger::getInstance().allow(LogLevel::DEBUG, "TCPConnection")) {
+            ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Typed next char from buffer: " + String(c));
+        }
         // Optionally update LEDs if buffer is now empty
         if (charterBuffer.length() == 0) {
-            ArduinoKeyBridgeNeoPixel::getInstance().setColor(NeoPixelColors::GREEN);
-            ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Charter buffer is now empty, setting color to GREEN");
+            ArduinoKeyBridgeNeoPixel::getInstance().flash(NeoPixelColors::GREEN);
+            ArduinoKeyBridgeLogger::getInstance().debug("TCPConnection", "Charter buffer is now empty, flashing GREEN");
         }
         return;
     } else if (charterBuffer.length() == 0) {
-        ArduinoKeyBridgeNeoPixel::getInstance().setColor(NeoPixelColors::RED);
+        ArduinoKeyBridgeNeoPixel::getInstance().flash(NeoPixelColors::RED);
         ArduinoKeyBridgeLogger::getInstance().warning("TCPConnection", "Charter mode on but buffer is empty");
         return;
     }
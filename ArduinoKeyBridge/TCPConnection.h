@@ -2,8 +2,21 @@
 #define TCP_CONNECTION_H
 
 #include <Arduino.h>
-#include <WiFiS3.h>
 #include "MinimalKeyboard.h" // For KeyReport
+#include "BridgeProtocol.h"
+#include "BridgeFraming.h"
+#include "Transport.h"
+#include "WiFiTcpTransport.h"
+#include "CharterBuffer.h"
+#include "CharterCredit.h"
+#include "CharterCodec.h"
+#include "MirrorQueue.h"
+#include "RolloverTyper.h"
+#include "BlobSink.h"
+#include "BridgeConfig.h"
+#include "SnippetLibrary.h"
+#include "TypingCalibrator.h"
+#include "LatencyTracer.h"
 #include "ArduinoKeyBridgeNeoPixel.h"
 
 class TCPConnection {
@@ -13,9 +26,15 @@ public:
     // Send a key report to connected clients
     void sendKeyReport(const KeyReport& report);
     void sendEmptyKeyReport();
+    // A USB key report for the server in command mode, announced with a
+    // trace id when LatencyTracer samples it
+    void forwardKeyReport(const KeyReport& report);
 
     // Start the WiFi Access Point
     void startAP();
+    // Speak the bridge protocol over another link instead of WiFi TCP (Transport.h)
+    void useTransport(Transport& transport);
+    Transport& transport() { return *transport_; }
     void poll();
     bool isReady() const;
     void status();
@@ -25,6 +44,16 @@ public:
     bool is_command_mode();
     bool is_charter_mode();
     void set_charter_mode(bool mode);
+    bool is_event_encoding();
+
+    // Local-first command mode: reports are typed locally and a copy is
+    // queued for the server instead of being forwarded only
+    void set_mirror_mode(bool enabled);
+    bool is_mirror_mode();
+    void mirrorKeyReport(const KeyReport& report);
+
+    // Route uploads announced with the given value control code to sink
+    bool registerBlobSink(uint8_t code, BlobSink* sink);
 
     // Charter mode/local typing support
     void handleCharterKeyReport(const KeyReport& report);
@@ -32,38 +61,133 @@ public:
     void clearCharterBuffer();
     void dumpCharterBuffer();
     void typeNextCharFromBuffer();
-    String charterBuffer = "This is a test string";
+    CharterBuffer charterBuffer;
 
     void type_charter(const char* str);
+    // Types a snippet from SnippetStore, a chunk per poll() like a charter dump
+    bool typeSnippet(uint16_t id);
+    void cancelSnippet();
+    // Probes the host's typing rate with the server's help (TypingCalibrator.h)
+    void startCalibration();
+    bool isCalibrating() const { return calibration_ != CALIBRATION_IDLE; }
+    void set_rollover_typing(bool enabled);
+    bool is_rollover_typing();
 
     KeyReport bufferToKeyReport(const uint8_t* buf);
 
 private:
-    static constexpr uint16_t PORT = 8080;
-    static constexpr const char* AP_SSID = "ArduinoKeyBridge";
-    static constexpr const char* AP_PASSWORD = "12345678";
-
-    struct WiFiStatus {
-        static const char* toString(int status) {
-            switch (status) {
-                case WL_IDLE_STATUS: return "IDLE";
-                case WL_NO_SSID_AVAIL: return "NO_SSID_AVAIL";
-                case WL_CONNECT_FAILED: return "CONNECT_FAILED";
-                case WL_CONNECTED: return "CONNECTED";
-                case WL_DISCONNECTED: return "DISCONNECTED";
-                case WL_AP_LISTENING: return "AP_LISTENING";
-                case WL_AP_CONNECTED: return "AP_CONNECTED";
-                case WL_AP_FAILED: return "AP_FAILED";
-                default: return "UNKNOWN";
-            }
-        }
-    };
+    // Compressed bytes the sender may have outstanding; they are only read
+    // while the decoder has room, the rest waits in the transport
+    static constexpr size_t COMPRESSED_CHARTER_CREDIT = CharterBuffer::CAPACITY / 2;
+    // Most characters typed per poll() while dumping (BridgeConfig::charterChunk),
+    // keeps the loop responsive
+    static constexpr size_t CHARTER_DUMP_CHUNK = BridgeConfig::MAX_CHARTER_CHUNK;
+    // Most HID reports a chunk can queue: two per character plus the final release
+    static constexpr size_t CHARTER_DUMP_REPORTS = CHARTER_DUMP_CHUNK * RolloverTyper::MAX_REPORTS_PER_KEY + 1;
+    static_assert(CHARTER_DUMP_REPORTS <= HidReportQueue::CAPACITY, "a dump chunk must fit the HID queue");
+    static constexpr size_t MAX_BLOB_SINKS = 4;
+    // Mirrored reports waiting for the network task, and how many it sends per poll
+    static constexpr size_t MIRROR_QUEUE_SIZE = 32;
+    static constexpr size_t MIRROR_BATCH = 8;
 
-    WiFiServer server_ = WiFiServer(PORT);
-    WiFiClient client_;
+    WiFiTcpTransport wifi_;
+    Transport* transport_ = &wifi_;
+    // Modem transactions at the last status(), for the per-second rate
+    uint32_t status_modem_calls_ = 0;
+    unsigned long status_ms_ = 0;
     bool ready_ = false;
     bool command_mode_ = false;
     bool charter_mode_ = false;
+    bool mirror_mode_ = false;
+    MirrorQueue<MIRROR_QUEUE_SIZE> mirror_;
+
+    // Raw or delta-encoded framing (KeyEventCodec), negotiated per connection
+    BridgeFraming::FrameParser parser_;
+    BridgeFraming::FrameWriter writer_;
+
+    // Credit-based flow control for charter text streams: the sender may only
+    // send as many bytes as the device has granted with CREDIT reports
+    bool charter_receiving_ = false;
+    bool charter_stream_typed_ = false;
+    bool charter_dumping_ = false;
+    size_t charter_stream_bytes_ = 0;
+    CharterCredit charter_credit_;
+
+    // CHARTER_COMPRESSED streams are expanded straight into charterBuffer
+    bool charter_compressed_ = false;
+    size_t charter_wire_bytes_ = 0;
+    size_t charter_decode_errors_ = 0;
+    CharterCodec::Decoder charter_decoder_;
+
+    // Snippet being typed straight from flash
+    bool snippet_typing_ = false;
+    SnippetLibrary::Snippet snippet_;
+    size_t snippet_typed_ = 0;
+
+    // Typing calibration: each probe is typed, drained from the HID queue,
+    // then the server's CRC of what arrived decides the next interval
+    enum CalibrationState : uint8_t {
+        CALIBRATION_IDLE,
+        CALIBRATION_TYPING,
+        CALIBRATION_DRAINING,
+        CALIBRATION_WAITING
+    };
+    static constexpr unsigned long CALIBRATION_RESULT_TIMEOUT_MS = 3000;
+    CalibrationState calibration_ = CALIBRATION_IDLE;
+    TypingCalibrator calibrator_;
+    size_t calibration_typed_ = 0;
+    unsigned long calibration_since_ = 0;
+    unsigned long calibration_previous_interval_ = 0;
+
+    // TRACE_QUERY answer, a batch of reports per poll
+    static constexpr size_t TRACE_EXPORT_BATCH = 16;
+    bool trace_exporting_ = false;
+    size_t trace_export_histogram_ = 0;
+    size_t trace_export_bucket_ = 0;
+
+    // Rollover typing keeps keys held between characters of one run
+    bool rollover_typing_ = false;
+    RolloverTyper rollover_typer_;
+
+    void typeChar(char c);
+    void finishTyping();
+
+    // Binary uploads (BlobSink.h)
+    struct BlobRoute {
+        uint8_t code;
+        BlobSink* sink;
+    };
+    BlobRoute blob_routes_[MAX_BLOB_SINKS];
+    size_t blob_route_count_ = 0;
+    bool blob_receiving_ = false;
+    bool blob_ok_ = false;
+    BlobSink* blob_sink_ = nullptr;
+    size_t blob_length_ = 0;
+    size_t blob_offset_ = 0;
+
+    bool change_value(uint8_t code, uint16_t value);
+    void startBlob(uint8_t code, uint16_t length);
+    void pollBlob();
+    void finishBlob();
+    void serviceSnippet();
+    void serviceCalibration();
+    void startProbe();
+    void calibrationResult(bool lossFree);
+    void finishCalibration(bool completed);
+    void serviceTracing();
+
+    void startCharterStream(bool compressed);
+    void pollCharterText();
+    void pollCompressedCharterText();
+    void finishCharterStream();
+    // start marks the first grant of a stream (CREDIT_START)
+    void grantCharterCredit(bool force, bool start = false);
+    void serviceCharterDump();
+
+    void set_event_encoding(bool enabled);
+    void pollFrames();
+    void drainMirror();
+    void writeReport(const KeyReport& report);
 
     // Private constructor for singleton pattern
     TCPConnection();
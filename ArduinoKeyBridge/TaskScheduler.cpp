@@ -0,0 +1,98 @@
+#include "TaskScheduler.h"
+#include "BridgeClock.h"
+#include "FlightRecorder.h"
+
+#ifdef ARDUINO
+#include "ArduinoKeyBridgeLogger.h"
+#endif
+
+TaskScheduler& TaskScheduler::getInstance() {
+    static TaskScheduler instance;
+    return instance;
+}
+
+int TaskScheduler::addTask(const char* name, TaskFunction function, uint8_t priority,
+                           unsigned long periodUs, unsigned long deadlineUs, unsigned long budgetUs) {
+    if (count_ >= MAX_TASKS) {
+#ifdef ARDUINO
+        ArduinoKeyBridgeLogger::getInstance().error("Scheduler", String("Task table full, dropping ") + name);
+#endif
+        return -1;
+    }
+    Task& task = tasks_[count_];
+    task.name = name;
+    task.function = function;
+    task.priority = priority;
+    task.periodUs = periodUs;
+    task.deadlineUs = deadlineUs;
+    task.budgetUs = budgetUs;
+    task.releaseUs = BridgeClock::micros();
+    task.stats = TaskStats();
+    return int(count_++);
+}
+
+bool TaskScheduler::runOnce() {
+    unsigned long now = BridgeClock::micros();
+
+    // Pick the due task with the lowest priority number, then the earliest deadline.
+    // Differences are compared as signed values so micros() wrapping is harmless.
+    Task* next = nullptr;
+    for (size_t i = 0; i < count_; ++i) {
+        Task& task = tasks_[i];
+        if (long(now - task.releaseUs) < 0) continue;
+        if (!next || task.priority < next->priority ||
+            (task.priority == next->priority &&
+             long((task.releaseUs + task.deadlineUs) - (next->releaseUs + next->deadlineUs)) < 0)) {
+            next = &task;
+        }
+    }
+    if (!next) return false;
+
+    unsigned long latency = now - next->releaseUs;
+    FlightRecorder::taskStarted(uint8_t(next - tasks_), now);
+    next->function();
+    FlightRecorder::taskEnded();
+    unsigned long end = BridgeClock::micros();
+    unsigned long runtime = end - now;
+
+    TaskStats& stats = next->stats;
+    stats.runs++;
+    stats.totalLatencyUs += latency;
+    stats.totalRuntimeUs += runtime;
+    if (latency > stats.maxLatencyUs) stats.maxLatencyUs = latency;
+    if (runtime > stats.maxRuntimeUs) stats.maxRuntimeUs = runtime;
+    if (latency > next->deadlineUs) stats.deadlineMisses++;
+    if (runtime > next->budgetUs) stats.overruns++;
+
+    // Next period; if the task fell a whole period behind, drop the missed releases
+    next->releaseUs += next->periodUs;
+    unsigned long behind = end - next->releaseUs;
+    if (long(behind) >= 0 && behind >= next->periodUs) {
+        if (next->periodUs > 0) stats.skipped += behind / next->periodUs;
+        next->releaseUs = end;
+    }
+    return true;
+}
+
+#ifdef ARDUINO
+void TaskScheduler::logStats() {
+    for (size_t i = 0; i < count_; ++i) {
+        const Task& task = tasks_[i];
+        const TaskStats& stats = task.stats;
+        unsigned long avgLatency = stats.runs ? (unsigned long)(stats.totalLatencyUs / stats.runs) : 0;
+        unsigned long avgRuntime = stats.runs ? (unsigned long)(stats.totalRuntimeUs / stats.runs) : 0;
+        ArduinoKeyBridgeLogger::getInstance().debug("Scheduler",
+            String(task.name) + ": runs " + stats.runs +
+            ", latency avg/max " + avgLatency + "/" + stats.maxLatencyUs + " us" +
+            ", runtime avg/max " + avgRuntime + "/" + stats.maxRuntimeUs + " us" +
+            ", overruns " + stats.overruns + ", deadline misses " + stats.deadlineMisses +
+            ", skipped " + stats.skipped);
+    }
+}
+#endif
+
+void TaskScheduler::resetStats() {
+    for (size_t i = 0; i < count_; ++i) {
+        tasks_[i].stats = TaskStats();
+    }
+}
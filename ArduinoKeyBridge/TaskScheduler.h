@@ -0,0 +1,75 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Small cooperative scheduler that replaces the fixed call order in loop().
+//
+// Every task has a period, a relative deadline, a priority and a time budget,
+// all in microseconds. runOnce() starts the most urgent task that is due:
+// lowest priority number first, earliest deadline among equal priorities.
+// Tasks run to completion, so a task that takes longer than its budget
+// delays everything else; that is counted as an overrun. Starting later than
+// release + deadline is counted as a deadline miss.
+//
+// Latency (release to start) and runtime are tracked per task and logged by
+// logStats(), which shows how long key events can wait while LEDs, logging
+// and network I/O are busy. Logging is only built for the board, so
+// tools/cpp/keybridge_scheduler_bench.cpp can run the scheduler on the host.
+class TaskScheduler {
+public:
+    typedef void (*TaskFunction)();
+
+    static constexpr size_t MAX_TASKS = 8;
+
+    struct TaskStats {
+        uint32_t runs = 0;
+        uint32_t overruns = 0;        // Runtime above budget
+        uint32_t deadlineMisses = 0;  // Started after release + deadline
+        uint32_t skipped = 0;         // Releases dropped because the task fell a whole period behind
+        unsigned long maxLatencyUs = 0;
+        unsigned long maxRuntimeUs = 0;
+        uint64_t totalLatencyUs = 0;
+        uint64_t totalRuntimeUs = 0;
+    };
+
+    static TaskScheduler& getInstance();
+
+    // Returns the task id, or -1 if the table is full
+    int addTask(const char* name, TaskFunction function, uint8_t priority,
+                unsigned long periodUs, unsigned long deadlineUs, unsigned long budgetUs);
+
+    // Runs the most urgent due task. Returns false if nothing was due.
+    bool runOnce();
+
+    const TaskStats& stats(int id) const { return tasks_[id].stats; }
+    const char* taskName(size_t id) const { return id < count_ ? tasks_[id].name : "?"; }
+    size_t taskCount() const { return count_; }
+#ifdef ARDUINO
+    void logStats();
+#endif
+    void resetStats();
+
+private:
+    struct Task {
+        const char* name;
+        TaskFunction function;
+        uint8_t priority;
+        unsigned long periodUs;
+        unsigned long deadlineUs;
+        unsigned long budgetUs;
+        unsigned long releaseUs; // Start of the current period
+        TaskStats stats;
+    };
+
+    Task tasks_[MAX_TASKS];
+    size_t count_ = 0;
+
+    TaskScheduler() = default;
+    ~TaskScheduler() = default;
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+};
+
+#endif
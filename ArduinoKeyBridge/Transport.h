@@ -0,0 +1,42 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Byte link between the bridge and its server. TCPConnection speaks the
+// bridge protocol (BridgeProtocol.h) through whichever transport is active,
+// so key processing is the same on WiFi TCP, BLE, serial or the in-memory
+// loopback used by the host tools.
+//
+// Frames are built and parsed by BridgeFraming.h; a transport only moves
+// bytes. write() is one unit on the link (a TCP segment, a BLE
+// notification), so FrameWriter never passes more than maxPayload() bytes.
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    // Called from poll(). Returns true once for each newly connected peer.
+    virtual bool accept() = 0;
+    virtual bool connected() = 0;
+
+    virtual int available() = 0;
+    // Returns the next byte or -1
+    virtual int read() = 0;
+    virtual int read(uint8_t* buf, size_t length) = 0;
+
+    // Returns the number of bytes accepted
+    virtual size_t write(const uint8_t* data, size_t length) = 0;
+    virtual void flush() {}
+
+    // Largest write() the link carries as one unit
+    virtual size_t maxPayload() const = 0;
+    // True if frames should be packed into maxPayload() sized writes instead
+    // of being written one by one (BLE, where every notification costs a
+    // connection event)
+    virtual bool batchWrites() const { return false; }
+
+    virtual const char* name() const = 0;
+};
+
+#endif
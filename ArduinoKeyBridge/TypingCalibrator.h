@@ -0,0 +1,96 @@
+#ifndef TYPING_CALIBRATOR_H
+#define TYPING_CALIBRATOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "Crc16.h"
+
+// Finds the fastest HID report interval a host takes without losing keys.
+//
+// USB polling is rarely the limit; remote desktops, VMs and busy
+// applications drop characters that arrive too quickly. Calibration types
+// PROBE at one of the CANDIDATES intervals, the server answers with the
+// CRC-16 of the text that actually arrived, and the next interval is chosen
+// by binary search: an interval has to come through CONFIRMATIONS probes in
+// a row to count as loss-free, one bad probe rules it out. Slower intervals
+// are assumed to work when a faster one does. The winner has to pass
+// VERIFICATIONS more probes, or the search goes on below it. With 8
+// candidates a search takes 9 to 14 probes unless that final check fails.
+//
+// Only the search lives here; TCPConnection types the probes and
+// CalibrationStore keeps the result per host profile.
+class TypingCalibrator {
+public:
+    // Microseconds per HID report, slowest first
+    static constexpr unsigned long CANDIDATES[] = {16000, 8000, 6000, 4000, 3000, 2000, 1500, 1000};
+    static constexpr int CANDIDATE_COUNT = sizeof(CANDIDATES) / sizeof(CANDIDATES[0]);
+    static constexpr uint8_t CONFIRMATIONS = 3;
+    // Extra probes the final interval has to pass
+    static constexpr uint8_t VERIFICATIONS = 2;
+
+    // Typed once per probe and followed by Enter. Shifted characters and
+    // doubled letters catch hosts that drop modifiers or repeated keys.
+    static constexpr const char* PROBE = "The quick brown fox jumps over the lazy dog; "
+                                         "Committee BOOKKEEPER 0123456789 [a+b]={c}?";
+
+    static uint16_t probeCrc() { return crc16(reinterpret_cast<const uint8_t*>(PROBE), strlen(PROBE)); }
+
+    void begin() {
+        good_ = -1;
+        bad_ = CANDIDATE_COUNT;
+        passes_ = 0;
+        probes_ = 0;
+        verified_ = false;
+        pick();
+    }
+
+    bool isRunning() const { return searching() || (good_ >= 0 && !verified_); }
+    // Interval for the next probe, valid while isRunning()
+    unsigned long probeInterval() const { return CANDIDATES[current_]; }
+
+    // Result of the probe at probeInterval()
+    void report(bool lossFree) {
+        if (!isRunning()) return;
+        probes_++;
+        if (!lossFree) {
+            // A failed final check says nothing about slower candidates, search them again
+            if (!searching()) good_ = -1;
+            bad_ = current_;
+            passes_ = 0;
+            pick();
+            return;
+        }
+        passes_++;
+        if (searching()) {
+            if (passes_ < CONFIRMATIONS) return;
+            good_ = current_;
+            passes_ = 0;
+            pick();
+        } else if (passes_ >= VERIFICATIONS) {
+            verified_ = true;
+        }
+    }
+
+    // Fastest loss-free interval, 0 if not even the slowest one was
+    unsigned long result() const { return good_ >= 0 && verified_ ? CANDIDATES[good_] : 0; }
+    uint8_t probes() const { return probes_; }
+
+private:
+    int good_ = -1;                // Fastest candidate known to work
+    int bad_ = CANDIDATE_COUNT;    // Slowest candidate known to lose keys
+    int current_ = 0;
+    uint8_t passes_ = 0;
+    uint8_t probes_ = 0;
+    bool verified_ = false;
+
+    bool searching() const { return bad_ - good_ > 1; }
+
+    void pick() {
+        // Binary search between the known good and bad candidates, then
+        // the winner is checked once more
+        current_ = searching() ? good_ + (bad_ - good_) / 2 : good_;
+    }
+};
+
+#endif
@@ -0,0 +1,34 @@
+#include "WiFiTcpTransport.h"
+#include "ArduinoKeyBridgeLogger.h"
+#include "BridgeClock.h"
+
+void WiFiTcpTransport::begin(const char* ssid, const char* password, uint16_t port) {
+    WiFi.beginAP(ssid, password);
+    while (WiFi.status() != WL_AP_LISTENING) {
+        ArduinoKeyBridgeLogger::getInstance().debug("WiFiTcpTransport", "Starting access point");
+        BridgeClock::delay(100);
+    }
+    ArduinoKeyBridgeLogger::getInstance().info("WiFiTcpTransport", "Access Point started");
+    ArduinoKeyBridgeLogger::getInstance().info("WiFiTcpTransport", String("Local IP address: ") + WiFi.localIP().toString());
+    server_.begin(port);
+}
+
+const char* WiFiTcpTransport::wifiStatus() {
+    switch (WiFi.status()) {
+        case WL_IDLE_STATUS: return "IDLE";
+        case WL_NO_SSID_AVAIL: return "NO_SSID_AVAIL";
+        case WL_CONNECT_FAILED: return "CONNECT_FAILED";
+        case WL_CONNECTED: return "CONNECTED";
+        case WL_DISCONNECTED: return "DISCONNECTED";
+        case WL_AP_LISTENING: return "AP_LISTENING";
+        case WL_AP_CONNECTED: return "AP_CONNECTED";
+        case WL_AP_FAILED: return "AP_FAILED";
+        default: return "UNKNOWN";
+    }
+}
+
+bool WiFiTcpTransport::accept() {
+    if (!ModemTransport::accept()) return false;
+    ArduinoKeyBridgeLogger::getInstance().info("WiFiTcpTransport", String("New client connected from IP: ") + client_.remoteIP().toString());
+    return true;
+}
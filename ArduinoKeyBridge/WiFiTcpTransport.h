@@ -0,0 +1,25 @@
+#ifndef WIFI_TCP_TRANSPORT_H
+#define WIFI_TCP_TRANSPORT_H
+
+#include <Arduino.h>
+#include <WiFiS3.h>
+#include "ModemTransport.h"
+
+// TCP server on the WiFiS3 access point, one client at a time. Socket calls
+// are AT transactions to the ESP32, polled as described in ModemTransport.h.
+class WiFiTcpTransport : public ModemTransport<WiFiServer, WiFiClient> {
+public:
+    // The port comes with begin(), the config isn't loaded at construction
+    WiFiTcpTransport() : ModemTransport(0) {}
+
+    // Starts the access point and the server, blocks until the AP is up
+    void begin(const char* ssid, const char* password, uint16_t port);
+    const char* wifiStatus();
+
+    bool accept() override;
+    // One TCP segment at the default MSS
+    size_t maxPayload() const override { return 536; }
+    const char* name() const override { return "wifi-tcp"; }
+};
+
+#endif
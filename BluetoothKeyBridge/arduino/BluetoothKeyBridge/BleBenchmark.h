@@ -0,0 +1,194 @@
+#ifndef BLE_BENCHMARK_H
+#define BLE_BENCHMARK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Throughput benchmark packets and counters for BluetoothKeyBridge.
+//
+// Every packet starts with a kind byte. DATA packets carry a 32-bit
+// little-endian sequence number and filler bytes derived from it, so the
+// receiver can count lost, reordered and corrupted packets:
+//
+//   DATA    0xB0, seq[4], (seq + i) & 0xFF for i in 0..
+//   CONFIG  0xB1, mtu[2]  negotiated ATT MTU, payload becomes mtu - 3
+//   RESET   0xB2          clear the counters
+namespace BleBenchmark {
+    enum Kind : uint8_t {
+        DATA = 0xB0,
+        CONFIG = 0xB1,
+        RESET = 0xB2
+    };
+
+    static constexpr size_t HEADER_SIZE = 5;
+    static constexpr size_t MIN_PAYLOAD = HEADER_SIZE;
+    static constexpr size_t MAX_PAYLOAD = 244; // ATT MTU 247
+    static constexpr size_t DEFAULT_PAYLOAD = 20; // ATT MTU 23
+    static constexpr size_t ATT_HEADER = 3;
+
+    inline size_t clampPayload(size_t bytes) {
+        if (bytes < MIN_PAYLOAD) return MIN_PAYLOAD;
+        if (bytes > MAX_PAYLOAD) return MAX_PAYLOAD;
+        return bytes;
+    }
+
+    inline uint8_t filler(uint32_t seq, size_t i) {
+        return uint8_t(seq + i);
+    }
+
+    struct Counters {
+        uint32_t packets = 0;
+        uint32_t bytes = 0;
+        uint32_t lost = 0;       // Sequence numbers skipped
+        uint32_t outOfOrder = 0; // Older than expected: late or duplicated
+        uint32_t corrupt = 0;    // Bad length or filler
+        uint32_t failed = 0;     // Sends the stack refused
+
+        void clear() { *this = Counters(); }
+    };
+
+    class Sender {
+    public:
+        explicit Sender(size_t payload = DEFAULT_PAYLOAD) { setPayload(payload); }
+
+        void setPayload(size_t bytes) { payload_ = clampPayload(bytes); }
+        // Payload for a negotiated ATT MTU
+        void setMtu(size_t mtu) { setPayload(mtu > ATT_HEADER ? mtu - ATT_HEADER : 0); }
+        size_t payload() const { return payload_; }
+
+        // Builds the next DATA packet into out (payload() bytes) and returns its size
+        size_t next(uint8_t* out) {
+            out[0] = DATA;
+            for (int i = 0; i < 4; ++i) out[1 + i] = uint8_t(seq_ >> (8 * i));
+            for (size_t i = HEADER_SIZE; i < payload_; ++i) out[i] = filler(seq_, i);
+            return payload_;
+        }
+
+        // Result of sending the packet from next(); a refused packet is retried with the same number
+        void sent(bool ok) {
+            if (!ok) {
+                counters_.failed++;
+                return;
+            }
+            counters_.packets++;
+            counters_.bytes += uint32_t(payload_);
+            seq_++;
+        }
+
+        uint32_t sequence() const { return seq_; }
+        const Counters& counters() const { return counters_; }
+        void reset() {
+            seq_ = 0;
+            counters_.clear();
+        }
+
+    private:
+        size_t payload_;
+        uint32_t seq_ = 0;
+        Counters counters_;
+    };
+
+    class Receiver {
+    public:
+        enum Result : uint8_t {
+            IGNORED,   // Not a benchmark packet
+            RECEIVED,  // DATA counted
+            CONFIGURED,// CONFIG, mtu() holds the new MTU
+            RESET_DONE
+        };
+
+        Result receive(const uint8_t* data, size_t length) {
+            if (length == 0) return IGNORED;
+            switch (data[0]) {
+                case DATA:
+                    onData(data, length);
+                    return RECEIVED;
+                case CONFIG:
+                    if (length < 3) return IGNORED;
+                    mtu_ = uint16_t(data[1] | (data[2] << 8));
+                    return CONFIGURED;
+                case RESET:
+                    reset();
+                    return RESET_DONE;
+                default:
+                    return IGNORED;
+            }
+        }
+
+        uint16_t mtu() const { return mtu_; }
+        uint32_t expected() const { return expected_; }
+        const Counters& counters() const { return counters_; }
+        void reset() {
+            expected_ = 0;
+            counters_.clear();
+        }
+
+    private:
+        uint32_t expected_ = 0;
+        uint16_t mtu_ = 0;
+        Counters counters_;
+
+        void onData(const uint8_t* data, size_t length) {
+            counters_.packets++;
+            counters_.bytes += uint32_t(length);
+            if (length < HEADER_SIZE) {
+                counters_.corrupt++;
+                return;
+            }
+            uint32_t seq = uint32_t(data[1]) | uint32_t(data[2]) << 8 | uint32_t(data[3]) << 16 | uint32_t(data[4]) << 24;
+            for (size_t i = HEADER_SIZE; i < length; ++i) {
+                if (data[i] != filler(seq, i)) {
+                    counters_.corrupt++;
+                    break;
+                }
+            }
+            if (seq < expected_) {
+                counters_.outOfOrder++;
+                return;
+            }
+            // A late packet was already counted as lost when the gap was seen
+            counters_.lost += seq - expected_;
+            expected_ = seq + 1;
+        }
+    };
+
+    // Counter deltas once per interval for the per-second summaries
+    class Summary {
+    public:
+        explicit Summary(unsigned long intervalMs = 1000) : intervalMs_(intervalMs) {}
+
+        void start(unsigned long nowMs) {
+            startMs_ = lastMs_ = nowMs;
+            last_.clear();
+        }
+
+        // True once per interval; delta and elapsed cover the time since the last summary
+        bool due(unsigned long nowMs, const Counters& now, Counters& delta, unsigned long& elapsedMs) {
+            if (nowMs - lastMs_ < intervalMs_) return false;
+            delta.packets = now.packets - last_.packets;
+            delta.bytes = now.bytes - last_.bytes;
+            delta.lost = now.lost - last_.lost;
+            delta.outOfOrder = now.outOfOrder - last_.outOfOrder;
+            delta.corrupt = now.corrupt - last_.corrupt;
+            delta.failed = now.failed - last_.failed;
+            elapsedMs = nowMs - lastMs_;
+            last_ = now;
+            lastMs_ = nowMs;
+            return true;
+        }
+
+        // Rebases after the counters were cleared
+        void rebase(const Counters& now) { last_ = now; }
+
+        unsigned long totalMs(unsigned long nowMs) const { return nowMs - startMs_; }
+
+    private:
+        unsigned long intervalMs_;
+        unsigned long startMs_ = 0;
+        unsigned long lastMs_ = 0;
+        Counters last_;
+    };
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include <ArduinoBLE.h>
- 
+#include "BleBenchmark.h"
+
 // Device name
 #define DEVICE_NAME "ArduinoKeyBridge"
 
@@ -13,14 +14,125 @@ const int BUFFER_SIZE = 512;  // Increased buffer size for more data
 
 // BLE objects
 BLEService keyService(SERVICE_UUID);
-// Update permissions to allow bidirectional communication
-BLECharacteristic txCharacteristic(TX_CHAR_UUID, BLERead | BLEWrite | BLEIndicate, BUFFER_SIZE);
-BLECharacteristic rxCharacteristic(RX_CHAR_UUID, BLEWrite | BLENotify, BUFFER_SIZE);
+// Notify for the benchmark (no ack per packet), indicate still works for older clients
+BLECharacteristic txCharacteristic(TX_CHAR_UUID, BLERead | BLEWrite | BLENotify | BLEIndicate, BUFFER_SIZE);
+BLECharacteristic rxCharacteristic(RX_CHAR_UUID, BLEWrite | BLEWriteWithoutResponse | BLENotify, BUFFER_SIZE);
 
 // Buffer for serial input
 char inputBuffer[BUFFER_SIZE];
 int bufferIndex = 0;
 
+// Benchmark mode (BleBenchmark.h). The device streams sequence numbered
+// packets on TX while enabled and counts what the central writes to RX.
+// Serial commands: "t" toggles sending, "p<bytes>" sets the payload,
+// "r" resets the counters. A central can send its negotiated MTU in a
+// CONFIG packet, the payload then follows it.
+bool benchmarkSending = false;
+BleBenchmark::Sender benchmarkSender;
+BleBenchmark::Receiver benchmarkReceiver;
+BleBenchmark::Summary txSummary;
+BleBenchmark::Summary rxSummary;
+uint8_t packetBuffer[BleBenchmark::MAX_PAYLOAD];
+
+void resetBenchmark() {
+    benchmarkSender.reset();
+    benchmarkReceiver.reset();
+    txSummary.start(millis());
+    rxSummary.start(millis());
+}
+
+void handleSerialCommand(const char* command) {
+    switch (command[0]) {
+        case 't':
+            benchmarkSending = !benchmarkSending;
+            Serial.print("Benchmark sending ");
+            Serial.println(benchmarkSending ? "ON" : "OFF");
+            break;
+        case 'p':
+            benchmarkSender.setPayload(atoi(command + 1));
+            Serial.print("Payload: ");
+            Serial.println(benchmarkSender.payload());
+            break;
+        case 'r':
+            resetBenchmark();
+            Serial.println("Counters reset");
+            break;
+        default:
+            Serial.println("Commands: t (toggle sending), p<bytes> (payload), r (reset)");
+            break;
+    }
+}
+
+void pollSerial() {
+    while (Serial.available() > 0) {
+        char c = Serial.read();
+        if (c == '\n' || c == '\r') {
+            if (bufferIndex > 0) {
+                inputBuffer[bufferIndex] = '\0';
+                handleSerialCommand(inputBuffer);
+                bufferIndex = 0;
+            }
+        } else if (bufferIndex < BUFFER_SIZE - 1) {
+            inputBuffer[bufferIndex++] = c;
+        }
+    }
+}
+
+void printSummary(const char* direction, const BleBenchmark::Counters& delta, unsigned long elapsedMs, unsigned long totalMs) {
+    Serial.print(direction);
+    Serial.print(": ");
+    Serial.print(delta.packets * 1000UL / elapsedMs);
+    Serial.print(" pkt/s, ");
+    Serial.print(delta.bytes * 1000UL / elapsedMs);
+    Serial.print(" B/s, lost ");
+    Serial.print(delta.lost);
+    Serial.print(", out of order ");
+    Serial.print(delta.outOfOrder);
+    Serial.print(", corrupt ");
+    Serial.print(delta.corrupt);
+    Serial.print(", refused ");
+    Serial.print(delta.failed);
+    Serial.print(", elapsed ");
+    Serial.print(totalMs / 1000);
+    Serial.println(" s");
+}
+
+void printSummaries() {
+    BleBenchmark::Counters delta;
+    unsigned long elapsedMs = 0;
+    unsigned long now = millis();
+    if (txSummary.due(now, benchmarkSender.counters(), delta, elapsedMs) && delta.packets + delta.failed > 0) {
+        printSummary("TX", delta, elapsedMs, txSummary.totalMs(now));
+    }
+    if (rxSummary.due(now, benchmarkReceiver.counters(), delta, elapsedMs) && delta.packets > 0) {
+        printSummary("RX", delta, elapsedMs, rxSummary.totalMs(now));
+    }
+}
+
+void handleReceived(const char* name, const uint8_t* data, int dataLength) {
+    switch (benchmarkReceiver.receive(data, dataLength)) {
+        case BleBenchmark::Receiver::RECEIVED:
+            break;
+        case BleBenchmark::Receiver::CONFIGURED:
+            benchmarkSender.setMtu(benchmarkReceiver.mtu());
+            Serial.print("MTU ");
+            Serial.print(benchmarkReceiver.mtu());
+            Serial.print(", payload ");
+            Serial.println(benchmarkSender.payload());
+            break;
+        case BleBenchmark::Receiver::RESET_DONE:
+            resetBenchmark();
+            Serial.println("Counters reset by central");
+            break;
+        default:
+            Serial.print("Received ");
+            Serial.print(dataLength);
+            Serial.print(" bytes on ");
+            Serial.println(name);
+            break;
+    }
+}
+
 void setup() {
     Serial.begin(115200);
     while (!Serial);
@@ -50,10 +162,12 @@ void setup() {
     // Start advertising
     BLE.advertise();
     Serial.println("BLE device active, waiting for connections...");
-    Serial.println("Type text in Serial Monitor to send over BLE");
+    Serial.println("Commands: t (toggle sending), p<bytes> (payload), r (reset)");
 }
 
 void loop() {
+    pollSerial();
+
     // Listen for BLE peripherals to connect
     BLEDevice central = BLE.central();
 
@@ -61,65 +175,29 @@ void loop() {
     if (central) {
         Serial.print("Connected to central: ");
         Serial.println(central.address());
+        resetBenchmark();
 
         // While the central is still connected to peripheral
         while (central.connected()) {
-            // Check for incoming BLE data on both characteristics
+            pollSerial();
+
             if (rxCharacteristic.written()) {
-                // Get the received data
-                const uint8_t* data = rxCharacteristic.value();
-                int dataLength = rxCharacteristic.valueLength();
-                
-                Serial.print("Received data on RX (");
-                Serial.print(dataLength);
-                Serial.println(" bytes):");
-                
-                // Print received data as hex
-                for (int i = 0; i < dataLength; i++) {
-                    if (data[i] < 0x10) Serial.print("0");
-                    Serial.print(data[i], HEX);
-                    Serial.print(" ");
-                }
-                Serial.println();
-                
-                // Send acknowledgment through TX characteristic
-                txCharacteristic.writeValue(data, dataLength);
+                handleReceived("RX", rxCharacteristic.value(), rxCharacteristic.valueLength());
             }
-
             if (txCharacteristic.written()) {
-                // Get the received data
-                const uint8_t* data = txCharacteristic.value();
-                int dataLength = txCharacteristic.valueLength();
-                
-                Serial.print("Received data on TX (");
-                Serial.print(dataLength);
-                Serial.println(" bytes):");
-                
-                // Print received data as hex
-                for (int i = 0; i < dataLength; i++) {
-                    if (data[i] < 0x10) Serial.print("0");
-                    Serial.print(data[i], HEX);
-                    Serial.print(" ");
-                }
-                Serial.println();
+                handleReceived("TX", txCharacteristic.value(), txCharacteristic.valueLength());
             }
 
-            // Throughput test: send random string every loop
-            const int MSG_LEN = 1; // Length of each random message
-            char randomMsg[MSG_LEN + 1];
-            for (int i = 0; i < MSG_LEN; i++) {
-                randomMsg[i] = 'A' + random(0, 26); // Random uppercase letter
+            // One packet per pass; a refused send is retried with the same sequence number
+            if (benchmarkSending && txCharacteristic.subscribed()) {
+                size_t length = benchmarkSender.next(packetBuffer);
+                benchmarkSender.sent(txCharacteristic.writeValue(packetBuffer, length));
             }
-            randomMsg[MSG_LEN] = '\0'; // Null-terminate
-
-            txCharacteristic.writeValue((uint8_t*)randomMsg, MSG_LEN);
-            Serial.print("Sent: ");
-            Serial.println(randomMsg);
 
-            //delay(10); // Adjust or remove for faster/slower sending
+            printSummaries();
         }
 
         Serial.print("Disconnected from central: ");
         Serial.println(central.address());
     }
-} 
\ No newline at end of file
+}
@@ -0,0 +1,75 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Scaffolding shared by the host benches in tools/cpp, which all link into
+// one keybridge_bench binary (docs/tools.md). A bench registers itself with
+// its name and usage, reads its options from args and returns 0 if every
+// check passed, 1 if one failed and 2 for bad options:
+//
+//   KEYBRIDGE_BENCH(credit, "[--bytes N] [--seed S]") {
+//       size_t bytes = args.number("--bytes", size_t(1) << 20);
+//       unsigned seed = args.number("--seed", 1u);
+//       if (!args.done()) return 2;
+//       ...
+//   }
+namespace Bench {
+    class Args {
+    public:
+        Args(const char* name, const char* usage, int argc, char** argv);
+
+        // Value of option, or fallback if it wasn't given
+        template <typename T>
+        T number(const char* option, T fallback) {
+            const char* value = find(option);
+            if (!value) return fallback;
+            if (std::is_floating_point<T>::value) return T(strtod(value, nullptr));
+            return T(strtoull(value, nullptr, 0));
+        }
+        const char* text(const char* option, const char* fallback = nullptr);
+
+        // False, after printing the usage, if an option was unknown or had no value
+        bool done();
+
+    private:
+        const char* name_;
+        const char* usage_;
+        std::vector<const char*> argv_;
+        std::vector<bool> used_;
+        bool ok_ = true;
+
+        const char* find(const char* option);
+    };
+
+    // Prints what with ok or FAILED, returns pass
+    bool check(const char* what, bool pass);
+
+    // Whole file into text; false, after saying so, if it can't be read
+    bool readFile(const char* path, std::string& text);
+
+    // Nanoseconds per item for f() doing n items
+    template <typename F>
+    double nsPer(size_t n, F f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+    }
+
+    using Main = int (*)(Args& args);
+
+    struct Registration {
+        Registration(const char* name, const char* usage, Main main);
+    };
+}
+
+#define KEYBRIDGE_BENCH(name, usage)                                                  \
+    static int name##Bench(Bench::Args& args);                                       \
+    static const Bench::Registration name##Registration(#name, usage, name##Bench); \
+    static int name##Bench(Bench::Args& args)
+
+#endif
@@ -0,0 +1,537 @@
+#include "KeyBridgeClient.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+namespace {
+    // How long the I/O thread sleeps in poll() when nothing is happening
+    constexpr int IDLE_POLL_MS = 100;
+    // Upper bound on a single write() so one huge batch can't starve reads
+    constexpr size_t MAX_WRITE_CHUNK = 64 * 1024;
+
+    bool setNonBlocking(int fd) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+    }
+}
+
+KeyBridgeClient::KeyBridgeClient() {
+    if (pipe(wakePipe_) == 0) {
+        setNonBlocking(wakePipe_[0]);
+        setNonBlocking(wakePipe_[1]);
+    }
+}
+
+KeyBridgeClient::~KeyBridgeClient() {
+    stop();
+    if (wakePipe_[0] >= 0) close(wakePipe_[0]);
+    if (wakePipe_[1] >= 0) close(wakePipe_[1]);
+}
+
+bool KeyBridgeClient::start(const std::string& host, uint16_t port, int connectTimeoutMs) {
+    if (running_.load()) return true;
+    host_ = host;
+    port_ = port;
+    connectTimeoutMs_ = connectTimeoutMs;
+
+    bool ok = openSocket();
+    if (!ok && !autoReconnect_) return false;
+
+    running_.store(true);
+    thread_ = std::thread(&KeyBridgeClient::run, this);
+    return ok;
+}
+
+void KeyBridgeClient::stop() {
+    if (!running_.exchange(false)) return;
+    wake();
+    if (thread_.joinable()) thread_.join();
+    closeSocket();
+    drained_.notify_all();
+}
+
+void KeyBridgeClient::setAutoReconnect(bool enabled, int maxBackoffMs) {
+    autoReconnect_ = enabled;
+    maxBackoffMs_ = maxBackoffMs;
+}
+
+void KeyBridgeClient::onReport(ReportCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reportCallback_ = std::move(callback);
+}
+
+void KeyBridgeClient::onStateChange(StateCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stateCallback_ = std::move(callback);
+}
+
+bool KeyBridgeClient::sendReport(const KeyReport& report) {
+    return sendReports(&report, 1);
+}
+
+bool KeyBridgeClient::sendReports(const KeyReport* reports, size_t count) {
+    if (!running_.load()) return false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < count; ++i) appendReportLocked(reports[i]);
+        stats_.reportsSent += count;
+    }
+    wake();
+    return true;
+}
+
+bool KeyBridgeClient::sendRelease() {
+    KeyReport release = {};
+    return sendReport(release);
+}
+
+bool KeyBridgeClient::sendKeyTap(const KeyReport& report) {
+    KeyReport pair[2] = {report, {}};
+    return sendReports(pair, 2);
+}
+
+bool KeyBridgeClient::sendControl(uint8_t code) {
+    if (!running_.load()) return false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        appendControlLocked(code);
+    }
+    wake();
+    return true;
+}
+
+bool KeyBridgeClient::sendValue(uint8_t code, uint16_t value) {
+    if (!running_.load()) return false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        appendValueLocked(code, value);
+    }
+    wake();
+    return true;
+}
+
+bool KeyBridgeClient::sendText(const std::string& text) {
+    std::vector<uint8_t> bytes(text.begin(), text.end());
+    bytes.push_back(static_cast<uint8_t>(BridgeProtocol::TEXT_TERMINATOR));
+    return sendCharter(BridgeProtocol::Control::CHARTER, std::move(bytes));
+}
+
+bool KeyBridgeClient::sendCompressedText(const std::vector<uint8_t>& stream) {
+    if (stream.empty() || stream.back() != static_cast<uint8_t>(BridgeProtocol::TEXT_TERMINATOR)) return false;
+    return sendCharter(BridgeProtocol::Control::CHARTER_COMPRESSED, stream);
+}
+
+bool KeyBridgeClient::sendCharter(uint8_t code, std::vector<uint8_t> bytes) {
+    if (!running_.load()) return false;
+    {
+        // The device switches to text framing as soon as it parses the control
+        // report, so the text can follow in the same segment without a pause.
+        std::lock_guard<std::mutex> lock(mutex_);
+        appendControlLocked(code);
+        Segment segment;
+        segment.bytes = std::move(bytes);
+        if (textFlowControl_) {
+            segment.credited = true;
+            staged_.push_back(std::move(segment));
+            pumpLocked();
+        } else {
+            appendBytesLocked(segment.bytes.data(), segment.bytes.size());
+        }
+    }
+    wake();
+    return true;
+}
+
+bool KeyBridgeClient::sendBlob(uint8_t code, const std::vector<uint8_t>& data) {
+    if (!running_.load() || data.size() > 0xFFFF) return false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        appendValueLocked(code, static_cast<uint16_t>(data.size()));
+        appendBytesLocked(data.data(), data.size());
+    }
+    wake();
+    return true;
+}
+
+bool KeyBridgeClient::enableEventEncoding() {
+    if (!running_.load()) return false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wantEvents_ = true;
+        if (!txEvents_) {
+            appendControlLocked(BridgeProtocol::Control::EVENTS_ON);
+            txEncoder_.reset();
+            txEvents_ = true;
+        }
+    }
+    wake();
+    return true;
+}
+
+bool KeyBridgeClient::disableEventEncoding() {
+    if (!running_.load()) return false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wantEvents_ = false;
+        if (txEvents_) {
+            appendControlLocked(BridgeProtocol::Control::EVENTS_OFF);
+            txEvents_ = false;
+        }
+    }
+    wake();
+    return true;
+}
+
+void KeyBridgeClient::appendBytesLocked(const uint8_t* data, size_t length) {
+    if (staged_.empty()) {
+        outbound_.insert(outbound_.end(), data, data + length);
+    } else if (!staged_.back().credited) {
+        staged_.back().bytes.insert(staged_.back().bytes.end(), data, data + length);
+    } else {
+        Segment segment;
+        segment.bytes.assign(data, data + length);
+        staged_.push_back(std::move(segment));
+    }
+}
+
+void KeyBridgeClient::pumpLocked() {
+    while (!staged_.empty()) {
+        Segment& segment = staged_.front();
+        if (segment.credited) {
+            if (segment.fresh) {
+                textCredit_ = 0;
+                awaitingCreditStart_ = true;
+                segment.fresh = false;
+            }
+            size_t count = std::min(textCredit_, segment.bytes.size() - segment.offset);
+            outbound_.insert(outbound_.end(), segment.bytes.begin() + segment.offset,
+                             segment.bytes.begin() + segment.offset + count);
+            segment.offset += count;
+            textCredit_ -= count;
+            if (segment.offset < segment.bytes.size()) return;
+        } else {
+            outbound_.insert(outbound_.end(), segment.bytes.begin() + segment.offset, segment.bytes.end());
+        }
+        staged_.pop_front();
+    }
+}
+
+void KeyBridgeClient::addCredit(uint16_t credit, bool start) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (start) {
+            textCredit_ = 0;
+            awaitingCreditStart_ = false;
+        } else if (awaitingCreditStart_) {
+            // Granted for the previous stream, which is all sent
+            return;
+        }
+        textCredit_ += credit;
+        stats_.creditGranted += credit;
+        pumpLocked();
+    }
+    wake();
+}
+
+void KeyBridgeClient::appendReportLocked(const KeyReport& report) {
+    uint8_t code = BridgeProtocol::controlCode(report);
+    if (code != BridgeProtocol::Control::NONE) {
+        appendControlLocked(code);
+        return;
+    }
+    if (!txEvents_) {
+        appendBytesLocked(reinterpret_cast<const uint8_t*>(&report), BridgeProtocol::REPORT_SIZE);
+        return;
+    }
+    uint8_t events[KeyEventCodec::MAX_REPORT_BYTES];
+    size_t length = txEncoder_.encode(report, events);
+    appendBytesLocked(events, length);
+}
+
+void KeyBridgeClient::appendControlLocked(uint8_t code) {
+    if (!txEvents_) {
+        KeyReport control = BridgeProtocol::makeControlReport(code);
+        appendBytesLocked(reinterpret_cast<const uint8_t*>(&control), BridgeProtocol::REPORT_SIZE);
+        return;
+    }
+    uint8_t events[KeyEventCodec::MAX_EVENT_BYTES];
+    size_t length = KeyEventCodec::Encoder::encodeControl(code, events);
+    appendBytesLocked(events, length);
+}
+
+void KeyBridgeClient::appendValueLocked(uint8_t code, uint16_t value) {
+    if (!txEvents_) {
+        KeyReport report = BridgeProtocol::makeValueReport(code, value);
+        appendBytesLocked(reinterpret_cast<const uint8_t*>(&report), BridgeProtocol::REPORT_SIZE);
+        return;
+    }
+    uint8_t events[KeyEventCodec::MAX_EVENT_BYTES];
+    size_t length = KeyEventCodec::Encoder::encodeControl(code, events, value);
+    appendBytesLocked(events, length);
+}
+
+bool KeyBridgeClient::flush(int timeoutMs) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return drained_.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] {
+        return (outbound_.size() == outboundOffset_ && staged_.empty()) || !running_.load();
+    }) && outbound_.size() == outboundOffset_ && staged_.empty();
+}
+
+size_t KeyBridgeClient::pendingBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t pending = outbound_.size() - outboundOffset_;
+    for (const Segment& segment : staged_) pending += segment.bytes.size() - segment.offset;
+    return pending;
+}
+
+size_t KeyBridgeClient::writableBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return outbound_.size() - outboundOffset_;
+}
+
+KeyBridgeClient::Stats KeyBridgeClient::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void KeyBridgeClient::wake() {
+    if (wakePipe_[1] < 0) return;
+    uint8_t byte = 1;
+    ssize_t ignored = write(wakePipe_[1], &byte, 1);
+    (void)ignored;
+}
+
+bool KeyBridgeClient::openSocket() {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* results = nullptr;
+    std::string service = std::to_string(port_);
+    if (getaddrinfo(host_.c_str(), service.c_str(), &hints, &results) != 0) return false;
+
+    int fd = -1;
+    for (addrinfo* ai = results; ai != nullptr; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        setNonBlocking(fd);
+
+        int rc = connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (rc != 0 && errno == EINPROGRESS) {
+            pollfd pfd = {fd, POLLOUT, 0};
+            int error = 0;
+            socklen_t len = sizeof(error);
+            if (poll(&pfd, 1, connectTimeoutMs_) == 1 &&
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0) {
+                rc = 0;
+            }
+        }
+        if (rc == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(results);
+    if (fd < 0) return false;
+
+    // Reports are tiny; never let Nagle hold one back waiting for an ACK
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    StateCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fd_ = fd;
+        rxFill_ = 0;
+        rxEvents_.store(false);
+        // Whatever was queued while disconnected was framed for the old
+        // connection, possibly as events, and would desynchronise the new one
+        discardPendingLocked();
+        // The device starts every connection in raw framing
+        txEvents_ = false;
+        if (wantEvents_) {
+            appendControlLocked(BridgeProtocol::Control::EVENTS_ON);
+            txEncoder_.reset();
+            txEvents_ = true;
+        }
+        stats_.connects++;
+        callback = stateCallback_;
+    }
+    connected_.store(true);
+    if (callback) callback(true);
+    return true;
+}
+
+void KeyBridgeClient::closeSocket() {
+    StateCallback callback;
+    bool wasConnected = connected_.exchange(false);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fd_ >= 0) close(fd_);
+        fd_ = -1;
+        if (wasConnected) {
+            // A partially written stream would desynchronise the device's 8-byte
+            // framing on the next connection, so pending data is discarded.
+            stats_.disconnects++;
+            discardPendingLocked();
+            callback = stateCallback_;
+        }
+    }
+    drained_.notify_all();
+    if (wasConnected && callback) callback(false);
+}
+
+void KeyBridgeClient::discardPendingLocked() {
+    stats_.droppedBytes += outbound_.size() - outboundOffset_;
+    for (const Segment& segment : staged_) stats_.droppedBytes += segment.bytes.size() - segment.offset;
+    staged_.clear();
+    outbound_.clear();
+    outboundOffset_ = 0;
+    textCredit_ = 0;
+    awaitingCreditStart_ = false;
+}
+
+bool KeyBridgeClient::writePending() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (outboundOffset_ < outbound_.size()) {
+        size_t chunk = std::min(outbound_.size() - outboundOffset_, MAX_WRITE_CHUNK);
+        ssize_t written = send(fd_, outbound_.data() + outboundOffset_, chunk, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Drop the already-sent prefix so a slow link can't grow the buffer forever
+                if (outboundOffset_ >= MAX_WRITE_CHUNK) {
+                    outbound_.erase(outbound_.begin(), outbound_.begin() + outboundOffset_);
+                    outboundOffset_ = 0;
+                }
+                return true;
+            }
+            if (errno == EINTR) continue;
+            return false;
+        }
+        stats_.writeCalls++;
+        stats_.bytesSent += static_cast<uint64_t>(written);
+        outboundOffset_ += static_cast<size_t>(written);
+    }
+    outbound_.clear();
+    outboundOffset_ = 0;
+    lock.unlock();
+    drained_.notify_all();
+    return true;
+}
+
+bool KeyBridgeClient::readAvailable() {
+    uint8_t buf[4096];
+    while (true) {
+        ssize_t got = recv(fd_, buf, sizeof(buf), 0);
+        if (got == 0) return false;
+        if (got < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.bytesReceived += static_cast<uint64_t>(got);
+        }
+        for (ssize_t i = 0; i < got; ++i) {
+            if (rxEvents_.load()) {
+                switch (rxDecoder_.feed(buf[i])) {
+                    case KeyEventCodec::Decoder::REPORT:
+                        deliverReport(rxDecoder_.report());
+                        break;
+                    case KeyEventCodec::Decoder::CONTROL:
+                        if (rxDecoder_.control() == BridgeProtocol::Notify::CREDIT ||
+                            rxDecoder_.control() == BridgeProtocol::Notify::CREDIT_START) {
+                            addCredit(rxDecoder_.value(), rxDecoder_.control() == BridgeProtocol::Notify::CREDIT_START);
+                            break;
+                        }
+                        if (rxDecoder_.control() == BridgeProtocol::Control::EVENTS_OFF) rxEvents_.store(false);
+                        // Value notifications keep their value
+                        if (rxDecoder_.control() & BridgeProtocol::VALUE_FLAG) {
+                            deliverReport(BridgeProtocol::makeValueReport(rxDecoder_.control(), rxDecoder_.value()));
+                            break;
+                        }
+                        deliverReport(BridgeProtocol::makeControlReport(rxDecoder_.control()));
+                        break;
+                    default:
+                        break;
+                }
+                continue;
+            }
+
+            rxFrame_[rxFill_++] = buf[i];
+            if (rxFill_ < BridgeProtocol::REPORT_SIZE) continue;
+            rxFill_ = 0;
+            KeyReport report;
+            memcpy(&report, rxFrame_, sizeof(report));
+            uint16_t credit = 0;
+            uint8_t code = BridgeProtocol::valueCode(report, credit);
+            if (code == BridgeProtocol::Notify::CREDIT || code == BridgeProtocol::Notify::CREDIT_START) {
+                addCredit(credit, code == BridgeProtocol::Notify::CREDIT_START);
+                continue;
+            }
+            if (BridgeProtocol::controlCode(report) == BridgeProtocol::Notify::EVENTS_ON) {
+                // Everything after the ack is delta encoded
+                rxDecoder_.reset();
+                rxEvents_.store(true);
+            }
+            deliverReport(report);
+        }
+    }
+}
+
+void KeyBridgeClient::deliverReport(const KeyReport& report) {
+    ReportCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.reportsReceived++;
+        callback = reportCallback_;
+    }
+    if (callback) callback(report);
+}
+
+void KeyBridgeClient::run() {
+    int backoffMs = 50;
+    while (running_.load()) {
+        if (!connected_.load()) {
+            if (!autoReconnect_) break;
+            if (!openSocket()) {
+                pollfd pfd = {wakePipe_[0], POLLIN, 0};
+                poll(&pfd, 1, backoffMs);
+                backoffMs = std::min(backoffMs * 2, maxBackoffMs_);
+                continue;
+            }
+            backoffMs = 50;
+        }
+
+        pollfd fds[2];
+        fds[0] = {fd_, POLLIN, 0};
+        fds[1] = {wakePipe_[0], POLLIN, 0};
+        if (writableBytes() > 0) fds[0].events |= POLLOUT;
+
+        if (poll(fds, 2, IDLE_POLL_MS) < 0 && errno != EINTR) break;
+
+        if (fds[1].revents & POLLIN) {
+            uint8_t drain[64];
+            while (read(wakePipe_[0], drain, sizeof(drain)) > 0) {}
+        }
+
+        bool ok = true;
+        if (fds[0].revents & (POLLERR | POLLHUP)) ok = false;
+        if (ok && (fds[0].revents & POLLIN)) ok = readAvailable();
+        // Try writing whenever data is queued; the socket is usually writable
+        // and this saves a poll() round for freshly queued batches.
+        if (ok && writableBytes() > 0) ok = writePending();
+        if (!ok) closeSocket();
+    }
+}
@@ -0,0 +1,163 @@
+#ifndef KEY_BRIDGE_CLIENT_H
+#define KEY_BRIDGE_CLIENT_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BridgeProtocol.h" // Shared with the firmware (ArduinoKeyBridge/)
+#include "KeyEventCodec.h"
+
+// Host-side client for the ArduinoKeyBridge TCP protocol.
+//
+// All socket I/O happens on a background thread using a non-blocking socket,
+// so send calls only append to an outbound buffer and return immediately.
+// Consecutive sends are pipelined into as few write() calls as the kernel
+// accepts; there are no per-report round trips or sleeps.
+class KeyBridgeClient {
+public:
+    using ReportCallback = std::function<void(const KeyReport&)>;
+    using StateCallback = std::function<void(bool connected)>;
+
+    struct Stats {
+        uint64_t bytesSent = 0;
+        uint64_t bytesReceived = 0;
+        uint64_t reportsSent = 0;
+        uint64_t reportsReceived = 0;
+        uint64_t writeCalls = 0;
+        uint64_t connects = 0;
+        uint64_t disconnects = 0;
+        uint64_t droppedBytes = 0; // Queued bytes discarded on disconnect or reconnect
+        uint64_t creditGranted = 0; // Charter text bytes the device allowed
+    };
+
+    KeyBridgeClient();
+    ~KeyBridgeClient();
+    KeyBridgeClient(const KeyBridgeClient&) = delete;
+    KeyBridgeClient& operator=(const KeyBridgeClient&) = delete;
+
+    // Start the I/O thread and connect. Returns false if the first connect
+    // fails and auto-reconnect is disabled.
+    bool start(const std::string& host, uint16_t port, int connectTimeoutMs = 3000);
+    void stop();
+
+    // Reconnect with exponential backoff (capped at maxBackoffMs) when the link drops
+    void setAutoReconnect(bool enabled, int maxBackoffMs = 2000);
+
+    // Invoked on the I/O thread for every 8-byte report the device sends
+    void onReport(ReportCallback callback);
+    void onStateChange(StateCallback callback);
+
+    // Queue reports for sending. All return false if the client is stopped.
+    // Anything queued while disconnected is discarded when the link comes
+    // back, so it never reaches the device framed for an old connection.
+    bool sendReport(const KeyReport& report);
+    bool sendReports(const KeyReport* reports, size_t count);
+    bool sendRelease();
+    bool sendKeyTap(const KeyReport& report); // Report followed by a release
+    bool sendControl(uint8_t code);
+    // Value report: code with VALUE_FLAG set and a 16-bit argument
+    bool sendValue(uint8_t code, uint16_t value);
+
+    // Charter mode text: CHARTER control report followed by NUL-terminated text.
+    // The text is released as the device grants CREDIT, so documents of any
+    // size can be queued; reports sent afterwards wait behind it.
+    bool sendText(const std::string& text);
+    // Same with a CharterCodec stream (ArduinoKeyBridge/CharterCodec.h), sent
+    // after a CHARTER_COMPRESSED control report; stream must end with END.
+    // Credit then counts compressed bytes.
+    bool sendCompressedText(const std::vector<uint8_t>& stream);
+    // Disable for firmware that predates charter credits
+    void setTextFlowControl(bool enabled) { textFlowControl_ = enabled; }
+
+    // Binary upload: a value report with code and length followed by the raw
+    // bytes. The device answers with a BLOB_OK or BLOB_ERROR control report.
+    bool sendBlob(uint8_t code, const std::vector<uint8_t>& data);
+
+    // Switch this connection to delta-encoded events (KeyEventCodec). Takes
+    // effect immediately for everything queued afterwards, and is renegotiated
+    // automatically after a reconnect.
+    bool enableEventEncoding();
+    bool disableEventEncoding();
+    // True once the device acknowledged EVENTS_ON on the current connection
+    bool eventEncodingAcked() const { return rxEvents_.load(); }
+
+    // Wait until the outbound buffer has been handed to the kernel
+    bool flush(int timeoutMs = 5000);
+
+    bool isConnected() const { return connected_.load(); }
+    size_t pendingBytes() const;
+    Stats stats() const;
+
+private:
+    void appendBytesLocked(const uint8_t* data, size_t length);
+    void appendReportLocked(const KeyReport& report);
+    void appendControlLocked(uint8_t code);
+    void appendValueLocked(uint8_t code, uint16_t value);
+    // Control report code followed by credit-gated charter bytes
+    bool sendCharter(uint8_t code, std::vector<uint8_t> bytes);
+    void deliverReport(const KeyReport& report);
+    void addCredit(uint16_t credit, bool start);
+    void pumpLocked();
+    size_t writableBytes() const;
+    void run();
+    bool openSocket();
+    void closeSocket();
+    // Drops queued and staged bytes, counting them in stats_.droppedBytes
+    void discardPendingLocked();
+    bool writePending();
+    bool readAvailable();
+    void wake();
+
+    std::string host_;
+    uint16_t port_ = 0;
+    int connectTimeoutMs_ = 3000;
+    bool autoReconnect_ = true;
+    int maxBackoffMs_ = 2000;
+
+    int fd_ = -1;
+    int wakePipe_[2] = {-1, -1};
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> connected_{false};
+
+    mutable std::mutex mutex_;
+    std::condition_variable drained_;
+    std::vector<uint8_t> outbound_;
+    size_t outboundOffset_ = 0;
+
+    // Bytes waiting behind a credit-gated text stream, in send order
+    struct Segment {
+        std::vector<uint8_t> bytes;
+        size_t offset = 0;
+        bool credited = false; // Charter text, released only against credit
+        bool fresh = true;     // Credit starts from zero for a new stream
+    };
+    std::deque<Segment> staged_;
+    size_t textCredit_ = 0;
+    // A new stream is at the front and its CREDIT_START hasn't come yet: a
+    // CREDIT now is a late one for the previous stream
+    bool awaitingCreditStart_ = false;
+    bool textFlowControl_ = true;
+    Stats stats_;
+
+    bool wantEvents_ = false;
+    bool txEvents_ = false;
+    KeyEventCodec::Encoder txEncoder_;
+
+    uint8_t rxFrame_[BridgeProtocol::REPORT_SIZE];
+    size_t rxFill_ = 0;
+    std::atomic<bool> rxEvents_{false};
+    KeyEventCodec::Decoder rxDecoder_;
+
+    ReportCallback reportCallback_;
+    StateCallback stateCallback_;
+};
+
+#endif
@@ -0,0 +1,120 @@
+// Runs the host benches in tools/cpp (docs/tools.md).
+//
+//   keybridge_bench                    list the benches and their options
+//   keybridge_bench NAME [options]     run one
+//   keybridge_bench all                run every bench with its defaults
+//
+// Exits with the bench's status: 0 if every check passed, 1 if one failed,
+// 2 for bad options.
+
+#include "BenchHarness.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace {
+    struct Entry {
+        const char* name;
+        const char* usage;
+        Bench::Main main;
+    };
+
+    // Filled by the Registration objects before main() runs
+    std::vector<Entry>& benches() {
+        static std::vector<Entry> list;
+        return list;
+    }
+
+    int run(const Entry& bench, int argc, char** argv) {
+        Bench::Args args(bench.name, bench.usage, argc, argv);
+        return bench.main(args);
+    }
+
+    void list() {
+        fprintf(stderr, "usage: keybridge_bench NAME [options] | all\n");
+        for (const Entry& bench : benches()) fprintf(stderr, "  %-16s %s\n", bench.name, bench.usage);
+    }
+}
+
+namespace Bench {
+    Args::Args(const char* name, const char* usage, int argc, char** argv)
+        : name_(name), usage_(usage), argv_(argv, argv + argc), used_(argc, false) {}
+
+    const char* Args::find(const char* option) {
+        for (size_t i = 0; i < argv_.size(); ++i) {
+            if (strcmp(argv_[i], option) != 0) continue;
+            used_[i] = true;
+            if (i + 1 >= argv_.size()) {
+                ok_ = false;
+                return nullptr;
+            }
+            used_[i + 1] = true;
+            return argv_[i + 1];
+        }
+        return nullptr;
+    }
+
+    const char* Args::text(const char* option, const char* fallback) {
+        const char* value = find(option);
+        return value ? value : fallback;
+    }
+
+    bool Args::done() {
+        ok_ &= std::find(used_.begin(), used_.end(), false) == used_.end();
+        if (!ok_) fprintf(stderr, "usage: keybridge_bench %s %s\n", name_, usage_);
+        return ok_;
+    }
+
+    bool check(const char* what, bool pass) {
+        printf("%-60s %s\n", what, pass ? "ok" : "FAILED");
+        return pass;
+    }
+
+    bool readFile(const char* path, std::string& text) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            fprintf(stderr, "cannot read %s\n", path);
+            return false;
+        }
+        text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    Registration::Registration(const char* name, const char* usage, Main main) {
+        benches().push_back({name, usage, main});
+    }
+}
+
+int main(int argc, char** argv) {
+    std::sort(benches().begin(), benches().end(),
+              [](const Entry& a, const Entry& b) { return strcmp(a.name, b.name) < 0; });
+    if (argc < 2) {
+        list();
+        return 2;
+    }
+
+    if (!strcmp(argv[1], "all") && argc == 2) {
+        size_t failed = 0;
+        for (const Entry& bench : benches()) {
+            printf("== %s\n", bench.name);
+            fflush(stdout);
+            int status = run(bench, 0, nullptr);
+            if (status != 0) {
+                printf("== %s FAILED (%d)\n", bench.name, status);
+                failed++;
+            }
+        }
+        printf("%zu of %zu benches passed\n", benches().size() - failed, benches().size());
+        return failed ? 1 : 0;
+    }
+
+    for (const Entry& bench : benches()) {
+        if (!strcmp(argv[1], bench.name)) return run(bench, argc - 2, argv + 2);
+    }
+    fprintf(stderr, "no bench named %s\n", argv[1]);
+    list();
+    return 2;
+}
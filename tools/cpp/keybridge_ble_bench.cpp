@@ -0,0 +1,201 @@
+// Host harness for the BluetoothKeyBridge benchmark mode
+// (BluetoothKeyBridge/arduino/BluetoothKeyBridge/BleBenchmark.h).
+//
+//   keybridge_bench ble [--seconds S] [--interval-us U] [--per-event N]
+//
+// Runs the sender and receiver against a simulated TX characteristic: the
+// stack queues a few notifications and sends up to N of them per connection
+// event, refusing writes while its queue is full. Checks that the counters
+// match injected loss, duplication, reordering and corruption exactly, then
+// prints the per-second summaries for a few payload sizes.
+
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+#include "BleBenchmark.h"
+#include "BenchHarness.h"
+
+namespace {
+    using BleBenchmark::Counters;
+
+    struct Faults {
+        unsigned dropEvery = 0;
+        unsigned duplicateEvery = 0;
+        unsigned swapEvery = 0;
+        unsigned corruptEvery = 0;
+    };
+
+    // Notifications queued in the stack and delivered on connection events
+    class SimulatedCharacteristic {
+    public:
+        SimulatedCharacteristic(size_t queueDepth, const Faults& faults) : depth_(queueDepth), faults_(faults) {}
+
+        bool writeValue(const uint8_t* data, size_t length) {
+            if (queue_.size() >= depth_) return false;
+            queue_.emplace_back(data, data + length);
+            return true;
+        }
+
+        // Delivers up to perEvent notifications, applying the faults
+        void connectionEvent(size_t perEvent, BleBenchmark::Receiver& receiver) {
+            for (size_t i = 0; i < perEvent && !queue_.empty(); ++i) {
+                std::vector<uint8_t> packet = queue_.front();
+                queue_.pop_front();
+                delivered_++;
+                if (faults_.dropEvery && delivered_ % faults_.dropEvery == 0) {
+                    dropped++;
+                    continue;
+                }
+                if (faults_.swapEvery && delivered_ % faults_.swapEvery == 0 && !queue_.empty()) {
+                    // The next packet overtakes this one
+                    std::vector<uint8_t> next = queue_.front();
+                    queue_.pop_front();
+                    delivered_++;
+                    receiver.receive(next.data(), next.size());
+                    swapped++;
+                }
+                if (faults_.corruptEvery && delivered_ % faults_.corruptEvery == 0 && packet.size() > BleBenchmark::HEADER_SIZE) {
+                    packet.back() ^= 0x5A;
+                    corrupted++;
+                }
+                receiver.receive(packet.data(), packet.size());
+                if (faults_.duplicateEvery && delivered_ % faults_.duplicateEvery == 0) {
+                    receiver.receive(packet.data(), packet.size());
+                    duplicated++;
+                }
+            }
+        }
+
+        uint32_t dropped = 0;
+        uint32_t duplicated = 0;
+        uint32_t swapped = 0;
+        uint32_t corrupted = 0;
+
+    private:
+        size_t depth_;
+        Faults faults_;
+        std::deque<std::vector<uint8_t>> queue_;
+        uint32_t delivered_ = 0;
+    };
+
+    struct Link {
+        unsigned long intervalUs = 7500;
+        size_t perEvent = 4;
+        size_t queueDepth = 8;
+    };
+
+    // Runs the sketch's send loop for the given time; one send attempt per 100 us pass
+    void simulate(BleBenchmark::Sender& sender, BleBenchmark::Receiver& receiver, SimulatedCharacteristic& characteristic,
+                  const Link& link, unsigned long seconds, bool printSummaries) {
+        uint8_t packet[BleBenchmark::MAX_PAYLOAD];
+        BleBenchmark::Summary txSummary;
+        BleBenchmark::Summary rxSummary;
+        txSummary.start(0);
+        rxSummary.start(0);
+        unsigned long nextEventUs = link.intervalUs;
+        for (unsigned long us = 0; us <= seconds * 1000000UL; us += 100) {
+            size_t length = sender.next(packet);
+            sender.sent(characteristic.writeValue(packet, length));
+            if (us >= nextEventUs) {
+                characteristic.connectionEvent(link.perEvent, receiver);
+                nextEventUs += link.intervalUs;
+            }
+            Counters delta;
+            unsigned long elapsedMs = 0;
+            if (txSummary.due(us / 1000, sender.counters(), delta, elapsedMs) && printSummaries) {
+                printf("  TX %6lu pkt/s %8lu B/s refused %lu\n", (unsigned long)delta.packets * 1000 / elapsedMs,
+                       (unsigned long)delta.bytes * 1000 / elapsedMs, (unsigned long)delta.failed);
+            }
+            if (rxSummary.due(us / 1000, receiver.counters(), delta, elapsedMs) && printSummaries) {
+                printf("  RX %6lu pkt/s %8lu B/s lost %lu\n", (unsigned long)delta.packets * 1000 / elapsedMs,
+                       (unsigned long)delta.bytes * 1000 / elapsedMs, (unsigned long)delta.lost);
+            }
+        }
+        // Let the queue drain
+        for (int i = 0; i < 16; ++i) characteristic.connectionEvent(link.perEvent, receiver);
+    }
+
+    bool expect(const char* what, uint32_t got, uint32_t want) {
+        if (got == want) return true;
+        printf("FAIL %s: got %lu, expected %lu\n", what, (unsigned long)got, (unsigned long)want);
+        return false;
+    }
+
+    bool faultTest(const char* name, const Faults& faults, const Link& link) {
+        BleBenchmark::Sender sender(20);
+        BleBenchmark::Receiver receiver;
+        SimulatedCharacteristic characteristic(link.queueDepth, faults);
+        simulate(sender, receiver, characteristic, link, 2, false);
+
+        const Counters& tx = sender.counters();
+        const Counters& rx = receiver.counters();
+        bool ok = true;
+        // Every packet the sender counted was delivered, dropped or duplicated
+        ok &= expect("packets", rx.packets, tx.packets - characteristic.dropped + characteristic.duplicated);
+        // A swap looks like one lost packet that then arrives late
+        ok &= expect("lost", rx.lost, characteristic.dropped + characteristic.swapped);
+        ok &= expect("out of order", rx.outOfOrder, characteristic.duplicated + characteristic.swapped);
+        ok &= expect("corrupt", rx.corrupt, characteristic.corrupted);
+        ok &= expect("next sequence", receiver.expected(), sender.sequence());
+        ok &= tx.failed > 0; // The stack queue filled up at least once
+        printf("%-12s sent %6lu refused %6lu | received %6lu lost %4lu out of order %4lu corrupt %4lu  %s\n", name,
+               (unsigned long)tx.packets, (unsigned long)tx.failed, (unsigned long)rx.packets, (unsigned long)rx.lost,
+               (unsigned long)rx.outOfOrder, (unsigned long)rx.corrupt, ok ? "ok" : "FAILED");
+        return ok;
+    }
+
+    bool controlTest() {
+        bool ok = true;
+        BleBenchmark::Sender sender;
+        BleBenchmark::Receiver receiver;
+        const uint8_t config[] = {BleBenchmark::CONFIG, 247, 0};
+        ok &= receiver.receive(config, sizeof(config)) == BleBenchmark::Receiver::CONFIGURED;
+        sender.setMtu(receiver.mtu());
+        ok &= expect("payload at MTU 247", uint32_t(sender.payload()), 244);
+        sender.setMtu(23);
+        ok &= expect("payload at MTU 23", uint32_t(sender.payload()), 20);
+        sender.setPayload(1000);
+        ok &= expect("payload clamped", uint32_t(sender.payload()), BleBenchmark::MAX_PAYLOAD);
+        sender.setPayload(1);
+        ok &= expect("payload minimum", uint32_t(sender.payload()), BleBenchmark::MIN_PAYLOAD);
+
+        uint8_t packet[BleBenchmark::MAX_PAYLOAD];
+        size_t length = sender.next(packet);
+        receiver.receive(packet, length);
+        const uint8_t reset[] = {BleBenchmark::RESET};
+        ok &= receiver.receive(reset, sizeof(reset)) == BleBenchmark::Receiver::RESET_DONE;
+        ok &= expect("packets after reset", receiver.counters().packets, 0);
+        const uint8_t text[] = {'h', 'i'};
+        ok &= receiver.receive(text, sizeof(text)) == BleBenchmark::Receiver::IGNORED;
+        printf("control packets: %s\n", ok ? "ok" : "FAILED");
+        return ok;
+    }
+}
+
+KEYBRIDGE_BENCH(ble, "[--seconds S] [--interval-us U] [--per-event N]") {
+    unsigned long seconds = args.number("--seconds", 3ul);
+    Link link;
+    link.intervalUs = args.number("--interval-us", link.intervalUs);
+    link.perEvent = args.number("--per-event", link.perEvent);
+    if (!args.done()) return 2;
+    if (seconds == 0 || link.intervalUs < 100 || link.perEvent == 0) return 2;
+
+    bool ok = controlTest();
+    ok &= faultTest("clean", Faults{}, link);
+    ok &= faultTest("drop", Faults{50, 0, 0, 0}, link);
+    ok &= faultTest("duplicate", Faults{0, 30, 0, 0}, link);
+    ok &= faultTest("reorder", Faults{0, 0, 25, 0}, link);
+    ok &= faultTest("corrupt", Faults{0, 0, 0, 40}, link);
+    ok &= faultTest("everything", Faults{97, 61, 43, 31}, link);
+    if (!ok) return 1;
+
+    for (size_t payload : {size_t(20), size_t(100), size_t(244)}) {
+        printf("payload %zu, %lu us interval, %zu packets per event:\n", payload, link.intervalUs, link.perEvent);
+        BleBenchmark::Sender sender(payload);
+        BleBenchmark::Receiver receiver;
+        SimulatedCharacteristic characteristic(link.queueDepth, Faults{});
+        simulate(sender, receiver, characteristic, link, seconds, true);
+    }
+    return 0;
+}
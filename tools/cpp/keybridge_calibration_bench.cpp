@@ -0,0 +1,171 @@
+// Host test for typing-rate calibration (ArduinoKeyBridge/TypingCalibrator.h).
+//
+//   keybridge_bench calibration [--runs N] [--seed S]
+//
+// Types the calibration probe the way TCPConnection does (rollover reports,
+// released every 16 characters, one report per interval from the HID queue)
+// into simulated hosts that lose keys when they come too fast:
+//
+//   - native:  handles a key in 0.2 ms, never loses one
+//   - remote:  a remote desktop that forwards a key every 2.5 ms through an
+//              8 key buffer and drops what doesn't fit
+//   - vm:      jittery 1-4 ms per key with a 4 key buffer
+//   - flaky:   loses keys at random below 4 ms per report, more the faster
+//   - hopeless: loses a key now and then at any rate
+//
+// The server's side of the protocol is modelled too: the CRC-16 of the text
+// that arrived decides each probe. For every host the search is run N times
+// and compared with the fastest interval that came through 50 probes without
+// a loss. Prints the intervals found and the probes they took, and fails if
+// more than 5% of the searches settle on an interval that loses keys.
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Crc16.h"
+#include "MagicKeyboardKeyMap.h"
+#include "RolloverTyper.h"
+#include "TypingCalibrator.h"
+#include "BenchHarness.h"
+
+namespace {
+    struct Host {
+        const char* name;
+        double serviceUs;   // Time the application takes per key
+        double jitterUs;    // Extra random time per key
+        size_t buffer;      // Keys that can wait; more are dropped
+        double lossBelowUs; // Random loss when reports come faster than this
+        double baseLoss;    // Random loss at any rate
+    };
+
+    const Host HOSTS[] = {
+        {"native", 200, 0, 64, 0, 0},
+        {"remote", 2500, 0, 8, 0, 0},
+        {"vm", 1000, 3000, 4, 0, 0},
+        {"flaky", 100, 0, 64, 4000, 0},
+        {"hopeless", 100, 0, 64, 0, 0.01},
+    };
+
+    // Reports for one probe, as TCPConnection::serviceCalibration() types them
+    std::vector<KeyReport> probeReports() {
+        std::string text = std::string(TypingCalibrator::PROBE) + "\n";
+        std::vector<KeyReport> reports;
+        RolloverTyper typer;
+        KeyReport out[RolloverTyper::MAX_REPORTS_PER_KEY];
+        for (size_t i = 0; i < text.size(); ++i) {
+            const KeyInfo* key = findKeyForChar(text[i]);
+            if (key) {
+                size_t count = typer.press(key->hexCode, key->shifted ? 0x02 : 0x00, out);
+                reports.insert(reports.end(), out, out + count);
+            }
+            if ((i + 1) % 16 == 0 || i + 1 == text.size()) {
+                if (typer.release(out) > 0) reports.push_back(out[0]);
+            }
+        }
+        return reports;
+    }
+
+    char charFor(uint8_t key, bool shifted) {
+        for (size_t i = 0; i < unifiedKeyMapSize; ++i) {
+            const KeyInfo& k = unifiedKeyMap[i];
+            if (k.hexCode == key && k.shifted == shifted && k.asciiValue >= 0) return char(k.asciiValue);
+        }
+        return '?';
+    }
+
+    // Text the application ends up with when reports arrive every intervalUs
+    std::string typeProbe(const Host& host, const std::vector<KeyReport>& reports, unsigned long intervalUs,
+                          std::mt19937& rng) {
+        std::uniform_real_distribution<double> unit(0, 1);
+        std::deque<double> waiting; // Arrival times of keys not handled yet
+        std::deque<char> pending;
+        std::string text;
+        double busyUntil = 0;
+        double lossChance = host.baseLoss;
+        if (intervalUs < host.lossBelowUs) lossChance += 0.05 * (host.lossBelowUs - intervalUs) / host.lossBelowUs;
+
+        auto handleUntil = [&](double now) {
+            while (!waiting.empty()) {
+                double start = std::max(busyUntil, waiting.front());
+                if (start > now) break;
+                busyUntil = start + host.serviceUs + host.jitterUs * unit(rng);
+                text += pending.front();
+                waiting.pop_front();
+                pending.pop_front();
+            }
+        };
+
+        KeyReport last = {};
+        for (size_t i = 0; i < reports.size(); ++i) {
+            double now = double(i) * intervalUs;
+            handleUntil(now);
+            const KeyReport& report = reports[i];
+            bool shifted = report.modifiers & 0x22;
+            for (uint8_t key : report.keys) {
+                if (key == 0 || memchr(last.keys, key, sizeof(last.keys))) continue;
+                if (unit(rng) < lossChance || waiting.size() >= host.buffer) continue;
+                waiting.push_back(now);
+                pending.push_back(charFor(key, shifted));
+            }
+            last = report;
+        }
+        handleUntil(1e18);
+        return text;
+    }
+
+    // The server's answer: CRC-16 of the line that arrived
+    bool lossFree(const std::string& text) {
+        std::string line = text;
+        if (!line.empty() && line.back() == '\n') line.pop_back();
+        return crc16(reinterpret_cast<const uint8_t*>(line.data()), line.size()) == TypingCalibrator::probeCrc();
+    }
+}
+
+KEYBRIDGE_BENCH(calibration, "[--runs N] [--seed S]") {
+    int runs = args.number("--runs", 200);
+    unsigned seed = args.number("--seed", 1u);
+    if (!args.done()) return 2;
+
+    std::mt19937 rng(seed);
+    std::vector<KeyReport> reports = probeReports();
+    printf("probe: %zu characters, %zu reports\n", strlen(TypingCalibrator::PROBE) + 1, reports.size());
+
+    bool ok = true;
+    for (const Host& host : HOSTS) {
+        // Reference: fastest candidate with no loss in 50 probes
+        unsigned long reference = 0;
+        for (unsigned long interval : TypingCalibrator::CANDIDATES) {
+            bool clean = true;
+            for (int t = 0; t < 50 && clean; ++t) clean = lossFree(typeProbe(host, reports, interval, rng));
+            if (!clean) break;
+            reference = interval;
+        }
+
+        int exact = 0, slower = 0, faster = 0, maxProbes = 0;
+        double probes = 0;
+        for (int r = 0; r < runs; ++r) {
+            TypingCalibrator calibrator;
+            calibrator.begin();
+            while (calibrator.isRunning()) {
+                calibrator.report(lossFree(typeProbe(host, reports, calibrator.probeInterval(), rng)));
+            }
+            unsigned long found = calibrator.result();
+            if (found == reference) exact++;
+            else if (reference != 0 && (found == 0 || found > reference)) slower++;
+            else faster++;
+            probes += calibrator.probes();
+            maxProbes = std::max(maxProbes, int(calibrator.probes()));
+        }
+        // Picking a faster interval than the reference means typing that loses keys
+        printf("%-9s reference %5lu us  found it %3d/%d  slower %3d  faster %3d  probes avg %.1f max %d\n", host.name,
+               reference, exact, runs, slower, faster, probes / runs, maxProbes);
+        // A host that loses keys at any rate has no right answer, only the probe count matters
+        if (reference) ok &= faster * 20 <= runs;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+// Host compressor and round-trip check for compressed charter text
+// (ArduinoKeyBridge/CharterCodec.h).
+//
+//   keybridge_charter_pack [-o OUT] [--link-bps B] FILE...
+//
+// Compresses every file, decodes the stream again the way TCPConnection
+// does (one compressed byte at a time, output stopping whenever the charter
+// buffer is full) and checks that the text comes back unchanged. Prints the
+// compression ratio and the transfer time at B bytes/s for plain and
+// compressed text. Bytes that can't be typed (NUL, 0x80 and above) are
+// dropped first, as the device would skip them. With -o and one file the
+// compressed stream is written to OUT, ready for KeyBridgeClient::sendCompressedText().
+//
+// Also feeds random bytes to the decoder to check that malformed streams
+// are rejected without reading outside the window.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CharterCodec.h"
+
+namespace {
+    std::vector<uint8_t> typeable(const std::string& text, size_t& dropped) {
+        std::vector<uint8_t> out;
+        dropped = 0;
+        for (char c : text) {
+            if (CharterCodec::isTypeable(uint8_t(c))) out.push_back(uint8_t(c));
+            else dropped++;
+        }
+        return out;
+    }
+
+    // Decodes like TCPConnection::pollCompressedCharterText(), with a random
+    // amount of free space in the charter buffer on every poll
+    bool roundTrip(const std::vector<uint8_t>& stream, const std::vector<uint8_t>& text, std::mt19937& rng,
+                   size_t& polls) {
+        std::unique_ptr<CharterCodec::Decoder> decoder(new CharterCodec::Decoder());
+        std::vector<uint8_t> decoded;
+        size_t in = 0;
+        bool done = false;
+        polls = 0;
+        while (!done) {
+            if (++polls > 10 * (stream.size() + text.size()) + 100) return false;
+            size_t freeSpace = rng() % 64;
+            while (freeSpace > 0) {
+                if (decoder->pending() > 0) {
+                    decoded.push_back(uint8_t(decoder->next()));
+                    freeSpace--;
+                    continue;
+                }
+                if (in >= stream.size()) return false; // No END
+                CharterCodec::Decoder::Result result = decoder->feed(stream[in++]);
+                if (result == CharterCodec::Decoder::FAILED) return false;
+                if (result == CharterCodec::Decoder::DONE) {
+                    done = true;
+                    break;
+                }
+            }
+        }
+        return in == stream.size() && decoded == text;
+    }
+
+    bool fuzz(unsigned seed) {
+        std::mt19937 rng(seed);
+        std::unique_ptr<CharterCodec::Decoder> decoder(new CharterCodec::Decoder());
+        size_t failed = 0, produced = 0;
+        for (int i = 0; i < 200000; ++i) {
+            while (decoder->pending() > 0) {
+                decoder->next();
+                produced++;
+            }
+            CharterCodec::Decoder::Result result = decoder->feed(uint8_t(rng()));
+            if (result == CharterCodec::Decoder::FAILED) failed++;
+            if (result == CharterCodec::Decoder::DONE) decoder->reset();
+        }
+        printf("random input: %zu characters, %zu bad tokens rejected\n", produced, failed);
+        return failed > 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* output = nullptr;
+    double linkBps = 8000;
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc) output = argv[++i];
+        else if (!strcmp(argv[i], "--link-bps") && i + 1 < argc) linkBps = atof(argv[++i]);
+        else if (argv[i][0] == '-') {
+            fprintf(stderr, "usage: keybridge_charter_pack [-o OUT] [--link-bps B] FILE...\n");
+            return 2;
+        } else files.push_back(argv[i]);
+    }
+    if (files.empty() || linkBps <= 0 || (output && files.size() != 1)) {
+        fprintf(stderr, "usage: keybridge_charter_pack [-o OUT] [--link-bps B] FILE...\n");
+        return 2;
+    }
+
+    std::unique_ptr<CharterCodec::Encoder> encoder(new CharterCodec::Encoder());
+    std::mt19937 rng(1);
+    bool ok = true;
+    size_t totalPlain = 0, totalPacked = 0;
+    for (const char* path : files) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            fprintf(stderr, "cannot read %s\n", path);
+            return 1;
+        }
+        std::string raw((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        size_t dropped = 0;
+        std::vector<uint8_t> text = typeable(raw, dropped);
+        std::vector<uint8_t> stream(text.size() + 1);
+        stream.resize(encoder->compress(text.data(), text.size(), stream.data(), stream.size()));
+
+        size_t polls = 0;
+        bool same = !stream.empty() && roundTrip(stream, text, rng, polls);
+        ok &= same;
+        // Plain text is NUL terminated as well
+        totalPlain += text.size() + 1;
+        totalPacked += stream.size();
+        printf("%-40s %8zu -> %7zu bytes  %5.2fx  %7.2f s -> %6.2f s  %s", path, text.size() + 1, stream.size(),
+               double(text.size() + 1) / stream.size(), (text.size() + 1) / linkBps, stream.size() / linkBps,
+               same ? "ok" : "ROUND TRIP FAILED");
+        if (dropped) printf("  (%zu bytes that can't be typed dropped)", dropped);
+        printf("\n");
+
+        if (output && same) {
+            std::ofstream out(output, std::ios::binary);
+            out.write(reinterpret_cast<const char*>(stream.data()), std::streamsize(stream.size()));
+            if (!out) {
+                fprintf(stderr, "cannot write %s\n", output);
+                return 1;
+            }
+        }
+    }
+    if (files.size() > 1) {
+        printf("total %zu -> %zu bytes, %.2fx\n", totalPlain, totalPacked, double(totalPlain) / totalPacked);
+    }
+    ok &= fuzz(7);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+// Host benchmark for ChordMatcher, the chord/sequence detector used by the
+// firmware's ChordStage.
+//
+//   keybridge_bench chord [--events N]
+//
+// Compiles 10 to 1000 random bindings (1-4 steps, some with modifiers) and
+// measures the matching cost per key event on a random stream, then checks
+// that typing every binding fires exactly that binding.
+//
+// Then checks the cases the firmware's mode keys rely on: F19 with Shift
+// held, an exact chord winning over an anyModifiers binding, Shift pressed
+// on the way through a sequence, and both shifts pressed in the middle of
+// one. Last, what passes on to the host once a binding completes: only its
+// key or modifiers are swallowed, until released.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "ChordMatcher.h"
+#include "BenchHarness.h"
+
+namespace {
+    typedef ChordMatcher<8192, 16384> Matcher;
+
+    struct Binding {
+        std::vector<Matcher::Step> steps;
+        uint8_t action;
+    };
+
+    Matcher::Step randomStep(std::mt19937& rng) {
+        static const uint8_t MODIFIERS[] = {0x00, 0x00, 0x00, 0x01, 0x02, 0x04, 0x08};
+        Matcher::Step step;
+        step.modifiers = MODIFIERS[rng() % sizeof(MODIFIERS)];
+        step.key = uint8_t(0x04 + rng() % 0x60);
+        return step;
+    }
+
+    std::vector<Binding> makeBindings(size_t count, std::mt19937& rng) {
+        std::vector<Binding> bindings;
+        while (bindings.size() < count) {
+            Binding binding;
+            // Start every sequence with one of the F13-F24 leader keys
+            binding.steps.push_back(Matcher::Step{0x00, uint8_t(0x68 + rng() % 12)});
+            size_t length = 1 + rng() % 4;
+            while (binding.steps.size() < length) binding.steps.push_back(randomStep(rng));
+            binding.action = uint8_t(1 + bindings.size() % 255);
+            bindings.push_back(binding);
+        }
+        return bindings;
+    }
+
+    // One report per event: the chord pressed, then everything released
+    void pressStep(Matcher& matcher, const Matcher::Step& step, unsigned long& now, std::vector<uint8_t>& fired) {
+        KeyReport press = {step.modifiers, 0, {step.key, 0, 0, 0, 0, 0}};
+        KeyReport release = {};
+        uint8_t action = matcher.feed(press, now++);
+        if (action != Matcher::NO_ACTION) fired.push_back(action);
+        action = matcher.feed(release, now++);
+        if (action != Matcher::NO_ACTION) fired.push_back(action);
+    }
+
+    void run(size_t bindingCount, size_t events) {
+        std::mt19937 rng(7);
+        std::vector<Binding> bindings = makeBindings(bindingCount, rng);
+
+        std::unique_ptr<Matcher> matcher(new Matcher());
+        std::vector<bool> accepted;
+        size_t added = 0;
+        auto compileStart = std::chrono::steady_clock::now();
+        for (const Binding& binding : bindings) {
+            // Duplicate sequences are rejected
+            accepted.push_back(matcher->addBinding(binding.steps.data(), binding.steps.size(), binding.action));
+            if (accepted.back()) added++;
+        }
+        double compileUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - compileStart).count();
+
+        // Random stream, a quarter of it leader keys so sequences get entered often
+        std::vector<KeyReport> stream(events);
+        for (KeyReport& report : stream) {
+            Matcher::Step step = (rng() % 4 == 0) ? Matcher::Step{0x00, uint8_t(0x68 + rng() % 12)} : randomStep(rng);
+            report = KeyReport{step.modifiers, 0, {step.key, 0, 0, 0, 0, 0}};
+        }
+        size_t fires = 0;
+        unsigned long now = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const KeyReport& report : stream) {
+            if (matcher->feed(report, now++) != Matcher::NO_ACTION) fires++;
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / events;
+
+        // Every binding typed on its own (after a timeout) must fire itself, unless a
+        // longer binding shares the prefix, in which case it fires on the timeout
+        size_t correct = 0;
+        matcher->reset();
+        now += 10000;
+        for (size_t b = 0; b < bindings.size(); ++b) {
+            if (!accepted[b]) continue;
+            const Binding& binding = bindings[b];
+            std::vector<uint8_t> fired;
+            for (const Matcher::Step& step : binding.steps) pressStep(*matcher, step, now, fired);
+            now += 5000;
+            uint8_t action = matcher->poll(now);
+            if (action != Matcher::NO_ACTION) fired.push_back(action);
+            if (fired.size() == 1 && fired[0] == binding.action) correct++;
+        }
+
+        printf("%8zu  %6zu  %6zu  %10.1f  %10.2f  %8zu  %zu/%zu\n", bindingCount, added,
+               matcher->nodeCount(), compileUs, ns, fires, correct, added);
+    }
+
+    // Reports in order, one millisecond apart; returns the actions fired
+    std::vector<uint8_t> type(ChordMatcher<32, 64>& matcher, std::initializer_list<KeyReport> reports) {
+        static unsigned long now = 0;
+        std::vector<uint8_t> fired;
+        matcher.reset();
+        now += 10000;
+        for (const KeyReport& report : reports) {
+            uint8_t action = matcher.feed(report, now++);
+            if (action != Matcher::NO_ACTION) fired.push_back(action);
+        }
+        now += 5000;
+        uint8_t action = matcher.poll(now);
+        if (action != Matcher::NO_ACTION) fired.push_back(action);
+        return fired;
+    }
+
+    bool check(const char* what, const std::vector<uint8_t>& fired, std::vector<uint8_t> want) {
+        return Bench::check(what, fired == want);
+    }
+
+    // What ChordStage passes on: every fired action is acted on and swallowed
+    std::vector<KeyReport> passed(ChordMatcher<32, 64>& matcher, std::initializer_list<KeyReport> reports) {
+        static unsigned long now = 0;
+        std::vector<KeyReport> out;
+        matcher.reset();
+        now += 10000;
+        for (KeyReport report : reports) {
+            if (matcher.feed(report, now++) != Matcher::NO_ACTION) matcher.swallow();
+            matcher.strip(report);
+            out.push_back(report);
+        }
+        return out;
+    }
+
+    bool check(const char* what, const std::vector<KeyReport>& got, std::initializer_list<KeyReport> want) {
+        bool ok = got.size() == want.size() && std::equal(got.begin(), got.end(), want.begin(), [](const KeyReport& a, const KeyReport& b) {
+            return memcmp(&a, &b, sizeof(KeyReport)) == 0;
+        });
+        return Bench::check(what, ok);
+    }
+
+    // The bindings of ChordStage (ArduinoKeyBridge/KeyStages.cpp)
+    bool checkModeKeys() {
+        typedef ChordMatcher<32, 64> Firmware;
+        enum : uint8_t { CHARTER = 1, COMMAND, ROLLOVER, SHIFT_F19 };
+        const Firmware::Step F19[] = {{0x00, 0x6E}};
+        const Firmware::Step SHIFTED_F19[] = {{0x02, 0x6E}};
+        const Firmware::Step BOTH_SHIFTS[] = {{0x22, 0x00}};
+        const Firmware::Step F13_R[] = {{0x00, 0x68}, {0x00, 0x15}};
+        const KeyReport none = {}, f13 = {0x00, 0, {0x68}}, r = {0x00, 0, {0x15}};
+        const KeyReport leftShift = {0x02, 0, {}}, bothShifts = {0x22, 0, {}};
+        const KeyReport shiftF19 = {0x02, 0, {0x6E}}, ctrlF19 = {0x01, 0, {0x6E}};
+
+        Firmware matcher;
+        matcher.addBinding(F19, 1, CHARTER, true);
+        matcher.addBinding(BOTH_SHIFTS, 1, COMMAND);
+        matcher.addBinding(F13_R, 2, ROLLOVER);
+        bool ok = true;
+        ok &= check("F19 with Shift held toggles charter mode", type(matcher, {shiftF19, none}), {CHARTER});
+        ok &= check("F13, Shift pressed and released, then R", type(matcher, {f13, none, leftShift, none, r, none}), {ROLLOVER});
+        ok &= check("F13 then both shifts toggles command mode", type(matcher, {f13, none, leftShift, bothShifts, none}), {COMMAND});
+        ok &= check("F13 then F19 toggles charter mode", type(matcher, {f13, none, ctrlF19, none}), {CHARTER});
+
+        matcher.addBinding(SHIFTED_F19, 1, SHIFT_F19);
+        ok &= check("an exact Shift+F19 binding wins over any modifiers", type(matcher, {shiftF19, none}), {SHIFT_F19});
+        ok &= check("Ctrl+F19 still falls back to any modifiers", type(matcher, {ctrlF19, none}), {CHARTER});
+
+        // What the host gets around a completed binding
+        const KeyReport ctrl = {0x01, 0, {}}, a = {0x00, 0, {0x04}}, f19 = {0x00, 0, {0x6E}};
+        const KeyReport f19A = {0x00, 0, {0x6E, 0x04}}, bothShiftsA = {0x22, 0, {0x04}};
+        ok &= check("Ctrl+F19 keeps Ctrl, F19 never reaches the host", passed(matcher, {ctrlF19, ctrl, none}), {ctrl, ctrl, none});
+        ok &= check("a key pressed with F19 still reaches the host", passed(matcher, {f19A, a, none}), {a, a, none});
+        ok &= check("F19 is swallowed while held, on every press", passed(matcher, {f19, f19, f19A, a, f19}), {none, none, a, a, none});
+        ok &= check("both shifts are swallowed until released", passed(matcher, {leftShift, bothShifts, bothShiftsA, none}),
+                    {leftShift, none, a, none});
+        return ok;
+    }
+}
+
+KEYBRIDGE_BENCH(chord, "[--events N]") {
+    size_t events = args.number("--events", size_t(2000000));
+    if (!args.done()) return 2;
+    if (events == 0) return 2;
+
+    printf("bindings   added   nodes  compile us  ns/report     fires  verified\n");
+    for (size_t count : {10, 100, 300, 1000}) run(count, events);
+    printf("\n");
+    return checkModeKeys() ? 0 : 1;
+}
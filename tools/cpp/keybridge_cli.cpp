@@ -0,0 +1,989 @@
+// Command line front end for KeyBridgeClient.
+//
+//   keybridge_cli [--host H] [--port P] report <8 hex bytes>
+//   keybridge_cli [--host H] [--port P] control <code>
+//   keybridge_cli [--host H] [--port P] type <text>
+//   keybridge_cli [--host H] [--port P] type-file [--compress] <path>
+//   keybridge_cli [--host H] [--port P] listen [seconds]
+//   keybridge_cli [--host H] [--port P] bench [--count N] [--batch B]
+//   keybridge_cli codec-stats <trace>
+//   keybridge_cli typing-verify [--chunk N] <text file>
+//   keybridge_cli remap-build <spec> <blob>
+//   keybridge_cli [--host H] [--port P] remap-load <blob>
+//   keybridge_cli snippet-build <spec> <image>
+//   keybridge_cli [--host H] [--port P] snippet-load <image>
+//   keybridge_cli config-build <spec> <blob>
+//   keybridge_cli [--host H] [--port P] config-load <blob>
+//   keybridge_cli [--host H] [--port P] calibrate [--profile NAME]
+//   keybridge_cli [--host H] [--port P] trace [--every N] [--inject-ms MS] [seconds]
+//
+// --events switches the connection to delta-encoded key events first.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "BridgeClock.h"
+#include "BridgeConfig.h"
+#include "CharterCodec.h"
+#include "KeyBridgeClient.h"
+#include "Crc16.h"
+#include "HidReportQueue.h"
+#include "KeyRemap.h"
+#include "LatencyTracer.h"
+#include "MagicKeyboardKeyMap.h"
+#include "RolloverTyper.h"
+#include "SnippetLibrary.h"
+#include "TypingCalibrator.h"
+
+namespace {
+    const char* DEFAULT_HOST = "192.168.4.1";
+    constexpr uint16_t DEFAULT_PORT = 8080;
+
+    void usage() {
+        fprintf(stderr,
+            "usage: keybridge_cli [--host H] [--port P] [--events] <command> [args]\n"
+            "  report <b0> .. <b7>        send one raw 8-byte report (hex)\n"
+            "  control <code>             send a 0x22 control report\n"
+            "  value <code> <value>       send a value report (e.g. 0x44 20: log rate)\n"
+            "  type <text>                type text through charter mode\n"
+            "  type-file [--compress] <path>\n"
+            "                             stream a file through charter mode, optionally\n"
+            "                             compressed (CharterCodec)\n"
+            "  listen [seconds]           print reports sent by the device\n"
+            "  bench [--count N] [--batch B]\n"
+            "                             pipelined key tap throughput test\n"
+            "  codec-stats <trace>        event codec round trip and size on a\n"
+            "                             trace recorded with 'listen' (offline)\n"
+            "  remap-build <spec> <blob>  compile a remap spec into a table blob (offline)\n"
+            "  remap-load <blob>          upload remap tables, stored in device flash\n"
+            "                             (an empty file clears them)\n"
+            "  snippet-build <spec> <image>\n"
+            "                             build a snippet library image (offline)\n"
+            "  snippet-load <image>       upload snippets, stored in device flash\n"
+            "                             (an empty file clears them)\n"
+            "  config-build <spec> <blob> build a device config from the defaults and\n"
+            "                             'key value' lines (offline)\n"
+            "  config-load <blob>         upload a config, stored in device flash\n"
+            "                             (an empty file restores the defaults)\n"
+            "  calibrate [--profile NAME]  find the fastest typing rate this host takes\n"
+            "                             without losing keys, stored in device flash per\n"
+            "                             profile (default: the host name); keep this\n"
+            "                             terminal focused\n"
+            "  trace [--every N] [--inject-ms MS] [seconds]\n"
+            "                             trace 1 in N keyboard reports (default 1) for a\n"
+            "                             while (default 10 s), answering command mode\n"
+            "                             reports by typing them back, optionally injecting\n"
+            "                             a traced F24 tap every MS; then print the device's\n"
+            "                             latency histograms per path and hop\n"
+            "  typing-verify [--chunk N] <file>\n"
+            "                             replay rollover typing of a text file through\n"
+            "                             a HID keyboard model (offline)\n");
+    }
+
+    // Last BLOB_OK / BLOB_ERROR answer from the device, 0 while waiting
+    std::atomic<uint8_t> blobResult{0};
+
+    // Calibration notifications: probe interval (counts up per probe), probe
+    // typed, and the final interval once done
+    std::atomic<unsigned> calibrationProbes{0};
+    std::atomic<unsigned long> calibrationInterval{0};
+    std::atomic<bool> calibrationEnd{false};
+    std::atomic<bool> calibrationDone{false};
+    std::atomic<unsigned long> calibrationResult{0};
+
+    void printReport(const KeyReport& report) {
+        uint8_t code = BridgeProtocol::controlCode(report);
+        if (code == BridgeProtocol::Notify::BLOB_OK || code == BridgeProtocol::Notify::BLOB_ERROR) {
+            blobResult.store(code);
+            return;
+        }
+        if (code == BridgeProtocol::Notify::CALIBRATE_END) {
+            calibrationEnd.store(true);
+            return;
+        }
+        uint16_t value = 0;
+        code = BridgeProtocol::valueCode(report, value);
+        if (code == BridgeProtocol::Notify::CALIBRATE_PROBE) {
+            calibrationInterval.store(value);
+            calibrationProbes.fetch_add(1);
+            return;
+        }
+        if (code == BridgeProtocol::Notify::CALIBRATE_DONE) {
+            calibrationResult.store(value);
+            calibrationDone.store(true);
+            return;
+        }
+        printf("%02x %02x %02x %02x %02x %02x %02x %02x\n",
+               report.modifiers, report.reserved,
+               report.keys[0], report.keys[1], report.keys[2],
+               report.keys[3], report.keys[4], report.keys[5]);
+        fflush(stdout);
+    }
+
+    int runBench(KeyBridgeClient& client, int argc, char** argv) {
+        size_t count = 10000;
+        size_t batch = 64;
+        for (int i = 0; i < argc; ++i) {
+            if (!strcmp(argv[i], "--count") && i + 1 < argc) count = strtoul(argv[++i], nullptr, 0);
+            else if (!strcmp(argv[i], "--batch") && i + 1 < argc) batch = strtoul(argv[++i], nullptr, 0);
+        }
+        if (batch == 0) batch = 1;
+
+        // Alternate press/release of 'a'..'z' so every report is a distinct state
+        std::vector<KeyReport> reports;
+        reports.reserve(batch * 2);
+
+        auto start = std::chrono::steady_clock::now();
+        size_t sent = 0;
+        while (sent < count) {
+            reports.clear();
+            for (size_t i = 0; i < batch && sent < count; ++i, ++sent) {
+                KeyReport press = {0x00, 0x00, {static_cast<uint8_t>(0x04 + sent % 26), 0, 0, 0, 0, 0}};
+                reports.push_back(press);
+                reports.push_back(KeyReport{});
+            }
+            if (!client.sendReports(reports.data(), reports.size())) break;
+            // Keep the backlog bounded so the measurement reflects the link, not memory
+            while (client.pendingBytes() > batch * 2 * BridgeProtocol::REPORT_SIZE * 4 && client.isConnected()) {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
+        bool flushed = client.flush(30000);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        KeyBridgeClient::Stats stats = client.stats();
+        printf("taps: %zu reports: %llu bytes: %llu write calls: %llu\n", sent,
+               (unsigned long long)stats.reportsSent, (unsigned long long)stats.bytesSent,
+               (unsigned long long)stats.writeCalls);
+        printf("elapsed: %.3f s  rate: %.0f reports/s  %.1f KiB/s%s\n", seconds,
+               stats.reportsSent / seconds, stats.bytesSent / seconds / 1024.0,
+               flushed ? "" : "  (flush timed out)");
+        return flushed ? 0 : 1;
+    }
+
+    std::set<uint8_t> keySet(const KeyReport& report) {
+        std::set<uint8_t> keys;
+        for (uint8_t key : report.keys) {
+            if (key != 0) keys.insert(key);
+        }
+        return keys;
+    }
+
+    // Encodes a recorded trace with KeyEventCodec, decodes it again and checks
+    // that the key state after every original report is reproduced.
+    int runCodecStats(const char* path) {
+        std::ifstream in(path);
+        if (!in) {
+            fprintf(stderr, "cannot read %s\n", path);
+            return 1;
+        }
+
+        KeyEventCodec::Encoder encoder;
+        KeyEventCodec::Decoder decoder;
+        size_t reports = 0, rawBytes = 0, encodedBytes = 0, decodedReports = 0, mismatches = 0;
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            unsigned value;
+            uint8_t raw[8];
+            int n = 0;
+            while (n < 8 && fields >> std::hex >> value) raw[n++] = static_cast<uint8_t>(value);
+            if (n != 8) continue;
+
+            KeyReport report;
+            memcpy(&report, raw, sizeof(report));
+            uint8_t events[KeyEventCodec::MAX_REPORT_BYTES];
+            uint8_t code = BridgeProtocol::controlCode(report);
+            size_t length = code != BridgeProtocol::Control::NONE
+                ? KeyEventCodec::Encoder::encodeControl(code, events)
+                : encoder.encode(report, events);
+
+            for (size_t i = 0; i < length; ++i) {
+                if (decoder.feed(events[i]) == KeyEventCodec::Decoder::REPORT) decodedReports++;
+            }
+            if (code == BridgeProtocol::Control::NONE &&
+                (decoder.report().modifiers != report.modifiers || keySet(decoder.report()) != keySet(report))) {
+                mismatches++;
+            }
+            reports++;
+            rawBytes += BridgeProtocol::REPORT_SIZE;
+            encodedBytes += length;
+        }
+
+        printf("reports: %zu  raw bytes: %zu  encoded bytes: %zu  ratio: %.2fx\n", reports, rawBytes,
+               encodedBytes, encodedBytes ? double(rawBytes) / encodedBytes : 0.0);
+        printf("decoded reports: %zu  state mismatches: %zu  rollover drops: %u\n", decodedReports,
+               mismatches, decoder.rolloverDrops());
+        return mismatches == 0 ? 0 : 1;
+    }
+
+    bool readFile(const char* path, std::vector<uint8_t>& data) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    // Remap spec, one statement per line, keycodes and masks in hex, '#' comments:
+    //
+    //   layer base | momentary <key> | toggle <key>   start a layer (base first)
+    //   map <from> <to>        key to key; e0-e7 turn a key into a modifier
+    //   block <key>            drop the key
+    //   mod <bit> <mask>       modifier bit 0-7 becomes mask (00 drops it)
+    int runRemapBuild(const char* specPath, const char* outPath) {
+        std::ifstream in(specPath);
+        if (!in) {
+            fprintf(stderr, "cannot read %s\n", specPath);
+            return 1;
+        }
+
+        std::vector<uint8_t> blob = {'K', 'R', KeyRemap::VERSION, 0};
+        uint8_t* layer = nullptr;
+        std::string line;
+        int lineNumber = 0;
+        auto fail = [&](const char* message) {
+            fprintf(stderr, "%s:%d: %s\n", specPath, lineNumber, message);
+            return 1;
+        };
+        while (std::getline(in, line)) {
+            lineNumber++;
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            std::string word;
+            if (!(fields >> word)) continue;
+
+            if (word == "layer") {
+                std::string type;
+                unsigned key = 0;
+                fields >> type >> std::hex >> key;
+                uint8_t layerType = type == "base" ? KeyRemap::BASE
+                    : type == "momentary" ? KeyRemap::MOMENTARY
+                    : type == "toggle" ? KeyRemap::TOGGLE : 0xFF;
+                if (layerType == 0xFF) return fail("unknown layer type");
+                if ((blob[3] == 0) != (layerType == KeyRemap::BASE)) return fail("the first layer, and only it, must be base");
+                if (layerType != KeyRemap::BASE && (key == 0 || key > 0xFF)) return fail("layer needs an activation key");
+                if (blob[3] == KeyRemap::MAX_LAYERS) return fail("too many layers");
+                blob[3]++;
+                size_t offset = blob.size();
+                blob.resize(offset + KeyRemap::LAYER_SIZE, KeyRemap::TRANSPARENT);
+                layer = blob.data() + offset;
+                layer[0] = layerType;
+                layer[1] = uint8_t(key);
+                memset(layer + 2, KeyRemap::MOD_TRANSPARENT, 8);
+                continue;
+            }
+
+            if (!layer) return fail("statement before the first layer");
+            unsigned a = 0, b = 0;
+            if (word == "map" && (fields >> std::hex >> a >> b) && a > 0 && a <= 0xFF && b > 1 && b <= 0xFF) {
+                layer[10 + a] = uint8_t(b);
+            } else if (word == "block" && (fields >> std::hex >> a) && a > 0 && a <= 0xFF) {
+                layer[10 + a] = KeyRemap::BLOCKED;
+            } else if (word == "mod" && (fields >> std::hex >> a >> b) && a < 8 && b <= 0xFE) {
+                layer[2 + a] = uint8_t(b);
+            } else {
+                return fail("bad statement");
+            }
+        }
+        if (blob[3] == 0) return fail("no layers");
+
+        uint16_t crc = crc16(blob.data(), blob.size());
+        blob.push_back(uint8_t(crc & 0xFF));
+        blob.push_back(uint8_t(crc >> 8));
+        if (!KeyRemap::validate(blob.data(), blob.size())) return fail("internal error, blob does not validate");
+
+        std::ofstream out(outPath, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(blob.data()), blob.size());
+        if (!out) {
+            fprintf(stderr, "cannot write %s\n", outPath);
+            return 1;
+        }
+        printf("%u layers, %zu bytes\n", blob[3], blob.size());
+        return 0;
+    }
+
+    // What a host does with a report stream: a key types a character when it
+    // appears in a report it wasn't in before, shifted by that report's modifiers.
+    struct HidModel {
+        KeyReport last{};
+        std::string typed;
+        size_t reports = 0;
+        size_t unknown = 0;
+
+        void apply(const KeyReport& report) {
+            reports++;
+            std::set<uint8_t> before = keySet(last);
+            bool shifted = (report.modifiers & 0x02) != 0;
+            for (uint8_t key : report.keys) {
+                if (key == 0 || before.count(key)) continue;
+                const KeyInfo* info = nullptr;
+                for (size_t j = 0; j < unifiedKeyMapSize && !info; ++j) {
+                    const KeyInfo& k = unifiedKeyMap[j];
+                    if (k.hexCode == key && k.shifted == shifted && k.asciiValue >= 0) info = &k;
+                }
+                if (info) typed += static_cast<char>(info->asciiValue);
+                else unknown++;
+            }
+            last = report;
+        }
+    };
+
+    // Snippet spec: "@<id> <name>" starts a snippet, the lines up to the next
+    // one are its text (the last line break is dropped). Lines before the
+    // first snippet and lines starting with '#' right after a header are
+    // comments.
+    int runSnippetBuild(const char* specPath, const char* outPath) {
+        std::ifstream in(specPath);
+        if (!in) {
+            fprintf(stderr, "cannot read %s\n", specPath);
+            return 1;
+        }
+        struct Spec {
+            unsigned id;
+            std::string name;
+            std::string text;
+        };
+        std::vector<Spec> specs;
+        std::string line;
+        int lineNumber = 0;
+        bool header = false;
+        while (std::getline(in, line)) {
+            lineNumber++;
+            if (!line.empty() && line[0] == '@') {
+                std::istringstream fields(line.substr(1));
+                Spec spec;
+                if (!(fields >> spec.id >> spec.name) || spec.id > 0xFFFF) {
+                    fprintf(stderr, "%s:%d: expected @<id> <name>\n", specPath, lineNumber);
+                    return 1;
+                }
+                specs.push_back(spec);
+                header = true;
+                continue;
+            }
+            if (specs.empty() || (header && !line.empty() && line[0] == '#')) continue;
+            header = false;
+            specs.back().text += line + "\n";
+        }
+        std::vector<SnippetLibrary::Source> sources;
+        size_t textBytes = 0;
+        for (Spec& spec : specs) {
+            if (!spec.text.empty()) spec.text.pop_back();
+            sources.push_back({uint16_t(spec.id), spec.name.c_str(), spec.text.c_str(), spec.text.size()});
+            textBytes += spec.text.size();
+        }
+
+        std::vector<uint8_t> image(0x10000);
+        image.resize(SnippetLibrary::build(sources.data(), sources.size(), image.data(), image.size()));
+        if (image.empty()) {
+            fprintf(stderr, "%s: no snippets, too many, repeated ids or names, or a name over %zu characters\n",
+                    specPath, SnippetLibrary::MAX_NAME_LENGTH);
+            return 1;
+        }
+        std::ofstream out(outPath, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(image.data()), image.size());
+        if (!out) {
+            fprintf(stderr, "cannot write %s\n", outPath);
+            return 1;
+        }
+        printf("%zu snippets, %zu bytes of text, %zu byte image\n", sources.size(), textBytes, image.size());
+        return 0;
+    }
+
+    // Config spec: "<key> <value>" lines over BridgeConfig::defaults(), '#'
+    // starts a comment. Keys are the BridgeConfig fields:
+    //   port, ssid, password, log-level (debug, info, warning, error or a
+    //   number), led-pin, led-count, led-idle, led-mode, hid-interval-us,
+    //   status-interval-ms, charter-chunk, macro-pad-route (host or server)
+    int runConfigBuild(const char* specPath, const char* outPath) {
+        std::ifstream in(specPath);
+        if (!in) {
+            fprintf(stderr, "cannot read %s\n", specPath);
+            return 1;
+        }
+
+        BridgeConfig config = BridgeConfig::defaults();
+        std::string line;
+        int lineNumber = 0;
+        auto fail = [&](const char* message) {
+            fprintf(stderr, "%s:%d: %s\n", specPath, lineNumber, message);
+            return 1;
+        };
+        const std::map<std::string, unsigned> levels = {{"debug", 1}, {"info", 2}, {"warning", 3}, {"error", 4}};
+        while (std::getline(in, line)) {
+            lineNumber++;
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            std::string key, value;
+            if (!(fields >> key)) continue;
+            if (!(fields >> value)) return fail("missing value");
+
+            if (key == "ssid" || key == "password") {
+                char* field = key == "ssid" ? config.apSsid : config.apPassword;
+                size_t size = key == "ssid" ? BridgeConfig::SSID_SIZE : BridgeConfig::PASSWORD_SIZE;
+                if (value.size() >= size) return fail("too long");
+                memset(field, 0, size);
+                memcpy(field, value.data(), value.size());
+                continue;
+            }
+            unsigned long number;
+            if (key == "log-level" && levels.count(value)) {
+                number = levels.at(value);
+            } else if (key == "macro-pad-route" && (value == "host" || value == "server")) {
+                number = value == "host" ? BridgeConfig::ROUTE_HOST : BridgeConfig::ROUTE_SERVER;
+            } else {
+                char* end = nullptr;
+                number = strtoul(value.c_str(), &end, 0);
+                if (*end != 0) return fail("expected a number");
+            }
+            if (key == "port" && number <= 0xFFFF) config.port = uint16_t(number);
+            else if (key == "log-level" && number <= 0xFF) config.logLevel = uint8_t(number);
+            else if (key == "led-pin" && number <= 0xFF) config.ledPin = uint8_t(number);
+            else if (key == "led-count" && number <= 0xFFFF) config.ledCount = uint16_t(number);
+            else if (key == "led-idle" && number <= 0xFF) config.ledIdleBrightness = uint8_t(number);
+            else if (key == "led-mode" && number <= 0xFF) config.ledModeBrightness = uint8_t(number);
+            else if (key == "hid-interval-us" && number <= 0xFFFF) config.hidIntervalUs = uint16_t(number);
+            else if (key == "status-interval-ms" && number <= 0xFFFFFFFF) config.statusIntervalMs = uint32_t(number);
+            else if (key == "charter-chunk" && number <= 0xFF) config.charterChunk = uint8_t(number);
+            else if (key == "macro-pad-route" && number <= 0xFF) config.macroPadRoute = uint8_t(number);
+            else return fail("unknown key or value out of range");
+        }
+
+        config.seal();
+        if (!config.valid()) {
+            fprintf(stderr, "%s: a value is out of range (ssid 1-32 and password 8-63 characters, port not 0, "
+                            "led-count 1-24, hid-interval-us from 125, status-interval-ms %u-%u, "
+                            "charter-chunk 1-%u, macro-pad-route host or server)\n", specPath,
+                    BridgeConfig::MIN_STATUS_INTERVAL_MS, BridgeConfig::MAX_STATUS_INTERVAL_MS,
+                    BridgeConfig::MAX_CHARTER_CHUNK);
+            return 1;
+        }
+        std::ofstream out(outPath, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&config), sizeof(config));
+        if (!out) {
+            fprintf(stderr, "cannot write %s\n", outPath);
+            return 1;
+        }
+        printf("access point %s, port %u, log level %u, %u LEDs on pin %u, %u us per HID report, %zu bytes\n",
+               config.apSsid, config.port, config.logLevel, config.ledCount, config.ledPin, config.hidIntervalUs,
+               sizeof(config));
+        return 0;
+    }
+
+    // Uploads a blob and waits for the device's answer
+    int runBlobLoad(KeyBridgeClient& client, uint8_t code, const std::vector<uint8_t>& blob, const char* applied) {
+        client.sendBlob(code, blob);
+        auto until = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (blobResult.load() == 0 && std::chrono::steady_clock::now() < until) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        uint8_t result = blobResult.load();
+        printf("%s\n", result == BridgeProtocol::Notify::BLOB_OK ? applied
+                       : result == BridgeProtocol::Notify::BLOB_ERROR ? "device rejected the blob" : "no answer");
+        client.stop();
+        return result == BridgeProtocol::Notify::BLOB_OK ? 0 : 1;
+    }
+
+    // The server's side of typing calibration: reads what the device types
+    // into this terminal and answers each probe with the CRC-16 of the line
+    // that arrived (see TypingCalibrator.h)
+    int runCalibrate(KeyBridgeClient& client, int argc, char** argv) {
+        std::string profile;
+        for (int i = 0; i < argc; ++i) {
+            if (!strcmp(argv[i], "--profile") && i + 1 < argc) {
+                profile = argv[++i];
+            } else {
+                usage();
+                return 2;
+            }
+        }
+        if (profile.empty()) {
+            char name[256] = {};
+            gethostname(name, sizeof(name) - 1);
+            profile = name;
+        }
+        uint16_t profileId = crc16(reinterpret_cast<const uint8_t*>(profile.data()), profile.size());
+
+        // Keys have to arrive one by one and stay off the screen
+        bool tty = isatty(STDIN_FILENO);
+        termios saved = {};
+        if (tty) {
+            tcgetattr(STDIN_FILENO, &saved);
+            termios raw = saved;
+            raw.c_lflag &= ~(ICANON | ECHO);
+            raw.c_cc[VMIN] = 0;
+            raw.c_cc[VTIME] = 0;
+            tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+        }
+
+        printf("calibrating profile \"%s\" (%04x), keep this terminal focused\n", profile.c_str(), profileId);
+        fflush(stdout);
+        client.sendValue(BridgeProtocol::Control::HOST_PROFILE, profileId);
+        client.sendControl(BridgeProtocol::Control::CALIBRATE);
+
+        std::string typed;
+        unsigned probes = 0;
+        auto lastActivity = std::chrono::steady_clock::now();
+        int rc = 1;
+        while (true) {
+            pollfd fd = {STDIN_FILENO, POLLIN, 0};
+            if (poll(&fd, 1, 10) > 0) {
+                char buf[256];
+                ssize_t got = read(STDIN_FILENO, buf, sizeof(buf));
+                if (got > 0) typed.append(buf, size_t(got));
+                lastActivity = std::chrono::steady_clock::now();
+            }
+            if (calibrationProbes.load() != probes) {
+                probes = calibrationProbes.load();
+                typed.clear();
+                calibrationEnd.store(false);
+                printf("probe %u at %lu us per report: ", probes, calibrationInterval.load());
+                fflush(stdout);
+                lastActivity = std::chrono::steady_clock::now();
+            }
+            // Keys still in flight on the host are part of the probe
+            if (calibrationEnd.load() &&
+                std::chrono::steady_clock::now() - lastActivity > std::chrono::milliseconds(300)) {
+                calibrationEnd.store(false);
+                std::string line = typed.substr(0, typed.find('\n'));
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                uint16_t crc = crc16(reinterpret_cast<const uint8_t*>(line.data()), line.size());
+                client.sendValue(BridgeProtocol::Control::CALIBRATE_RESULT, crc);
+                printf("%s\n", crc == TypingCalibrator::probeCrc() ? "loss-free" : "keys lost");
+                fflush(stdout);
+            }
+            if (calibrationDone.load()) {
+                unsigned long result = calibrationResult.load();
+                if (result) printf("calibrated: %lu us per HID report\n", result);
+                else printf("calibration failed: keys were lost even at the slowest rate\n");
+                rc = result ? 0 : 1;
+                break;
+            }
+            if (!client.isConnected()) {
+                printf("connection lost\n");
+                break;
+            }
+        }
+
+        if (tty) tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+        client.stop();
+        return rc;
+    }
+
+    // Percentile of a histogram exported by the device, the middle of its bucket
+    uint32_t percentile(const std::map<size_t, uint32_t>& buckets, double p) {
+        uint64_t total = 0;
+        for (const auto& bucket : buckets) total += bucket.second;
+        uint64_t seen = 0;
+        for (const auto& bucket : buckets) {
+            seen += bucket.second;
+            if (seen >= p * total) {
+                uint32_t low = LatencyHistogram::bucketLow(bucket.first);
+                uint32_t high = LatencyHistogram::bucketHigh(bucket.first);
+                return high == 0xFFFFFFFFu ? low : low + (high - low) / 2;
+            }
+        }
+        return 0;
+    }
+
+    // Acts as the server for a latency trace (LatencyTracer.h): answers
+    // traced command mode reports, injects traced taps, then exports the
+    // device's histograms
+    int runTrace(KeyBridgeClient& client, int argc, char** argv) {
+        uint16_t every = 1;
+        int injectMs = 0;
+        int seconds = 10;
+        for (int i = 0; i < argc; ++i) {
+            if (!strcmp(argv[i], "--every") && i + 1 < argc) every = static_cast<uint16_t>(strtoul(argv[++i], nullptr, 0));
+            else if (!strcmp(argv[i], "--inject-ms") && i + 1 < argc) injectMs = atoi(argv[++i]);
+            else seconds = atoi(argv[i]);
+        }
+        if (every == 0 || seconds <= 0) {
+            usage();
+            return 2;
+        }
+        using Clock = std::chrono::steady_clock;
+
+        std::mutex mutex;
+        uint16_t announced = 0; // Device trace id for the next report
+        std::map<uint16_t, Clock::time_point> injected;
+        std::vector<double> injectedUs;
+        std::map<size_t, std::map<size_t, uint32_t>> histograms;
+        size_t histogram = 0, bucket = 0;
+        bool ended = false;
+        uint16_t lost = 0;
+        client.onReport([&](const KeyReport& report) {
+            auto received = Clock::now();
+            std::lock_guard<std::mutex> lock(mutex);
+            uint16_t value = 0;
+            switch (BridgeProtocol::valueCode(report, value)) {
+                case BridgeProtocol::Notify::TRACE_ID:
+                    announced = value;
+                    return;
+                case BridgeProtocol::Notify::TRACE_DONE: {
+                    auto it = injected.find(value);
+                    if (it != injected.end()) {
+                        injectedUs.push_back(std::chrono::duration<double, std::micro>(received - it->second).count());
+                        injected.erase(it);
+                    }
+                    return;
+                }
+                case BridgeProtocol::Notify::TRACE_HISTOGRAM:
+                    histogram = value;
+                    return;
+                case BridgeProtocol::Notify::TRACE_BUCKET:
+                    bucket = value;
+                    return;
+                case BridgeProtocol::Notify::TRACE_COUNT:
+                    histograms[histogram][bucket] = value;
+                    return;
+                case BridgeProtocol::Notify::TRACE_END:
+                    lost = value;
+                    ended = true;
+                    return;
+                case BridgeProtocol::Control::NONE:
+                    break;
+                default:
+                    return;
+            }
+            if (BridgeProtocol::controlCode(report) != BridgeProtocol::Control::NONE) return;
+            // A command mode report: type it back, traced ones with their id
+            if (announced) {
+                double held = std::chrono::duration<double, std::micro>(Clock::now() - received).count();
+                client.sendValue(BridgeProtocol::Control::TRACE_HOLD, static_cast<uint16_t>(std::min(held, 65535.0)));
+                client.sendValue(BridgeProtocol::Control::TRACE_ID, announced);
+                announced = 0;
+            }
+            client.sendReport(report);
+        });
+
+        client.sendControl(BridgeProtocol::Control::TRACE_RESET);
+        client.sendValue(BridgeProtocol::Control::TRACE_SAMPLE, every);
+        printf("tracing 1 in %u keyboard reports for %d s, switch to command mode to trace round trips\n", every, seconds);
+        fflush(stdout);
+
+        // Injected ids start at 0x8000, away from the ones the device hands out
+        uint16_t nextId = 0x8000;
+        KeyReport tap = {0, 0, {0x73, 0, 0, 0, 0, 0}}; // F24
+        auto until = Clock::now() + std::chrono::seconds(seconds);
+        while (Clock::now() < until && client.isConnected()) {
+            if (injectMs > 0) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    injected[nextId] = Clock::now();
+                }
+                client.sendValue(BridgeProtocol::Control::TRACE_ID, nextId++);
+                client.sendKeyTap(tap);
+                if (nextId == 0) nextId = 0x8000;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(injectMs > 0 ? injectMs : 100));
+        }
+
+        client.sendValue(BridgeProtocol::Control::TRACE_SAMPLE, 0);
+        client.sendControl(BridgeProtocol::Control::TRACE_QUERY);
+        auto deadline = Clock::now() + std::chrono::seconds(5);
+        while (Clock::now() < deadline) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (ended) break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        client.stop();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!ended) {
+            printf("no answer to the histogram query\n");
+            return 1;
+        }
+        printf("%-13s %8s %9s %9s %9s %9s\n", "us", "samples", "p50", "p90", "p99", "max");
+        for (const auto& entry : histograms) {
+            if (entry.first >= LatencyTracer::HISTOGRAM_COUNT) continue;
+            uint64_t samples = 0;
+            for (const auto& b : entry.second) samples += b.second;
+            printf("%-13s %8llu %9u %9u %9u %9u\n", LatencyTracer::NAMES[entry.first],
+                   static_cast<unsigned long long>(samples), percentile(entry.second, 0.5),
+                   percentile(entry.second, 0.9), percentile(entry.second, 0.99), percentile(entry.second, 1.0));
+        }
+        printf("traces lost: %u\n", lost);
+        if (!injectedUs.empty()) {
+            std::sort(injectedUs.begin(), injectedUs.end());
+            printf("injected, server send to TRACE_DONE: %zu samples, p50 %.0f us, p99 %.0f us\n", injectedUs.size(),
+                   injectedUs[injectedUs.size() / 2], injectedUs[injectedUs.size() * 99 / 100]);
+        }
+        return 0;
+    }
+
+    // Types a file the way TCPConnection does while dumping the charter buffer
+    // (rollover presses, everything released after every chunk) and checks the
+    // HID model reproduces the text. Classic typing is counted for comparison.
+    // Delays run on virtual clocks, so the typing time is exact and instant.
+    int runTypingVerify(int argc, char** argv) {
+        size_t chunk = 16;
+        const char* path = nullptr;
+        for (int i = 0; i < argc; ++i) {
+            if (!strcmp(argv[i], "--chunk") && i + 1 < argc) chunk = strtoul(argv[++i], nullptr, 0);
+            else path = argv[i];
+        }
+        if (!path || chunk == 0) {
+            usage();
+            return 2;
+        }
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            fprintf(stderr, "cannot read %s\n", path);
+            return 1;
+        }
+        std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        VirtualClock clock, classicClock;
+        BridgeClock::set(&clock);
+        RolloverTyper typer;
+        HidModel model;
+        auto emit = [&](const KeyReport& report) {
+            model.apply(report);
+            // HidReportQueue sends one report per host polling interval
+            BridgeClock::delayMicroseconds(HidReportQueue::DEFAULT_INTERVAL_US);
+        };
+        std::string expected;
+        size_t classicReports = 0, skipped = 0;
+        KeyReport out[RolloverTyper::MAX_REPORTS_PER_KEY];
+        for (size_t i = 0; i < text.size(); ++i) {
+            const KeyInfo* key = findKeyForChar(text[i]);
+            if (!key) {
+                skipped++;
+            } else {
+                expected += text[i];
+                classicReports += 2;
+                classicClock.delayMicroseconds(2 * HidReportQueue::DEFAULT_INTERVAL_US);
+                size_t count = typer.press(key->hexCode, key->shifted ? 0x02 : 0x00, out);
+                for (size_t r = 0; r < count; ++r) emit(out[r]);
+            }
+            if ((i + 1) % chunk == 0 || i + 1 == text.size()) {
+                if (typer.release(out) > 0) emit(out[0]);
+            }
+        }
+        BridgeClock::set(nullptr);
+
+        bool released = keySet(model.last).empty() && model.last.modifiers == 0;
+        bool match = model.typed == expected;
+        size_t chars = expected.size();
+        printf("chars: %zu  unmapped skipped: %zu\n", chars, skipped);
+        printf("classic reports: %zu  rollover reports: %zu  (%.2f per char)\n", classicReports,
+               model.reports, chars ? double(model.reports) / chars : 0.0);
+        printf("typing time: classic %.3f s  rollover %.3f s  (%.0f vs %.0f chars/s)\n",
+               classicClock.now() / 1e6, clock.now() / 1e6,
+               classicClock.now() ? chars * 1e6 / classicClock.now() : 0.0,
+               clock.now() ? chars * 1e6 / clock.now() : 0.0);
+        printf("text identical: %s  all keys released: %s  unknown keys: %zu\n", match ? "yes" : "NO",
+               released ? "yes" : "NO", model.unknown);
+        if (!match) {
+            size_t at = 0;
+            while (at < expected.size() && at < model.typed.size() && expected[at] == model.typed[at]) at++;
+            printf("first difference at char %zu: expected \"%s\" got \"%s\"\n", at,
+                   expected.substr(at, 16).c_str(), model.typed.substr(at, 16).c_str());
+        }
+        return match && released && model.unknown == 0 ? 0 : 1;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string host = DEFAULT_HOST;
+    uint16_t port = DEFAULT_PORT;
+    bool events = false;
+
+    int i = 1;
+    for (; i < argc; ++i) {
+        if (!strcmp(argv[i], "--events")) events = true;
+        else if (!strcmp(argv[i], "--host") && i + 1 < argc) host = argv[++i];
+        else if (!strcmp(argv[i], "--port") && i + 1 < argc) port = static_cast<uint16_t>(atoi(argv[++i]));
+        else break;
+    }
+    if (i >= argc) {
+        usage();
+        return 2;
+    }
+    std::string command = argv[i++];
+    if (command == "codec-stats") {
+        if (i >= argc) {
+            usage();
+            return 2;
+        }
+        return runCodecStats(argv[i]);
+    }
+    if (command == "remap-build") {
+        if (argc - i != 2) {
+            usage();
+            return 2;
+        }
+        return runRemapBuild(argv[i], argv[i + 1]);
+    }
+    if (command == "snippet-build") {
+        if (argc - i != 2) {
+            usage();
+            return 2;
+        }
+        return runSnippetBuild(argv[i], argv[i + 1]);
+    }
+    if (command == "config-build") {
+        if (argc - i != 2) {
+            usage();
+            return 2;
+        }
+        return runConfigBuild(argv[i], argv[i + 1]);
+    }
+    if (command == "typing-verify") {
+        return runTypingVerify(argc - i, argv + i);
+    }
+
+    KeyBridgeClient client;
+    client.onReport(printReport);
+    client.setAutoReconnect(command == "listen");
+    if (!client.start(host, port)) {
+        fprintf(stderr, "could not connect to %s:%u\n", host.c_str(), port);
+        return 1;
+    }
+    if (events) client.enableEventEncoding();
+
+    if (command == "report") {
+        if (argc - i != 8) {
+            usage();
+            return 2;
+        }
+        uint8_t raw[8];
+        for (int b = 0; b < 8; ++b) raw[b] = static_cast<uint8_t>(strtoul(argv[i + b], nullptr, 16));
+        KeyReport report;
+        memcpy(&report, raw, sizeof(report));
+        client.sendReport(report);
+    } else if (command == "control") {
+        if (i >= argc) {
+            usage();
+            return 2;
+        }
+        client.sendControl(static_cast<uint8_t>(strtoul(argv[i], nullptr, 0)));
+    } else if (command == "value") {
+        if (argc - i != 2) {
+            usage();
+            return 2;
+        }
+        client.sendValue(static_cast<uint8_t>(strtoul(argv[i], nullptr, 0)),
+                         static_cast<uint16_t>(strtoul(argv[i + 1], nullptr, 0)));
+    } else if (command == "type") {
+        std::string text;
+        for (; i < argc; ++i) {
+            if (!text.empty()) text += ' ';
+            text += argv[i];
+        }
+        client.sendText(text);
+    } else if (command == "type-file") {
+        bool compress = i < argc && !strcmp(argv[i], "--compress");
+        if (compress) i++;
+        if (i >= argc) {
+            usage();
+            return 2;
+        }
+        std::ifstream in(argv[i], std::ios::binary);
+        std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (!in && !in.eof()) {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 1;
+        }
+        if (compress) {
+            // Characters that can't be typed are dropped either way
+            std::vector<uint8_t> typeable;
+            for (char c : text) {
+                if (CharterCodec::isTypeable(static_cast<uint8_t>(c))) typeable.push_back(static_cast<uint8_t>(c));
+            }
+            std::vector<uint8_t> stream(typeable.size() + 1);
+            std::unique_ptr<CharterCodec::Encoder> encoder(new CharterCodec::Encoder());
+            stream.resize(encoder->compress(typeable.data(), typeable.size(), stream.data(), stream.size()));
+            fprintf(stderr, "%zu bytes compressed to %zu\n", typeable.size(), stream.size());
+            client.sendCompressedText(stream);
+        } else {
+            client.sendText(text);
+        }
+        // Streaming is paced by the device's credit, i.e. by how fast it types
+        bool flushed = client.flush(60000 + static_cast<int>(std::min<size_t>(text.size(), 1000000) * 50));
+        client.stop();
+        return flushed ? 0 : 1;
+    } else if (command == "remap-load") {
+        std::vector<uint8_t> blob;
+        if (i >= argc || !readFile(argv[i], blob)) {
+            fprintf(stderr, "cannot read %s\n", i < argc ? argv[i] : "");
+            return 1;
+        }
+        if (!blob.empty() && !KeyRemap::validate(blob.data(), blob.size())) {
+            fprintf(stderr, "%s is not a valid remap blob\n", argv[i]);
+            return 1;
+        }
+        return runBlobLoad(client, BridgeProtocol::Control::REMAP_BLOB, blob, "remap tables applied");
+    } else if (command == "snippet-load") {
+        std::vector<uint8_t> blob;
+        if (i >= argc || !readFile(argv[i], blob)) {
+            fprintf(stderr, "cannot read %s\n", i < argc ? argv[i] : "");
+            return 1;
+        }
+        SnippetLibrary::MemoryReader reader(blob.data());
+        std::unique_ptr<SnippetLibrary> library(new SnippetLibrary());
+        if (!blob.empty() && !library->load(reader, blob.size())) {
+            fprintf(stderr, "%s is not a valid snippet image\n", argv[i]);
+            return 1;
+        }
+        return runBlobLoad(client, BridgeProtocol::Control::SNIPPET_BLOB, blob, "snippets stored");
+    } else if (command == "config-load") {
+        std::vector<uint8_t> blob;
+        if (i >= argc || !readFile(argv[i], blob)) {
+            fprintf(stderr, "cannot read %s\n", i < argc ? argv[i] : "");
+            return 1;
+        }
+        BridgeConfig config;
+        bool valid = blob.size() == sizeof(config);
+        if (valid) {
+            memcpy(&config, blob.data(), sizeof(config));
+            valid = config.valid();
+        }
+        if (!blob.empty() && !valid) {
+            fprintf(stderr, "%s is not a valid config blob\n", argv[i]);
+            return 1;
+        }
+        return runBlobLoad(client, BridgeProtocol::Control::CONFIG_BLOB, blob, "config stored");
+    } else if (command == "trace") {
+        return runTrace(client, argc - i, argv + i);
+    } else if (command == "calibrate") {
+        return runCalibrate(client, argc - i, argv + i);
+    } else if (command == "listen") {
+        int seconds = i < argc ? atoi(argv[i]) : 0;
+        auto until = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+        while (seconds == 0 || std::chrono::steady_clock::now() < until) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    } else if (command == "bench") {
+        int rc = runBench(client, argc - i, argv + i);
+        client.stop();
+        return rc;
+    } else {
+        usage();
+        return 2;
+    }
+
+    bool flushed = client.flush();
+    client.stop();
+    return flushed ? 0 : 1;
+}
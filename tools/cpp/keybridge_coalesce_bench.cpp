@@ -0,0 +1,337 @@
+// Host test for the USB input path (ArduinoKeyBridge/InputCoalescer.h).
+//
+//   keybridge_bench coalesce [--trace FILE] [--reports N] [--seed S]
+//
+// Replays keyboard reports, one per millisecond, through KeyboardMerger and
+// the coalescer into a consumer that is sometimes slow, the way the pipeline
+// stalls on a network write. The reports come from a trace recorded with
+// 'keybridge_cli listen' (one report per line), or from simulated typing
+// with overlapping keys, fast taps and a keyboard that repeats its report
+// every millisecond while keys are held.
+//
+// The states the pipeline sees must be semantically the same as the merged
+// states the keyboards produced:
+//
+//   - they are a subsequence of them, in order
+//   - every key and modifier is pressed and released as often
+//   - the last state is the same
+//
+// The old single-slot handoff is replayed alongside for comparison, with
+// the presses it lost.
+//
+// Then a main keyboard and a macro pad type at once with the macro pad
+// routed to the server (DeviceRouter.h). The pipeline runs only every few
+// reports, so taps are pressed and released before it sees them. The host
+// must get every edge of the main keyboard's keys and the server every edge
+// of the pad's, both from the per-tag reports stored with each state and
+// not, as before, from the merger's state when the pipeline runs.
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "DeviceRouter.h"
+#include "InputCoalescer.h"
+#include "KeyboardMerger.h"
+#include "BenchHarness.h"
+
+namespace {
+    // Keys 0-255 plus the eight modifiers as 256-263
+    constexpr size_t KEYS = 264;
+
+    bool same(const KeyReport& a, const KeyReport& b) { return memcmp(&a, &b, sizeof(KeyReport)) == 0; }
+
+    void keySet(const KeyReport& report, std::vector<bool>& down) {
+        down.assign(KEYS, false);
+        for (uint8_t key : report.keys) {
+            if (key != 0) down[key] = true;
+        }
+        for (int bit = 0; bit < 8; ++bit) down[256 + bit] = report.modifiers & (1 << bit);
+    }
+
+    // Presses and releases per key going through states from nothing pressed
+    void edges(const std::vector<KeyReport>& states, std::vector<uint32_t>& presses, std::vector<uint32_t>& releases) {
+        presses.assign(KEYS, 0);
+        releases.assign(KEYS, 0);
+        std::vector<bool> before(KEYS, false), after;
+        for (const KeyReport& state : states) {
+            keySet(state, after);
+            for (size_t k = 0; k < KEYS; ++k) {
+                if (after[k] && !before[k]) presses[k]++;
+                if (!after[k] && before[k]) releases[k]++;
+            }
+            before = after;
+        }
+    }
+
+    std::vector<KeyReport> readTrace(const char* path) {
+        std::vector<KeyReport> reports;
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            unsigned value;
+            uint8_t raw[8];
+            int n = 0;
+            while (n < 8 && fields >> std::hex >> value) raw[n++] = static_cast<uint8_t>(value);
+            if (n != 8) continue;
+            KeyReport report;
+            memcpy(&report, raw, sizeof(report));
+            reports.push_back(report);
+        }
+        return reports;
+    }
+
+    bool sameEdges(const std::vector<KeyReport>& want, const std::vector<KeyReport>& got) {
+        std::vector<uint32_t> wantPresses, wantReleases, gotPresses, gotReleases;
+        edges(want, wantPresses, wantReleases);
+        edges(got, gotPresses, gotReleases);
+        return wantPresses == gotPresses && wantReleases == gotReleases;
+    }
+
+    // What the host and the server got from the routed states, and what the
+    // split from the merger's state at pop time would have sent the host
+    struct Routed {
+        std::vector<KeyReport> host, server, live;
+        InputCoalescer::Entry previous = {};
+        KeyReport lastLive = {0, 0, {0, 0, 0, 0, 0, 0}};
+
+        void drain(InputCoalescer& input, const KeyboardMerger& merger) {
+            InputCoalescer::Entry entry;
+            while (input.pop(entry)) {
+                DeviceRouter::Split split = DeviceRouter::route(previous, entry, BridgeConfig::ROUTE_SERVER);
+                if (split.toHost) host.push_back(split.host);
+                if (split.toServer) server.push_back(split.server);
+                previous = entry;
+                KeyReport now = merger.report(KeyboardMerger::tagMask(KeyboardMerger::KEYBOARD));
+                if (!same(now, lastLive)) live.push_back(now);
+                lastLive = now;
+            }
+        }
+    };
+
+    void toggle(KeyReport& held, uint8_t key) {
+        for (uint8_t& k : held.keys) {
+            if (k == key) {
+                k = 0;
+                return;
+            }
+        }
+        for (uint8_t& k : held.keys) {
+            if (k == 0) {
+                k = key;
+                return;
+            }
+        }
+    }
+
+    void press(KeyboardMerger& merger, InputCoalescer& input, KeyReport* held, uint8_t device, uint8_t key) {
+        toggle(held[device], key);
+        uint8_t boot[8];
+        memcpy(boot, &held[device], sizeof(boot));
+        merger.update(device, boot, sizeof(boot));
+        input.push(merger, 0, device);
+    }
+
+    bool checkRouting(size_t count, std::mt19937& rng) {
+        const uint8_t A = 0x04, B = 0x05, PAD = 0x59;
+        bool ok = true;
+
+        // A tap on the main keyboard, pressed and released before the pipeline runs
+        {
+            KeyboardMerger merger;
+            merger.setTag(1, KeyboardMerger::MACRO_PAD);
+            InputCoalescer input;
+            KeyReport held[2] = {};
+            Routed routed;
+            press(merger, input, held, 0, A);
+            press(merger, input, held, 0, A);
+            routed.drain(input, merger);
+            bool tap = routed.host.size() == 2 && routed.host[0].keys[0] == A && routed.host[1].keys[0] == 0;
+            printf("routing: queued main keyboard tap reaches the host: %s (split at pop time: %zu of 2 states)\n",
+                   tap ? "yes" : "NO", routed.live.size());
+            ok &= tap && routed.server.empty();
+        }
+
+        // A macro pad tap while the main keyboard holds a key
+        {
+            KeyboardMerger merger;
+            merger.setTag(1, KeyboardMerger::MACRO_PAD);
+            InputCoalescer input;
+            KeyReport held[2] = {};
+            Routed routed;
+            press(merger, input, held, 0, B);
+            routed.drain(input, merger);
+            press(merger, input, held, 1, PAD);
+            press(merger, input, held, 1, PAD);
+            routed.drain(input, merger);
+            bool tap = routed.server.size() == 2 && routed.server[0].keys[0] == PAD && routed.server[1].keys[0] == 0;
+            bool hostQuiet = routed.host.size() == 1 && routed.host[0].keys[0] == B;
+            printf("routing: queued macro pad tap reaches the server: %s, host only sees the main keyboard: %s\n",
+                   tap ? "yes" : "NO", hostQuiet ? "yes" : "NO");
+            ok &= tap && hostQuiet;
+        }
+
+        // Both keyboards at random, the pipeline up to eight states behind
+        KeyboardMerger merger;
+        merger.setTag(1, KeyboardMerger::MACRO_PAD);
+        InputCoalescer input;
+        KeyReport held[2] = {};
+        Routed routed;
+        std::vector<KeyReport> wantHost, wantServer;
+        KeyReport lastHost = {0, 0, {0, 0, 0, 0, 0, 0}}, lastServer = lastHost;
+        size_t behind = 0, pending = rng() % 9;
+        for (size_t i = 0; i < count; ++i) {
+            uint8_t device = uint8_t(rng() % 2);
+            press(merger, input, held, device, uint8_t((device ? PAD : A) + rng() % 8));
+            KeyReport host = merger.report(KeyboardMerger::tagMask(KeyboardMerger::KEYBOARD));
+            KeyReport server = merger.report(KeyboardMerger::tagMask(KeyboardMerger::MACRO_PAD));
+            if (!same(host, lastHost)) wantHost.push_back(host);
+            if (!same(server, lastServer)) wantServer.push_back(server);
+            lastHost = host;
+            lastServer = server;
+            if (++behind >= pending) {
+                routed.drain(input, merger);
+                behind = 0;
+                pending = rng() % 9;
+            }
+        }
+        routed.drain(input, merger);
+        bool hostEdges = sameEdges(wantHost, routed.host);
+        bool serverEdges = sameEdges(wantServer, routed.server);
+        printf("routing: %zu random changes, every main keyboard edge at the host: %s, every pad edge at the server: %s "
+               "(split at pop time: %s)\n", count, hostEdges ? "yes" : "NO", serverEdges ? "yes" : "NO",
+               sameEdges(wantHost, routed.live) ? "same" : "edges lost");
+        ok &= hostEdges && serverEdges && input.stats().overflows == 0;
+        return ok;
+    }
+
+    // Typing at a few keys per second with overlap, now and then a burst of
+    // 2-4 ms taps, and a keyboard that sends its state every millisecond
+    std::vector<KeyReport> simulate(size_t count, std::mt19937& rng) {
+        struct Held {
+            uint8_t key;
+            uint32_t until;
+        };
+        std::vector<KeyReport> reports;
+        std::vector<Held> held;
+        uint8_t modifiers = 0;
+        uint32_t shiftUntil = 0, nextPress = 0;
+        for (uint32_t ms = 0; reports.size() < count; ++ms) {
+            for (size_t i = 0; i < held.size();) {
+                if (held[i].until <= ms) held.erase(held.begin() + i);
+                else ++i;
+            }
+            if (ms >= shiftUntil) modifiers = 0;
+            if (ms >= nextPress && held.size() < 6) {
+                bool tap = rng() % 8 == 0;
+                uint8_t key = uint8_t(0x04 + rng() % 40);
+                bool isHeld = false;
+                for (const Held& h : held) isHeld |= h.key == key;
+                if (!isHeld) held.push_back({key, uint32_t(ms + (tap ? 2 + rng() % 3 : 40 + rng() % 80))});
+                if (rng() % 10 == 0) {
+                    modifiers = 0x02;
+                    shiftUntil = ms + 60 + rng() % 100;
+                }
+                nextPress = uint32_t(ms + (tap ? 1 + rng() % 4 : 30 + rng() % 170));
+            }
+            KeyReport report = {modifiers, 0, {0, 0, 0, 0, 0, 0}};
+            for (size_t i = 0; i < held.size(); ++i) report.keys[i] = held[i].key;
+            reports.push_back(report);
+        }
+        return reports;
+    }
+}
+
+KEYBRIDGE_BENCH(coalesce, "[--trace FILE] [--reports N] [--seed S]") {
+    const char* trace = args.text("--trace");
+    size_t count = args.number("--reports", size_t(200000));
+    unsigned seed = args.number("--seed", 1u);
+    if (!args.done()) return 2;
+
+    std::mt19937 rng(seed);
+    std::vector<KeyReport> reports = trace ? readTrace(trace) : simulate(count, rng);
+    if (reports.empty()) {
+        fprintf(stderr, "no reports in %s\n", trace);
+        return 1;
+    }
+
+    KeyboardMerger merger;
+    InputCoalescer input;
+    std::vector<KeyReport> merged, delivered, singleSlot;
+    KeyReport slot;
+    bool slotFull = false;
+    // The consumer is busy until then: usually a fraction of a millisecond per
+    // report, and every 20th report a stall of up to 60 ms
+    unsigned long busyUntil = 0, slotBusyUntil = 0;
+    auto serviceUs = [&]() -> unsigned long {
+        return rng() % 20 == 0 ? 1000 + rng() % 60000 : 50 + rng() % 400;
+    };
+
+    for (size_t i = 0; i < reports.size(); ++i) {
+        unsigned long now = i * 1000;
+        uint8_t boot[8];
+        memcpy(boot, &reports[i], sizeof(boot));
+        if (merger.update(0, boot, sizeof(boot))) {
+            merged.push_back(merger.report());
+            input.push(merger.report(), now);
+            slot = merger.report();
+            slotFull = true;
+        }
+        // usbTask drains everything it can; the consumer may still be busy
+        // with the last report
+        InputCoalescer::Entry entry;
+        while (busyUntil <= now && input.pop(entry)) {
+            delivered.push_back(entry.report);
+            busyUntil = now + serviceUs();
+        }
+        if (slotFull && slotBusyUntil <= now) {
+            singleSlot.push_back(slot);
+            slotFull = false;
+            slotBusyUntil = now + serviceUs();
+        }
+    }
+    // Nothing comes in any more, so the consumer catches up
+    InputCoalescer::Entry entry;
+    while (input.pop(entry)) delivered.push_back(entry.report);
+    if (slotFull) singleSlot.push_back(slot);
+
+    bool ok = true;
+    // Subsequence, in order
+    size_t matched = 0;
+    for (size_t j = 0; j < merged.size() && matched < delivered.size(); ++j) {
+        if (same(merged[j], delivered[matched])) matched++;
+    }
+    bool ordered = matched == delivered.size();
+    bool sameEnd = merged.empty() ? delivered.empty() : !delivered.empty() && same(delivered.back(), merged.back());
+
+    std::vector<uint32_t> wantPresses, wantReleases, gotPresses, gotReleases, slotPresses, slotReleases;
+    edges(merged, wantPresses, wantReleases);
+    edges(delivered, gotPresses, gotReleases);
+    edges(singleSlot, slotPresses, slotReleases);
+    uint32_t presses = 0, lostPresses = 0, wrongEdges = 0, slotLost = 0;
+    for (size_t k = 0; k < KEYS; ++k) {
+        presses += wantPresses[k];
+        wrongEdges += gotPresses[k] != wantPresses[k] || gotReleases[k] != wantReleases[k];
+        if (gotPresses[k] < wantPresses[k]) lostPresses += wantPresses[k] - gotPresses[k];
+        if (slotPresses[k] < wantPresses[k]) slotLost += wantPresses[k] - slotPresses[k];
+    }
+
+    const InputCoalescer::Stats& stats = input.stats();
+    printf("reports: %zu  merged states: %zu  repeats dropped: %zu  key presses: %u\n", reports.size(),
+           merged.size(), reports.size() - merged.size(), presses);
+    printf("coalescer: %zu states delivered, %u coalesced, %u duplicates, %u overflows, high water %zu/%zu\n",
+           delivered.size(), stats.coalesced, stats.duplicates, stats.overflows, stats.highWater,
+           InputCoalescer::CAPACITY);
+    printf("  in order: %s  same last state: %s  keys with other edges: %u  presses lost: %u\n",
+           ordered ? "yes" : "NO", sameEnd ? "yes" : "NO", wrongEdges, lostPresses);
+    printf("single slot: %zu states delivered, presses lost: %u\n", singleSlot.size(), slotLost);
+    // Edges can only be lost when the queue overflowed
+    ok &= ordered && sameEnd && (wrongEdges == 0 || stats.overflows > 0);
+    ok &= checkRouting(20000, rng);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+// Host test for the config in data flash (ArduinoKeyBridge/BridgeConfig.h).
+//
+//   keybridge_bench config [--writes N] [--seed S]
+//
+// Replays ConfigStore's two-slot scheme on a model of the flash region:
+// each write goes to the slot not in use with the next sequence number, and
+// boot takes BridgeConfig::newest() of the two. Checks that:
+//
+//   - erased flash gives no config, so the firmware runs on the defaults
+//   - after every write boot finds the config just written, also when the
+//     sequence number wraps around
+//   - a write cut short at any byte leaves the previous config in charge
+//   - a corrupted active slot falls back to the other one
+//
+// Then times what boot spends checking the slots.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "BridgeConfig.h"
+#include "FlashLayout.h"
+#include "BenchHarness.h"
+
+namespace {
+    // The two slots as the EEPROM library sees them
+    struct Flash {
+        uint8_t bytes[FlashLayout::CONFIG_SLOTS][sizeof(BridgeConfig)];
+
+        Flash() { memset(bytes, 0xFF, sizeof(bytes)); }
+
+        // Copy at boot; nullptr means the defaults
+        const BridgeConfig* load(BridgeConfig slots[2]) const {
+            memcpy(&slots[0], bytes[0], sizeof(BridgeConfig));
+            memcpy(&slots[1], bytes[1], sizeof(BridgeConfig));
+            return BridgeConfig::newest(slots[0], slots[1]);
+        }
+    };
+
+    // ConfigStore::save(), stopped after the first cut bytes
+    int save(Flash& flash, int slot, const BridgeConfig& active, BridgeConfig config, size_t cut = sizeof(BridgeConfig)) {
+        int target = slot == 0 ? 1 : 0;
+        config.sequence = active.sequence + 1;
+        config.seal();
+        memcpy(flash.bytes[target], &config, cut);
+        return target;
+    }
+
+    BridgeConfig randomConfig(std::mt19937& rng) {
+        BridgeConfig config = BridgeConfig::defaults();
+        config.port = uint16_t(1024 + rng() % 60000);
+        snprintf(config.apSsid, sizeof(config.apSsid), "bridge-%u", unsigned(rng() % 1000));
+        config.logLevel = uint8_t(1 + rng() % 4);
+        config.ledCount = uint16_t(1 + rng() % 24);
+        config.hidIntervalUs = uint16_t(125 + rng() % 8000);
+        config.charterChunk = uint8_t(1 + rng() % BridgeConfig::MAX_CHARTER_CHUNK);
+        return config;
+    }
+
+    bool same(const BridgeConfig* a, const BridgeConfig& b) {
+        return a && memcmp(a, &b, sizeof(BridgeConfig)) == 0;
+    }
+}
+
+KEYBRIDGE_BENCH(config, "[--writes N] [--seed S]") {
+    size_t writes = args.number("--writes", size_t(1000));
+    unsigned seed = args.number("--seed", 1u);
+    if (!args.done()) return 2;
+
+    bool ok = true;
+    std::mt19937 rng(seed);
+    Flash flash;
+    BridgeConfig slots[2];
+    bool erased = flash.load(slots) == nullptr;
+    printf("erased flash: %s\n", erased ? "defaults" : "WRONG, took a config");
+    ok &= erased;
+
+    // Start just below the wrap of the sequence number
+    BridgeConfig active = BridgeConfig::defaults();
+    active.sequence = 0xFFFFFFFFu - uint32_t(writes / 2);
+    int slot = -1;
+    size_t found = 0, kept = 0, cuts = 0, fallbacks = 0;
+    for (size_t w = 0; w < writes; ++w) {
+        BridgeConfig next = randomConfig(rng);
+
+        // Reset halfway through the write, at a random byte. If the bytes
+        // left to write were already there, the write did complete.
+        size_t cut = rng() % sizeof(BridgeConfig);
+        Flash torn = flash, whole = flash;
+        int target = save(torn, slot, active, next, cut);
+        save(whole, slot, active, next);
+        const BridgeConfig* loaded = torn.load(slots);
+        cuts++;
+        if (!memcmp(torn.bytes[target], whole.bytes[target], sizeof(BridgeConfig))) kept++;
+        else if (slot < 0 ? loaded == nullptr : same(loaded, active)) kept++;
+
+        slot = save(flash, slot, active, next);
+        loaded = flash.load(slots);
+        if (loaded && loaded->sequence == active.sequence + 1 && loaded->port == next.port &&
+            !strcmp(loaded->apSsid, next.apSsid)) {
+            found++;
+            active = *loaded;
+        }
+
+        // A bit flip in the active slot hands over to the other one
+        if (w > 0) {
+            Flash flipped = flash;
+            flipped.bytes[slot][rng() % sizeof(BridgeConfig)] ^= uint8_t(1u << (rng() % 8));
+            loaded = flipped.load(slots);
+            if (loaded && loaded->sequence == active.sequence - 1) fallbacks++;
+        }
+    }
+    printf("writes found at boot: %zu/%zu (sequence now %u)\n", found, writes, active.sequence);
+    printf("writes cut short that kept the previous config (or completed): %zu/%zu\n", kept, cuts);
+    printf("corrupted active slot, fell back to the other: %zu/%zu\n", fallbacks, writes - 1);
+    ok &= found == writes && kept == cuts && fallbacks == writes - 1;
+
+    // Every byte of the last write, in turn
+    size_t keptEveryByte = 0;
+    BridgeConfig next = randomConfig(rng);
+    Flash whole = flash;
+    int target = save(whole, slot, active, next);
+    for (size_t cut = 0; cut < sizeof(BridgeConfig); ++cut) {
+        Flash torn = flash;
+        save(torn, slot, active, next, cut);
+        bool complete = !memcmp(torn.bytes[target], whole.bytes[target], sizeof(BridgeConfig));
+        if (complete || same(torn.load(slots), active)) keptEveryByte++;
+    }
+    printf("cut at each of the %zu bytes, kept the previous config: %zu\n", sizeof(BridgeConfig), keptEveryByte);
+    ok &= keptEveryByte == sizeof(BridgeConfig);
+
+    // What boot spends: two slot checks. Fields are read in place afterwards.
+    const size_t runs = 200000;
+    volatile uint32_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < runs; ++i) {
+        const BridgeConfig* loaded = flash.load(slots);
+        sink = sink + (loaded ? loaded->sequence : 0);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / runs;
+    printf("boot check of both slots: %.0f ns on the host, %zu bytes per slot\n", ns, sizeof(BridgeConfig));
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,274 @@
+// Host test for charter text flow control (ArduinoKeyBridge/CharterCredit.h).
+//
+//   keybridge_bench credit [--text FILE] [--bytes N] [--streams N] [--seed S]
+//
+// Streams a text (1 MB by default, the file repeated or simulated prose)
+// through a model of TCPConnection's charter path: CharterBuffer, the
+// CharterCredit grants, a WiFi module that holds what the device hasn't read
+// yet, and a network with 2-20 ms latency and now and then a 200 ms stall in
+// each direction. The device polls every millisecond, reads only as much as
+// the buffer has room for, and types at most 16 characters per poll at
+// about two characters per millisecond, like serviceCharterDump().
+//
+// The sender is KeyBridgeClient's credit logic: it sends exactly what it was
+// granted. Checks that:
+//
+//   - no byte arrives without outstanding credit
+//   - no byte ever waits in the WiFi module for buffer room
+//   - the buffer's high water stays within CharterBuffer::CAPACITY
+//   - the host types the whole text, in order
+//
+// The same stream from a sender that ignores credit is replayed for
+// comparison, with how much piles up in the WiFi module.
+//
+// Then the text goes out as --streams back-to-back transfers (64 by default).
+// A CREDIT granted for one transfer can still be on its way when the next
+// one starts. The sender ignores credit from the start of a transfer until
+// that transfer's CREDIT_START, so no byte may arrive without credit of its
+// own transfer. The old sender, which only zeroed its credit when a transfer
+// started, is replayed for comparison.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CharterBuffer.h"
+#include "CharterCredit.h"
+#include "BenchHarness.h"
+
+namespace {
+    constexpr size_t CHUNK = 16;           // BridgeConfig::MAX_CHARTER_CHUNK
+    constexpr double TYPE_PER_MS = 2.0;    // Rollover typing with 1 ms host polling
+    constexpr char TERMINATOR = '\0';      // BridgeProtocol::TEXT_TERMINATOR
+
+    // Wire symbol for the control report that starts a transfer
+    constexpr int START = -1;
+
+    enum Sender {
+        MARKED,          // KeyBridgeClient: credit counts from CREDIT_START
+        RESET_AT_START,  // Zeroes its credit when a transfer starts, takes any CREDIT
+        GREEDY           // Ignores credit
+    };
+
+    struct Packet {
+        unsigned long at;  // Arrival time in ms
+        size_t count;      // Wire symbols, or credit for CREDIT reports
+        bool start;        // CREDIT_START
+    };
+
+    struct Result {
+        std::string typed;
+        unsigned long ms = 0;
+        size_t highWater = 0;
+        size_t credits = 0;        // CREDIT reports
+        size_t late = 0;           // CREDIT reports that arrived after the next transfer started
+        size_t granted = 0;
+        size_t uncredited = 0;     // Bytes that arrived with no credit outstanding
+        size_t waited = 0;         // Polls that left bytes in the WiFi module
+        size_t moduleHighWater = 0;
+    };
+
+    std::string simulate(size_t bytes, std::mt19937& rng) {
+        static const char* words[] = {"the", "bridge", "types", "charter", "text", "at", "the", "speed",
+                                      "of", "the", "host", "credit", "flows", "back", "in", "batches"};
+        std::string text;
+        while (text.size() < bytes) {
+            text += words[rng() % 16];
+            text += rng() % 12 == 0 ? ".\n" : " ";
+        }
+        text.resize(bytes);
+        return text;
+    }
+
+    // One direction of the TCP connection: in order, with jitter and stalls
+    class Link {
+    public:
+        explicit Link(std::mt19937& rng) : rng_(rng) {}
+
+        void send(unsigned long now, size_t count, bool start = false) {
+            unsigned long latency = 2 + rng_() % 19;
+            if (rng_() % 50 == 0) latency += 200;
+            last_ = std::max(last_, now + latency);
+            packets_.push_back({last_, count, start});
+        }
+
+        // Packets that arrived by now
+        std::vector<Packet> receive(unsigned long now) {
+            std::vector<Packet> arrived;
+            while (!packets_.empty() && packets_.front().at <= now) {
+                arrived.push_back(packets_.front());
+                packets_.pop_front();
+            }
+            return arrived;
+        }
+
+    private:
+        std::mt19937& rng_;
+        std::deque<Packet> packets_;
+        unsigned long last_ = 0;
+    };
+
+    Result stream(const std::vector<std::string>& texts, Sender sender, unsigned seed) {
+        std::mt19937 rng(seed);
+        Link toDevice(rng), toHost(rng);
+        CharterBuffer buffer;
+        CharterCredit credit;
+        Result result;
+        std::vector<int> wire;
+        std::vector<size_t> ends; // Where each transfer's text and terminator end
+        for (const std::string& text : texts) {
+            wire.push_back(START);
+            for (char c : text) wire.push_back((unsigned char)c);
+            wire.push_back(TERMINATOR);
+            ends.push_back(wire.size());
+        }
+        size_t sent = 0, received = 0, senderCredit = 0, finished = 0;
+        bool awaitingStart = false;
+        std::deque<int> module; // Received by the WiFi module, not read yet
+        bool receiving = false;
+        double typeBudget = 0;
+
+        // grantCharterCredit()
+        auto grant = [&](unsigned long now, bool start) {
+            if (!receiving) return;
+            size_t count = credit.grant(buffer.freeSpace(), buffer.isEmpty(), start);
+            if (count == 0) return;
+            result.credits++;
+            result.granted += count;
+            toHost.send(now, count, start);
+        };
+
+        for (unsigned long now = 0;; ++now) {
+            // Sender, KeyBridgeClient::addCredit() and pumpLocked()
+            for (const Packet& packet : toHost.receive(now)) {
+                if (packet.start) {
+                    if (sender == MARKED) senderCredit = 0;
+                    awaitingStart = false;
+                } else if (awaitingStart) {
+                    result.late++;
+                    if (sender == MARKED) continue;
+                }
+                senderCredit += packet.count;
+            }
+            while (sent < wire.size()) {
+                if (wire[sent] == START) {
+                    // The start goes out as soon as the transfer before is sent
+                    senderCredit = 0;
+                    awaitingStart = true;
+                    toDevice.send(now, 1);
+                    sent++;
+                    continue;
+                }
+                size_t end = *std::upper_bound(ends.begin(), ends.end(), sent);
+                size_t count = sender == GREEDY ? end - sent : std::min(senderCredit, end - sent);
+                if (count == 0) break;
+                toDevice.send(now, count);
+                sent += count;
+                senderCredit -= std::min(senderCredit, count);
+                if (sent < end) break;
+            }
+
+            // WiFi module
+            for (const Packet& packet : toDevice.receive(now)) {
+                for (size_t i = 0; i < packet.count; ++i) module.push_back(wire[received++]);
+            }
+            result.moduleHighWater = std::max(result.moduleHighWater, module.size());
+
+            // pollFrames() and startCharterStream(), then pollCharterText()
+            while (!module.empty()) {
+                int c = module.front();
+                if (!receiving) {
+                    module.pop_front();
+                    buffer.clear();
+                    credit.reset();
+                    receiving = true;
+                    grant(now, true);
+                    continue;
+                }
+                if (buffer.freeSpace() == 0) break;
+                module.pop_front();
+                if (credit.outstanding() == 0) result.uncredited++;
+                credit.consumed();
+                if (c == TERMINATOR) {
+                    receiving = false;
+                    finished++;
+                    continue;
+                }
+                buffer.push(char(c));
+            }
+            if (!module.empty()) result.waited++;
+
+            // serviceCharterDump(), one typeNextCharFromBuffer() per character
+            typeBudget = std::min(typeBudget + TYPE_PER_MS, double(CHUNK));
+            while (typeBudget >= 1 && !buffer.isEmpty()) {
+                result.typed += char(buffer.pop());
+                typeBudget -= 1;
+                grant(now, false);
+            }
+
+            if (finished == texts.size() && buffer.isEmpty()) {
+                result.ms = now;
+                break;
+            }
+            // A stuck stream would never finish
+            if (now > 100000000) break;
+        }
+        result.highWater = buffer.highWater();
+        return result;
+    }
+}
+
+KEYBRIDGE_BENCH(credit, "[--text FILE] [--bytes N] [--streams N] [--seed S]") {
+    const char* path = args.text("--text");
+    size_t bytes = args.number("--bytes", size_t(1) << 20);
+    size_t streams = args.number("--streams", size_t(64));
+    unsigned seed = args.number("--seed", 1u);
+    if (!args.done()) return 2;
+
+    std::mt19937 rng(seed);
+    std::string text;
+    if (path) {
+        std::string file;
+        if (!Bench::readFile(path, file)) return 1;
+        file.erase(std::remove(file.begin(), file.end(), TERMINATOR), file.end());
+        if (file.empty()) {
+            fprintf(stderr, "no text in %s\n", path);
+            return 1;
+        }
+        while (text.size() < bytes) text += file;
+        text.resize(bytes);
+    } else {
+        text = simulate(bytes, rng);
+    }
+
+    Result credited = stream({text}, MARKED, seed);
+    bool typed = credited.typed == text;
+    printf("credit: %zu bytes typed in %.1f s (%s), %zu CREDIT reports, %.0f bytes per grant\n", credited.typed.size(),
+           credited.ms / 1000.0, typed ? "in order" : "WRONG", credited.credits,
+           credited.credits ? double(credited.granted) / credited.credits : 0.0);
+    printf("credit: buffer peak %zu/%zu, WiFi module peak %zu, bytes without credit %zu, polls with bytes waiting %zu\n",
+           credited.highWater, CharterBuffer::CAPACITY, credited.moduleHighWater, credited.uncredited, credited.waited);
+
+    Result greedy = stream({text}, GREEDY, seed);
+    printf("no credit: buffer peak %zu/%zu, WiFi module peak %zu, polls with bytes waiting %zu\n", greedy.highWater,
+           CharterBuffer::CAPACITY, greedy.moduleHighWater, greedy.waited);
+
+    bool ok = typed && credited.highWater <= CharterBuffer::CAPACITY && credited.uncredited == 0 && credited.waited == 0;
+
+    // Back to back; each start clears what the last transfer left untyped
+    std::vector<std::string> parts;
+    size_t part = (text.size() + std::max<size_t>(streams, 1) - 1) / std::max<size_t>(streams, 1);
+    for (size_t at = 0; at < text.size(); at += part) parts.push_back(text.substr(at, part));
+    Result marked = stream(parts, MARKED, seed);
+    Result reset = stream(parts, RESET_AT_START, seed);
+    printf("%zu transfers: %zu late CREDIT reports ignored, buffer peak %zu/%zu, bytes without credit %zu, polls with bytes waiting %zu\n",
+           parts.size(), marked.late, marked.highWater, CharterBuffer::CAPACITY, marked.uncredited, marked.waited);
+    printf("%zu transfers, late CREDIT counted for the next transfer: bytes without credit %zu, polls with bytes waiting %zu\n",
+           parts.size(), reset.uncredited, reset.waited);
+    ok &= marked.highWater <= CharterBuffer::CAPACITY && marked.uncredited == 0 && marked.waited == 0;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+// Host test and overhead benchmark for the flight recorder
+// (ArduinoKeyBridge/FlightRecorder.h).
+//
+//   keybridge_bench flight_recorder [--events N]
+//
+// Checks that:
+//
+//   - a record survives a "reset" (start() again without clearing RAM) with
+//     its events in order, followed by the new BOOT event
+//   - the task running when the record ended is kept
+//   - a run that hung in a task, stalled or halted ended badly, a clean one
+//     did not
+//   - random RAM, as after power-on, is not taken for a record
+//
+// Then times record() and the per-task bookkeeping TaskScheduler does, and
+// prints what that costs per second at the firmware's task rates.
+
+#include <cstdio>
+#include <random>
+
+#include "FlightRecorder.h"
+#include "BenchHarness.h"
+
+namespace {
+    FlightRecorder::Image& ram() { return const_cast<FlightRecorder::Image&>(FlightRecorder::image()); }
+}
+
+KEYBRIDGE_BENCH(flight_recorder, "[--events N]") {
+    size_t events = args.number("--events", size_t(10000000));
+    if (!args.done()) return 2;
+
+    bool ok = true;
+    VirtualClock clock;
+    BridgeClock::set(&clock);
+
+    // Power-on RAM is garbage
+    std::mt19937 rng(1);
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(&ram());
+    for (size_t i = 0; i < sizeof(FlightRecorder::Image); ++i) bytes[i] = uint8_t(rng());
+    bool garbage = FlightRecorder::recover();
+    FlightRecorder::start();
+    printf("power-on RAM taken for a record: %s, boots after start: %u\n", garbage ? "YES" : "no", FlightRecorder::image().boots);
+    ok &= !garbage && FlightRecorder::image().boots == 1 && FlightRecorder::size() == 1;
+
+    // A run that hangs in task 1 after 300 events
+    for (uint16_t i = 0; i < 300; ++i) {
+        clock.advance(100);
+        if (i % 10 == 0) FlightRecorder::taskStarted(uint8_t(i / 10 % 4), clock.micros());
+        else FlightRecorder::record(FlightRecorder::KEY_REPORT, 0, i);
+        if (i % 10 == 5) FlightRecorder::taskEnded();
+    }
+    FlightRecorder::taskStarted(1, clock.micros());
+    FlightRecorder::record(FlightRecorder::NET_WRITE, 0, 8);
+
+    // Reset: RAM stays, start() runs again
+    bool recovered = FlightRecorder::recover();
+    const FlightRecorder::Image& image = FlightRecorder::image();
+    bool inOrder = FlightRecorder::size() == FlightRecorder::CAPACITY;
+    for (size_t i = 1; i < FlightRecorder::size(); ++i) {
+        inOrder &= FlightRecorder::entry(i).timeUs >= FlightRecorder::entry(i - 1).timeUs;
+    }
+    const FlightRecorder::Entry& last = FlightRecorder::entry(FlightRecorder::size() - 1);
+    bool hang = image.inTask && image.task == 1 && last.event == FlightRecorder::NET_WRITE;
+    printf("after reset: record found %s, %zu events in order %s, ended in task %u with a %s\n",
+           recovered ? "yes" : "NO", FlightRecorder::size(), inOrder ? "yes" : "NO", image.task,
+           FlightRecorder::name(last.event));
+    bool badly = FlightRecorder::endedBadly();
+    ok &= recovered && inOrder && hang && badly;
+    FlightRecorder::start();
+    const FlightRecorder::Entry& boot = FlightRecorder::entry(FlightRecorder::size() - 1);
+    printf("next boot: boot %u, last event %s, task cleared %s\n", image.boots, FlightRecorder::name(boot.event),
+           image.inTask ? "NO" : "yes");
+    ok &= image.boots == 2 && boot.event == FlightRecorder::BOOT && !image.inTask;
+
+    // A clean run, a run with a stall and one that halted, each followed by a reset
+    auto run = [&](int trouble) {
+        for (uint8_t task = 0; task < 4; ++task) {
+            clock.advance(1000);
+            FlightRecorder::taskStarted(task, clock.micros());
+            FlightRecorder::taskEnded();
+            if (trouble == 1 && task == 2) FlightRecorder::stalled(task, 80000);
+        }
+        if (trouble == 2) FlightRecorder::halted(3);
+        bool ended = FlightRecorder::endedBadly();
+        FlightRecorder::start();
+        return ended;
+    };
+    bool clean = run(0), stall = run(1), halt = run(2), cleanAgain = run(0);
+    printf("ended badly: hang %s, clean %s, stall %s, halt %s, clean after a halt %s\n", badly ? "yes" : "NO",
+           clean ? "YES" : "no", stall ? "yes" : "NO", halt ? "yes" : "NO", cleanAgain ? "YES" : "no");
+    ok &= !clean && stall && halt && !cleanAgain;
+
+    // Overhead; the virtual clock stands in for micros()
+    double empty = Bench::nsPer(events, [&]() {
+        for (size_t i = 0; i < events; ++i) {
+            clock.advance(1);
+            asm volatile("" ::: "memory");
+        }
+    });
+    double record = Bench::nsPer(events, [&]() {
+        for (size_t i = 0; i < events; ++i) {
+            clock.advance(1);
+            FlightRecorder::record(FlightRecorder::KEY_REPORT, uint8_t(i), uint16_t(i));
+        }
+    }) - empty;
+    double task = Bench::nsPer(events, [&]() {
+        for (size_t i = 0; i < events; ++i) {
+            clock.advance(1);
+            FlightRecorder::taskStarted(uint8_t(i & 3), clock.micros());
+            FlightRecorder::taskEnded();
+        }
+    }) - empty;
+    // usb every 1 ms and network every 2 ms, plus a few key reports and modem reads/writes
+    double perSecond = 1500 * task + 100 * record;
+    printf("record %.1f ns, task bookkeeping %.1f ns: %.0f us per second at the firmware's task rates (%.4f%%)\n",
+           record, task, perSecond / 1000, perSecond / 1e7);
+    printf("retained RAM: %zu bytes\n", sizeof(FlightRecorder::Image));
+
+    BridgeClock::set(nullptr);
+    return ok ? 0 : 1;
+}
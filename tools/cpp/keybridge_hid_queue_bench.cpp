@@ -0,0 +1,235 @@
+// Host test for the paced HID output queue (ArduinoKeyBridge/HidReportQueue.h).
+//
+//   keybridge_bench hid_queue [--text FILE] [--seed S]
+//
+// Types a text with RolloverTyper the way TCPConnection dumps the charter
+// buffer (16 characters per chunk, everything released after each chunk)
+// into a model of the keyboard endpoint. The endpoint holds one report; the
+// host takes it when it polls, and a send while it is still full fails the
+// way the USB stack refuses it. The device pumps from a jittery 1 ms USB task.
+//
+// For each host polling interval it compares:
+//
+//   - direct sends with a fixed delay after each report (the old typing
+//     path, which ignored failed sends)
+//   - the queue, pumped once per USB task and after every push
+//
+// and checks that with the queue the host sees every distinct state exactly
+// once, in order, with no overruns. Prints reports per second, lost states
+// and queue metrics.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "HidReportQueue.h"
+#include "MagicKeyboardKeyMap.h"
+#include "RolloverTyper.h"
+#include "BenchHarness.h"
+
+namespace {
+    constexpr size_t CHUNK = 16;
+    constexpr size_t CHUNK_REPORTS = CHUNK * RolloverTyper::MAX_REPORTS_PER_KEY + 1;
+    constexpr unsigned long USB_PERIOD_US = 1000;
+    constexpr unsigned long USB_JITTER_US = 400; // Scheduler latency of the USB task
+
+    const char* SAMPLE_TEXT =
+        "The quick brown fox jumps over the lazy dog. PACK MY BOX WITH FIVE DOZEN LIQUOR JUGS!\n"
+        "int main(int argc, char** argv) { return argc > 1 ? atoi(argv[1]) : 0; }\n"
+        "Mississippi, bookkeeper, aaa bbb ccc: repeated keys need a release in between.\n";
+
+    bool sameReport(const KeyReport& a, const KeyReport& b) {
+        return memcmp(&a, &b, sizeof(KeyReport)) == 0;
+    }
+
+    // Typed reports in chunks, as serviceCharterDump() produces them
+    std::vector<std::vector<KeyReport>> typeChunks(const std::string& text) {
+        std::vector<std::vector<KeyReport>> chunks;
+        RolloverTyper typer;
+        KeyReport out[RolloverTyper::MAX_REPORTS_PER_KEY];
+        std::vector<KeyReport> chunk;
+        for (size_t i = 0; i < text.size(); ++i) {
+            const KeyInfo* key = findKeyForChar(text[i]);
+            if (key) {
+                size_t count = typer.press(key->hexCode, key->shifted ? 0x02 : 0x00, out);
+                chunk.insert(chunk.end(), out, out + count);
+            }
+            if ((i + 1) % CHUNK == 0 || i + 1 == text.size()) {
+                if (typer.release(out) > 0) chunk.push_back(out[0]);
+                chunks.push_back(chunk);
+                chunk.clear();
+            }
+        }
+        return chunks;
+    }
+
+    // Single-buffered interrupt IN endpoint, read by the host every interval
+    struct Endpoint {
+        unsigned long intervalUs;
+        unsigned long nextPollUs;
+        bool full = false;
+        KeyReport report = {};
+        std::vector<KeyReport> seen;
+
+        Endpoint(unsigned long interval, unsigned long phase) : intervalUs(interval), nextPollUs(phase) {}
+
+        void runUntil(unsigned long nowUs) {
+            while (nextPollUs <= nowUs) {
+                if (full) seen.push_back(report);
+                full = false;
+                nextPollUs += intervalUs;
+            }
+        }
+        bool send(const KeyReport& r) {
+            if (full) return false;
+            report = r;
+            full = true;
+            return true;
+        }
+    };
+
+    struct Outcome {
+        size_t states = 0;  // Distinct states the device meant to send
+        size_t seen = 0;
+        size_t lost = 0;
+        bool inOrder = true;
+        double seconds = 0;
+    };
+
+    // Expected sequence with consecutive duplicates removed, starting from all released
+    std::vector<KeyReport> distinct(const std::vector<std::vector<KeyReport>>& chunks) {
+        std::vector<KeyReport> states;
+        KeyReport last = {};
+        for (const auto& chunk : chunks) {
+            for (const KeyReport& r : chunk) {
+                if (sameReport(r, last)) continue;
+                states.push_back(r);
+                last = r;
+            }
+        }
+        return states;
+    }
+
+    void compare(const std::vector<KeyReport>& expected, const std::vector<KeyReport>& seen, Outcome& outcome) {
+        outcome.states = expected.size();
+        outcome.seen = seen.size();
+        // Longest in-order match; anything missing from it was lost
+        size_t e = 0;
+        for (const KeyReport& r : seen) {
+            if (e < expected.size() && sameReport(r, expected[e])) e++;
+            else outcome.inOrder = false;
+        }
+        outcome.lost = expected.size() - e;
+        if (outcome.lost) outcome.inOrder = false;
+    }
+
+    Outcome runDirect(const std::vector<std::vector<KeyReport>>& chunks, unsigned long hostUs, unsigned long delayUs,
+                      std::mt19937& rng) {
+        Endpoint endpoint(hostUs, rng() % hostUs);
+        unsigned long now = 0;
+        KeyReport last = {};
+        for (const auto& chunk : chunks) {
+            for (const KeyReport& r : chunk) {
+                endpoint.runUntil(now);
+                if (!sameReport(r, last)) endpoint.send(r); // Return value ignored, as before
+                last = r;
+                now += delayUs + rng() % 50;
+            }
+            now += rng() % USB_JITTER_US; // Next network poll
+        }
+        endpoint.runUntil(now + hostUs);
+        Outcome outcome;
+        compare(distinct(chunks), endpoint.seen, outcome);
+        outcome.seconds = now / 1e6;
+        return outcome;
+    }
+
+    Outcome runQueued(const std::vector<std::vector<KeyReport>>& chunks, unsigned long hostUs, std::mt19937& rng,
+                      HidReportQueue::Stats& stats, unsigned long& lastSeenUs) {
+        Endpoint endpoint(hostUs, rng() % hostUs);
+        HidReportQueue queue;
+        unsigned long now = 0;
+        auto pump = [&]() {
+            endpoint.runUntil(now);
+            if (!queue.due(now)) return;
+            if (endpoint.send(queue.front())) queue.sent(now);
+            else queue.busy(now);
+        };
+
+        size_t next = 0;
+        unsigned long tick = 0;
+        size_t lastCount = 0;
+        lastSeenUs = 0;
+        while (next < chunks.size() || !queue.isEmpty() || endpoint.full) {
+            now = tick + rng() % USB_JITTER_US;
+            // The dump only types a chunk the queue can take whole
+            if (next < chunks.size() && queue.freeSpace() >= CHUNK_REPORTS) {
+                for (const KeyReport& r : chunks[next]) {
+                    queue.push(r);
+                    pump();
+                }
+                next++;
+            }
+            pump();
+            if (endpoint.seen.size() != lastCount) {
+                lastCount = endpoint.seen.size();
+                lastSeenUs = now;
+            }
+            tick += USB_PERIOD_US;
+        }
+        endpoint.runUntil(now + hostUs);
+        Outcome outcome;
+        compare(distinct(chunks), endpoint.seen, outcome);
+        outcome.seconds = now / 1e6;
+        stats = queue.stats();
+        return outcome;
+    }
+}
+
+KEYBRIDGE_BENCH(hid_queue, "[--text FILE] [--seed S]") {
+    std::string text = SAMPLE_TEXT;
+    const char* path = args.text("--text");
+    unsigned seed = args.number("--seed", 1u);
+    if (!args.done()) return 2;
+    if (path && !Bench::readFile(path, text)) return 1;
+
+    std::vector<std::vector<KeyReport>> chunks = typeChunks(text);
+    std::mt19937 rng(seed);
+    bool ok = true;
+    const unsigned long hostIntervals[] = {1000, 2000, 8000};
+    for (unsigned long hostUs : hostIntervals) {
+        printf("host polls every %lu ms\n", hostUs / 1000);
+        for (unsigned long delayMs : {1ul, 4ul}) {
+            Outcome d = runDirect(chunks, hostUs, delayMs * 1000, rng);
+            printf("  direct, %lu ms delay   %6.0f states/s  %zu/%zu states lost\n", delayMs,
+                   d.states / d.seconds, d.lost, d.states);
+        }
+        HidReportQueue::Stats stats;
+        unsigned long lastSeenUs = 0;
+        Outcome q = runQueued(chunks, hostUs, rng, stats, lastSeenUs);
+        bool exact = q.inOrder && q.seen == q.states && stats.overruns == 0 && stats.stalled == 0;
+        ok &= exact;
+        printf("  queued                %6.0f states/s  %zu/%zu states lost  high water %zu/%zu  "
+               "overruns %u  retries %u  %s\n",
+               q.states / (lastSeenUs / 1e6), q.lost, q.states, stats.highWater, HidReportQueue::CAPACITY,
+               unsigned(stats.overruns), unsigned(stats.retries), exact ? "exactly once, in order" : "FAILED");
+    }
+
+    // Overrun accounting: a producer that ignores freeSpace() loses states but keeps the latest
+    HidReportQueue queue;
+    KeyReport r = {};
+    for (int i = 0; i < int(HidReportQueue::CAPACITY) + 10; ++i) {
+        r.keys[0] = uint8_t(4 + i % 2);
+        queue.push(r);
+    }
+    bool overrun = queue.stats().overruns == 10 && queue.size() == HidReportQueue::CAPACITY;
+    while (queue.size() > 1) queue.sent(0);
+    overrun &= sameReport(queue.front(), r);
+    printf("queue full: %u overruns, newest state kept: %s\n", unsigned(queue.stats().overruns),
+           overrun ? "yes" : "NO");
+    ok &= overrun;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+// Host test for latency tracing (ArduinoKeyBridge/LatencyTracer.h).
+//
+//   keybridge_bench latency [--reports N] [--seed S]
+//
+// Runs N reports down each path the way the firmware does: USB arrival,
+// pipeline, HID queue paced at 1 ms and, for round trips, a simulated WiFi
+// link and server with random delays. Every hop's true latency is known, so
+// the tracer's histograms can be checked against exact percentiles: p50 and
+// p99 must land within one bucket (25%) of them. Reports the server never
+// answers must show up as lost, and the cost of tracing a report is timed.
+
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "HidReportQueue.h"
+#include "LatencyTracer.h"
+#include "BenchHarness.h"
+
+namespace {
+    // Exact percentile of the samples
+    uint32_t exact(std::vector<uint32_t> samples, double p) {
+        std::sort(samples.begin(), samples.end());
+        return samples[std::min(samples.size() - 1, size_t(p * samples.size()))];
+    }
+
+    // Bucket of the tracer's histogram holding percentile p
+    size_t histogramBucket(const LatencyHistogram& histogram, double p) {
+        uint64_t total = 0;
+        for (size_t b = 0; b < LatencyHistogram::BUCKET_COUNT; ++b) total += histogram.count(b);
+        uint64_t seen = 0;
+        for (size_t b = 0; b < LatencyHistogram::BUCKET_COUNT; ++b) {
+            seen += histogram.count(b);
+            if (seen > p * total) return b;
+        }
+        return LatencyHistogram::BUCKET_COUNT - 1;
+    }
+
+    bool check(const char* name, const LatencyHistogram& histogram, const std::vector<uint32_t>& truth) {
+        bool ok = histogram.total() == truth.size();
+        printf("%-13s %6zu samples ", name, truth.size());
+        for (double p : {0.5, 0.99}) {
+            uint32_t want = exact(truth, p);
+            size_t bucket = histogramBucket(histogram, p);
+            // Off by one bucket at most, the percentile may sit on a boundary
+            size_t wantBucket = LatencyHistogram::bucketFor(want);
+            bool near = bucket + 1 >= wantBucket && bucket <= wantBucket + 1;
+            printf(" p%02.0f %7u us (bucket %7u-%-7u)%s", p * 100, want, LatencyHistogram::bucketLow(bucket),
+                   LatencyHistogram::bucketHigh(bucket), near ? "" : " WRONG");
+            ok &= near;
+        }
+        printf("\n");
+        return ok;
+    }
+}
+
+KEYBRIDGE_BENCH(latency, "[--reports N] [--seed S]") {
+    size_t reports = args.number("--reports", size_t(20000));
+    unsigned seed = args.number("--seed", 1u);
+    if (!args.done()) return 2;
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<uint32_t> pipeline(20, 400);
+    // WiFi: mostly a few ms, with a long tail
+    std::lognormal_distribution<double> wifi(8.0, 0.6);
+    std::uniform_int_distribution<uint32_t> server(50, 2000);
+
+    LatencyTracer& tracer = LatencyTracer::getInstance();
+    tracer.setSampling(1);
+    std::vector<uint32_t> truth[LatencyTracer::HISTOGRAM_COUNT];
+    auto hop = [&](size_t h, uint32_t us) { truth[LatencyTracer::PATH_COUNT + h].push_back(us); };
+
+    HidReportQueue queue;
+    unsigned long now = 1000;
+    size_t unanswered = 0;
+    double traceSeconds = 0;
+    for (size_t i = 0; i < reports; ++i) {
+        int path = int(i % LatencyTracer::PATH_COUNT);
+        // A different key each time, so the queue never skips a duplicate
+        KeyReport report = {0, 0, {uint8_t(0x04 + i % 26), 0, 0, 0, 0, 0}};
+        unsigned long start = now;
+        uint8_t tag = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        if (path == LatencyTracer::PASS_THROUGH) {
+            tracer.arrival(start);
+            now += pipeline(rng);
+            tag = tracer.passThrough();
+            hop(LatencyTracer::PIPELINE, now - start);
+        } else if (path == LatencyTracer::ROUND_TRIP) {
+            tracer.arrival(start);
+            now += pipeline(rng);
+            uint16_t id = 0;
+            tracer.forward(id);
+            tracer.forwarded(id, now);
+            // Every 50th report never comes back
+            if (i % 50 == 1) {
+                unanswered++;
+                now += LatencyTracer::TIMEOUT_US;
+                tracer.expire(now);
+                continue;
+            }
+            hop(LatencyTracer::PIPELINE, now - start);
+            uint32_t network = uint32_t(wifi(rng)), held = server(rng);
+            now += network + held;
+            tracer.serverHold(uint16_t(held));
+            tracer.serverTrace(id, now);
+            hop(LatencyTracer::NETWORK, network);
+            hop(LatencyTracer::SERVER, held);
+            unsigned long received = now;
+            now += pipeline(rng);
+            tag = tracer.takeServerTag();
+            hop(LatencyTracer::RECEIVE, now - received);
+        } else {
+            tracer.serverTrace(uint16_t(0x8000 | i), start);
+            now += pipeline(rng);
+            tag = tracer.takeServerTag();
+            hop(LatencyTracer::RECEIVE, now - start);
+        }
+        queue.push(report, tag);
+        tracer.queued(tag, now);
+        unsigned long queued = now;
+        // Whatever the queue holds goes out one report per interval
+        now += HidReportQueue::DEFAULT_INTERVAL_US / 2 + rng() % HidReportQueue::DEFAULT_INTERVAL_US;
+        uint8_t sentTag = queue.sent(now);
+        tracer.delivered(sentTag, now);
+        traceSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        hop(LatencyTracer::HID_QUEUE, now - queued);
+        truth[path].push_back(now - start);
+        uint16_t done;
+        while (tracer.takeDone(done)) {}
+        now += 5000;
+    }
+
+    bool ok = true;
+    for (size_t h = 0; h < LatencyTracer::HISTOGRAM_COUNT; ++h) {
+        ok &= check(LatencyTracer::NAMES[h], tracer.histogram(h), truth[h]);
+    }
+    printf("completed %u, lost %u (expected %zu)\n", tracer.completed(), tracer.lost(), unanswered);
+    ok &= tracer.lost() == unanswered && tracer.completed() == reports - unanswered;
+    printf("tracing cost: %.0f ns per report, histograms %zu bytes of RAM\n", traceSeconds * 1e9 / reports,
+           sizeof(LatencyHistogram) * LatencyTracer::HISTOGRAM_COUNT);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+// Host check for the LED compositor (ArduinoKeyBridge/LedCompositor.h).
+//
+//   keybridge_bench led [--seconds S] [--changes-per-second N]
+//
+// Counts how often the strip would be sent per second under a burst of mode
+// changes, with render() called every millisecond, against sending the strip
+// on every setter call as before. Also checks layer priority, expiry of
+// flashes and that a static frame is never sent twice.
+
+#include <cstdio>
+
+#include "LedCompositor.h"
+#include "BenchHarness.h"
+
+namespace {
+    constexpr uint16_t PIXELS = 8;
+
+    bool expect(bool ok, const char* what) {
+        if (!ok) printf("FAIL %s\n", what);
+        return ok;
+    }
+
+    bool allPixels(const LedCompositor& leds, const NeoPixelColor& color) {
+        for (size_t i = 0; i < leds.pixelCount(); ++i) {
+            if (leds.pixel(i) != color) return false;
+        }
+        return true;
+    }
+
+    bool selfTest() {
+        bool ok = true;
+        LedCompositor leds;
+        leds.begin(PIXELS);
+        unsigned long now = 0;
+
+        leds.setSolid(LedCompositor::MODE, NeoPixelColors::BLUE);
+        ok &= expect(leds.render(now, true) && allPixels(leds, NeoPixelColors::BLUE), "mode color");
+        ok &= expect(!leds.render(now += 100), "unchanged frame not sent again");
+
+        leds.setSolid(LedCompositor::ERROR, NeoPixelColors::RED);
+        leds.setSolid(LedCompositor::ACTIVITY, NeoPixelColors::GREEN, 255, 500);
+        ok &= expect(leds.render(now += 100) && allPixels(leds, NeoPixelColors::RED), "error over activity");
+        leds.setProgress(LedCompositor::BOOT, NeoPixelColors::WHITE, 0.5f);
+        leds.render(now += 100);
+        ok &= expect(leds.pixel(0) == NeoPixelColors::WHITE && leds.pixel(PIXELS - 1) == NeoPixelColors::BLACK,
+                     "boot progress over everything");
+        leds.clearLayer(LedCompositor::BOOT);
+        leds.clearLayer(LedCompositor::ERROR);
+        ok &= expect(leds.render(now += 100) && allPixels(leds, NeoPixelColors::GREEN), "activity flash");
+        leds.render(now += 600);
+        ok &= expect(allPixels(leds, NeoPixelColors::BLUE), "flash expired");
+
+        leds.setSolid(LedCompositor::MODE, NeoPixelColors::WHITE, 15);
+        leds.render(now += 100);
+        ok &= expect(leds.pixel(0) == NeoPixelColor(15, 15, 15), "mode level");
+
+        leds.setRolling(LedCompositor::AMBIENT, NeoPixelColors::MAGENTA);
+        size_t changes = 0;
+        for (int i = 0; i < 1000; ++i) changes += leds.render(now += 1);
+        // One step per AMBIENT_STEP_MS
+        ok &= expect(changes >= 9 && changes <= 11, "ambient dot steps ten times a second");
+
+        printf("self test: %s\n", ok ? "ok" : "FAILED");
+        return ok;
+    }
+}
+
+KEYBRIDGE_BENCH(led, "[--seconds S] [--changes-per-second N]") {
+    unsigned long seconds = args.number("--seconds", 5ul);
+    unsigned long changesPerSecond = args.number("--changes-per-second", 200ul);
+    if (!args.done()) return 2;
+    if (seconds == 0 || changesPerSecond == 0 || changesPerSecond > 1000) return 2;
+    if (!selfTest()) return 1;
+
+    // Command mode toggles plus server feedback flashes, as during a burst of
+    // commands; every change used to send the strip at least once
+    LedCompositor leds;
+    leds.begin(PIXELS);
+    unsigned long interval = 1000 / changesPerSecond;
+    unsigned long directShows = 0;
+    unsigned long shows = 0;
+    unsigned long maxPerSecond = 0;
+    unsigned long thisSecond = 0;
+    bool command = false;
+    for (unsigned long now = 0; now < seconds * 1000; ++now) {
+        if (now % interval == 0) {
+            command = !command;
+            leds.setSolid(LedCompositor::MODE, command ? NeoPixelColors::BLUE : NeoPixelColors::WHITE, command ? 15 : 1);
+            leds.setRolling(LedCompositor::AMBIENT, command ? NeoPixelColors::BLUE : NeoPixelColors::WHITE, command ? 60 : 4);
+            directShows += 2; // setColor() and setBrightness() each sent the strip
+        }
+        // A server feedback flash once a second
+        if (now % 1000 == 0) {
+            leds.setSolid(LedCompositor::ACTIVITY, NeoPixelColors::GREEN, 60, 300);
+            directShows++;
+        }
+        if (leds.render(now)) {
+            shows++;
+            thisSecond++;
+        }
+        if (now % 1000 == 999) {
+            if (thisSecond > maxPerSecond) maxPerSecond = thisSecond;
+            thisSecond = 0;
+        }
+    }
+
+    unsigned long cap = 1000 / LedCompositor::FRAME_INTERVAL_MS + 1;
+    printf("%lu mode changes/s for %lu s, render() every 1 ms\n", changesPerSecond, seconds);
+    printf("show() per second: direct %lu  composited %.1f (max %lu in one second, cap %lu)\n",
+           directShows / seconds, double(shows) / seconds, maxPerSecond, cap);
+    printf("frames composed %lu  changed %lu\n", (unsigned long)leds.framesComposed(), (unsigned long)leds.framesChanged());
+    return maxPerSecond <= cap ? 0 : 1;
+}
@@ -0,0 +1,376 @@
+// Concurrent load generator and soak tester for the ArduinoKeyBridge protocol.
+//
+// Opens several KeyBridgeClient sessions and replays a weighted mix of
+// workloads against the device at a target rate:
+//
+//   flood      pipelined bursts of key taps (press + release)
+//   text       charter mode text bursts
+//   toggle     command mode on/off control reports
+//   reconnect  drop and re-open the session
+//
+// With --hid-device the tool grabs the bridge's keyboard on this host
+// (/dev/input/eventN) and correlates injected taps with the key-down events
+// the device produces, giving end-to-end latency percentiles. Results are
+// written as a JSON summary.
+
+#include <linux/input.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "KeyBridgeClient.h"
+
+namespace {
+    struct Options {
+        std::string host = "192.168.4.1";
+        uint16_t port = 8080;
+        int sessions = 4;
+        double durationSec = 30.0;
+        double rate = 20.0;          // Workload operations per second per session
+        int floodTaps = 16;          // Taps per flood burst
+        int textLength = 64;         // Characters per text burst
+        int weights[4] = {70, 10, 10, 10}; // flood, text, toggle, reconnect
+        std::string hidDevice;
+        std::string jsonPath;
+    };
+
+    enum Workload { FLOOD, TEXT, TOGGLE, RECONNECT, WORKLOAD_COUNT };
+    const char* WORKLOAD_NAMES[WORKLOAD_COUNT] = {"flood", "text", "toggle", "reconnect"};
+
+    // HID usage for 'a'..'z' is 0x04..0x1D; these are the matching evdev codes
+    const uint16_t EVDEV_LETTERS[26] = {
+        KEY_A, KEY_B, KEY_C, KEY_D, KEY_E, KEY_F, KEY_G, KEY_H, KEY_I, KEY_J, KEY_K, KEY_L, KEY_M,
+        KEY_N, KEY_O, KEY_P, KEY_Q, KEY_R, KEY_S, KEY_T, KEY_U, KEY_V, KEY_W, KEY_X, KEY_Y, KEY_Z
+    };
+
+    int64_t monotonicMicros() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+    }
+
+    // Send timestamps per letter, matched FIFO against HID key-down events
+    class LatencyTracker {
+    public:
+        static constexpr int64_t MATCH_TIMEOUT_US = 5000000;
+
+        void injected(int letter, int64_t atUs) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_[letter].push_back(atUs);
+        }
+
+        void observed(int letter, int64_t atUs) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::deque<int64_t>& queue = pending_[letter];
+            expire(queue, atUs);
+            if (queue.empty()) {
+                unmatchedEvents_++;
+                return;
+            }
+            samples_.push_back(atUs - queue.front());
+            queue.pop_front();
+        }
+
+        void finish(int64_t nowUs) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& queue : pending_) expire(queue, nowUs + MATCH_TIMEOUT_US);
+        }
+
+        std::vector<int64_t> samples() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return samples_;
+        }
+        uint64_t lost() const { return lost_; }
+        uint64_t unmatchedEvents() const { return unmatchedEvents_; }
+
+    private:
+        void expire(std::deque<int64_t>& queue, int64_t nowUs) {
+            while (!queue.empty() && nowUs - queue.front() > MATCH_TIMEOUT_US) {
+                queue.pop_front();
+                lost_++;
+            }
+        }
+
+        mutable std::mutex mutex_;
+        std::deque<int64_t> pending_[26];
+        std::vector<int64_t> samples_;
+        uint64_t lost_ = 0;
+        uint64_t unmatchedEvents_ = 0;
+    };
+
+    struct SessionResult {
+        uint64_t ops[WORKLOAD_COUNT] = {0};
+        uint64_t connectFailures = 0;
+        KeyBridgeClient::Stats stats;
+    };
+
+    std::atomic<bool> stopping{false};
+
+    void runSession(const Options& options, int index, LatencyTracker& tracker, SessionResult& result) {
+        std::mt19937 rng(0x4B42u + index);
+        std::discrete_distribution<int> pick(options.weights, options.weights + WORKLOAD_COUNT);
+        std::uniform_int_distribution<int> letterPick(0, 25);
+
+        auto client = std::make_unique<KeyBridgeClient>();
+        client->setAutoReconnect(true, 500);
+        if (!client->start(options.host, options.port)) result.connectFailures++;
+
+        // Each session injects its own subset of letters so latency samples
+        // can be attributed even when several sessions are active.
+        std::vector<int> letters;
+        for (int l = 0; l < 26; ++l) {
+            if (l % std::min(options.sessions, 26) == index % 26) letters.push_back(l);
+        }
+
+        KeyBridgeClient::Stats carried;
+        auto period = std::chrono::duration<double>(1.0 / options.rate);
+        auto next = std::chrono::steady_clock::now();
+        size_t letterIndex = 0;
+
+        while (!stopping.load()) {
+            int workload = pick(rng);
+            result.ops[workload]++;
+            switch (workload) {
+                case FLOOD: {
+                    std::vector<KeyReport> reports;
+                    reports.reserve(options.floodTaps * 2);
+                    int64_t now = monotonicMicros();
+                    for (int t = 0; t < options.floodTaps; ++t) {
+                        int letter = letters[letterIndex++ % letters.size()];
+                        KeyReport press = {0x00, 0x00, {static_cast<uint8_t>(0x04 + letter), 0, 0, 0, 0, 0}};
+                        reports.push_back(press);
+                        reports.push_back(KeyReport{});
+                        if (!options.hidDevice.empty() && client->isConnected()) tracker.injected(letter, now);
+                    }
+                    client->sendReports(reports.data(), reports.size());
+                    break;
+                }
+                case TEXT: {
+                    std::string text;
+                    for (int c = 0; c < options.textLength; ++c) {
+                        text += (c % 6 == 5) ? ' ' : static_cast<char>('a' + letterPick(rng));
+                    }
+                    client->sendText(text);
+                    break;
+                }
+                case TOGGLE:
+                    client->sendControl(BridgeProtocol::Control::COMMAND_ON);
+                    client->sendControl(BridgeProtocol::Control::COMMAND_OFF);
+                    break;
+                case RECONNECT: {
+                    client->stop();
+                    KeyBridgeClient::Stats stats = client->stats();
+                    carried.bytesSent += stats.bytesSent;
+                    carried.reportsSent += stats.reportsSent;
+                    carried.connects += stats.connects;
+                    carried.disconnects += stats.disconnects;
+                    carried.droppedBytes += stats.droppedBytes;
+                    client = std::make_unique<KeyBridgeClient>();
+                    client->setAutoReconnect(true, 500);
+                    if (!client->start(options.host, options.port)) result.connectFailures++;
+                    break;
+                }
+            }
+
+            next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+            std::this_thread::sleep_until(next);
+        }
+
+        client->flush(1000);
+        client->stop();
+        result.stats = client->stats();
+        result.stats.bytesSent += carried.bytesSent;
+        result.stats.reportsSent += carried.reportsSent;
+        result.stats.connects += carried.connects;
+        result.stats.disconnects += carried.disconnects;
+        result.stats.droppedBytes += carried.droppedBytes;
+    }
+
+    // Reads key-down events from the bridge's HID keyboard on this host
+    void runHidReader(const std::string& path, LatencyTracker& tracker, std::atomic<bool>& ok) {
+        int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK);
+        if (fd < 0) {
+            fprintf(stderr, "cannot open %s: %s\n", path.c_str(), strerror(errno));
+            return;
+        }
+        int clock = CLOCK_MONOTONIC;
+        ioctl(fd, EVIOCSCLOCKID, &clock);
+        // Keep the injected floods away from whatever has focus on this host
+        ioctl(fd, EVIOCGRAB, 1);
+        ok.store(true);
+
+        std::map<uint16_t, int> letterFor;
+        for (int l = 0; l < 26; ++l) letterFor[EVDEV_LETTERS[l]] = l;
+
+        input_event events[64];
+        while (!stopping.load()) {
+            pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, 100) <= 0) continue;
+            ssize_t got = read(fd, events, sizeof(events));
+            if (got <= 0) continue;
+            for (size_t i = 0; i < got / sizeof(input_event); ++i) {
+                const input_event& ev = events[i];
+                if (ev.type != EV_KEY || ev.value != 1) continue;
+                auto it = letterFor.find(ev.code);
+                if (it == letterFor.end()) continue;
+                int64_t atUs = static_cast<int64_t>(ev.input_event_sec) * 1000000 + ev.input_event_usec;
+                tracker.observed(it->second, atUs);
+            }
+        }
+        ioctl(fd, EVIOCGRAB, 0);
+        close(fd);
+    }
+
+    int64_t percentile(const std::vector<int64_t>& sorted, double p) {
+        if (sorted.empty()) return 0;
+        size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+
+    bool parseMix(const char* spec, int* weights) {
+        std::fill(weights, weights + WORKLOAD_COUNT, 0);
+        std::string s = spec;
+        size_t pos = 0;
+        while (pos < s.size()) {
+            size_t comma = s.find(',', pos);
+            std::string item = s.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+            size_t eq = item.find('=');
+            if (eq == std::string::npos) return false;
+            std::string name = item.substr(0, eq);
+            int w;
+            for (w = 0; w < WORKLOAD_COUNT && name != WORKLOAD_NAMES[w]; ++w) {}
+            if (w == WORKLOAD_COUNT) return false;
+            weights[w] = atoi(item.c_str() + eq + 1);
+            if (comma == std::string::npos) break;
+            pos = comma + 1;
+        }
+        return true;
+    }
+
+    void usage() {
+        fprintf(stderr,
+            "usage: keybridge_load [options]\n"
+            "  --host H --port P          device address (192.168.4.1:8080)\n"
+            "  --sessions N               concurrent sessions (4)\n"
+            "  --duration S               run time in seconds (30)\n"
+            "  --rate R                   operations/s per session (20)\n"
+            "  --mix flood=70,text=10,toggle=10,reconnect=10\n"
+            "  --flood-taps N             taps per flood burst (16)\n"
+            "  --text-length N            characters per text burst (64)\n"
+            "  --hid-device /dev/input/eventN  measure end-to-end latency\n"
+            "  --json FILE                write summary to FILE instead of stdout\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : ""; };
+        if (!strcmp(argv[i], "--host")) options.host = next();
+        else if (!strcmp(argv[i], "--port")) options.port = static_cast<uint16_t>(atoi(next()));
+        else if (!strcmp(argv[i], "--sessions")) options.sessions = std::max(1, atoi(next()));
+        else if (!strcmp(argv[i], "--duration")) options.durationSec = atof(next());
+        else if (!strcmp(argv[i], "--rate")) options.rate = std::max(0.1, atof(next()));
+        else if (!strcmp(argv[i], "--flood-taps")) options.floodTaps = std::max(1, atoi(next()));
+        else if (!strcmp(argv[i], "--text-length")) options.textLength = std::max(1, atoi(next()));
+        else if (!strcmp(argv[i], "--hid-device")) options.hidDevice = next();
+        else if (!strcmp(argv[i], "--json")) options.jsonPath = next();
+        else if (!strcmp(argv[i], "--mix")) {
+            if (!parseMix(next(), options.weights)) {
+                usage();
+                return 2;
+            }
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    LatencyTracker tracker;
+    std::atomic<bool> hidOk{false};
+    std::thread hidThread;
+    if (!options.hidDevice.empty()) {
+        hidThread = std::thread(runHidReader, options.hidDevice, std::ref(tracker), std::ref(hidOk));
+    }
+
+    std::vector<SessionResult> results(options.sessions);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < options.sessions; ++s) {
+        threads.emplace_back(runSession, std::cref(options), s, std::ref(tracker), std::ref(results[s]));
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.durationSec));
+    stopping.store(true);
+    for (auto& t : threads) t.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (hidThread.joinable()) hidThread.join();
+    tracker.finish(monotonicMicros());
+
+    SessionResult total;
+    for (const SessionResult& r : results) {
+        for (int w = 0; w < WORKLOAD_COUNT; ++w) total.ops[w] += r.ops[w];
+        total.connectFailures += r.connectFailures;
+        total.stats.bytesSent += r.stats.bytesSent;
+        total.stats.reportsSent += r.stats.reportsSent;
+        total.stats.reportsReceived += r.stats.reportsReceived;
+        total.stats.connects += r.stats.connects;
+        total.stats.disconnects += r.stats.disconnects;
+        total.stats.droppedBytes += r.stats.droppedBytes;
+    }
+
+    std::vector<int64_t> samples = tracker.samples();
+    std::sort(samples.begin(), samples.end());
+
+    FILE* out = stdout;
+    if (!options.jsonPath.empty()) {
+        out = fopen(options.jsonPath.c_str(), "w");
+        if (!out) {
+            fprintf(stderr, "cannot write %s\n", options.jsonPath.c_str());
+            return 1;
+        }
+    }
+    fprintf(out, "{\n");
+    fprintf(out, "  \"target\": \"%s:%u\",\n", options.host.c_str(), options.port);
+    fprintf(out, "  \"sessions\": %d,\n", options.sessions);
+    fprintf(out, "  \"duration_s\": %.3f,\n", elapsed);
+    fprintf(out, "  \"rate_per_session\": %.2f,\n", options.rate);
+    fprintf(out, "  \"operations\": {");
+    for (int w = 0; w < WORKLOAD_COUNT; ++w) {
+        fprintf(out, "%s\"%s\": %llu", w ? ", " : "", WORKLOAD_NAMES[w], (unsigned long long)total.ops[w]);
+    }
+    fprintf(out, "},\n");
+    fprintf(out, "  \"reports_sent\": %llu,\n", (unsigned long long)total.stats.reportsSent);
+    fprintf(out, "  \"reports_received\": %llu,\n", (unsigned long long)total.stats.reportsReceived);
+    fprintf(out, "  \"bytes_sent\": %llu,\n", (unsigned long long)total.stats.bytesSent);
+    fprintf(out, "  \"bytes_per_s\": %.1f,\n", total.stats.bytesSent / elapsed);
+    fprintf(out, "  \"connects\": %llu,\n", (unsigned long long)total.stats.connects);
+    fprintf(out, "  \"disconnects\": %llu,\n", (unsigned long long)total.stats.disconnects);
+    fprintf(out, "  \"connect_failures\": %llu,\n", (unsigned long long)total.connectFailures);
+    fprintf(out, "  \"dropped_bytes\": %llu,\n", (unsigned long long)total.stats.droppedBytes);
+    fprintf(out, "  \"latency_us\": {\"measured\": %s, \"samples\": %zu, \"lost\": %llu, \"unmatched\": %llu, "
+                 "\"p50\": %lld, \"p99\": %lld, \"p999\": %lld, \"max\": %lld}\n",
+            hidOk.load() ? "true" : "false", samples.size(),
+            (unsigned long long)tracker.lost(), (unsigned long long)tracker.unmatchedEvents(),
+            (long long)percentile(samples, 0.50), (long long)percentile(samples, 0.99),
+            (long long)percentile(samples, 0.999), (long long)(samples.empty() ? 0 : samples.back()));
+    fprintf(out, "}\n");
+    if (out != stdout) fclose(out);
+    return 0;
+}
@@ -0,0 +1,100 @@
+// Host test for the logger's rate limit (ArduinoKeyBridge/LogRateLimiter.h).
+//
+//   keybridge_bench log_limit [--messages N]
+//
+// Runs the firmware's default limit, 20 messages/s with a burst of 40, and
+// checks that:
+//
+//   - a burst of 100 messages at one instant prints exactly the first 40
+//   - half a second later the bucket has refilled by 10, no more
+//   - the first message through reports how many were suppressed before it,
+//     and the count starts over after that
+//   - a steady 100 messages/s settles at 20 printed per second
+//   - 1-in-N sampling offers every Nth message to the bucket, and a source
+//     that went quiet hands over its suppressed count to takeSuppressed()
+//   - a source with its own limit doesn't share the default bucket
+//
+// Then times allow(), the check the logger makes before it builds a message.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "LogRateLimiter.h"
+#include "BenchHarness.h"
+
+namespace {
+    // Messages from source at nowMs that get through; suppressed is the count reported by the first one
+    size_t offer(LogRateLimiter& limiter, const char* source, unsigned long nowMs, size_t count, uint32_t* suppressed = nullptr) {
+        size_t passed = 0;
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t dropped = 0;
+            if (!limiter.allow(source, nowMs, dropped)) continue;
+            if (passed == 0 && suppressed) *suppressed = dropped;
+            passed++;
+        }
+        return passed;
+    }
+}
+
+KEYBRIDGE_BENCH(log_limit, "[--messages N]") {
+    size_t messages = args.number("--messages", size_t(10000000));
+    if (!args.done()) return 2;
+
+    bool ok = true;
+    LogRateLimiter::Limit limit;
+    limit.perSecond = 20;
+    limit.burst = 40;
+
+    LogRateLimiter limiter;
+    limiter.setDefault(limit);
+    ok &= Bench::check("burst of 100 prints 40", offer(limiter, "TCPConnection", 1000, 100) == 40);
+    uint32_t suppressed = 0;
+    ok &= Bench::check("500 ms later 10 more get through", offer(limiter, "TCPConnection", 1500, 100, &suppressed) == 10);
+    ok &= Bench::check("the first of them reports 60 suppressed", suppressed == 60);
+    suppressed = 0;
+    ok &= Bench::check("one second later 20 more", offer(limiter, "TCPConnection", 2500, 100, &suppressed) == 20);
+    ok &= Bench::check("reporting 90 suppressed, counted from the last report", suppressed == 90);
+    ok &= Bench::check("a full minute idle refills to the burst, not beyond", offer(limiter, "TCPConnection", 62500, 100) == 40);
+
+    // 100 messages/s for 10 s, one every 10 ms
+    LogRateLimiter steady;
+    steady.setDefault(limit);
+    size_t printed = 0;
+    for (unsigned long ms = 0; ms < 10000; ms += 10) printed += offer(steady, "MinimalKeyboard", ms, 1);
+    printf("steady 100/s for 10 s: %zu printed, %u suppressed\n", printed, steady.totalSuppressed());
+    ok &= Bench::check("steady 100/s prints the burst plus 20/s", printed >= 40 + 195 && printed <= 40 + 200);
+
+    LogRateLimiter sampled;
+    LogRateLimiter::Limit every10;
+    every10.sampleEvery = 10;
+    sampled.setDefault(every10);
+    ok &= Bench::check("1 in 10 sampling keeps 10 of 100", offer(sampled, "Loop", 0, 100) == 10);
+    const char* quiet = sampled.takeSuppressed(suppressed);
+    // The other 81 were reported by the message kept after them
+    ok &= Bench::check("the 9 after the last kept one go to takeSuppressed()", quiet && !strcmp(quiet, "Loop") && suppressed == 9);
+    ok &= Bench::check("and only once", sampled.takeSuppressed(suppressed) == nullptr);
+
+    LogRateLimiter own;
+    own.setDefault(limit);
+    LogRateLimiter::Limit tight;
+    tight.perSecond = 1;
+    tight.burst = 2;
+    own.setLimit("TCPConnection", tight);
+    size_t tightPassed = offer(own, "TCPConnection", 0, 10);
+    size_t defaultPassed = offer(own, "Loop", 0, 100);
+    ok &= Bench::check("own limit 2, default 40 for everyone else", tightPassed == 2 && defaultPassed == 40);
+
+    // Cost of the check itself, mostly at the default limit with the bucket empty
+    LogRateLimiter timed;
+    timed.setDefault(limit);
+    auto start = std::chrono::steady_clock::now();
+    size_t passed = 0;
+    for (size_t i = 0; i < messages; ++i) {
+        uint32_t dropped = 0;
+        passed += timed.allow("TCPConnection", (unsigned long)(i / 1000), dropped);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / messages;
+    printf("allow(): %.1f ns per message, %zu of %zu printed\n", ns, passed, messages);
+    return ok ? 0 : 1;
+}
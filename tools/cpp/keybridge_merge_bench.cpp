@@ -0,0 +1,197 @@
+// Host test for merging several USB keyboards (ArduinoKeyBridge/KeyboardMerger.h).
+//
+//   keybridge_bench merge [--events N] [--seed S] [--keys K]
+//
+// Four simulated keyboards press and release random keys from a shared
+// range of K keys, so several keyboards often hold the same key. Their boot
+// reports are interleaved one event at a time, with some ErrorRollOver
+// reports and an unplug now and then. After every report the merged report
+// is checked against a model of what each keyboard holds:
+//
+//   - modifiers are the OR of all keyboards
+//   - every key in the report is held somewhere, none appears twice
+//   - the report has min(6, distinct held keys) keys
+//   - a key that was in the report stays until nobody holds it
+//   - report(mask) only has keys of keyboards with that tag
+//
+// Then prints merged reports per second on the host.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "KeyboardMerger.h"
+#include "BenchHarness.h"
+
+namespace {
+    constexpr uint8_t DEVICES = KeyboardMerger::MAX_DEVICES;
+
+    struct Keyboard {
+        uint8_t modifiers = 0;
+        std::vector<uint8_t> keys; // As the keyboard reports them, at most six
+    };
+
+    void bootReport(const Keyboard& kb, uint8_t* buf) {
+        memset(buf, 0, 8);
+        buf[0] = kb.modifiers;
+        for (size_t i = 0; i < kb.keys.size(); ++i) buf[2 + i] = kb.keys[i];
+    }
+
+    bool inReport(const KeyReport& report, uint8_t key) {
+        for (uint8_t k : report.keys) {
+            if (k == key) return true;
+        }
+        return false;
+    }
+
+    size_t reportSize(const KeyReport& report) {
+        size_t n = 0;
+        for (uint8_t k : report.keys) n += k != 0;
+        return n;
+    }
+
+    class Checker {
+    public:
+        explicit Checker(const Keyboard* keyboards) : keyboards_(keyboards) {}
+
+        bool check(const KeyboardMerger& merger, const KeyReport& previous, unsigned long event) {
+            const KeyReport& report = merger.report();
+            std::set<uint8_t> held;
+            uint8_t modifiers = 0;
+            for (uint8_t d = 0; d < DEVICES; ++d) {
+                modifiers |= keyboards_[d].modifiers;
+                held.insert(keyboards_[d].keys.begin(), keyboards_[d].keys.end());
+            }
+            if (report.modifiers != modifiers) return fail(event, "modifiers");
+            std::set<uint8_t> seen;
+            for (uint8_t k : report.keys) {
+                if (k == 0) continue;
+                if (!held.count(k)) return fail(event, "key in report nobody holds");
+                if (!seen.insert(k).second) return fail(event, "key twice in report");
+            }
+            if (reportSize(report) != (held.size() < 6 ? held.size() : 6)) return fail(event, "report size");
+            for (uint8_t k : previous.keys) {
+                if (k != 0 && held.count(k) && !inReport(report, k)) return fail(event, "held key left the report");
+            }
+            KeyReport pads = merger.report(KeyboardMerger::tagMask(KeyboardMerger::MACRO_PAD));
+            for (uint8_t k : pads.keys) {
+                if (k == 0) continue;
+                bool onPad = false;
+                for (uint8_t d = 0; d < DEVICES; ++d) {
+                    if (merger.tag(d) != KeyboardMerger::MACRO_PAD) continue;
+                    for (uint8_t h : keyboards_[d].keys) onPad |= h == k;
+                }
+                if (!onPad) return fail(event, "macro pad report has a key from the main keyboard");
+            }
+            return true;
+        }
+
+    private:
+        const Keyboard* keyboards_;
+
+        static bool fail(unsigned long event, const char* what) {
+            printf("FAIL after event %lu: %s\n", event, what);
+            return false;
+        }
+    };
+
+    // One random change on one keyboard; returns false for an ErrorRollOver report
+    bool step(Keyboard& kb, std::mt19937& rng, uint8_t keyRange) {
+        unsigned r = rng() % 100;
+        if (r < 2) return false;
+        if (r < 10) {
+            kb.modifiers ^= uint8_t(1u << (rng() % 8));
+        } else if (!kb.keys.empty() && (kb.keys.size() == 6 || r < 55)) {
+            kb.keys.erase(kb.keys.begin() + rng() % kb.keys.size());
+        } else {
+            uint8_t key = uint8_t(4 + rng() % keyRange);
+            bool held = false;
+            for (uint8_t k : kb.keys) held |= k == key;
+            if (!held) kb.keys.push_back(key);
+        }
+        return true;
+    }
+
+    bool run(unsigned long events, unsigned seed, uint8_t keyRange) {
+        std::mt19937 rng(seed);
+        Keyboard keyboards[DEVICES];
+        KeyboardMerger merger;
+        merger.setTag(0, KeyboardMerger::KEYBOARD);
+        for (uint8_t d = 1; d < DEVICES; ++d) merger.setTag(d, KeyboardMerger::MACRO_PAD);
+        Checker checker(keyboards);
+
+        unsigned long changes = 0, rollovers = 0, unplugs = 0;
+        uint8_t buf[8];
+        for (unsigned long e = 0; e < events; ++e) {
+            KeyReport previous = merger.report();
+            uint8_t d = uint8_t(rng() % DEVICES);
+            if (rng() % 1000 == 0) {
+                keyboards[d] = Keyboard();
+                changes += merger.releaseDevice(d);
+                unplugs++;
+            } else if (step(keyboards[d], rng, keyRange)) {
+                bootReport(keyboards[d], buf);
+                changes += merger.update(d, buf, sizeof(buf));
+            } else {
+                bootReport(keyboards[d], buf);
+                for (int i = 2; i < 8; ++i) buf[i] = KeyboardMerger::ERROR_ROLLOVER;
+                merger.update(d, buf, sizeof(buf));
+                rollovers++;
+            }
+            if (!checker.check(merger, previous, e)) return false;
+        }
+        for (uint8_t d = 0; d < DEVICES; ++d) {
+            keyboards[d] = Keyboard();
+            bootReport(keyboards[d], buf);
+            merger.update(d, buf, sizeof(buf));
+        }
+        const KeyReport& last = merger.report();
+        if (last.modifiers != 0 || reportSize(last) != 0 || merger.heldCount() != 0) {
+            printf("FAIL keys left after releasing everything\n");
+            return false;
+        }
+        if (merger.rollovers() != rollovers || merger.dropped() != 0) {
+            printf("FAIL counters: rollovers %lu (expected %lu), dropped %lu\n", (unsigned long)merger.rollovers(),
+                   rollovers, (unsigned long)merger.dropped());
+            return false;
+        }
+        printf("seed %u: %lu events, %lu merged changes, %lu rollover reports, %lu unplugs: ok\n", seed, events, changes,
+               rollovers, unplugs);
+        return true;
+    }
+}
+
+KEYBRIDGE_BENCH(merge, "[--events N] [--seed S] [--keys K]") {
+    unsigned long events = args.number("--events", 200000ul);
+    unsigned seed = args.number("--seed", 1u);
+    unsigned long keyRange = args.number("--keys", 12ul);
+    if (!args.done()) return 2;
+    if (events == 0 || keyRange < 6 || keyRange > 200) return 2;
+
+    for (unsigned s = seed; s < seed + 4; ++s) {
+        if (!run(events, s, uint8_t(keyRange))) return 1;
+    }
+
+    // Merging only, four keyboards typing interleaved
+    std::mt19937 rng(seed);
+    Keyboard keyboards[DEVICES];
+    std::vector<std::pair<uint8_t, std::vector<uint8_t>>> stream;
+    for (unsigned long e = 0; e < events; ++e) {
+        uint8_t d = uint8_t(rng() % DEVICES);
+        std::vector<uint8_t> buf(8);
+        if (!step(keyboards[d], rng, uint8_t(keyRange))) continue;
+        bootReport(keyboards[d], buf.data());
+        stream.emplace_back(d, buf);
+    }
+    KeyboardMerger merger;
+    unsigned long changes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& report : stream) changes += merger.update(report.first, report.second.data(), 8);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%zu reports from %u keyboards merged in %.3f ms: %.0f reports/s (%lu merged changes)\n", stream.size(),
+           unsigned(DEVICES), seconds * 1000, stream.size() / seconds, changes);
+    return 0;
+}
@@ -0,0 +1,244 @@
+// Host benchmark for the WiFiS3 polling strategy (ArduinoKeyBridge/ModemTransport.h).
+//
+//   keybridge_bench modem [--seconds S] [--poll-ms P] [--cps C]
+//
+// Runs the network task's poll loop against counting WiFiServer/WiFiClient
+// shims, where every call stands for one AT transaction to the modem. The
+// link alternates between idle time and typing bursts of C characters per
+// second sent as raw frames. Compares the calls the old transport made
+// (connected() every poll, available() before every read, flush after every
+// write) with ModemTransport, checks that both deliver the same reports and
+// prints modem transactions per second and the extra delay before a frame
+// is read.
+
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "BridgeClock.h"
+#include "BridgeFraming.h"
+#include "ModemTransport.h"
+#include "BenchHarness.h"
+
+namespace {
+    VirtualClock clock_;
+    uint32_t shimCalls = 0;
+
+    struct Arrival {
+        unsigned long ms;
+        uint8_t byte;
+    };
+
+    // Bytes the peer has sent, visible once their arrival time has passed
+    struct Peer {
+        std::deque<Arrival> pending;
+        bool open = true;
+        unsigned long maxDelayMs = 0;
+        uint64_t delaySumMs = 0;
+        uint32_t delayed = 0;
+
+        size_t ready() const {
+            size_t n = 0;
+            for (const Arrival& a : pending) {
+                if (a.ms > clock_.millis()) break;
+                n++;
+            }
+            return n;
+        }
+    };
+
+    class FakeClient {
+    public:
+        FakeClient() = default;
+        explicit FakeClient(std::shared_ptr<Peer> peer) : peer_(std::move(peer)) {}
+
+        explicit operator bool() const { return peer_ != nullptr; }
+        bool connected() {
+            shimCalls++;
+            return peer_ && peer_->open;
+        }
+        int available() {
+            shimCalls++;
+            return peer_ ? int(peer_->ready()) : 0;
+        }
+        int read(uint8_t* buf, size_t length) {
+            shimCalls++;
+            size_t n = 0;
+            while (peer_ && n < length && n < peer_->ready()) {
+                const Arrival& a = peer_->pending.front();
+                // Time from arrival at the modem until the sketch read it
+                unsigned long delay = clock_.millis() - a.ms;
+                peer_->delaySumMs += delay;
+                peer_->delayed++;
+                if (delay > peer_->maxDelayMs) peer_->maxDelayMs = delay;
+                buf[n++] = a.byte;
+                peer_->pending.pop_front();
+            }
+            return int(n);
+        }
+        size_t write(const uint8_t*, size_t length) {
+            shimCalls++;
+            return peer_ && peer_->open ? length : 0;
+        }
+        void flush() { shimCalls++; }
+
+    private:
+        std::shared_ptr<Peer> peer_;
+    };
+
+    class FakeServer {
+    public:
+        explicit FakeServer(uint16_t) {}
+        FakeClient available() {
+            shimCalls++;
+            if (!incoming) return FakeClient();
+            FakeClient client(incoming);
+            incoming.reset();
+            return client;
+        }
+        std::shared_ptr<Peer> incoming;
+    };
+
+    // The old WiFiTcpTransport call pattern
+    class DirectTransport : public Transport {
+    public:
+        explicit DirectTransport(uint16_t port) : server_(port) {}
+        bool accept() override {
+            if (client_ && client_.connected()) return false;
+            client_ = server_.available();
+            return bool(client_);
+        }
+        bool connected() override { return client_ && client_.connected(); }
+        int available() override { return client_.available(); }
+        int read() override {
+            uint8_t b;
+            if (client_.available() <= 0 || client_.read(&b, 1) != 1) return -1;
+            return b;
+        }
+        int read(uint8_t* buf, size_t length) override {
+            return client_.available() > 0 ? client_.read(buf, length) : 0;
+        }
+        size_t write(const uint8_t* data, size_t length) override {
+            size_t n = client_.write(data, length);
+            client_.flush();
+            return n;
+        }
+        size_t maxPayload() const override { return 536; }
+        const char* name() const override { return "direct"; }
+        FakeServer& server() { return server_; }
+
+    private:
+        FakeServer server_;
+        FakeClient client_;
+    };
+
+    class PolledTransport : public ModemTransport<FakeServer, FakeClient> {
+    public:
+        explicit PolledTransport(uint16_t port) : ModemTransport(port) {}
+        size_t maxPayload() const override { return 536; }
+        const char* name() const override { return "modem"; }
+        FakeServer& server() { return server_; }
+    };
+
+    struct Result {
+        double idleCallsPerSecond = 0;
+        double typingCallsPerSecond = 0;
+        double meanDelayMs = 0;
+        unsigned long maxDelayMs = 0;
+        std::vector<uint8_t> keys;
+    };
+
+    // Same traffic for both transports: a client connects, then 2 s idle and
+    // 1 s of typing alternate; every tenth frame gets a one frame answer
+    template <typename T>
+    Result run(T& transport, unsigned long seconds, unsigned long pollMs, unsigned long cps) {
+        clock_.set(0);
+        shimCalls = 0;
+        BridgeClock::set(&clock_);
+
+        auto peer = std::make_shared<Peer>();
+        transport.server().incoming = peer;
+        unsigned long interval = 1000 / cps;
+        uint8_t key = 4;
+        for (unsigned long ms = 100; ms < seconds * 1000; ms += interval) {
+            if ((ms / 1000) % 3 != 2) continue; // Typing in every third second
+            uint8_t press[8] = {0, 0, key, 0, 0, 0, 0, 0};
+            uint8_t release[8] = {};
+            for (uint8_t b : press) peer->pending.push_back({ms, b});
+            for (uint8_t b : release) peer->pending.push_back({ms + interval / 2, b});
+            key = key == 0x1D ? 4 : key + 1;
+        }
+
+        Result result;
+        BridgeFraming::FrameParser parser;
+        uint32_t frames = 0;
+        uint32_t idleCalls = 0, typingCalls = 0;
+        unsigned long idleMs = 0, typingMs = 0;
+        // A little longer than the traffic, so the last frames are read
+        for (unsigned long now = 0; now < seconds * 1000 + 50; now += pollMs) {
+            clock_.set(uint64_t(now) * 1000);
+            uint32_t before = shimCalls;
+            transport.accept();
+            while (transport.available() > 0) {
+                int b = transport.read();
+                if (b < 0) break;
+                if (parser.feed(uint8_t(b)) != BridgeFraming::FrameParser::REPORT) continue;
+                if (parser.report().keys[0]) result.keys.push_back(parser.report().keys[0]);
+                if (++frames % 10 == 0) {
+                    uint8_t answer[8] = {0x22, 0, 0x10, 0, 0, 0, 0, 0};
+                    transport.write(answer, sizeof(answer));
+                }
+            }
+            transport.flush();
+            if (now >= seconds * 1000) continue;
+            if ((now / 1000) % 3 == 2) {
+                typingCalls += shimCalls - before;
+                typingMs += pollMs;
+            } else {
+                idleCalls += shimCalls - before;
+                idleMs += pollMs;
+            }
+        }
+        BridgeClock::set(nullptr);
+
+        result.idleCallsPerSecond = idleMs ? idleCalls * 1000.0 / idleMs : 0;
+        result.typingCallsPerSecond = typingMs ? typingCalls * 1000.0 / typingMs : 0;
+        result.meanDelayMs = peer->delayed ? double(peer->delaySumMs) / peer->delayed : 0;
+        result.maxDelayMs = peer->maxDelayMs;
+        return result;
+    }
+
+    void print(const char* name, const Result& r) {
+        printf("%-8s idle %7.1f calls/s  typing %7.1f calls/s  read delay mean %.2f ms max %lu ms  (%zu keys)\n", name,
+               r.idleCallsPerSecond, r.typingCallsPerSecond, r.meanDelayMs, r.maxDelayMs, r.keys.size());
+    }
+}
+
+KEYBRIDGE_BENCH(modem, "[--seconds S] [--poll-ms P] [--cps C]") {
+    unsigned long seconds = args.number("--seconds", 30ul);
+    unsigned long pollMs = args.number("--poll-ms", 2ul);
+    unsigned long cps = args.number("--cps", 15ul);
+    if (!args.done()) return 2;
+    if (seconds < 3 || pollMs == 0 || cps == 0 || cps > 500) return 2;
+
+    DirectTransport direct(8080);
+    Result before = run(direct, seconds, pollMs, cps);
+    PolledTransport polled(8080);
+    Result after = run(polled, seconds, pollMs, cps);
+
+    printf("%lu s, poll every %lu ms, typing %lu chars/s one second in three\n", seconds, pollMs, cps);
+    print("direct", before);
+    print("modem", after);
+    const auto& stats = polled.stats();
+    printf("modem stats: accepts %lu connected %lu available %lu reads %lu writes %lu\n", (unsigned long)stats.accepts,
+           (unsigned long)stats.connected, (unsigned long)stats.available, (unsigned long)stats.reads,
+           (unsigned long)stats.writes);
+
+    bool ok = !before.keys.empty() && before.keys == after.keys;
+    // Every counted transaction is a shim call and the other way round
+    ok &= stats.total() == shimCalls;
+    ok &= after.maxDelayMs <= PolledTransport::MAX_IDLE_BACKOFF_MS + pollMs;
+    printf("%s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
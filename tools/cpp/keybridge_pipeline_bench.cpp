@@ -0,0 +1,127 @@
+// Host benchmark for the KeyPipeline used by handle_new_key_report.
+//
+//   keybridge_bench pipeline [--reports N] [--rounds R]
+//
+// Runs a stream of reports through compile-time pipelines of 1..32 stages and,
+// for comparison, through the same stages called via a virtual interface, and
+// prints the cost per report.
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "KeyPipeline.h"
+#include "BenchHarness.h"
+
+namespace {
+    // A stage that does roughly what the real ones do: one or two compares,
+    // a counter, sometimes a modification and rarely consuming the report
+    template <size_t N>
+    class BenchStage {
+    public:
+        KeyPipeline::Result process(KeyReport& report) {
+            seen_++;
+            if (report.keys[0] == 0x70 + N % 16 && report.modifiers == 0x80) return KeyPipeline::CONSUMED;
+            if (report.modifiers & 0x01) report.reserved ^= uint8_t(N);
+            return KeyPipeline::PASS;
+        }
+        uint32_t seen() const { return seen_; }
+
+    private:
+        uint32_t seen_ = 0;
+    };
+
+    template <size_t... I>
+    KeyPipeline::Pipeline<BenchStage<I>...> makePipeline(std::index_sequence<I...>);
+
+    template <size_t N>
+    using BenchPipeline = decltype(makePipeline(std::make_index_sequence<N>()));
+
+    // The same stages behind a virtual interface, as a runtime-configured chain would be
+    class DynamicStage {
+    public:
+        virtual ~DynamicStage() = default;
+        virtual KeyPipeline::Result process(KeyReport& report) = 0;
+    };
+
+    template <size_t N>
+    class DynamicBenchStage : public DynamicStage {
+    public:
+        KeyPipeline::Result process(KeyReport& report) override { return stage_.process(report); }
+    private:
+        BenchStage<N> stage_;
+    };
+
+    template <size_t... I>
+    std::vector<std::unique_ptr<DynamicStage>> makeDynamic(std::index_sequence<I...>) {
+        std::vector<std::unique_ptr<DynamicStage>> stages;
+        (stages.emplace_back(new DynamicBenchStage<I>()), ...);
+        return stages;
+    }
+
+    std::vector<KeyReport> makeReports(size_t count) {
+        std::mt19937 rng(42);
+        std::vector<KeyReport> reports(count);
+        for (KeyReport& report : reports) {
+            report.modifiers = uint8_t(rng() & 0x83);
+            report.reserved = 0;
+            for (uint8_t& key : report.keys) key = (rng() % 3 == 0) ? uint8_t(0x04 + rng() % 0x70) : 0;
+        }
+        return reports;
+    }
+
+    template <typename Process>
+    double measure(const std::vector<KeyReport>& reports, int rounds, Process&& process, uint32_t& checksum) {
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r) {
+            for (const KeyReport& original : reports) {
+                KeyReport report = original;
+                checksum += process(report) + report.reserved;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return seconds * 1e9 / (double(reports.size()) * rounds);
+    }
+
+    template <size_t N>
+    void runStageCount(const std::vector<KeyReport>& reports, int rounds) {
+        uint32_t checksum = 0;
+
+        BenchPipeline<N> pipeline;
+        double staticNs = measure(reports, rounds,
+            [&](KeyReport& report) { return pipeline.process(report); }, checksum);
+
+        auto dynamic = makeDynamic(std::make_index_sequence<N>());
+        double dynamicNs = measure(reports, rounds, [&](KeyReport& report) {
+            for (auto& stage : dynamic) {
+                if (stage->process(report) == KeyPipeline::CONSUMED) return KeyPipeline::CONSUMED;
+            }
+            return KeyPipeline::PASS;
+        }, checksum);
+
+        printf("%6zu  %12.2f  %12.2f  %12.2f  (checksum %08x, first stage saw %u)\n", N, staticNs,
+               staticNs / N, dynamicNs, checksum, pipeline.template stage<0>().seen());
+    }
+}
+
+KEYBRIDGE_BENCH(pipeline, "[--reports N] [--rounds R]") {
+    size_t count = args.number("--reports", size_t(100000));
+    int rounds = args.number("--rounds", 50);
+    if (!args.done()) return 2;
+    if (count == 0 || rounds <= 0) return 2;
+
+    std::vector<KeyReport> reports = makeReports(count);
+    printf("%zu reports x %d rounds\n", count, rounds);
+    printf("stages  ns/report     ns/stage      virtual ns/report\n");
+    runStageCount<1>(reports, rounds);
+    runStageCount<2>(reports, rounds);
+    runStageCount<4>(reports, rounds);
+    runStageCount<5>(reports, rounds);
+    runStageCount<8>(reports, rounds);
+    runStageCount<16>(reports, rounds);
+    runStageCount<32>(reports, rounds);
+    return 0;
+}
@@ -0,0 +1,132 @@
+// Host benchmark for KeyRemap, the layered remapping applied by the
+// firmware's RemapStage.
+//
+//   keybridge_bench remap [--reports N] [--rounds R]
+//
+// Builds a four layer table blob, checks a few mappings, then measures the
+// cost per report with layers idle and with a layer key pressed every 16
+// reports (which rebuilds the flattened tables).
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Crc16.h"
+#include "KeyRemap.h"
+#include "BenchHarness.h"
+
+namespace {
+    constexpr uint8_t MOMENTARY_KEY = 0x68; // F13
+    constexpr uint8_t TOGGLE_KEY = 0x69;    // F14
+
+    std::vector<uint8_t> makeBlob(uint8_t layers) {
+        std::vector<uint8_t> blob = {'K', 'R', KeyRemap::VERSION, layers};
+        for (uint8_t i = 0; i < layers; ++i) {
+            size_t offset = blob.size();
+            blob.resize(offset + KeyRemap::LAYER_SIZE, KeyRemap::TRANSPARENT);
+            uint8_t* layer = blob.data() + offset;
+            layer[0] = i == 0 ? KeyRemap::BASE : (i % 2 ? KeyRemap::MOMENTARY : KeyRemap::TOGGLE);
+            layer[1] = i == 0 ? 0 : (i % 2 ? MOMENTARY_KEY : TOGGLE_KEY) + 2 * ((i - 1) / 2);
+            memset(layer + 2, KeyRemap::MOD_TRANSPARENT, 8);
+            uint8_t* keys = layer + 10;
+            if (i == 0) {
+                keys[0x39] = 0xE0;       // Caps Lock -> Left Control
+                layer[2 + 2] = 0x08;     // Left Alt -> Left GUI
+                layer[2 + 3] = 0x04;     // Left GUI -> Left Alt
+            } else if (i == 1) {
+                keys[0x0B] = 0x50;       // h j k l -> arrows
+                keys[0x0D] = 0x51;
+                keys[0x0E] = 0x52;
+                keys[0x0F] = 0x4F;
+            } else {
+                for (int k = 0x04; k <= 0x1D; ++k) keys[k] = uint8_t(0x1D + 0x04 - k); // Reversed alphabet
+                keys[0x04] = KeyRemap::BLOCKED;
+            }
+        }
+        uint16_t crc = crc16(blob.data(), blob.size());
+        blob.push_back(uint8_t(crc & 0xFF));
+        blob.push_back(uint8_t(crc >> 8));
+        return blob;
+    }
+
+    KeyReport report(uint8_t modifiers, uint8_t key0, uint8_t key1 = 0) {
+        return KeyReport{modifiers, 0, {key0, key1, 0, 0, 0, 0}};
+    }
+
+    bool check(KeyRemap& remap, KeyReport input, uint8_t modifiers, uint8_t key0, const char* what) {
+        remap.apply(input);
+        bool ok = input.modifiers == modifiers && input.keys[0] == key0 && input.keys[1] == 0;
+        if (!ok) {
+            printf("FAIL %s: got %02x %02x %02x\n", what, input.modifiers, input.keys[0], input.keys[1]);
+        }
+        return ok;
+    }
+
+    bool selfTest() {
+        std::vector<uint8_t> blob = makeBlob(3);
+        KeyRemap remap;
+        if (!remap.load(blob.data(), blob.size())) {
+            printf("FAIL blob does not load\n");
+            return false;
+        }
+        bool ok = true;
+        ok &= check(remap, report(0, 0x39), 0x01, 0, "caps lock to control");
+        ok &= check(remap, report(0x04, 0x06), 0x08, 0x06, "alt to gui");
+        ok &= check(remap, report(0, 0x0B), 0, 0x0B, "h without layer");
+        ok &= check(remap, report(0, MOMENTARY_KEY, 0x0B), 0, 0x50, "h on momentary layer");
+        ok &= check(remap, report(0, 0x0B), 0, 0x0B, "h after releasing layer key");
+        ok &= check(remap, report(0, TOGGLE_KEY), 0, 0, "toggle key swallowed");
+        ok &= check(remap, report(0, 0x04), 0, 0, "a blocked on toggle layer");
+        ok &= check(remap, report(0, 0), 0, 0, "release");
+        ok &= check(remap, report(0, TOGGLE_KEY), 0, 0, "toggle off");
+        ok &= check(remap, report(0, 0x04), 0, 0x04, "a back to normal");
+
+        blob[10] ^= 0x01;
+        ok &= !remap.load(blob.data(), blob.size());
+        printf("self test: %s\n", ok ? "ok" : "FAILED");
+        return ok;
+    }
+
+    void measure(uint8_t layers, bool switching, const std::vector<KeyReport>& reports, int rounds) {
+        std::vector<uint8_t> blob = makeBlob(layers);
+        KeyRemap remap;
+        remap.load(blob.data(), blob.size());
+
+        uint32_t checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r) {
+            for (size_t i = 0; i < reports.size(); ++i) {
+                KeyReport report = reports[i];
+                if (switching && i % 16 == 0) report.keys[5] = MOMENTARY_KEY;
+                remap.apply(report);
+                checksum += report.modifiers + report.keys[0];
+            }
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()
+                    / (double(reports.size()) * rounds);
+        printf("%6u  %-9s  %10.2f  (checksum %08x)\n", layers, switching ? "yes" : "no", ns, checksum);
+    }
+}
+
+KEYBRIDGE_BENCH(remap, "[--reports N] [--rounds R]") {
+    size_t count = args.number("--reports", size_t(100000));
+    int rounds = args.number("--rounds", 20);
+    if (!args.done()) return 2;
+    if (count == 0 || rounds <= 0) return 2;
+    if (!selfTest()) return 1;
+
+    std::mt19937 rng(3);
+    std::vector<KeyReport> reports(count);
+    for (KeyReport& report : reports) {
+        report = KeyReport{uint8_t(rng() & 0x0F), 0, {0, 0, 0, 0, 0, 0}};
+        for (int k = 0; k < 3; ++k) report.keys[k] = uint8_t(0x04 + rng() % 0x60);
+    }
+
+    printf("layers  switching  ns/report\n");
+    measure(1, false, reports, rounds);
+    measure(4, false, reports, rounds);
+    measure(4, true, reports, rounds);
+    return 0;
+}
@@ -0,0 +1,139 @@
+// Host test for the loop scheduler (ArduinoKeyBridge/TaskScheduler.h).
+//
+//   keybridge_bench scheduler [--seconds N] [--stall-ms N] [--seed S]
+//
+// Registers the firmware's four tasks with their setup() parameters and runs
+// them on a VirtualClock. Each task advances the clock by a runtime drawn
+// around what it costs on the board: usb 50-300 us, network 200-800 us, leds
+// 300-900 us, status 5 ms. An idle loop() costs 10 us.
+//
+// The first half of the run has no stalls. In the second half one network
+// run in every 250 takes --stall-ms longer (30 ms by default), like a
+// blocking modem write. Checks that:
+//
+//   - the usb task never waits longer than the longest run of another task:
+//     tasks are cooperative, but usb goes first whenever one finishes
+//   - without stalls only the status task makes it miss its 1 ms deadline
+//   - every stall shows up as a network overrun and a usb deadline miss
+//   - the usb task runs or counts a skipped release for every period, give
+//     or take the part of a period lost when it resynchronises after a miss
+//
+// and prints the per-task stats statusTask() logs.
+
+#include <cstdio>
+#include <random>
+
+#include "BridgeClock.h"
+#include "TaskScheduler.h"
+#include "BenchHarness.h"
+
+namespace {
+    // From ArduinoKeyBridge.ino
+    constexpr unsigned long USB_PERIOD = 1000;
+    constexpr unsigned long NETWORK_PERIOD = 2000;
+    constexpr unsigned long LED_PERIOD = 33 * 1000;
+    constexpr unsigned long STATUS_PERIOD = 10000 * 1000;
+
+    constexpr unsigned long NETWORK_MAX_US = 800;
+    constexpr unsigned long IDLE_US = 10;
+    constexpr unsigned STALL_EVERY = 250;
+
+    VirtualClock board;
+    std::mt19937 rng;
+    bool stalls = false;
+    unsigned long stallUs = 30000;
+    unsigned networkRuns = 0;
+    unsigned stallCount = 0;
+
+    void spend(unsigned long low, unsigned long high) { board.advance(low + rng() % (high - low + 1)); }
+
+    void usbTask() { spend(50, 300); }
+    void networkTask() {
+        spend(200, NETWORK_MAX_US);
+        if (stalls && ++networkRuns % STALL_EVERY == 0) {
+            board.advance(stallUs);
+            stallCount++;
+        }
+    }
+    void ledTask() { spend(300, 900); }
+    void statusTask() { spend(5000, 5000); }
+
+    void print(const char* phase) {
+        TaskScheduler& scheduler = TaskScheduler::getInstance();
+        printf("%s\n", phase);
+        for (size_t i = 0; i < scheduler.taskCount(); ++i) {
+            const TaskScheduler::TaskStats& stats = scheduler.stats(int(i));
+            printf("  %-8s runs %7u  latency avg/max %5llu/%6lu us  runtime avg/max %5llu/%6lu us  "
+                   "overruns %4u  deadline misses %4u  skipped %4u\n",
+                   scheduler.taskName(i), stats.runs,
+                   (unsigned long long)(stats.runs ? stats.totalLatencyUs / stats.runs : 0), stats.maxLatencyUs,
+                   (unsigned long long)(stats.runs ? stats.totalRuntimeUs / stats.runs : 0), stats.maxRuntimeUs,
+                   stats.overruns, stats.deadlineMisses, stats.skipped);
+        }
+    }
+
+    void run(uint64_t us) {
+        uint64_t end = board.now() + us;
+        while (board.now() < end) {
+            if (!TaskScheduler::getInstance().runOnce()) board.advance(IDLE_US);
+        }
+    }
+
+    unsigned long longestOtherRun(int task) {
+        TaskScheduler& scheduler = TaskScheduler::getInstance();
+        unsigned long longest = 0;
+        for (size_t i = 0; i < scheduler.taskCount(); ++i) {
+            if (int(i) != task && scheduler.stats(int(i)).maxRuntimeUs > longest) longest = scheduler.stats(int(i)).maxRuntimeUs;
+        }
+        return longest;
+    }
+
+    // Every release of the usb task either ran or was counted as skipped.
+    // Resynchronising after falling behind drops the rest of a period.
+    bool accounted(const TaskScheduler::TaskStats& usb, uint64_t us) {
+        uint64_t periods = us / USB_PERIOD;
+        uint64_t seen = uint64_t(usb.runs) + usb.skipped;
+        return seen + usb.deadlineMisses + 2 >= periods && seen <= periods + 2;
+    }
+}
+
+KEYBRIDGE_BENCH(scheduler, "[--seconds N] [--stall-ms N] [--seed S]") {
+    unsigned long seconds = args.number("--seconds", 60ul);
+    stallUs = args.number("--stall-ms", stallUs / 1000) * 1000;
+    unsigned seed = args.number("--seed", 1u);
+    if (!args.done()) return 2;
+    rng.seed(seed);
+    BridgeClock::set(&board);
+
+    TaskScheduler& scheduler = TaskScheduler::getInstance();
+    int usb = scheduler.addTask("usb", usbTask, 0, USB_PERIOD, USB_PERIOD, 1000);
+    int network = scheduler.addTask("network", networkTask, 1, NETWORK_PERIOD, 5000, 5000);
+    scheduler.addTask("leds", ledTask, 2, LED_PERIOD, LED_PERIOD, 2000);
+    int status = scheduler.addTask("status", statusTask, 3, STATUS_PERIOD, 1000000, 20000);
+
+    bool ok = true;
+    uint64_t half = uint64_t(seconds) * 1000000 / 2;
+    run(half);
+    print("no stalls:");
+    const TaskScheduler::TaskStats& usbStats = scheduler.stats(usb);
+    const TaskScheduler::TaskStats& networkStats = scheduler.stats(network);
+    const TaskScheduler::TaskStats& statusStats = scheduler.stats(status);
+    bool bounded = usbStats.maxLatencyUs <= longestOtherRun(usb) + IDLE_US;
+    bool quiet = usbStats.deadlineMisses <= statusStats.runs;
+    printf("  usb waits at most one run of another task (%lu us): %s\n", longestOtherRun(usb), bounded ? "yes" : "NO");
+    printf("  usb deadline misses only behind the status task: %s\n", quiet ? "yes" : "NO");
+    ok &= bounded && quiet && accounted(usbStats, half);
+
+    scheduler.resetStats();
+    stalls = true;
+    run(half);
+    char phase[64];
+    snprintf(phase, sizeof(phase), "%u network stalls of %lu ms:", stallCount, stallUs / 1000);
+    print(phase);
+    bounded = usbStats.maxLatencyUs <= longestOtherRun(usb) + IDLE_US;
+    bool visible = networkStats.overruns == stallCount && usbStats.deadlineMisses >= stallCount;
+    printf("  usb waits at most one run of another task (%lu us): %s\n", longestOtherRun(usb), bounded ? "yes" : "NO");
+    printf("  every stall counted as a network overrun and a usb deadline miss: %s\n", visible ? "yes" : "NO");
+    ok &= bounded && visible && stallCount > 0 && accounted(usbStats, half);
+    return ok ? 0 : 1;
+}
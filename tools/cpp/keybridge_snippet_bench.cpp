@@ -0,0 +1,209 @@
+// Host test and lookup benchmark for the snippet library
+// (ArduinoKeyBridge/SnippetLibrary.h).
+//
+//   keybridge_bench snippet [--lookups N] [--seed S]
+//
+// Builds a library that fills the data flash region (FlashLayout.h): one
+// 4 KB snippet and as many short ones as fit. Checks that:
+//
+//   - every snippet is found by id and by name, with its text intact
+//   - ids and names that aren't in the library are not found
+//   - an image with any single byte changed is rejected
+//
+// Then measures lookups per second by id and by name, and counts the image
+// bytes each lookup reads, against a linear scan of the image in flash.
+// Also prints how long typing the 4 KB snippet takes through HidReportQueue.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "FlashLayout.h"
+#include "HidReportQueue.h"
+#include "MagicKeyboardKeyMap.h"
+#include "RolloverTyper.h"
+#include "SnippetLibrary.h"
+#include "BenchHarness.h"
+
+namespace {
+    // Counts image reads, the cost of a flash access on the board
+    class CountingReader : public SnippetLibrary::Reader {
+    public:
+        explicit CountingReader(const std::vector<uint8_t>& image) : image_(image) {}
+        uint8_t read(size_t offset) const override {
+            reads++;
+            return image_[offset];
+        }
+        mutable size_t reads = 0;
+    private:
+        const std::vector<uint8_t>& image_;
+    };
+
+    struct Spec {
+        uint16_t id;
+        std::string name;
+        std::string text;
+    };
+
+    std::string randomText(std::mt19937& rng, size_t length) {
+        static const char CHARS[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789.,;:-_/\n";
+        std::string text;
+        for (size_t i = 0; i < length; ++i) text += CHARS[rng() % (sizeof(CHARS) - 1)];
+        return text;
+    }
+
+    std::vector<uint8_t> buildImage(const std::vector<Spec>& specs) {
+        std::vector<SnippetLibrary::Source> sources;
+        for (const Spec& spec : specs) {
+            sources.push_back({spec.id, spec.name.c_str(), spec.text.c_str(), spec.text.size()});
+        }
+        std::vector<uint8_t> image(FlashLayout::SNIPPET_SIZE);
+        image.resize(SnippetLibrary::build(sources.data(), sources.size(), image.data(), image.size()));
+        return image;
+    }
+
+    // Linear scan of the image, what a lookup costs without the RAM index
+    bool scanForId(const SnippetLibrary::Reader& reader, uint16_t id) {
+        size_t count = reader.read(3);
+        for (size_t i = 0; i < count; ++i) {
+            size_t at = SnippetLibrary::HEADER_SIZE + i * SnippetLibrary::ENTRY_SIZE;
+            if ((reader.read(at) | (reader.read(at + 1) << 8)) == id) return true;
+        }
+        return false;
+    }
+
+    template <typename F>
+    double perSecond(size_t n, F f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return n / seconds;
+    }
+}
+
+KEYBRIDGE_BENCH(snippet, "[--lookups N] [--seed S]") {
+    size_t lookups = args.number("--lookups", size_t(2000000));
+    unsigned seed = args.number("--seed", 1u);
+    if (!args.done()) return 2;
+
+    std::mt19937 rng(seed);
+    std::vector<Spec> specs;
+    // One 4 KB snippet, the rest short, in random id order
+    specs.push_back({uint16_t(1 + rng() % 1000), "big", randomText(rng, 4096)});
+    while (specs.size() < SnippetLibrary::MAX_SNIPPETS) {
+        uint16_t id = uint16_t(1 + rng() % 1000);
+        bool taken = false;
+        for (const Spec& spec : specs) taken |= spec.id == id;
+        if (taken) continue;
+        specs.push_back({id, "snippet" + std::to_string(specs.size()), randomText(rng, 2 + rng() % 8)});
+        // As many as fit next to the big one
+        if (buildImage(specs).empty()) {
+            specs.pop_back();
+            break;
+        }
+    }
+    std::vector<uint8_t> image = buildImage(specs);
+    if (image.empty()) {
+        printf("library does not fit %zu bytes\n", FlashLayout::SNIPPET_SIZE);
+        return 1;
+    }
+
+    CountingReader reader(image);
+    std::unique_ptr<SnippetLibrary> library(new SnippetLibrary());
+    bool ok = library->load(reader, FlashLayout::SNIPPET_SIZE);
+    size_t loadReads = reader.reads;
+    printf("%zu snippets, %zu byte image of %zu, index in RAM %zu bytes, load reads %zu bytes\n",
+           library->count(), image.size(), FlashLayout::SNIPPET_SIZE, sizeof(SnippetLibrary), loadReads);
+
+    // Every snippet by id and by name, text intact
+    size_t bad = 0;
+    for (const Spec& spec : specs) {
+        SnippetLibrary::Snippet byId, byName;
+        if (!library->find(spec.id, byId) || !library->find(spec.name.c_str(), byName) || byId.text != byName.text ||
+            byId.length != spec.text.size()) {
+            bad++;
+            continue;
+        }
+        for (size_t i = 0; i < byId.length; ++i) {
+            if (library->textAt(byId, i) != spec.text[i]) {
+                bad++;
+                break;
+            }
+        }
+    }
+    size_t falseHits = 0;
+    for (uint16_t id = 0; id < 2000; ++id) {
+        bool present = false;
+        for (const Spec& spec : specs) present |= spec.id == id;
+        SnippetLibrary::Snippet snippet;
+        if (!present && library->find(id, snippet)) falseHits++;
+    }
+    for (int i = 0; i < 1000; ++i) {
+        SnippetLibrary::Snippet snippet;
+        std::string name = "x" + std::to_string(i);
+        if (library->find(name.c_str(), snippet)) falseHits++;
+    }
+    printf("lookups: %zu wrong, %zu false hits\n", bad, falseHits);
+    ok &= bad == 0 && falseHits == 0;
+
+    // Any single changed byte must be rejected
+    size_t accepted = 0;
+    for (size_t at = 0; at < image.size(); ++at) {
+        std::vector<uint8_t> corrupt = image;
+        corrupt[at] ^= uint8_t(1 + rng() % 255);
+        SnippetLibrary::MemoryReader corruptReader(corrupt.data());
+        std::unique_ptr<SnippetLibrary> check(new SnippetLibrary());
+        if (check->load(corruptReader, corrupt.size())) accepted++;
+    }
+    printf("corrupted images: %zu of %zu accepted\n", accepted, image.size());
+    ok &= accepted == 0;
+
+    // Lookup speed and image reads per lookup
+    std::vector<uint16_t> ids;
+    std::vector<std::string> names;
+    for (size_t i = 0; i < 1024; ++i) {
+        const Spec& spec = specs[rng() % specs.size()];
+        ids.push_back(spec.id);
+        names.push_back(spec.name);
+    }
+    size_t found = 0;
+    reader.reads = 0;
+    double byIdRate = perSecond(lookups, [&]() {
+        SnippetLibrary::Snippet snippet;
+        for (size_t i = 0; i < lookups; ++i) found += library->find(ids[i & 1023], snippet);
+    });
+    double byIdReads = double(reader.reads) / lookups;
+    reader.reads = 0;
+    double byNameRate = perSecond(lookups, [&]() {
+        SnippetLibrary::Snippet snippet;
+        for (size_t i = 0; i < lookups; ++i) found += library->find(names[i & 1023].c_str(), snippet);
+    });
+    double byNameReads = double(reader.reads) / lookups;
+    reader.reads = 0;
+    double scanRate = perSecond(lookups, [&]() {
+        for (size_t i = 0; i < lookups; ++i) found += scanForId(reader, ids[i & 1023]);
+    });
+    double scanReads = double(reader.reads) / lookups;
+    printf("by id:   %6.1f M lookups/s  %5.1f image bytes read per lookup\n", byIdRate / 1e6, byIdReads);
+    printf("by name: %6.1f M lookups/s  %5.1f image bytes read per lookup\n", byNameRate / 1e6, byNameReads);
+    printf("scan:    %6.1f M lookups/s  %5.1f image bytes read per lookup\n", scanRate / 1e6, scanReads);
+    ok &= found == 3 * lookups;
+
+    // Typing the 4 KB snippet, one HID report per host poll
+    RolloverTyper typer;
+    KeyReport out[RolloverTyper::MAX_REPORTS_PER_KEY];
+    size_t reports = 0;
+    const std::string& big = specs[0].text;
+    for (size_t i = 0; i < big.size(); ++i) {
+        const KeyInfo* key = findKeyForChar(big[i]);
+        if (key) reports += typer.press(key->hexCode, key->shifted ? 0x02 : 0x00, out);
+        if ((i + 1) % 16 == 0 || i + 1 == big.size()) reports += typer.release(out);
+    }
+    printf("4 KB snippet: %zu reports, typed in %.2f s at one report per %lu us\n", reports,
+           reports * HidReportQueue::DEFAULT_INTERVAL_US / 1e6, HidReportQueue::DEFAULT_INTERVAL_US);
+    return ok ? 0 : 1;
+}
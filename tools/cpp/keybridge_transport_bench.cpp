@@ -0,0 +1,113 @@
+// Host benchmark for the transport framing shared by every link
+// (ArduinoKeyBridge/Transport.h, BridgeFraming.h).
+//
+//   keybridge_bench transport [--text FILE] [--rounds R] [--burst N]
+//
+// Types a text as key reports through a FrameWriter on one end of a
+// LoopbackTransport and parses them with a FrameParser on the other end,
+// with each backend's payload size and batching. Reports the framing cost
+// per event on the host and the bytes and packets per report the link would
+// carry, and checks that the parser rebuilds every report.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BridgeFraming.h"
+#include "LoopbackTransport.h"
+#include "MagicKeyboardKeyMap.h"
+#include "BenchHarness.h"
+
+namespace {
+    struct Profile {
+        const char* name;
+        size_t payload;
+        bool batch;
+        bool events;
+    };
+
+    // Payload sizes and batching match the firmware backends
+    const Profile PROFILES[] = {
+        {"wifi-tcp raw", 536, false, false},
+        {"wifi-tcp events", 536, false, true},
+        {"serial events", 64, false, true},
+        {"ble-20 raw", 20, true, false},
+        {"ble-20 events", 20, true, true},
+        {"ble-244 events", 244, true, true},
+    };
+
+    const char* SAMPLE_TEXT =
+        "The quick brown fox jumps over the lazy dog. PACK MY BOX WITH FIVE DOZEN LIQUOR JUGS!\n"
+        "int main(int argc, char** argv) { return argc > 1 ? atoi(argv[1]) : 0; }\n";
+
+    std::vector<KeyReport> typeText(const std::string& text) {
+        std::vector<KeyReport> reports;
+        for (char c : text) {
+            const KeyInfo* key = findKeyForChar(c);
+            if (!key) continue;
+            reports.push_back(KeyReport{uint8_t(key->shifted ? 0x02 : 0x00), 0, {key->hexCode, 0, 0, 0, 0, 0}});
+            reports.push_back(KeyReport{0, 0, {0, 0, 0, 0, 0, 0}});
+        }
+        return reports;
+    }
+
+    bool sameReport(const KeyReport& a, const KeyReport& b) {
+        return memcmp(&a, &b, sizeof(KeyReport)) == 0;
+    }
+
+    void run(const Profile& profile, const std::vector<KeyReport>& reports, int rounds, size_t burst) {
+        std::unique_ptr<LoopbackTransport> device(new LoopbackTransport(profile.payload, profile.batch));
+        std::unique_ptr<LoopbackTransport> host(new LoopbackTransport(profile.payload));
+        device->connect(*host);
+        device->accept();
+        host->accept();
+
+        BridgeFraming::FrameWriter writer;
+        BridgeFraming::FrameParser parser;
+        writer.setTransport(device.get());
+        writer.setEventEncoding(profile.events);
+        parser.setEventEncoding(profile.events);
+
+        size_t events = 0;
+        size_t mismatches = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r) {
+            // One burst per poll(), as the firmware flushes at the end of each
+            for (size_t i = 0; i < reports.size(); i += burst) {
+                size_t end = i + burst < reports.size() ? i + burst : reports.size();
+                for (size_t j = i; j < end; ++j) writer.write(reports[j]);
+                writer.flush();
+                while (host->available() > 0) {
+                    if (parser.feed(uint8_t(host->read())) == BridgeFraming::FrameParser::REPORT) events++;
+                }
+                if (!sameReport(parser.report(), reports[end - 1])) mismatches++;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double total = double(reports.size()) * rounds;
+
+        printf("%-16s  %7zu  %12.0f  %9.2f  %11.3f  %8.2f  %s\n", profile.name, profile.payload,
+               events / seconds, double(writer.bytes()) / total, double(writer.packets()) / total,
+               total / writer.packets(), mismatches == 0 ? "ok" : "MISMATCH");
+    }
+}
+
+KEYBRIDGE_BENCH(transport, "[--text FILE] [--rounds R] [--burst N]") {
+    std::string text = SAMPLE_TEXT;
+    const char* path = args.text("--text");
+    int rounds = args.number("--rounds", 2000);
+    size_t burst = args.number("--burst", size_t(8));
+    if (!args.done()) return 2;
+    if (path && !Bench::readFile(path, text)) return 1;
+    std::vector<KeyReport> reports = typeText(text);
+    if (reports.empty() || rounds <= 0 || burst == 0) return 2;
+
+    printf("%zu reports per round, %zu per poll\n", reports.size(), burst);
+    printf("profile           payload    events/s  bytes/rpt  packets/rpt  rpt/pkt   check\n");
+    for (const Profile& profile : PROFILES) run(profile, reports, rounds, burst);
+    return 0;
+}